@@ -0,0 +1,245 @@
+// aabbtree.cpp - version 1.0
+// Functions declared in aabbtree.h.
+// See aabbtree.h for documentation of functions.
+
+#include "aabbtree.h"
+#include <algorithm>
+#include <cmath>
+
+const double AabbTree::FAT_MARGIN = .25;
+
+void AabbTree::rebuild(const std::vector<BoundingBox> &newBoxes) {
+	if (newBoxes.size() == boxes.size()) {
+		for (unsigned long i = 0; i < newBoxes.size(); i++) {
+			update(i, newBoxes[i]);
+		}
+		return;
+	}
+	boxes = newBoxes;
+	nodes.clear();
+	freeNodes.clear();
+	root = NONE;
+	ireinserts = 0;
+	nodes.reserve(2 * boxes.size());
+	leaf.resize(boxes.size());
+	std::vector<unsigned long> leaves(boxes.size());
+	for (unsigned long i = 0; i < boxes.size(); i++) {
+		unsigned long n = allocateNode();
+		nodes[n].box = fatten(boxes[i]);
+		nodes[n].ball = i;
+		leaf[i] = n;
+		leaves[i] = n;
+	}
+	if (!leaves.empty()) {
+		root = build(&leaves[0], leaves.size());
+		nodes[root].parent = NONE;
+	}
+}
+
+unsigned long AabbTree::build(unsigned long *first, unsigned long count) {
+	if (count == 1) return first[0];
+
+	// Split the leaves at the median of their centres along the longer side
+	// of the box bounding the centres
+	double minX = HUGE_VAL, minY = HUGE_VAL, maxX = -HUGE_VAL, maxY = -HUGE_VAL;
+	for (unsigned long k = 0; k < count; k++) {
+		const BoundingBox &box = nodes[first[k]].box;
+		double cx = box.x1() + box.x2(), cy = box.y1() + box.y2();
+		if (cx < minX) minX = cx;
+		if (cx > maxX) maxX = cx;
+		if (cy < minY) minY = cy;
+		if (cy > maxY) maxY = cy;
+	}
+	bool alongX = maxX - minX >= maxY - minY;
+	unsigned long half = count / 2;
+	std::nth_element(first, first + half, first + count, [&](unsigned long a, unsigned long b) {
+		const BoundingBox &ba = nodes[a].box, &bb = nodes[b].box;
+		return alongX ? ba.x1() + ba.x2() < bb.x1() + bb.x2() : ba.y1() + ba.y2() < bb.y1() + bb.y2();
+	});
+
+	unsigned long child1 = build(first, half);
+	unsigned long child2 = build(first + half, count - half);
+	unsigned long n = allocateNode();
+	Node &node = nodes[n];
+	node.child1 = child1;
+	node.child2 = child2;
+	node.box = nodes[child1].box.merge(nodes[child2].box);
+	node.height = 1 + (nodes[child1].height > nodes[child2].height ? nodes[child1].height : nodes[child2].height);
+	nodes[child1].parent = n;
+	nodes[child2].parent = n;
+	return n;
+}
+
+void AabbTree::update(unsigned long i, const BoundingBox &box) {
+	boxes[i] = box;
+	unsigned long n = leaf[i];
+	BoundingBox fat = fatten(box);
+
+	// Keep the leaf unless the box has left it, or the leaf is more than
+	// twice as large as it needs to be and slows down the queries
+	const BoundingBox &old = nodes[n].box;
+	if (old.contains(box) && old.perimeter() <= 2. * fat.perimeter()) return;
+	removeLeaf(n);
+	nodes[n].box = fat;
+	insertLeaf(n);
+	ireinserts++;
+}
+
+unsigned long AabbTree::allocateNode() {
+	unsigned long n;
+	if (!freeNodes.empty()) {
+		n = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else {
+		n = nodes.size();
+		nodes.push_back(Node());
+	}
+	Node &node = nodes[n];
+	node.parent = node.child1 = node.child2 = NONE;
+	node.ball = NONE;
+	node.height = 0;
+	return n;
+}
+
+void AabbTree::insertLeaf(unsigned long n) {
+	if (root == NONE) {
+		root = n;
+		nodes[n].parent = NONE;
+		return;
+	}
+
+	// Find the best sibling: descend while the cost of pairing the leaf with
+	// a child, plus the growth it causes in the nodes above, is less than
+	// pairing it with the node itself
+	const BoundingBox box = nodes[n].box;
+	unsigned long index = root;
+	while (nodes[index].child1 != NONE) {
+		const Node &node = nodes[index];
+		double area = node.box.perimeter();
+		double combined = node.box.merge(box).perimeter();
+		double cost = 2. * combined; // Of a new parent for this node and the leaf
+		double inherited = 2. * (combined - area); // Growth of the nodes above a deeper sibling
+		double childCost[2];
+		unsigned long child[2] = { node.child1, node.child2 };
+		for (int k = 0; k < 2; k++) {
+			const Node &c = nodes[child[k]];
+			childCost[k] = c.box.merge(box).perimeter() + inherited;
+			if (c.child1 != NONE) childCost[k] -= c.box.perimeter();
+		}
+		if (cost < childCost[0] && cost < childCost[1]) break;
+		index = childCost[0] < childCost[1] ? child[0] : child[1];
+	}
+
+	// New parent for the sibling and the leaf
+	unsigned long sibling = index;
+	unsigned long oldParent = nodes[sibling].parent;
+	unsigned long parent = allocateNode();
+	nodes[parent].parent = oldParent;
+	nodes[parent].box = box.merge(nodes[sibling].box);
+	nodes[parent].height = nodes[sibling].height + 1;
+	nodes[parent].child1 = sibling;
+	nodes[parent].child2 = n;
+	nodes[sibling].parent = parent;
+	nodes[n].parent = parent;
+	if (oldParent == NONE) root = parent;
+	else if (nodes[oldParent].child1 == sibling) nodes[oldParent].child1 = parent;
+	else nodes[oldParent].child2 = parent;
+
+	refitUpwards(oldParent);
+}
+
+void AabbTree::removeLeaf(unsigned long n) {
+	if (n == root) {
+		root = NONE;
+		return;
+	}
+
+	// The sibling takes the place of the parent
+	unsigned long parent = nodes[n].parent;
+	unsigned long grandParent = nodes[parent].parent;
+	unsigned long sibling = nodes[parent].child1 == n ? nodes[parent].child2 : nodes[parent].child1;
+	nodes[sibling].parent = grandParent;
+	if (grandParent == NONE) root = sibling;
+	else if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+	else nodes[grandParent].child2 = sibling;
+	freeNodes.push_back(parent);
+	refitUpwards(grandParent);
+}
+
+void AabbTree::refitUpwards(unsigned long n) {
+	while (n != NONE) {
+		n = balance(n);
+		Node &node = nodes[n];
+		const Node &c1 = nodes[node.child1];
+		const Node &c2 = nodes[node.child2];
+		node.height = 1 + (c1.height > c2.height ? c1.height : c2.height);
+		node.box = c1.box.merge(c2.box);
+		n = node.parent;
+	}
+}
+
+unsigned long AabbTree::balance(unsigned long a) {
+	Node &na = nodes[a];
+	if (na.child1 == NONE || na.height < 2) return a;
+	unsigned long b = na.child1;
+	unsigned long c = na.child2;
+	Node &nb = nodes[b];
+	Node &nc = nodes[c];
+	int difference = nc.height - nb.height;
+
+	if (difference > 1) {
+		// c becomes the parent of a and keeps its taller child
+		unsigned long f = nc.child1;
+		unsigned long g = nc.child2;
+		Node &nf = nodes[f];
+		Node &ng = nodes[g];
+		nc.child1 = a;
+		nc.parent = na.parent;
+		na.parent = c;
+		if (nc.parent == NONE) root = c;
+		else if (nodes[nc.parent].child1 == a) nodes[nc.parent].child1 = c;
+		else nodes[nc.parent].child2 = c;
+		unsigned long kept = f, moved = g;
+		if (nf.height <= ng.height) {
+			kept = g;
+			moved = f;
+		}
+		nc.child2 = kept;
+		na.child2 = moved;
+		nodes[moved].parent = a;
+		na.box = nb.box.merge(nodes[moved].box);
+		nc.box = na.box.merge(nodes[kept].box);
+		na.height = 1 + (nb.height > nodes[moved].height ? nb.height : nodes[moved].height);
+		nc.height = 1 + (na.height > nodes[kept].height ? na.height : nodes[kept].height);
+		return c;
+	}
+
+	if (difference < -1) {
+		// b becomes the parent of a and keeps its taller child
+		unsigned long d = nb.child1;
+		unsigned long e = nb.child2;
+		Node &nd = nodes[d];
+		Node &ne = nodes[e];
+		nb.child1 = a;
+		nb.parent = na.parent;
+		na.parent = b;
+		if (nb.parent == NONE) root = b;
+		else if (nodes[nb.parent].child1 == a) nodes[nb.parent].child1 = b;
+		else nodes[nb.parent].child2 = b;
+		unsigned long kept = d, moved = e;
+		if (nd.height <= ne.height) {
+			kept = e;
+			moved = d;
+		}
+		nb.child2 = kept;
+		na.child1 = moved;
+		nodes[moved].parent = a;
+		na.box = nc.box.merge(nodes[moved].box);
+		nb.box = na.box.merge(nodes[kept].box);
+		na.height = 1 + (nc.height > nodes[moved].height ? nc.height : nodes[moved].height);
+		nb.height = 1 + (na.height > nodes[kept].height ? na.height : nodes[kept].height);
+		return b;
+	}
+	return a;
+}
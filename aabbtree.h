@@ -0,0 +1,173 @@
+// aabbtree.h - version 1.0
+// Dynamic bounding volume hierarchy broad phase used by BallsSim to limit
+// the pairs of balls passed to findTimeUntilTwoBallsCollide(). Like
+// SweepAndPrune it has no cell size, so it copes with balls of very
+// different sizes, and it does not depend on their order along x.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef AABBTREE_H
+#define AABBTREE_H
+
+#include "boundingbox.h"
+#include <vector>
+#include <utility>
+
+// Each ball is represented by a bounding box (normally the box swept by the
+// ball over the rest of the frame), held in a leaf of a binary tree whose
+// inner nodes bound their children. A new tree is built top down by
+// splitting the leaves at the median of their centres. Leaves hold a fat
+// box, the ball's box grown by a fraction of its size, so a ball whose box
+// moves or changes a little keeps its leaf; only a box that leaves its fat
+// box, or shrinks well inside it, is removed and inserted again, and the
+// boxes of the nodes above it are refitted. A leaf is inserted next to the
+// node for which the growth in perimeter of the tree is least, and the nodes
+// above it are rotated to keep the tree balanced (as in the dynamic tree of
+// Box2D).
+//
+// Queries descend the tree through the fat boxes and test the ball's own
+// box at the leaves, so the candidates are the same as those of the other
+// broad phases; the margins only cost some extra descents.
+class AabbTree {
+	public:
+
+		// Fat box margin on each side, as a fraction of the width (or height)
+		// of a box. A box swept over a frame covers the distance its ball
+		// travels in a frame, so a quarter keeps the leaf of a slow ball for
+		// several frames. Larger margins save reinserts but make the queries
+		// descend into more nodes.
+		static const double FAT_MARGIN;
+
+		// Constructors
+		AabbTree() {
+			root = NONE;
+			ireinserts = 0;
+		}
+
+		// Registers boxes, replacing the previous ones. Box i belongs to ball
+		// i. If the number of boxes is unchanged the tree is updated with
+		// update() for each box, otherwise it is built from scratch.
+		void rebuild(const std::vector<BoundingBox> &newBoxes);
+
+		// Replaces the box of ball i, reinserting its leaf if needed
+		void update(unsigned long i, const BoundingBox &box);
+
+		// Calls f(i, j) with i < j for each pair of balls whose boxes overlap.
+		// The tree is descended against itself, so each pair of subtrees whose
+		// boxes overlap is visited once.
+		template <class F> void forEachPair(F f) const {
+			if (root == NONE) return;
+			std::vector<std::pair<unsigned long, unsigned long> > &stack = pairStack;
+			stack.clear();
+			stack.push_back(std::make_pair(root, root));
+			while (!stack.empty()) {
+				unsigned long a = stack.back().first;
+				unsigned long b = stack.back().second;
+				stack.pop_back();
+				const Node &na = nodes[a];
+				if (a == b) {
+					// Pairs within one subtree
+					if (na.child1 == NONE) continue;
+					stack.push_back(std::make_pair(na.child1, na.child1));
+					stack.push_back(std::make_pair(na.child2, na.child2));
+					stack.push_back(std::make_pair(na.child1, na.child2));
+					continue;
+				}
+				const Node &nb = nodes[b];
+				if (!na.box.overlaps(nb.box)) continue;
+				if (na.child1 == NONE && nb.child1 == NONE) {
+					if (boxes[na.ball].overlaps(boxes[nb.ball])) {
+						if (na.ball < nb.ball) f(na.ball, nb.ball);
+						else f(nb.ball, na.ball);
+					}
+				}
+				else if (nb.child1 == NONE || (na.child1 != NONE && na.height >= nb.height)) {
+					stack.push_back(std::make_pair(na.child1, b));
+					stack.push_back(std::make_pair(na.child2, b));
+				}
+				else {
+					stack.push_back(std::make_pair(a, nb.child1));
+					stack.push_back(std::make_pair(a, nb.child2));
+				}
+			}
+		}
+
+		// Calls f(j) for each ball j != i whose box overlaps the box of ball i
+		template <class F> void forEachCandidate(unsigned long i, F f) const {
+			forEachOverlap(boxes[i], [&](unsigned long j) {
+				if (j != i) f(j);
+			});
+		}
+
+		// Calls f(j) for each ball j whose box overlaps box
+		template <class F> void forEachOverlap(const BoundingBox &box, F f) const {
+			if (root == NONE) return;
+			unsigned long stack[MAX_DEPTH];
+			unsigned long top = 0;
+			stack[top++] = root;
+			while (top > 0) {
+				const Node &n = nodes[stack[--top]];
+				if (!n.box.overlaps(box)) continue;
+				if (n.child1 == NONE) {
+					if (boxes[n.ball].overlaps(box)) f(n.ball);
+				}
+				else {
+					stack[top++] = n.child1;
+					stack[top++] = n.child2;
+				}
+			}
+		}
+
+		// Get methods
+		// Height of the tree: 0 for a single leaf
+		int height() const { return root == NONE ? 0 : nodes[root].height; }
+		// Leaves reinserted by update() since the tree was last built from scratch
+		unsigned long long reinserts() const { return ireinserts; }
+
+	private:
+		static const unsigned long NONE = ~0UL; // No node
+		// Room on the stack of a query. Rotations keep the height of the tree
+		// under 1.45 log2 of the number of balls, so this is never reached.
+		static const unsigned long MAX_DEPTH = 128;
+
+		struct Node {
+			BoundingBox box; // Fat box of a leaf, or box bounding both children
+			unsigned long parent; // NONE for the root
+			unsigned long child1, child2; // NONE for a leaf
+			unsigned long ball; // Ball of a leaf
+			int height; // 0 for a leaf
+		};
+
+		std::vector<Node> nodes;
+		std::vector<unsigned long> freeNodes; // Unused entries of nodes
+		unsigned long root;
+		std::vector<BoundingBox> boxes; // Current box of each ball
+		std::vector<unsigned long> leaf; // Node of each ball
+		unsigned long long ireinserts; // See reinserts()
+		mutable std::vector<std::pair<unsigned long, unsigned long> > pairStack; // Scratch space of forEachPair()
+
+		// Fat box of a ball's box
+		static BoundingBox fatten(const BoundingBox &box) {
+			return box.grow(FAT_MARGIN * (box.x2() - box.x1()), FAT_MARGIN * (box.y2() - box.y1()));
+		}
+
+		// Builds a subtree over count leaves, reordering them. Returns its root.
+		unsigned long build(unsigned long *first, unsigned long count);
+
+		// Takes a node from freeNodes or the end of nodes
+		unsigned long allocateNode();
+
+		// Puts leaf into the tree, or takes it out, keeping it balanced
+		void insertLeaf(unsigned long leaf);
+		void removeLeaf(unsigned long leaf);
+
+		// Refits and rebalances the nodes from n up to the root
+		void refitUpwards(unsigned long n);
+
+		// Rotates the child of node a that is taller by more than one level
+		// above it, if any. Returns the node now in a's place.
+		unsigned long balance(unsigned long a);
+};
+
+#endif
@@ -1,4 +1,4 @@
-// ball.h version 2.0
+// ball.h version 2.1
 // Copyright 2006 Chad Berchek
 // Not compatible with version 1.0
 // Replaces Ball structure 1.0
@@ -8,6 +8,8 @@
 //     - changed position and velocity to vectors
 //     - eliminated need to #include windows.h
 //     - added ID member
+//   2.1: (compatible with 2.0)
+//     - made Ball a template on the scalar type, BallT. Ball is BallT<SimScalar>.
 
 #ifndef BALL_H
 #define BALL_H
@@ -24,58 +26,72 @@
 // color (color)
 // id (id) - an integer used to identify the ball if there are several balls in a container
 
-class Ball {
+template <class T>
+class BallT {
 	public:
+		typedef T Scalar;
 
 		// Constructors
-		Ball() {
-			im = 0.;
-			ir = 0.;
+		BallT() {
+			im = 0;
+			ir = 0;
 			icolor = 0;
 			// Vectors should initialize themselves to <0, 0>
 		}
 		
+		// Copy of a ball with a different scalar type
+		template <class U> explicit BallT(const BallT<U> &b) {
+			setXY(T(b.x()), T(b.y()));
+			setVXY(T(b.vx()), T(b.vy()));
+			im = T(b.m());
+			ir = T(b.r());
+			icolor = b.color();
+			iid = b.id();
+		}
+		
 		// Get methods
-		double x() const { return ipos.x(); }
-		double y() const { return ipos.y(); }
-		double vx() const { return iv.x(); }
-		double vy() const { return iv.y(); }
-		double m() const { return im; }
-		double r() const { return ir; }
+		T x() const { return ipos.x(); }
+		T y() const { return ipos.y(); }
+		T vx() const { return iv.x(); }
+		T vy() const { return iv.y(); }
+		T m() const { return im; }
+		T r() const { return ir; }
 		unsigned long color() const { return icolor; }
-		const Vector2D &pos() const { return ipos; }
-		const Vector2D &v() const { return iv; }
+		const Vector2DT<T> &pos() const { return ipos; }
+		const Vector2DT<T> &v() const { return iv; }
 		int id() const { return iid; }
 		
 		// Set methods
-		void setX(const double x) { ipos.setX(x); }
-		void setY(const double y) { ipos.setY(y); }
-		void setXY(const double x, const double y) { setX(x); setY(y); }
-		void setPos(const Vector2D &pos) { ipos = pos; }
-		void setVX(const double vx) { iv.setX(vx); }
-		void setVY(const double vy) { iv.setY(vy); }
-		void setVXY(const double vx, const double vy) { setVX(vx); setVY(vy); }
-		void setV(const Vector2D &v) { iv = v; }
-		void setM(const double mass) { im = mass; }
-		void setR(const double radius) { ir = radius; }
+		void setX(const T x) { ipos.setX(x); }
+		void setY(const T y) { ipos.setY(y); }
+		void setXY(const T x, const T y) { setX(x); setY(y); }
+		void setPos(const Vector2DT<T> &pos) { ipos = pos; }
+		void setVX(const T vx) { iv.setX(vx); }
+		void setVY(const T vy) { iv.setY(vy); }
+		void setVXY(const T vx, const T vy) { setVX(vx); setVY(vy); }
+		void setV(const Vector2DT<T> &v) { iv = v; }
+		void setM(const T mass) { im = mass; }
+		void setR(const T radius) { ir = radius; }
 		void setColor(const unsigned long color) { icolor = color; }
 		void setID(const int sid) { iid = sid; }
 		
 		// Other methods
 		// Moves the ball according to the current velocity by time dt
-		void advanceBallPosition(const double dt) {
+		void advanceBallPosition(const T dt) {
 			setX(x() + vx() * dt);
 			setY(y() + vy() * dt);
 		}
 		
 	private:
 		// Note: i stands for internal
-		Vector2D ipos; // Position
-		Vector2D iv; // Velocity
-		double im; // Mass
-		double ir; // Radius
+		Vector2DT<T> ipos; // Position
+		Vector2DT<T> iv; // Velocity
+		T im; // Mass
+		T ir; // Radius
 		unsigned long icolor; // Color
 		int iid; // ID
 };
 
+typedef BallT<SimScalar> Ball;
+
 #endif
@@ -1,4 +1,4 @@
-// ballssim.cpp - version 2.4
+// ballssim.cpp - version 2.24
 // Functions declared in ballssim.h.
 // Copyright 2006 Chad Berchek
 // See ballssim.h for documentation of functions.
@@ -22,55 +22,370 @@
 //     - changed findEarliestCollisionOfTwoBalls() to check for case when there are no balls in the simulator
 //     - changed references to balls.size() to numBalls()
 //     - made minimum area four times the area of the balls
+//   2.7
+//     - made advanceSim() event driven: predicted collisions are kept in a priority queue,
+//       invalidated by per-ball collision counters, and only the balls involved in a
+//       collision are re-predicted. Balls are advanced lazily to the time of their own events.
+//   2.8
+//     - added optional uniform grid broad phase (setBroadPhase()) limiting the pairs of balls
+//       tested in advanceSim() and findEarliestCollisionOfTwoBalls()
+//     - added time horizon to the earliest collision functions
+//   2.9
+//     - balls are stored as a structure of arrays (BallStore). getBall() returns a ConstBallRef
+//       and the earliest collision functions return ball indices instead of pointers
+//   2.10
+//     - brute force pair and wall scans use the batched SIMD kernels from collisionsimd.h
+//   2.11
+//     - brute force pair and wall scans run on a persistent thread pool (setNumThreads()). The
+//       pair triangle is split into chunks with equal numbers of pairs and the per-chunk results
+//       are combined in chunk order, so they do not depend on the number of threads
+//   2.12
+//     - added getNumCollisionsLastFrame()
+//   2.13
+//     - added performance counters of advanceSim() (getLastFrameStats(), getTotalStats()),
+//       collected only if built with BALLSSIM_STATS
+//   2.14
+//     - added optional reordering of the balls along a Hilbert curve (setReorderInterval(),
+//       reorderBalls()) and findBall() to find a ball by ID
+//   2.15
+//     - added sweep-and-prune broad phase (SWEEP_AND_PRUNE)
+//   2.16
+//     - made BallsSim a template on the scalar type (BallsSimT), built for double and float
+//     - balls that have just collided with each other are not taken to collide again
+//       until one of them hits something else (only with a contact tolerance, see scalar.h)
+//   2.17
+//     - added saveCheckpoint(), loadCheckpoint() and getWalls()
+//   2.18
+//     - added setTrajectoryWriter() and getTime(); advanceSim() can add every frame to a trajectory file
+//   2.19
+//     - added addBalls()
+//     - setBallsVector() now updates the collision limit, the sizes derived from the balls and the next ID
+//   2.20
+//     - added setNumSectors(): advanceSim() can process the collisions of a frame in sectors of the
+//       walls on several threads (SectorSim)
+//   2.21
+//     - added the AABB_TREE broad phase (AabbTree)
+//   2.22
+//     - added setMaxBatchSize(): advanceSim() can process runs of independent collisions as batches,
+//       re-predicting their balls on several threads
+//   2.23
+//     - added the observables (setObservablesInterval(), getObservables()): energy, momentum,
+//       velocity histograms, wall pressure, collision frequency and mean free path
+//   2.24
+//     - added setDeterministic(): results independent of the number of threads and of the order in which
+//       collisions at the same time are found
 
 #include "ball.h"
 #include "walls.h"
 #include "ballssim.h"
+#include "ballstore.h"
 #include "collision.h"
+#include "collisionsimd.h"
+#include "cellgrid.h"
+#include "sweepandprune.h"
+#include "aabbtree.h"
+#include "boundingbox.h"
+#include "threadpool.h"
+#include "simstats.h"
+#include "checkpoint.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
 
-void BallsSim::advanceBallPositions(const double dt) {
+// STATS(statement) runs statement only if the performance counters are enabled
+#ifdef BALLSSIM_STATS
+#include <chrono>
+#define STATS(statement) statement
+
+// Current time in nanoseconds, for the phase timers
+static unsigned long long nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#else
+#define STATS(statement)
+#endif
+
+template <class T>
+bool BallsSimT<T>::statsEnabled() {
+#ifdef BALLSSIM_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+template <class T>
+void BallsSimT<T>::advanceBallPositions(const T dt) {
+	T *x = balls.x();
+	T *y = balls.y();
+	const T *vx = balls.vx();
+	const T *vy = balls.vy();
 	for (unsigned long i = 0; i < numBalls(); i++) {
-		balls[i].advanceBallPosition(dt);
+		x[i] += vx[i] * dt;
+		y[i] += vy[i] * dt;
 	}
 }
 
-Collision BallsSim::findEarliestCollisionOfTwoBalls(Ball *&b1, Ball *&b2) {
-	Collision earliestCollision;
+template <class T>
+void BallsSimT<T>::setBallsVector(const std::vector<BallT<T> > &setBalls) {
+	balls.clear();
+	balls.reserve(setBalls.size());
+	for (unsigned long i = 0; i < setBalls.size(); i++) {
+		balls.push_back(setBalls[i]);
+		if (setBalls[i].id() >= nextID) nextID = setBalls[i].id() + 1;
+	}
+	idIndex.clear();
+	minArea = 0.;
+	maxDiameter = 0.;
+	lastBallCollision.clear();
+	accountBalls(0);
+}
+
+template <class T>
+void BallsSimT<T>::addedBalls(unsigned long first) {
+	unsigned long n = numBalls();
+	if (first == n) return;
+	for (unsigned long i = first; i < n; i++) {
+		balls.setID(i, nextID++);
+		moveBallToWithinBounds(balls[i]);
+	}
+	accountBalls(first);
+	if (reorderInterval == REORDER_ADAPTIVE) travelSinceReorder = HUGE_VAL;
+}
+
+template <class T>
+void BallsSimT<T>::accountBalls(unsigned long first) {
+	unsigned long n = numBalls();
+	if (nextID > 0 && (unsigned long)nextID <= 2 * n) idIndex.reserve(nextID);
+	const T *r = balls.r();
+	for (unsigned long i = first; i < n; i++) {
+		indexBallID(i);
+		if (r[i] * 2. > maxDiameter) maxDiameter = r[i] * 2.;
+		minArea += 4. * r[i] * r[i]; // Add area of square surrounding ball to minArea
+	}
+	maxCollisions = maxCollisionsPerBall * n;
+}
+
+template <class T>
+void BallsSimT<T>::indexBallID(unsigned long i) {
+	// IDs are normally assigned by addBall() and run from 0, so a table
+	// indexed by ID holds them. Other IDs are looked up by findBall().
+	int id = balls.id(i);
+	if (id < 0 || (unsigned long)id > 2 * numBalls()) return;
+	if ((unsigned long)id >= idIndex.size()) idIndex.resize(id + 1, numBalls());
+	idIndex[id] = i;
+}
+
+template <class T>
+bool BallsSimT<T>::findBall(int id, unsigned long &index) const {
+	if (id >= 0 && (unsigned long)id < idIndex.size()) {
+		unsigned long i = idIndex[id];
+		if (i < numBalls() && balls.id(i) == id) {
+			index = i;
+			return true;
+		}
+	}
+	for (unsigned long i = 0; i < numBalls(); i++) {
+		if (balls.id(i) == id) {
+			index = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Distance along a Hilbert curve filling a 65536 x 65536 grid of the point
+// (x, y) of the grid
+static unsigned long long hilbertKey(unsigned long x, unsigned long y) {
+	const unsigned long n = 65536;
+	unsigned long long d = 0;
+	for (unsigned long s = n / 2; s > 0; s /= 2) {
+		unsigned long rx = (x & s) != 0;
+		unsigned long ry = (y & s) != 0;
+		d += (unsigned long long)s * s * ((3 * rx) ^ ry);
+		// Rotate the quadrant so the curve inside it has the standard orientation
+		if (ry == 0) {
+			if (rx == 1) {
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+	return d;
+}
+
+template <class T>
+void BallsSimT<T>::reorderBalls() {
+	unsigned long n = numBalls();
+	const T *x = balls.x();
+	const T *y = balls.y();
+	
+	// The curve covers the walls, or all the balls if there are no walls
+	double x1 = walls.x1(), y1 = walls.y1(), x2 = walls.x2(), y2 = walls.y2();
+	if (!hasWalls() && n > 0) {
+		x1 = x2 = x[0];
+		y1 = y2 = y[0];
+		for (unsigned long i = 1; i < n; i++) {
+			if (x[i] < x1) x1 = x[i];
+			if (x[i] > x2) x2 = x[i];
+			if (y[i] < y1) y1 = y[i];
+			if (y[i] > y2) y2 = y[i];
+		}
+	}
+	double size = x2 - x1 > y2 - y1 ? x2 - x1 : y2 - y1;
+	double scale = size > 0. ? 65535. / size : 0.;
+	
+	// Sort by key, then by current index so equal keys keep their order
+	std::vector<std::pair<unsigned long long, unsigned long> > keys(n);
+	double speedSum = 0.;
+	unsigned long numChunks = numRangeChunks(n);
+	std::vector<double> chunkSpeedSum(numChunks);
+	pool.run(numChunks, [&](unsigned long k) {
+		for (unsigned long i = rangeStart(n, numChunks, k); i < rangeStart(n, numChunks, k + 1); i++) {
+			double gx = (x[i] - x1) * scale;
+			double gy = (y[i] - y1) * scale;
+			gx = gx > 0. ? (gx < 65535. ? gx : 65535.) : 0.;
+			gy = gy > 0. ? (gy < 65535. ? gy : 65535.) : 0.;
+			keys[i] = std::make_pair(hilbertKey((unsigned long)gx, (unsigned long)gy), i);
+			chunkSpeedSum[k] += std::sqrt(balls.vx()[i] * balls.vx()[i] + balls.vy()[i] * balls.vy()[i]);
+		}
+	});
+	for (unsigned long k = 0; k < numChunks; k++) speedSum += chunkSpeedSum[k];
+	std::sort(keys.begin(), keys.end());
+	
+	std::vector<unsigned long> order(n);
+	for (unsigned long k = 0; k < n; k++) order[k] = keys[k].second;
+	balls.permute(order);
+	if (lastBallCollision.size() == n) {
+		std::vector<double> permuted(n);
+		for (unsigned long k = 0; k < n; k++) permuted[k] = lastBallCollision[order[k]];
+		lastBallCollision.swap(permuted);
+	}
+	idIndex.clear();
+	for (unsigned long i = 0; i < n; i++) indexBallID(i);
+	
+	framesSinceReorder = 0;
+	travelSinceReorder = 0.;
+	reorderSpeed = n > 0 ? speedSum / n : 0.;
+}
+
+template <class T>
+bool BallsSimT<T>::isReorderDue() const {
+	if (reorderInterval == 0 || numBalls() < 2) return false;
+	if (reorderInterval == REORDER_ADAPTIVE) return travelSinceReorder >= 2. * maxDiameter;
+	return framesSinceReorder >= reorderInterval;
+}
+
+template <class T>
+BallT<T> BallsSimT<T>::ballAt(unsigned long i, T t) const {
+	BallT<T> b;
+	b.setXY(balls.x()[i], balls.y()[i]);
+	b.setVXY(balls.vx()[i], balls.vy()[i]);
+	b.setM(balls.m()[i]);
+	b.setR(balls.r()[i]);
+	b.advanceBallPosition(t - ballTime[i]);
+	return b;
+}
+
+template <class T>
+CollisionT<T> BallsSimT<T>::findEarliestCollisionOfTwoBalls(unsigned long &b1, unsigned long &b2, T horizon) {
+	CollisionT<T> earliestCollision;
 	
 	if (numBalls() == 0) return earliestCollision; // Make sure there are some balls
 	
+	// The broad phase needs a finite horizon to know how far balls can travel
+	if (broadPhase != BRUTE_FORCE && horizon < HUGE_VAL) {
+		rebuildBroadPhase(horizon);
+		forEachCandidatePair([&](unsigned long i, unsigned long j) {
+			CollisionT<T> c = findTimeUntilTwoBallsCollide(balls[i], balls[j]);
+			if (c.ball1HasCollisionWithBall() && c.getTimeToCollision() < horizon) {
+				if (!earliestCollision.ball1HasCollision() || isEarlier(c, i, j, earliestCollision, b1, b2)) {
+					earliestCollision = c;
+					b1 = i;
+					b2 = j;
+				}
+			}
+		});
+		return earliestCollision;
+	}
+	
 	// Compare each pair of balls. Index i runs from the first
 	// ball up through the second-to-last ball. For each value of
 	// i, index j runs from the ball after i up through the last ball.
-	for (unsigned long i = 0; i < numBalls() - 1; i++) {
-		for (unsigned long j = i + 1; j < numBalls(); j++) {
-			Collision c = findTimeUntilTwoBallsCollide(balls[i], balls[j]);
-			if (c.ball1HasCollisionWithBall()) {
-				if (!earliestCollision.ball1HasCollision() || c.getTimeToCollision() < earliestCollision.getTimeToCollision()) {
-					earliestCollision = c;
-					b1 = &balls[i];
-					b2 = &balls[j];
+	// The rows i are split into chunks that are searched in parallel; the
+	// kernel compares ball i with a block of balls j at a time.
+	const CollisionKernelsT<T> &kernels = getCollisionKernels<T>();
+	ballTime.assign(numBalls(), 0.); // Balls are all at the same time between frames
+	BallArraysT<T> a = arrays();
+	std::vector<unsigned long> rowStart;
+	splitPairRows(rowStart);
+	unsigned long numChunks = rowStart.size() - 1;
+	std::vector<CollisionT<T> > chunkCollision(numChunks);
+	std::vector<unsigned long> chunkB1(numChunks), chunkB2(numChunks);
+	pool.run(numChunks, [&](unsigned long k) {
+		for (unsigned long i = rowStart[k]; i < rowStart[k + 1]; i++) {
+			T t;
+			unsigned long j;
+			if (kernels.earliestTwoBalls(a, i, i + 1, numBalls(), horizon, t, j)) {
+				CollisionT<T> c;
+				c.setCollisionWithBall(t);
+				if (!chunkCollision[k].ball1HasCollision() || isEarlier(c, i, j, chunkCollision[k], chunkB1[k], chunkB2[k])) {
+					chunkCollision[k] = c;
+					chunkB1[k] = i;
+					chunkB2[k] = j;
 				}
 			}
 		}
+	});
+	
+	// Combine in chunk order, so ties are broken as in a serial search. In
+	// deterministic mode they are broken by ID, except between the balls
+	// compared with one ball i, where the kernel keeps the lowest index.
+	for (unsigned long k = 0; k < numChunks; k++) {
+		if (chunkCollision[k].ball1HasCollision()) {
+			if (!earliestCollision.ball1HasCollision() ||
+				isEarlier(chunkCollision[k], chunkB1[k], chunkB2[k], earliestCollision, b1, b2)) {
+				earliestCollision = chunkCollision[k];
+				b1 = chunkB1[k];
+				b2 = chunkB2[k];
+			}
+		}
 	}
 	
 	return earliestCollision;
 }
 
-Collision BallsSim::findEarliestCollisionWithWall(Ball *&b) {
-	Collision earliestCollision;
+template <class T>
+CollisionT<T> BallsSimT<T>::findEarliestCollisionWithWall(unsigned long &b, T horizon) {
+	CollisionT<T> earliestCollision;
 	
 	// If there are no walls, return no collision
 	if (!hasWalls()) return earliestCollision;
 	
 	// Check each ball to see if any collide. Store the earliest colliding ball.
-	for (unsigned long i = 0; i < numBalls(); i++) {
-		Collision c = findTimeUntilBallCollidesWithWall(balls[i], walls);
-		if (c.ball1HasCollisionWithWall()) {
-			if (!earliestCollision.ball1HasCollision() || c.getTimeToCollision() < earliestCollision.getTimeToCollision()) {
-				earliestCollision = c;
-				b = &balls[i];
+	// Chunks of balls are checked in parallel and combined in order.
+	const CollisionKernelsT<T> &kernels = getCollisionKernels<T>();
+	ballTime.assign(numBalls(), 0.); // Balls are all at the same time between frames
+	BallArraysT<T> a = arrays();
+	unsigned long numChunks = numRangeChunks(numBalls());
+	std::vector<CollisionT<T> > chunkCollision(numChunks);
+	std::vector<unsigned long> chunkBall(numChunks);
+	pool.run(numChunks, [&](unsigned long k) {
+		T t;
+		WallsBase::Wall w;
+		if (kernels.earliestWall(a, walls, rangeStart(numBalls(), numChunks, k), rangeStart(numBalls(), numChunks, k + 1),
+			horizon, t, chunkBall[k], w)) {
+			chunkCollision[k].setCollisionWithWall(w, t);
+		}
+	});
+	for (unsigned long k = 0; k < numChunks; k++) {
+		if (chunkCollision[k].ball1HasCollision()) {
+			if (!earliestCollision.ball1HasCollision() ||
+				isEarlier(chunkCollision[k], chunkBall[k], chunkBall[k], earliestCollision, b, b)) {
+				earliestCollision = chunkCollision[k];
+				b = chunkBall[k];
 			}
 		}
 	}
@@ -78,13 +393,15 @@ Collision BallsSim::findEarliestCollisionWithWall(Ball *&b) {
 	return earliestCollision;
 }
 
-Collision BallsSim::findEarliestCollision(Ball *&b1, Ball *&b2) {
-	Collision earliestCollision = findEarliestCollisionOfTwoBalls(b1, b2);
+template <class T>
+CollisionT<T> BallsSimT<T>::findEarliestCollision(unsigned long &b1, unsigned long &b2, T horizon) {
+	CollisionT<T> earliestCollision = findEarliestCollisionOfTwoBalls(b1, b2, horizon);
 	if (hasWalls()) {
-		Ball *bCollideWithWall;
-		Collision cWalls = findEarliestCollisionWithWall(bCollideWithWall);
+		unsigned long bCollideWithWall;
+		CollisionT<T> cWalls = findEarliestCollisionWithWall(bCollideWithWall, horizon);
 		if (cWalls.ball1HasCollisionWithWall()) {
-			if (!earliestCollision.ball1HasCollisionWithBall() || (cWalls.getTimeToCollision() < earliestCollision.getTimeToCollision())) {
+			if (!earliestCollision.ball1HasCollisionWithBall() ||
+				isEarlier(cWalls, bCollideWithWall, bCollideWithWall, earliestCollision, b1, b2)) {
 				earliestCollision = cWalls;
 				b1 = bCollideWithWall;
 			}
@@ -94,42 +411,631 @@ Collision BallsSim::findEarliestCollision(Ball *&b1, Ball *&b2) {
 	return earliestCollision;
 }
 
-void BallsSim::advanceSim(const double dt) {
-	double tElapsed = 0.;
-	Collision c;
-	Collision lastCollision;
-	Ball *b1;
-	Ball *b2;
+template <class T>
+void BallsSimT<T>::rebuildBroadPhase(T horizon) {
+	std::vector<BoundingBox> boxes(numBalls());
+	for (unsigned long i = 0; i < numBalls(); i++) {
+		boxes[i] = BoundingBox::swept(balls[i], horizon);
+	}
+	if (broadPhase == SWEEP_AND_PRUNE) {
+		sweep.rebuild(boxes);
+		return;
+	}
+	if (broadPhase == AABB_TREE) {
+		tree.rebuild(boxes);
+		return;
+	}
 	
-	for (unsigned int i = 0; i < maxCollisions; i++) {
-		// Find earliest collision
-		c = findEarliestCollision(b1, b2);
+	// The grid covers the walls, or all the balls if there are no walls
+	BoundingBox bounds(walls.x1(), walls.y1(), walls.x2(), walls.y2());
+	if (!hasWalls() && numBalls() > 0) {
+		bounds = boxes[0];
+		for (unsigned long i = 1; i < numBalls(); i++) {
+			bounds = bounds.merge(boxes[i]);
+		}
+	}
+	grid.rebuild(bounds, maxDiameter, boxes);
+}
+
+template <class T>
+void BallsSimT<T>::updateBroadPhase(unsigned long i, T horizon) {
+	if (broadPhase == CELL_GRID) grid.update(i, BoundingBox::swept(balls[i], horizon - ballTime[i]));
+	else if (broadPhase == SWEEP_AND_PRUNE) sweep.update(i, BoundingBox::swept(balls[i], horizon - ballTime[i]));
+	else if (broadPhase == AABB_TREE) tree.update(i, BoundingBox::swept(balls[i], horizon - ballTime[i]));
+}
+
+template <class T>
+void BallsSimT<T>::advanceBallTo(unsigned long i, T t) {
+	balls.x()[i] += balls.vx()[i] * (t - ballTime[i]);
+	balls.y()[i] += balls.vy()[i] * (t - ballTime[i]);
+	ballTime[i] = t;
+}
+
+template <class T>
+bool BallsSimT<T>::findPairEvent(unsigned long i, unsigned long j, T horizon, SimEvent &e) const {
+	// Bring the ball that is behind in time up to the other one, without
+	// modifying the stored ball, so the prediction does not depend on when
+	// it is made.
+	T t = ballTime[i] > ballTime[j] ? ballTime[i] : ballTime[j];
+	CollisionT<T> c;
+	if (ballTime[i] == ballTime[j]) c = findTimeUntilTwoBallsCollide(balls[i], balls[j]);
+	else {
+		BallT<T> bi = ballAt(i, t);
+		BallT<T> bj = ballAt(j, t);
+		c = findTimeUntilTwoBallsCollide(bi, bj);
+	}
+	
+	if (!c.ball1HasCollisionWithBall() || !(t + c.getTimeToCollision() < horizon)) return false;
+	e = SimEvent(t + c.getTimeToCollision(), i, j, collisionCount[i], collisionCount[j]);
+	return true;
+}
+
+template <class T>
+bool BallsSimT<T>::findWallEvent(unsigned long i, T horizon, SimEvent &e) const {
+	CollisionT<T> c = findTimeUntilBallCollidesWithWall(balls[i], walls);
+	if (!c.ball1HasCollisionWithWall() || !(ballTime[i] + c.getTimeToCollision() < horizon)) return false;
+	e = SimEvent(ballTime[i] + c.getTimeToCollision(), i, collisionCount[i], c.getCollisionWall());
+	return true;
+}
+
+template <class T>
+void BallsSimT<T>::predictTwoBalls(unsigned long i, unsigned long j, T horizon) {
+	SimEvent e;
+	STATS(frameStats.ipairTests++);
+	if (findPairEvent(i, j, horizon, e)) {
+		events.push(e);
+		STATS(frameStats.ieventsQueued++);
+	}
+}
+
+template <class T>
+void BallsSimT<T>::predictWall(unsigned long i, T horizon) {
+	if (!hasWalls()) return;
+	SimEvent e;
+	STATS(frameStats.iwallTests++);
+	if (findWallEvent(i, horizon, e)) {
+		events.push(e);
+		STATS(frameStats.ieventsQueued++);
+	}
+}
+
+template <class T>
+void BallsSimT<T>::predictBall(unsigned long i, unsigned long exclude, T horizon) {
+	predictWall(i, horizon);
+	if (broadPhase != BRUTE_FORCE) {
+		forEachCandidate(i, [&](unsigned long j) {
+			if (j != exclude) predictTwoBalls(i, j, horizon);
+		});
+		return;
+	}
+	
+	// Only split the scan between threads if it is long enough to pay for waking them
+	unsigned long numChunks = numBalls() >= PARALLEL_MIN_BALLS ? numRangeChunks(numBalls()) : 1;
+	chunkEvents.resize(numChunks);
+	pool.run(numChunks, [&](unsigned long k) {
+		chunkEvents[k].clear();
+		findTwoBallsEvents(i, rangeStart(numBalls(), numChunks, k), rangeStart(numBalls(), numChunks, k + 1), exclude,
+			horizon, chunkEvents[k]);
+	});
+	pushChunkEvents();
+	STATS(frameStats.ipairTests += numBalls() - (i == exclude ? 1 : 2));
+}
+
+template <class T>
+void BallsSimT<T>::findTwoBallsEvents(unsigned long i, unsigned long j0, unsigned long j1, unsigned long exclude,
+	T horizon, std::vector<SimEvent> &out) const {
+	const CollisionKernelsT<T> &kernels = getCollisionKernels<T>();
+	BallArraysT<T> a = arrays();
+	T times[SCAN_BLOCK];
+	for (unsigned long jb = j0; jb < j1; jb += SCAN_BLOCK) {
+		unsigned long je = jb + SCAN_BLOCK < j1 ? jb + SCAN_BLOCK : j1;
+		kernels.twoBallsTimes(a, i, jb, je, times);
+		for (unsigned long j = jb; j < je; j++) {
+			if (times[j - jb] < horizon && j != i && j != exclude) {
+				out.push_back(SimEvent(times[j - jb], i, j, collisionCount[i], collisionCount[j]));
+			}
+		}
+	}
+}
+
+template <class T>
+void BallsSimT<T>::findWallEvents(unsigned long i0, unsigned long i1, T horizon, std::vector<SimEvent> &out) const {
+	const CollisionKernelsT<T> &kernels = getCollisionKernels<T>();
+	BallArraysT<T> a = arrays();
+	T times[SCAN_BLOCK];
+	WallsBase::Wall which[SCAN_BLOCK];
+	for (unsigned long ib = i0; ib < i1; ib += SCAN_BLOCK) {
+		unsigned long ie = ib + SCAN_BLOCK < i1 ? ib + SCAN_BLOCK : i1;
+		kernels.wallTimes(a, walls, ib, ie, times, which);
+		for (unsigned long i = ib; i < ie; i++) {
+			if (times[i - ib] < horizon) out.push_back(SimEvent(times[i - ib], i, collisionCount[i], which[i - ib]));
+		}
+	}
+}
+
+template <class T>
+void BallsSimT<T>::predictAll(T horizon) {
+	// Collisions with the walls
+	unsigned long numChunks = numRangeChunks(numBalls());
+	chunkEvents.resize(numChunks);
+	pool.run(numChunks, [&](unsigned long k) {
+		chunkEvents[k].clear();
+		if (hasWalls()) {
+			findWallEvents(rangeStart(numBalls(), numChunks, k), rangeStart(numBalls(), numChunks, k + 1), horizon,
+				chunkEvents[k]);
+		}
+	});
+	pushChunkEvents();
+	STATS(if (hasWalls()) frameStats.iwallTests += numBalls());
+	
+	// Collisions between balls
+	if (broadPhase != BRUTE_FORCE) {
+		STATS(unsigned long long start = nowNs());
+		rebuildBroadPhase(horizon);
+		STATS(frameStats.ibroadPhaseNs += nowNs() - start);
+		forEachCandidatePair([&](unsigned long i, unsigned long j) { predictTwoBalls(i, j, horizon); });
+		return;
+	}
+	std::vector<unsigned long> rowStart;
+	splitPairRows(rowStart);
+	numChunks = rowStart.size() - 1;
+	chunkEvents.resize(numChunks);
+	pool.run(numChunks, [&](unsigned long k) {
+		chunkEvents[k].clear();
+		for (unsigned long i = rowStart[k]; i < rowStart[k + 1]; i++) {
+			findTwoBallsEvents(i, i + 1, numBalls(), i, horizon, chunkEvents[k]);
+		}
+	});
+	pushChunkEvents();
+	STATS(frameStats.ipairTests += (unsigned long long)numBalls() * (numBalls() - 1) / 2);
+}
+
+template <class T>
+unsigned long BallsSimT<T>::findBallEvents(unsigned long i, unsigned long exclude, T horizon,
+	std::vector<SimEvent> &out) const {
+	SimEvent e;
+	if (hasWalls() && findWallEvent(i, horizon, e)) out.push_back(e);
+	if (broadPhase != BRUTE_FORCE) {
+		unsigned long tests = 0;
+		forEachCandidate(i, [&](unsigned long j) {
+			if (j == exclude) return;
+			tests++;
+			if (findPairEvent(i, j, horizon, e)) out.push_back(e);
+		});
+		return tests;
+	}
+	findTwoBallsEvents(i, 0, numBalls(), exclude, horizon, out);
+	return numBalls() - (i == exclude ? 1 : 2);
+}
+
+template <class T>
+void BallsSimT<T>::applyEvent(const SimEvent &e) {
+	unsigned long b1 = e.ball1();
+	advanceBallTo(b1, e.time());
+	BallRefT<T> r1 = balls[b1];
+	if (e.isWallEvent()) {
+		doElasticCollisionWithWall(r1, e.wall());
+		collisionCount[b1]++;
+		lastPartner[b1] = numBalls();
+		return;
+	}
+	unsigned long b2 = e.ball2();
+	advanceBallTo(b2, e.time());
+	BallRefT<T> r2 = balls[b2];
+	doElasticCollisionTwoBalls(r1, r2);
+	collisionCount[b1]++;
+	collisionCount[b2]++;
+	lastPartner[b1] = b2;
+	lastPartner[b2] = b1;
+}
+
+template <class T>
+unsigned int BallsSimT<T>::processBatch(T horizon, unsigned int limit) {
+	// Take the next events while the regions their balls may reach before
+	// the horizon, before or after the collision, are apart from those of
+	// the events already taken. The events are processed as they are taken,
+	// so each one sees the balls as serial processing would. An event of a
+	// ball already in the batch ends it: it is probably stale, but would
+	// not be if the event before it were put back.
+	batch.clear();
+	batchBoxes.clear();
+	batchUndo.clear();
+	while (!events.empty() && batch.size() < maxBatchSize && batch.size() < limit) {
+		SimEvent e = events.top();
+		bool shared = false;
+		for (unsigned long u = 0; u < batchUndo.size() && !shared; u++) {
+			shared = batchUndo[u].ball == e.ball1() || (!e.isWallEvent() && batchUndo[u].ball == e.ball2());
+		}
+		if (shared) break;
+		if (!isEventValid(e) || (!e.isWallEvent() && isRepeatContact(e.ball1(), e.ball2()))) {
+			events.pop();
+			STATS(frameStats.istaleEvents++);
+			continue;
+		}
 		
-		// If no collisions, break
-		if (!c.ball1HasCollision()) break;
+		unsigned long first = batchUndo.size();
+		unsigned long ballsOfEvent[2] = { e.ball1(), e.ball2() };
+		int numBallsOfEvent = e.isWallEvent() ? 1 : 2;
+		BoundingBox box = BoundingBox::swept(balls[e.ball1()], horizon - ballTime[e.ball1()]);
+		for (int k = 0; k < numBallsOfEvent; k++) {
+			unsigned long i = ballsOfEvent[k];
+			BatchUndo u = { i, balls.x()[i], balls.y()[i], balls.vx()[i], balls.vy()[i], ballTime[i], collisionCount[i],
+				lastPartner[i] };
+			batchUndo.push_back(u);
+			if (k > 0) box = box.merge(BoundingBox::swept(balls[i], horizon - ballTime[i]));
+		}
+		applyEvent(e);
+		for (int k = 0; k < numBallsOfEvent; k++) {
+			unsigned long i = ballsOfEvent[k];
+			box = box.merge(BoundingBox::swept(balls[i], horizon - ballTime[i]));
+		}
+		bool apart = true;
+		for (unsigned long k = 0; k < batchBoxes.size() && apart; k++) {
+			apart = !batchBoxes[k].overlaps(box);
+		}
+		if (!apart) {
+			undoBatchEvents(first, horizon);
+			break;
+		}
+		events.pop();
+		batch.push_back(e);
+		batchBoxes.push_back(box);
+	}
+	if (batch.empty()) return 0;
+	
+	// Re-predict the balls of the batch in parallel. The balls of one event
+	// cannot meet those of another before the horizon, so each event finds
+	// the collisions it would if it had been processed alone.
+	for (unsigned long u = 0; u < batchUndo.size(); u++) {
+		updateBroadPhase(batchUndo[u].ball, horizon);
+	}
+	batchEvents.resize(batch.size());
+	batchTests.resize(batch.size());
+	pool.run(batch.size(), [&](unsigned long k) {
+		const SimEvent &e = batch[k];
+		batchEvents[k].clear();
+		batchTests[k] = findBallEvents(e.ball1(), e.ball1(), horizon, batchEvents[k]);
+		if (!e.isWallEvent()) batchTests[k] += findBallEvents(e.ball2(), e.ball1(), horizon, batchEvents[k]);
+	});
+	
+	// Keep the events up to the first one that a collision found for an
+	// earlier one precedes: serial processing would have processed that
+	// collision first, and it may lead to the balls of the event
+	unsigned long predicted = batchUndo.size();
+	unsigned long kept = 0;
+	unsigned long keptUndo = 0;
+	bool found = false;
+	SimEvent earliest; // Earliest collision found for the events kept, if found
+	while (kept < batch.size() && !(found && eventOrder(batch[kept], earliest))) {
+		for (unsigned long n = 0; n < batchEvents[kept].size(); n++) {
+			if (!found || eventOrder(earliest, batchEvents[kept][n])) {
+				earliest = batchEvents[kept][n];
+				found = true;
+			}
+		}
+		keptUndo += batch[kept].isWallEvent() ? 1 : 2;
+		kept++;
+	}
+	undoBatchEvents(keptUndo, horizon);
+	for (unsigned long k = kept; k < batch.size(); k++) {
+		events.push(batch[k]);
+	}
+	
+	// The kept events are applied for good, so their balls hold the
+	// velocities after them and their undo records those before
+	if (observablesInterval > 0) {
+		unsigned long u = 0;
+		for (unsigned long k = 0; k < kept; k++) {
+			const BatchUndo &u1 = batchUndo[u];
+			const BatchUndo &u2 = batchUndo[batch[k].isWallEvent() ? u : u + 1];
+			observeEvent(batch[k], u1.vx, u1.vy, u2.vx, u2.vy);
+			u += batch[k].isWallEvent() ? 1 : 2;
+		}
+	}
+	for (unsigned long k = 0; k < kept; k++) {
+		for (unsigned long n = 0; n < batchEvents[k].size(); n++) {
+			events.push(batchEvents[k][n]);
+		}
+		STATS(frameStats.ieventsQueued += batchEvents[k].size());
+		STATS(if (batch[k].isWallEvent()) frameStats.iwallCollisions++; else frameStats.iballCollisions++);
+	}
+	STATS(for (unsigned long k = 0; k < batch.size(); k++) frameStats.ipairTests += batchTests[k]);
+	STATS(if (hasWalls()) frameStats.iwallTests += predicted);
+	STATS(frameStats.ibatches++);
+	STATS(frameStats.ibatchedCollisions += kept);
+	STATS(if (kept > frameStats.ilargestBatch) frameStats.ilargestBatch = kept);
+	STATS(if (kept < batch.size()) frameStats.icutBatches++);
+	STATS(frameStats.iputBackEvents += batch.size() - kept);
+	return (unsigned int)kept;
+}
+
+template <class T>
+void BallsSimT<T>::observeEvent(const SimEvent &e, T vx1, T vy1, T vx2, T vy2) {
+	unsigned long b1 = e.ball1();
+	if (e.isWallEvent()) {
+		// The wall takes the momentum the ball loses
+		double dvx = double(balls.vx()[b1]) - vx1;
+		double dvy = double(balls.vy()[b1]) - vy1;
+		observables.iwallImpulse[e.wall() - 1] += double(balls.m()[b1]) * std::sqrt(dvx * dvx + dvy * dvy);
+		observables.iwallCollisions++;
+		return;
+	}
+	
+	// The collision ends the free path of each ball. Collisions with the
+	// walls keep its speed, so the path is its speed times the time since
+	// it last hit a ball.
+	double t = simTime + e.time();
+	unsigned long ballsOfEvent[2] = { b1, e.ball2() };
+	double speed[2] = { std::sqrt(double(vx1) * vx1 + double(vy1) * vy1), std::sqrt(double(vx2) * vx2 + double(vy2) * vy2) };
+	for (int k = 0; k < 2; k++) {
+		unsigned long i = ballsOfEvent[k];
+		if (lastBallCollision[i] >= 0.) {
+			double freeTime = t - lastBallCollision[i];
+			observables.ifreePaths++;
+			observables.ifreeTimeSum += freeTime;
+			observables.ifreePathSum += speed[k] * freeTime;
+		}
+		lastBallCollision[i] = t;
+	}
+	observables.iballCollisions++;
+}
+
+template <class T>
+void BallsSimT<T>::observeFrame(T dt) {
+	Observables &o = observables;
+	unsigned long n = numBalls();
+	o.iobservedTime += dt;
+	o.iballTime += double(n) * dt;
+	if (hasWalls()) {
+		double width = walls.x2() - walls.x1();
+		double height = walls.y2() - walls.y1();
+		o.iwallLengthTime[Walls::X1 - 1] += height * dt;
+		o.iwallLengthTime[Walls::X2 - 1] += height * dt;
+		o.iwallLengthTime[Walls::Y1 - 1] += width * dt;
+		o.iwallLengthTime[Walls::Y2 - 1] += width * dt;
+	}
+	if (++framesSinceSample < observablesInterval) return;
+	framesSinceSample = 0;
+	
+	// Sum in LANES separate accumulators, added up in a fixed order at the
+	// end, so the compiler can vectorise the pass without reordering the sums
+	const unsigned long LANES = 8;
+	const T *vx = balls.vx();
+	const T *vy = balls.vy();
+	const T *m = balls.m();
+	double energy[LANES] = {}, px[LANES] = {}, py[LANES] = {}, speed2[LANES] = {};
+	unsigned long i = 0;
+	for (; i + LANES <= n; i += LANES) {
+		for (unsigned long k = 0; k < LANES; k++) {
+			double v2 = double(vx[i + k]) * vx[i + k] + double(vy[i + k]) * vy[i + k];
+			energy[k] += .5 * double(m[i + k]) * v2;
+			px[k] += double(m[i + k]) * vx[i + k];
+			py[k] += double(m[i + k]) * vy[i + k];
+			speed2[k] += v2;
+		}
+	}
+	for (unsigned long k = 0; i < n; i++, k++) {
+		double v2 = double(vx[i]) * vx[i] + double(vy[i]) * vy[i];
+		energy[k] += .5 * double(m[i]) * v2;
+		px[k] += double(m[i]) * vx[i];
+		py[k] += double(m[i]) * vy[i];
+		speed2[k] += v2;
+	}
+	double totalSpeed2 = 0.;
+	o.ikineticEnergy = o.imomentumX = o.imomentumY = 0.;
+	for (unsigned long k = 0; k < LANES; k++) {
+		o.ikineticEnergy += energy[k];
+		o.imomentumX += px[k];
+		o.imomentumY += py[k];
+		totalSpeed2 += speed2[k];
+	}
+	o.inumBalls = n;
+	o.ienergySum += o.ikineticEnergy;
+	o.isamples++;
+	
+	if (!(o.imaxSpeed > 0.) && n > 0) {
+		double rms = std::sqrt(totalSpeed2 / n);
+		o.setHistogramRange(rms > 0. ? 4. * rms : 1., o.ihistogramBins);
+	}
+	for (i = 0; i < n; i++) {
+		o.ispeeds.add(std::sqrt(double(vx[i]) * vx[i] + double(vy[i]) * vy[i]));
+		o.ivx.add(vx[i]);
+		o.ivy.add(vy[i]);
+	}
+}
+
+template <class T>
+void BallsSimT<T>::undoBatchEvents(unsigned long first, T horizon) {
+	for (unsigned long u = first; u < batchUndo.size(); u++) {
+		const BatchUndo &b = batchUndo[u];
+		balls.x()[b.ball] = b.x;
+		balls.y()[b.ball] = b.y;
+		balls.vx()[b.ball] = b.vx;
+		balls.vy()[b.ball] = b.vy;
+		ballTime[b.ball] = b.t;
+		collisionCount[b.ball] = b.count;
+		lastPartner[b.ball] = b.partner;
+		updateBroadPhase(b.ball, horizon);
+	}
+	batchUndo.resize(first);
+}
+
+template <class T>
+void BallsSimT<T>::pushChunkEvents() {
+	for (unsigned long k = 0; k < chunkEvents.size(); k++) {
+		for (unsigned long e = 0; e < chunkEvents[k].size(); e++) {
+			events.push(chunkEvents[k][e]);
+		}
+		STATS(frameStats.ieventsQueued += chunkEvents[k].size());
+	}
+}
+
+template <class T>
+unsigned long BallsSimT<T>::numRangeChunks(unsigned long n) const {
+	unsigned long numChunks = deterministic ? DETERMINISTIC_CHUNKS : CHUNKS_PER_THREAD * pool.numThreads();
+	if (numChunks > n) numChunks = n;
+	if (numChunks == 0) numChunks = 1;
+	return numChunks;
+}
+
+template <class T>
+void BallsSimT<T>::splitPairRows(std::vector<unsigned long> &rowStart) const {
+	// Row i holds the n - 1 - i pairs (i, j > i), so rows get shorter as i
+	// grows. Close each chunk once it holds its share of the pairs.
+	unsigned long n = numBalls();
+	double totalPairs = 0.5 * double(n) * double(n > 0 ? n - 1 : 0);
+	unsigned long numChunks = numRangeChunks(n);
+	rowStart.clear();
+	rowStart.push_back(0);
+	double pairs = 0.;
+	for (unsigned long i = 0; i < n && rowStart.size() < numChunks; i++) {
+		pairs += double(n - 1 - i);
+		if (pairs >= totalPairs * rowStart.size() / numChunks) rowStart.push_back(i + 1);
+	}
+	if (rowStart.back() != n) rowStart.push_back(n);
+}
+
+template <class T>
+BallArraysT<T> BallsSimT<T>::arrays() const {
+	BallArraysT<T> a;
+	a.x = balls.x();
+	a.y = balls.y();
+	a.vx = balls.vx();
+	a.vy = balls.vy();
+	a.r = balls.r();
+	a.t = ballTime.data();
+	return a;
+}
+
+template <class T>
+bool BallsSimT<T>::isEventValid(const SimEvent &e) const {
+	if (e.count1() != collisionCount[e.ball1()]) return false;
+	if (!e.isWallEvent() && e.count2() != collisionCount[e.ball2()]) return false;
+	return true;
+}
+
+template <class T>
+bool BallsSimT<T>::isEarlier(const CollisionT<T> &c, unsigned long i, unsigned long j, const CollisionT<T> &c2,
+	unsigned long i2, unsigned long j2) const {
+	SimEvent e = c.ball1HasCollisionWithWall() ? SimEvent(c.getTimeToCollision(), i, 0, c.getCollisionWall()) :
+		SimEvent(c.getTimeToCollision(), i, j, 0, 0);
+	SimEvent e2 = c2.ball1HasCollisionWithWall() ? SimEvent(c2.getTimeToCollision(), i2, 0, c2.getCollisionWall()) :
+		SimEvent(c2.getTimeToCollision(), i2, j2, 0, 0);
+	return SimEvent::Later(deterministic ? balls.ids() : 0)(e2, e);
+}
+
+template <class T>
+bool BallsSimT<T>::isRepeatContact(unsigned long i, unsigned long j) const {
+	// With a contact tolerance, two balls that have just collided may still
+	// overlap slightly and look as if they were approaching. In exact
+	// arithmetic they cannot meet again until one of them hits something else.
+	if (ScalarTraits<T>::contactTolerance() == 0) return false;
+	return lastPartner[i] == j && lastPartner[j] == i;
+}
+
+template <class T>
+void BallsSimT<T>::advanceSim(const T dt) {
+	STATS(frameStats.reset());
+	STATS(frameStats.iframes = 1);
+	STATS(unsigned long long phaseStart = nowNs());
+	
+	if (isReorderDue()) {
+		reorderBalls();
+		STATS(frameStats.ireorders = 1);
+		STATS(unsigned long long now = nowNs());
+		STATS(frameStats.ireorderNs = now - phaseStart);
+		STATS(phaseStart = now);
+	}
+	framesSinceReorder++;
+	travelSinceReorder += reorderSpeed * dt;
+	
+	// All balls start the frame at time 0
+	ballTime.assign(numBalls(), 0.);
+	collisionCount.assign(numBalls(), 0);
+	lastPartner.assign(numBalls(), numBalls());
+	if (observablesInterval > 0) lastBallCollision.resize(numBalls(), -1.); // Balls added since the last frame
+	
+	// A frame split into sectors predicts and processes its own collisions;
+	// it returns false if the frame must be run in one piece. Sectors do not
+	// record their collisions for the observables, nor order collisions at
+	// the same time as deterministic mode does.
+	unsigned int numCollisions;
+	if (observablesInterval == 0 && !deterministic && sectors.advance(*this, dt, numCollisions)) {
+		STATS(phaseStart = nowNs());
+	}
+	else {
+		eventOrder = SimEvent::Later(deterministic ? balls.ids() : 0);
+		events = std::priority_queue<SimEvent, std::vector<SimEvent>, SimEvent::Later>(eventOrder);
+		
+		// Predict every collision within the frame.
+		// Note: events are only queued if they happen strictly before dt, not at dt, because if the two were
+		// exactly equal, we would perform the velocity adjustment for collision but not move the balls any more,
+		// so the collision could be detected again on the next call to advanceSim().
+		predictAll(dt);
+		STATS(unsigned long long now = nowNs());
+		STATS(frameStats.ipredictNs = now - phaseStart);
+		STATS(phaseStart = now);
+		
+		numCollisions = 0;
+		while (maxBatchSize > 1 && !events.empty() && numCollisions < maxCollisions) {
+			numCollisions += processBatch(dt, maxCollisions - numCollisions);
+		}
+		while (!events.empty() && numCollisions < maxCollisions) {
+			SimEvent e = events.top();
+			events.pop();
+			if (!isEventValid(e)) { // One of the balls has collided since this was predicted
+				STATS(frameStats.istaleEvents++);
+				continue;
+			}
+			if (!e.isWallEvent() && isRepeatContact(e.ball1(), e.ball2())) { // Contact just handled, found again after rounding
+				STATS(frameStats.istaleEvents++);
+				continue;
+			}
 		
-		// Is collision within the time frame?
-		// Note: condition is tElapsed + timeToCollision strictly < dt, not <=, because if the two were exactly
-		// equal, we would perform the velocity adjustment for collision but not move the balls any more, so the
-		// collision could be detected again on the next call to advanceSim().
-		if (tElapsed + c.getTimeToCollision() < dt) {
-			// Collision is within time frame
-			// Advance balls to point of collision
-			advanceBallPositions(c.getTimeToCollision());
-			// Collision is now occuring. Do collision calculation
-			if (c.ball1HasCollisionWithWall()) doElasticCollisionWithWall(*b1, c.getCollisionWall());
-			else if (c.ball1HasCollisionWithBall()) doElasticCollisionTwoBalls(*b1, *b2);
-			tElapsed += c.getTimeToCollision(); // Move time counter forward
-		}
-		else break; // Break if collision is not within this frame
-		lastCollision = c; // Update lastCollision
+			// Advance the balls involved to the point of collision and do the collision calculation
+			unsigned long b1 = e.ball1();
+			unsigned long b2 = e.isWallEvent() ? b1 : e.ball2();
+			T vx1 = balls.vx()[b1], vy1 = balls.vy()[b1], vx2 = balls.vx()[b2], vy2 = balls.vy()[b2];
+			applyEvent(e);
+			if (observablesInterval > 0) observeEvent(e, vx1, vy1, vx2, vy2);
+			if (e.isWallEvent()) {
+				updateBroadPhase(b1, dt);
+				predictBall(b1, b1, dt);
+				STATS(frameStats.iwallCollisions++);
+			}
+			else {
+				// Both balls must be up to date in the broad phase before either is re-predicted
+				updateBroadPhase(b1, dt);
+				updateBroadPhase(b2, dt);
+				predictBall(b1, b1, dt);
+				predictBall(b2, b1, dt); // b1 already checked against b2
+				STATS(frameStats.iballCollisions++);
+			}
+			numCollisions++;
+		}
+		STATS(if (!events.empty()) frameStats.icapHits = 1);
+		STATS(frameStats.ieventsLeftAtCap = events.size());
+		STATS(now = nowNs());
+		STATS(frameStats.ieventNs = now - phaseStart);
+		STATS(phaseStart = now);
 	}
+	lastFrameCollisions = numCollisions;
 	
 	// Advance ball positions further if necessary after any collisions to complete the time frame
-	advanceBallPositions(dt - tElapsed);
+	for (unsigned long i = 0; i < numBalls(); i++) {
+		advanceBallTo(i, dt);
+	}
+	simTime += dt;
+	if (observablesInterval > 0) observeFrame(dt);
+	STATS(frameStats.iadvanceNs = nowNs() - phaseStart);
+	STATS(totalStats += frameStats);
+	
+	// Only copies the balls; the writer compresses them on its own thread
+	if (trajectory != 0) trajectory->addFrame(simTime, balls);
 }
 
-void BallsSim::moveBallToWithinBounds(Ball &b) {
+template <class T>
+void BallsSimT<T>::moveBallToWithinBounds(BallRefT<T> b) {
 	// Check wall X1
 	if (b.x() - b.r() < walls.x1()) b.setX(walls.x1() + b.r());
 	// Check wall Y1
@@ -140,7 +1046,8 @@ void BallsSim::moveBallToWithinBounds(Ball &b) {
 	if (b.y() + b.r() > walls.y2()) b.setY(walls.y2() - b.r());
 }
 
-void BallsSim::moveWalls(const Walls &newWalls) {
+template <class T>
+void BallsSimT<T>::moveWalls(const WallsT<T> &newWalls) {
 	walls = newWalls;
 	iHasWalls = true;
 	for (unsigned int i = 0; i < numBalls(); i++) {
@@ -148,8 +1055,9 @@ void BallsSim::moveWalls(const Walls &newWalls) {
 	}
 }
 
-double BallsSim::getMinWallDimension(double fixedWallDimension) {
-	double minDimension = 0.;
+template <class T>
+T BallsSimT<T>::getMinWallDimension(T fixedWallDimension) {
+	T minDimension = 0.;
 	if (fixedWallDimension > 0.) {
 		minDimension = 4. * minArea / fixedWallDimension;
 	}
@@ -157,12 +1065,100 @@ double BallsSim::getMinWallDimension(double fixedWallDimension) {
 	return minDimension;
 }
 
-void BallsSim::addBall(const Ball &newBall) {
+template <class T>
+void BallsSimT<T>::addBall(const BallT<T> &newBall) {
 	balls.push_back(newBall);
 	balls.back().setID(nextID);
+	indexBallID(numBalls() - 1);
 	nextID++;
 	maxCollisions = maxCollisionsPerBall * numBalls();
 	moveBallToWithinBounds(balls.back());
 	if (newBall.r() * 2. > maxDiameter) maxDiameter = newBall.r() * 2.;
 	minArea += 4. * newBall.r() * newBall.r(); // Add area of square surrounding ball to minArea
 }
+
+template <class T>
+bool BallsSimT<T>::saveCheckpoint(const char *fileName, const char **error) const {
+	unsigned long n = numBalls();
+	std::vector<uint32_t> colors(n);
+	std::vector<int32_t> ids(n);
+	for (unsigned long i = 0; i < n; i++) {
+		colors[i] = (uint32_t)balls.color(i);
+		ids[i] = balls.id(i);
+	}
+	CheckpointHeader h;
+	memset(&h, 0, sizeof(h));
+	h.scalarSize = sizeof(T);
+	h.numBalls = n;
+	h.nextID = nextID;
+	h.maxCollisionsPerBall = maxCollisionsPerBall;
+	h.maxCollisions = maxCollisions;
+	h.hasWalls = iHasWalls;
+	h.walls[0] = walls.x1();
+	h.walls[1] = walls.y1();
+	h.walls[2] = walls.x2();
+	h.walls[3] = walls.y2();
+	const void *arrays[Checkpoint::NUM_ARRAYS] = {
+		balls.x(), balls.y(), balls.vx(), balls.vy(), balls.r(), balls.m(), colors.data(), ids.data()
+	};
+	Checkpoint file;
+	if (file.write(fileName, h, arrays)) return true;
+	if (error != 0) *error = file.getError();
+	return false;
+}
+
+// Copies n scalars of scalarSize bytes (a float or a double) to dst
+template <class T>
+static void copyScalars(const void *src, uint32_t scalarSize, unsigned long n, T *dst) {
+	if (scalarSize == sizeof(float)) {
+		const float *s = static_cast<const float *>(src);
+		std::copy(s, s + n, dst);
+	}
+	else {
+		const double *s = static_cast<const double *>(src);
+		std::copy(s, s + n, dst);
+	}
+}
+
+template <class T>
+bool BallsSimT<T>::loadCheckpoint(const char *fileName, const char **error) {
+	Checkpoint file;
+	if (!file.open(fileName)) {
+		if (error != 0) *error = file.getError();
+		return false;
+	}
+	const CheckpointHeader &h = file.header();
+	unsigned long n = (unsigned long)h.numBalls;
+	
+	resetBalls();
+	balls.resize(n);
+	T *scalars[] = { balls.x(), balls.y(), balls.vx(), balls.vy(), balls.r(), balls.m() };
+	for (int a = Checkpoint::X; a <= Checkpoint::M; a++) {
+		copyScalars(file.array(Checkpoint::Array(a)), h.scalarSize, n, scalars[a]);
+	}
+	const uint32_t *colors = static_cast<const uint32_t *>(file.array(Checkpoint::COLOR));
+	const int32_t *ids = static_cast<const int32_t *>(file.array(Checkpoint::ID));
+	for (unsigned long i = 0; i < n; i++) {
+		balls.setColor(i, colors[i]);
+		balls.setID(i, ids[i]);
+		indexBallID(i);
+	}
+	
+	nextID = h.nextID;
+	maxCollisionsPerBall = h.maxCollisionsPerBall;
+	maxCollisions = h.maxCollisions;
+	iHasWalls = h.hasWalls != 0;
+	walls = WallsT<T>(T(h.walls[0]), T(h.walls[1]), T(h.walls[2]), T(h.walls[3]));
+	
+	// Sizes derived from the balls, as addBall() computes them
+	const T *r = balls.r();
+	for (unsigned long i = 0; i < n; i++) {
+		if (r[i] * 2. > maxDiameter) maxDiameter = r[i] * 2.;
+		minArea += 4. * r[i] * r[i];
+	}
+	return true;
+}
+
+// Simulators for both scalar types are always built
+template class BallsSimT<double>;
+template class BallsSimT<float>;
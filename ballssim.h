@@ -1,4 +1,4 @@
-// ballssim.h - version 2.6
+// ballssim.h - version 2.24
 // Class for a simulator of many balls
 // Copyright 2006 Chad Berchek
 // Revisions - see ballssim.cpp
@@ -7,25 +7,73 @@
 #define BALLSSIM_H
 
 #include "ball.h"
+#include "ballstore.h"
 #include "walls.h"
 #include "collision.h"
+#include "collisionsimd.h"
+#include "simevent.h"
+#include "cellgrid.h"
+#include "sweepandprune.h"
+#include "aabbtree.h"
+#include "threadpool.h"
+#include "simstats.h"
+#include "checkpoint.h"
+#include "trajectorywriter.h"
+#include "sectorsim.h"
+#include "observables.h"
 #include <vector>
+#include <queue>
+#include <cmath>
+#include <iterator>
 
-class BallsSim {
+// Constants shared by the simulators of all scalar types
+class BallsSimBase {
+	public:
+
+		// Constants
+		// Method used to find the pairs of balls that may collide
+		// BRUTE_FORCE - every pair of balls is tested
+		// CELL_GRID - only balls whose paths share a cell of a uniform grid are tested
+		// SWEEP_AND_PRUNE - only balls whose paths overlap along x, then y, are tested;
+		//   suits balls of very different sizes
+		// AABB_TREE - only balls whose paths overlap, found in a dynamic tree of
+		//   their bounding boxes, are tested; suits balls of very different
+		//   sizes that are spread in both x and y
+		enum BroadPhase { BRUTE_FORCE, CELL_GRID, SWEEP_AND_PRUNE, AABB_TREE };
+		
+		// Reorder interval (see setReorderInterval()) that reorders the balls
+		// whenever they have moved on average two diameters of the largest
+		// ball since they were last reordered
+		static const unsigned int REORDER_ADAPTIVE = 0xFFFFFFFFu;
+};
+
+// Simulator of balls whose positions, velocities, masses and radii are of
+// type T, float or double. float halves the memory traffic and doubles the
+// width of the SIMD kernels, at the cost of precision: collisions are found
+// with the contact tolerance of ScalarTraits<float> (see scalar.h).
+template <class T>
+class BallsSimT : public BallsSimBase {
 	public:
 
 		// Constructors
-		BallsSim() {
+		BallsSimT() {
 			iHasWalls = false;
 			maxCollisionsPerBall = 10;
+			broadPhase = BRUTE_FORCE;
+			lastFrameCollisions = 0;
+			reorderInterval = 0;
+			maxBatchSize = 1;
+			deterministic = false;
+			observablesInterval = 0;
+			framesSinceSample = 0;
+			trajectory = 0;
 			resetBalls();
 		}
 
 		// Modifier methods
-		// Replace internal set of balls with setBalls
-		void setBallsVector(const std::vector<Ball> &setBalls) {
-			balls = setBalls;
-		}
+		// Replace internal set of balls with setBalls. The balls keep their
+		// IDs; balls added later get IDs above all of them.
+		void setBallsVector(const std::vector<BallT<T> > &setBalls);
 		
 		// Remove all balls and reset counters
 		void resetBalls() {
@@ -34,6 +82,12 @@ class BallsSim {
 			minArea = 0.;
 			maxDiameter = 0.;
 			maxCollisions = 10; // This will be overwritten on the first call to addBall()
+			idIndex.clear();
+			framesSinceReorder = 0;
+			travelSinceReorder = HUGE_VAL; // Not reordered yet
+			reorderSpeed = 0.;
+			simTime = 0.;
+			lastBallCollision.clear();
 		}
 		
 		// Set maximum number of collisions for a frame based on the number of balls
@@ -41,14 +95,106 @@ class BallsSim {
 			maxCollisionsPerBall = cpb;
 		}
 		
+		// Select the broad phase used to find candidate pairs of balls
+		void setBroadPhase(BroadPhase bp) {
+			broadPhase = bp;
+		}
+		
+		// Set how often advanceSim() reorders the balls in memory along a
+		// Hilbert curve through their positions, so balls that are close in
+		// space are close in memory. 0 (the default) never reorders, n > 0
+		// reorders every n frames and REORDER_ADAPTIVE reorders as the balls
+		// mix. Reordering changes the indices of balls but not their IDs;
+		// use findBall() to find a ball by ID.
+		void setReorderInterval(unsigned int frames) {
+			reorderInterval = frames;
+		}
+		
+		// Reorders the balls along a Hilbert curve now
+		void reorderBalls();
+		
+		// Set the number of threads used to search for collisions,
+		// including the calling thread. 0 means one per hardware thread.
+		void setNumThreads(unsigned int n) {
+			pool.setNumThreads(n);
+		}
+		
+		// Set the number of sectors advanceSim() splits the walls into, so
+		// that collisions in different sectors are processed on different
+		// threads (see SectorSim). 1 (the default) processes all collisions
+		// on the calling thread and 0 means one sector per thread. The
+		// results are those of a single sector, except that collisions at
+		// exactly the same time may be processed in another order. Not used
+		// while the observables or deterministic mode are on.
+		void setNumSectors(unsigned int n) {
+			sectors.setNumSectors(n);
+		}
+		
+		// Set deterministic mode, off by default. In deterministic mode the
+		// same balls and settings give bit-identical results on any number
+		// of threads, and whatever order the broad phase finds collisions in:
+		// - collisions at exactly the same time are processed in the order of
+		//   the lower ID of their balls, then the higher, then the wall, and
+		//   findEarliestCollision() breaks ties the same way
+		// - parallel scans and sums are split into a fixed number of chunks,
+		//   combined in order, rather than a number that depends on the threads
+		// - frames are not split into sectors, whose order of collisions at
+		//   the same time depends on the timing of the threads
+		// Otherwise the results depend only on the order in which the
+		// collisions at the same time were predicted.
+		void setDeterministic(bool d) {
+			deterministic = d;
+		}
+		
+		// Set how often advanceSim() samples the balls for the observables
+		// (see Observables). 0 (the default) turns the observables off;
+		// n > 0 samples the energy, momentum and velocity histograms every n
+		// frames and records every collision. While the observables are on,
+		// frames are not split into sectors.
+		void setObservablesInterval(unsigned int frames) {
+			observablesInterval = frames;
+			framesSinceSample = 0;
+			lastBallCollision.clear(); // Collisions were not recorded while off
+		}
+		
+		// Set the range of the velocity histograms of the observables to
+		// speeds below maxSpeed (components from -maxSpeed to maxSpeed), in
+		// bins bins, and clear them. If it is not set, the first sample sets
+		// it to four times the root mean square speed of the balls.
+		void setHistogramRange(double maxSpeed, unsigned int bins = Observables::DEFAULT_HISTOGRAM_BINS) {
+			observables.setHistogramRange(maxSpeed, bins);
+		}
+		
+		// Clear the observables, keeping the range of their histograms
+		void resetObservables() {
+			observables.reset();
+			framesSinceSample = 0;
+			lastBallCollision.clear();
+		}
+		
+		// Set the largest number of collisions advanceSim() processes as one
+		// batch. A batch is a run of the next collisions in time order whose
+		// balls differ and whose paths until the end of the frame, before and
+		// after the collisions, do not meet, so the balls can be re-predicted
+		// on several threads at once. A batch is cut short at the first
+		// collision that one found by re-predicting an earlier one of the
+		// batch would precede, and the rest is put back in the queue, so the
+		// results are those of processing one collision at a time except that
+		// collisions at exactly the same time may be processed in another
+		// order. 1 (the default) processes one collision at a time. Not used
+		// in frames split into sectors.
+		void setMaxBatchSize(unsigned int n) {
+			maxBatchSize = n > 0 ? n : 1;
+		}
+		
 		// Apply boundaries to simulation
-		void addWalls(const Walls &w) {
+		void addWalls(const WallsT<T> &w) {
 			moveWalls(w);
 		}
 		
 		// Moves the walls. Moves balls, without collision checking,
 		// to be within the new boundaries
-		void moveWalls(const Walls &newWalls);
+		void moveWalls(const WallsT<T> &newWalls);
 
 		// Remove boundaries of simulation
 		void removeWalls() {
@@ -57,23 +203,107 @@ class BallsSim {
 		
 		// Adds a ball to the simulation. Ball ID is set
 		// automatically and newBall.ID is ignored.
-		void addBall(const Ball &newBall);
+		void addBall(const BallT<T> &newBall);
+		
+		// Adds the balls in the range [first, last) of Balls of any scalar
+		// type, with the same result as calling addBall() for each in turn
+		// but in one pass: storage is reserved once, IDs are assigned in
+		// order and the sizes derived from the balls are updated together.
+		// If the balls are reordered adaptively, they are reordered once at
+		// the start of the next frame rather than as they mix.
+		template <class It> void addBalls(It first, It last) {
+			unsigned long start = numBalls();
+			balls.reserve(start + (unsigned long)std::distance(first, last));
+			for (; first != last; ++first) balls.push_back(BallT<T>(*first));
+			addedBalls(start);
+		}
+		
+		// Writes the balls, walls, next ball ID and collision limits to a
+		// binary checkpoint file (see checkpoint.h). Returns false if the
+		// file cannot be written; error, if not 0, is set to the reason.
+		bool saveCheckpoint(const char *fileName, const char **error = 0) const;
+		
+		// Replaces the balls, walls, next ball ID and collision limits with
+		// those saved in a checkpoint file. The file is mapped into memory and
+		// each array copied whole, so loading costs about as much as reading
+		// the file. A checkpoint of the other scalar type is converted.
+		// Returns false, leaving the simulator unchanged, if the file cannot
+		// be read or is not a valid checkpoint; error, if not 0, is set to the reason.
+		bool loadCheckpoint(const char *fileName, const char **error = 0);
+		
+		// Set the writer to which advanceSim() adds the balls at the end of
+		// every frame, or 0 (the default) for none. The writer must stay open
+		// while it is set; it is not owned by the simulator.
+		void setTrajectoryWriter(TrajectoryWriter *writer) {
+			trajectory = writer;
+		}
 		
 		// Advances the simulation by time dt with full
-		// collision detection
-		void advanceSim(const double dt);
+		// collision detection. Collisions are processed in time order
+		// from a queue of predicted events; after each collision only
+		// the balls involved are re-predicted.
+		void advanceSim(const T dt);
 		
 		// Other methods
 		// Finds earliest of any collisions - between balls or
-		// with walls (if walls present).
-		Collision findEarliestCollision(Ball *&b1, Ball *&b2);
+		// with walls (if walls present). Only collisions happening
+		// before time horizon are considered; a finite horizon lets
+		// the broad phase skip pairs of balls that are far apart.
+		// b1 and b2 are set to the indices of the colliding balls.
+		CollisionT<T> findEarliestCollision(unsigned long &b1, unsigned long &b2, T horizon = HUGE_VAL);
+		
+		// Get the broad phase used to find candidate pairs of balls
+		BroadPhase getBroadPhase() const { return broadPhase; }
+		
+		// Get the number of threads used to search for collisions
+		unsigned int getNumThreads() const { return pool.numThreads(); }
+		
+		// Get the number of sectors set by setNumSectors()
+		unsigned int getNumSectors() const { return sectors.getNumSectors(); }
+		
+		// Get the largest number of collisions processed as one batch
+		unsigned int getMaxBatchSize() const { return maxBatchSize; }
+		
+		// Is deterministic mode on?
+		bool isDeterministic() const { return deterministic; }
+		
+		// Get the interval at which the balls are sampled for the observables
+		unsigned int getObservablesInterval() const { return observablesInterval; }
+		
+		// Observables accumulated since they were last reset
+		const Observables &getObservables() const { return observables; }
+		
+		// Get the interval at which the balls are reordered in memory
+		unsigned int getReorderInterval() const { return reorderInterval; }
 		
 		// Get the max. number of collisions per frame based on the number of balls
 		unsigned int getMaxCollisionsPerBall() const { return maxCollisionsPerBall; }
 		
+		// Get the simulated time, the sum of dt over all calls to advanceSim()
+		// since the balls were last reset or loaded
+		double getTime() const { return simTime; }
+		
+		// Get the number of collisions processed by the last call to advanceSim()
+		unsigned int getNumCollisionsLastFrame() const { return lastFrameCollisions; }
+		
+		// Performance counters of the last call to advanceSim(), and of all
+		// calls since the simulator was created or resetStats() was called.
+		// They stay 0 unless statsEnabled().
+		const SimStats &getLastFrameStats() const { return frameStats; }
+		const SimStats &getTotalStats() const { return totalStats; }
+		
+		// Set the cumulative performance counters to 0
+		void resetStats() { totalStats.reset(); }
+		
+		// Was the library built with the performance counters (BALLSSIM_STATS)?
+		static bool statsEnabled();
+		
 		// Get the minimum dimension of the walls in one direction given the other dimension
 		// This depends on the area occupied by the balls and the diameter of the largest ball
-		double getMinWallDimension(double fixedWallDimension);
+		T getMinWallDimension(T fixedWallDimension);
+		
+		// Get the wall boundaries. Valid only if hasWalls().
+		const WallsT<T> &getWalls() const { return walls; }
 		
 		// Wall boundaries have been set?
 		bool hasWalls() const { return iHasWalls; }
@@ -83,32 +313,238 @@ class BallsSim {
 		
 		// getBall - no bounds checking. Caller must use numBalls() to make sure index is valid
 		// Index starts at 0 and runs up through numBalls()-1
-		const Ball &getBall(unsigned long index) const { return balls[index]; }
+		// The returned reference has the get methods of BallT and converts to BallT<T>.
+		ConstBallRefT<T> getBall(unsigned long index) const { return balls[index]; }
+		
+		// Finds the index of the ball with the given ID. Returns false if
+		// there is no such ball.
+		bool findBall(int id, unsigned long &index) const;
 
 	private:
-		std::vector<Ball> balls; // Stores all the balls
+		friend class SectorSimT<T>; // Runs the events of a frame on the state below
+		
+		BallStoreT<T> balls; // Stores all the balls
 		bool iHasWalls; // Have wall boundaries been set?
-		Walls walls; // Wall boundaries
+		WallsT<T> walls; // Wall boundaries
 		int nextID; // Next ID to assign to an added ball
 		unsigned int maxCollisions; // Max number of collisions per frame in advanceSim
 		unsigned int maxCollisionsPerBall; // Max number of collisions per frame based on the number of balls
-		double minArea; // Minimum area within walls
-		double maxDiameter; // Maximum diameter out of all the balls
+		unsigned int lastFrameCollisions; // Number of collisions processed by the last call to advanceSim()
+		T minArea; // Minimum area within walls
+		T maxDiameter; // Maximum diameter out of all the balls
+		BroadPhase broadPhase; // Method used to find candidate pairs of balls
+		CellGrid grid; // Broad phase grid, used if broadPhase == CELL_GRID
+		SweepAndPrune sweep; // Sorted list of the balls, used if broadPhase == SWEEP_AND_PRUNE
+		AabbTree tree; // Tree of the boxes of the balls, used if broadPhase == AABB_TREE
+		SimStats frameStats; // Performance counters of the last frame
+		SimStats totalStats; // Performance counters of all frames since the last resetStats()
+		std::vector<unsigned long> idIndex; // Index of the ball with each ID, for IDs below its size
+		unsigned int reorderInterval; // See setReorderInterval()
+		unsigned int maxBatchSize; // See setMaxBatchSize()
+		bool deterministic; // See setDeterministic()
+		unsigned int observablesInterval; // See setObservablesInterval()
+		unsigned int framesSinceSample; // Frames since the balls were last sampled for the observables
+		Observables observables; // See getObservables()
+		std::vector<double> lastBallCollision; // Time of the last collision of each ball with another, -1 if none yet
+		unsigned int framesSinceReorder; // Frames since the balls were last reordered
+		double travelSinceReorder; // Estimated distance each ball has moved since then
+		double reorderSpeed; // Mean speed of the balls when they were last reordered
+		double simTime; // Simulated time, see getTime()
+		TrajectoryWriter *trajectory; // Writer of the frames, 0 if none
+		
+		// Number of balls the SIMD kernels test in one call
+		static const unsigned long SCAN_BLOCK = 256;
+		// Number of chunks per thread a parallel scan is split into, so
+		// threads that finish early can take more work
+		static const unsigned long CHUNKS_PER_THREAD = 4;
+		// Minimum number of balls for re-predicting one ball in parallel
+		static const unsigned long PARALLEL_MIN_BALLS = 16384;
+		// Number of chunks a parallel scan is split into in deterministic
+		// mode, whatever the number of threads
+		static const unsigned long DETERMINISTIC_CHUNKS = 256;
+		
+		ThreadPool pool; // Threads for the collision searches
+		
+		// Event-driven simulation state, valid only during advanceSim()
+		std::vector<T> ballTime; // Time within the frame to which each ball's position refers
+		std::vector<unsigned long> collisionCount; // Number of collisions of each ball in the frame
+		std::vector<unsigned long> lastPartner; // Ball each ball last collided with, numBalls() if a wall
+		SimEvent::Later eventOrder; // Order of the events of the frame, see setDeterministic()
+		std::priority_queue<SimEvent, std::vector<SimEvent>, SimEvent::Later> events; // Predicted collisions
+		std::vector<std::vector<SimEvent> > chunkEvents; // Events found by each chunk of a parallel scan
+		SectorSimT<T> sectors; // Runs the events of a frame split into sectors, see setNumSectors()
+		
+		// State of a ball before the event of a batch that involves it, to
+		// put it back if the batch is cut short
+		struct BatchUndo {
+			unsigned long ball;
+			T x, y, vx, vy, t;
+			unsigned long count, partner;
+		};
+		std::vector<SimEvent> batch; // Events of the batch being processed, in time order
+		std::vector<BoundingBox> batchBoxes; // Region the balls of each event of the batch may reach
+		std::vector<BatchUndo> batchUndo; // Balls of the batch before its events, in order
+		std::vector<std::vector<SimEvent> > batchEvents; // Collisions found by re-predicting the balls of each event
+		std::vector<unsigned long> batchTests; // Pairs of balls tested to find them
+		
+		// Gives IDs to the balls from index first on, which have just been
+		// added, moves them within the walls and updates the derived state
+		void addedBalls(unsigned long first);
+		
+		// Indexes the IDs of the balls from index first on and adds them to
+		// the collision limit and the sizes derived from the balls
+		void accountBalls(unsigned long first);
 		
 		// Advances ball positions according to current velocities
 		// with no collision detection. Advances by time dt
-		void advanceBallPositions(const double dt);
+		void advanceBallPositions(const T dt);
 		
 		// Look at all pairs of balls and find the earliest
-		// collision between any two.
-		Collision findEarliestCollisionOfTwoBalls(Ball *&b1, Ball *&b2);
+		// collision between any two that happens before time horizon.
+		CollisionT<T> findEarliestCollisionOfTwoBalls(unsigned long &b1, unsigned long &b2, T horizon);
 		
 		// Look at all balls and find the earliest one
-		// to collide with a wall.
-		Collision findEarliestCollisionWithWall(Ball *&b);
+		// to collide with a wall before time horizon.
+		CollisionT<T> findEarliestCollisionWithWall(unsigned long &b, T horizon);
+		
+		// Rebuilds the broad phase from the boxes swept by the balls between
+		// time 0 and time horizon. All balls must be at time 0.
+		void rebuildBroadPhase(T horizon);
+		
+		// Updates the broad phase after the velocity of ball i has changed.
+		// Ball i must be at time ballTime[i].
+		void updateBroadPhase(unsigned long i, T horizon);
+		
+		// Calls f(i, j) with i < j for each pair of balls the broad phase
+		// reports as candidates. broadPhase must not be BRUTE_FORCE.
+		template <class F> void forEachCandidatePair(F f) const {
+			if (broadPhase == CELL_GRID) grid.forEachPair(f);
+			else if (broadPhase == AABB_TREE) tree.forEachPair(f);
+			else sweep.forEachPair(f);
+		}
+		
+		// Calls f(j) for each ball j the broad phase reports as a candidate
+		// for a collision with ball i. broadPhase must not be BRUTE_FORCE.
+		template <class F> void forEachCandidate(unsigned long i, F f) const {
+			if (broadPhase == CELL_GRID) grid.forEachCandidate(i, f);
+			else if (broadPhase == AABB_TREE) tree.forEachCandidate(i, f);
+			else sweep.forEachCandidate(i, f);
+		}
+		
+		// Is collision c, of balls i and j (or ball i and a wall), earlier than
+		// collision c2 of balls i2 and j2? In deterministic mode ties are
+		// broken as in the event queue.
+		bool isEarlier(const CollisionT<T> &c, unsigned long i, unsigned long j, const CollisionT<T> &c2, unsigned long i2,
+			unsigned long j2) const;
+		
+		// Is it time to reorder the balls, according to reorderInterval?
+		bool isReorderDue() const;
+		
+		// Records that ball i has the ID it holds in balls
+		void indexBallID(unsigned long i);
 		
 		// Moves a ball, which may be anywhere, to within the walls
-		void moveBallToWithinBounds(Ball &b);
+		void moveBallToWithinBounds(BallRefT<T> b);
+		
+		// Moves ball i along its current velocity to time t within the frame
+		void advanceBallTo(unsigned long i, T t);
+		
+		// Copy of the position, velocity, mass and radius of ball i as they
+		// will be at time t within the frame. Ball i itself is not moved.
+		BallT<T> ballAt(unsigned long i, T t) const;
+		
+		// Predicts the collision of balls i and j. Returns true, with e set
+		// to the collision, if it happens before time horizon. The
+		// prediction is made at the later of the two balls' times. Safe to
+		// call from several threads at once.
+		bool findPairEvent(unsigned long i, unsigned long j, T horizon, SimEvent &e) const;
+		
+		// Predicts the collision of ball i with the walls. Returns true, with
+		// e set to the collision, if it happens before time horizon. Safe to
+		// call from several threads at once.
+		bool findWallEvent(unsigned long i, T horizon, SimEvent &e) const;
+		
+		// Predicts the collision of balls i and j and queues it if it
+		// happens before time horizon. The prediction is made at the later
+		// of the two balls' times, so it depends only on their states.
+		void predictTwoBalls(unsigned long i, unsigned long j, T horizon);
+		
+		// Predicts the collision of ball i with the walls and queues it if
+		// it happens before time horizon
+		void predictWall(unsigned long i, T horizon);
+		
+		// Predicts all collisions of ball i, except with ball exclude,
+		// that happen before time horizon
+		void predictBall(unsigned long i, unsigned long exclude, T horizon);
+		
+		// Predicts all collisions in the frame that happen before time horizon
+		void predictAll(T horizon);
+		
+		// Appends to out the collisions of ball i, except with ball exclude,
+		// that happen before time horizon, like predictBall() but on the
+		// calling thread only. Returns the number of pairs of balls tested.
+		// Safe to call from several threads at once.
+		unsigned long findBallEvents(unsigned long i, unsigned long exclude, T horizon, std::vector<SimEvent> &out) const;
+		
+		// Moves the balls of event e to its time and collides them
+		void applyEvent(const SimEvent &e);
+		
+		// Processes a batch of at most limit of the next events (see
+		// setMaxBatchSize()) and queues the collisions it leads to. Returns
+		// the number of collisions processed.
+		unsigned int processBatch(T horizon, unsigned int limit);
+		
+		// Adds event e, which has just been applied, to the observables. vx1,
+		// vy1, vx2 and vy2 are the velocities of its balls before it.
+		void observeEvent(const SimEvent &e, T vx1, T vy1, T vx2, T vy2);
+		
+		// Adds a frame of duration dt to the observables, sampling the balls
+		// if it is time to
+		void observeFrame(T dt);
+		
+		// Puts the balls of the batch back as they were before their events,
+		// from record first of batchUndo on, and drops those records
+		void undoBatchEvents(unsigned long first, T horizon);
+		
+		// Appends to out the collisions of ball i with balls j0 through j1 - 1,
+		// except itself and ball exclude, that happen before time horizon.
+		// Uses the SIMD kernels. Safe to call from several threads at once.
+		void findTwoBallsEvents(unsigned long i, unsigned long j0, unsigned long j1, unsigned long exclude,
+			T horizon, std::vector<SimEvent> &out) const;
+		
+		// Appends to out the collisions of balls i0 through i1 - 1 with the
+		// walls that happen before time horizon. Uses the SIMD kernels. Safe
+		// to call from several threads at once.
+		void findWallEvents(unsigned long i0, unsigned long i1, T horizon, std::vector<SimEvent> &out) const;
+		
+		// Queues the events in chunkEvents, in chunk order
+		void pushChunkEvents();
+		
+		// Number of chunks to split a parallel scan of n items into
+		unsigned long numRangeChunks(unsigned long n) const;
+		
+		// Start of chunk k when n items are split into numChunks equal chunks
+		static unsigned long rangeStart(unsigned long n, unsigned long numChunks, unsigned long k) {
+			return (unsigned long)((unsigned long long)n * k / numChunks);
+		}
+		
+		// Splits the rows i of the pair triangle (i, j > i) into chunks holding
+		// about the same number of pairs. Chunk k is rows rowStart[k] through
+		// rowStart[k + 1] - 1.
+		void splitPairRows(std::vector<unsigned long> &rowStart) const;
+		
+		// Arrays of the balls and their times, for the SIMD kernels
+		BallArraysT<T> arrays() const;
+		
+		// Is the event still valid, i.e. have its balls not collided since
+		// it was predicted?
+		bool isEventValid(const SimEvent &e) const;
+		
+		// Is a collision of balls i and j the contact they have just been
+		// through, found again because of rounding?
+		bool isRepeatContact(unsigned long i, unsigned long j) const;
 };
 
+typedef BallsSimT<SimScalar> BallsSim;
+
 #endif
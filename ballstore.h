@@ -0,0 +1,242 @@
+// ballstore.h - version 1.4
+// Structure-of-arrays container for the balls of a simulator, and
+// lightweight references that give a Ball-like view of one ball in it.
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - added permute()
+//   1.2:
+//     - made the store and references templates on the scalar type (BallStoreT, ConstBallRefT,
+//       BallRefT). BallStore, ConstBallRef and BallRef use SimScalar.
+//   1.3:
+//     - added resize()
+//   1.4:
+//     - added ids()
+
+#ifndef BALLSTORE_H
+#define BALLSTORE_H
+
+#include "ball.h"
+#include "vector2d.h"
+#include "scalar.h"
+#include <vector>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+
+// Allocator for std::vector that aligns storage to Alignment bytes (a power
+// of 2), so arrays of numbers start on a cache line and can be loaded with
+// aligned SIMD instructions.
+template <class T, std::size_t Alignment = 64>
+class AlignedAllocator {
+	public:
+		typedef T value_type;
+
+		template <class U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+		// Constructors
+		AlignedAllocator() { }
+		template <class U> AlignedAllocator(const AlignedAllocator<U, Alignment> &) { }
+
+		T *allocate(std::size_t n) {
+			// Over-allocate and keep the pointer returned by malloc just before
+			// the aligned block so deallocate() can free it
+			void *raw = std::malloc(n * sizeof(T) + Alignment + sizeof(void *));
+			if (raw == 0) throw std::bad_alloc();
+			std::size_t p = reinterpret_cast<std::size_t>(raw) + sizeof(void *);
+			p = (p + Alignment - 1) & ~(Alignment - 1);
+			reinterpret_cast<void **>(p)[-1] = raw;
+			return reinterpret_cast<T *>(p);
+		}
+
+		void deallocate(T *p, std::size_t) {
+			if (p != 0) std::free(reinterpret_cast<void **>(p)[-1]);
+		}
+
+		template <class U> bool operator==(const AlignedAllocator<U, Alignment> &) const { return true; }
+		template <class U> bool operator!=(const AlignedAllocator<U, Alignment> &) const { return false; }
+};
+
+template <class T> class BallStoreT;
+
+// Common part of ConstBallRefT and BallRefT. S is BallStoreT<T> or
+// const BallStoreT<T>. The get methods are the same as those of Ball.
+template <class T, class S>
+class BallRefBase {
+	public:
+		typedef T Scalar;
+
+		// Constructors
+		BallRefBase(S &s, unsigned long index) : store(&s), i(index) { }
+
+		// Get methods
+		T x() const { return store->x()[i]; }
+		T y() const { return store->y()[i]; }
+		T vx() const { return store->vx()[i]; }
+		T vy() const { return store->vy()[i]; }
+		T m() const { return store->m()[i]; }
+		T r() const { return store->r()[i]; }
+		unsigned long color() const { return store->color(i); }
+		Vector2DT<T> pos() const { return Vector2DT<T>(x(), y()); }
+		Vector2DT<T> v() const { return Vector2DT<T>(vx(), vy()); }
+		int id() const { return store->id(i); }
+
+		// Index of the ball in its store
+		unsigned long index() const { return i; }
+
+		// Copy of the ball
+		operator BallT<T>() const {
+			BallT<T> b;
+			b.setXY(x(), y());
+			b.setVXY(vx(), vy());
+			b.setM(m());
+			b.setR(r());
+			b.setColor(color());
+			b.setID(id());
+			return b;
+		}
+
+	protected:
+		S *store; // Store holding the ball
+		unsigned long i; // Index of the ball in store
+};
+
+// Read-only reference to a ball in a BallStoreT
+template <class T>
+class ConstBallRefT : public BallRefBase<T, const BallStoreT<T> > {
+	public:
+		ConstBallRefT(const BallStoreT<T> &s, unsigned long index) : BallRefBase<T, const BallStoreT<T> >(s, index) { }
+};
+
+// Modifiable reference to a ball in a BallStoreT. The set methods are the
+// same as those of Ball and change the ball in the store.
+template <class T>
+class BallRefT : public BallRefBase<T, BallStoreT<T> > {
+	public:
+		BallRefT(BallStoreT<T> &s, unsigned long index) : BallRefBase<T, BallStoreT<T> >(s, index) { }
+
+		operator ConstBallRefT<T>() const { return ConstBallRefT<T>(*this->store, this->i); }
+
+		// Set methods
+		void setX(const T x) { this->store->x()[this->i] = x; }
+		void setY(const T y) { this->store->y()[this->i] = y; }
+		void setXY(const T x, const T y) { setX(x); setY(y); }
+		void setPos(const Vector2DT<T> &pos) { setXY(pos.x(), pos.y()); }
+		void setVX(const T vx) { this->store->vx()[this->i] = vx; }
+		void setVY(const T vy) { this->store->vy()[this->i] = vy; }
+		void setVXY(const T vx, const T vy) { setVX(vx); setVY(vy); }
+		void setV(const Vector2DT<T> &v) { setVXY(v.x(), v.y()); }
+		void setM(const T mass) { this->store->m()[this->i] = mass; }
+		void setR(const T radius) { this->store->r()[this->i] = radius; }
+		void setColor(const unsigned long color) { this->store->setColor(this->i, color); }
+		void setID(const int sid) { this->store->setID(this->i, sid); }
+
+		// Moves the ball according to the current velocity by time dt
+		void advanceBallPosition(const T dt) {
+			setX(this->x() + this->vx() * dt);
+			setY(this->y() + this->vy() * dt);
+		}
+};
+
+// Stores balls as separate contiguous arrays of x, y, vx, vy, r and m, so
+// loops that only need positions, velocities and radii read nothing else.
+// Color and ID, which the simulation never reads, are kept apart.
+template <class T>
+class BallStoreT {
+	public:
+		typedef T Scalar;
+		typedef std::vector<T, AlignedAllocator<T> > Array;
+
+		// How many balls are there?
+		unsigned long size() const { return ix.size(); }
+
+		// Remove all balls
+		void clear() {
+			ix.clear(); iy.clear(); ivx.clear(); ivy.clear(); ir.clear(); im.clear();
+			icolor.clear(); iid.clear();
+		}
+
+		// Reserve storage for n balls
+		void reserve(unsigned long n) {
+			ix.reserve(n); iy.reserve(n); ivx.reserve(n); ivy.reserve(n); ir.reserve(n); im.reserve(n);
+			icolor.reserve(n); iid.reserve(n);
+		}
+
+		// Set the number of balls to n. Balls added are all 0.
+		void resize(unsigned long n) {
+			ix.resize(n); iy.resize(n); ivx.resize(n); ivy.resize(n); ir.resize(n); im.resize(n);
+			icolor.resize(n); iid.resize(n);
+		}
+		
+		// Add a copy of b at the end
+		void push_back(const BallT<T> &b) {
+			ix.push_back(b.x());
+			iy.push_back(b.y());
+			ivx.push_back(b.vx());
+			ivy.push_back(b.vy());
+			ir.push_back(b.r());
+			im.push_back(b.m());
+			icolor.push_back(b.color());
+			iid.push_back(b.id());
+		}
+
+		// Reorders the balls so that the ball at index k is the one that was
+		// at index order[k]. order must be a permutation of 0 .. size() - 1.
+		void permute(const std::vector<unsigned long> &order) {
+			permuteArray(ix, order); permuteArray(iy, order); permuteArray(ivx, order); permuteArray(ivy, order);
+			permuteArray(ir, order); permuteArray(im, order);
+			permuteArray(icolor, order); permuteArray(iid, order);
+		}
+
+		// References to ball i (no bounds checking)
+		ConstBallRefT<T> operator[](unsigned long i) const { return ConstBallRefT<T>(*this, i); }
+		BallRefT<T> operator[](unsigned long i) { return BallRefT<T>(*this, i); }
+		BallRefT<T> back() { return BallRefT<T>(*this, size() - 1); }
+
+		// Arrays of each property, indexed by ball
+		const T *x() const { return ix.data(); }
+		const T *y() const { return iy.data(); }
+		const T *vx() const { return ivx.data(); }
+		const T *vy() const { return ivy.data(); }
+		const T *r() const { return ir.data(); }
+		const T *m() const { return im.data(); }
+		T *x() { return ix.data(); }
+		T *y() { return iy.data(); }
+		T *vx() { return ivx.data(); }
+		T *vy() { return ivy.data(); }
+		T *r() { return ir.data(); }
+		T *m() { return im.data(); }
+
+		// IDs of the balls, indexed by ball
+		const int *ids() const { return iid.data(); }
+
+		// Cold properties of ball i
+		unsigned long color(unsigned long i) const { return icolor[i]; }
+		int id(unsigned long i) const { return iid[i]; }
+		void setColor(unsigned long i, unsigned long color) { icolor[i] = color; }
+		void setID(unsigned long i, int id) { iid[i] = id; }
+
+	private:
+		// Note: i stands for internal
+		Array ix; // Position
+		Array iy;
+		Array ivx; // Velocity
+		Array ivy;
+		Array ir; // Radius
+		Array im; // Mass
+		std::vector<unsigned long> icolor; // Color
+		std::vector<int> iid; // ID
+
+		template <class V> static void permuteArray(V &a, const std::vector<unsigned long> &order) {
+			V permuted(a.size());
+			for (unsigned long k = 0; k < order.size(); k++) permuted[k] = a[order[k]];
+			a.swap(permuted);
+		}
+};
+
+typedef BallStoreT<SimScalar> BallStore;
+typedef ConstBallRefT<SimScalar> ConstBallRef;
+typedef BallRefT<SimScalar> BallRef;
+
+#endif
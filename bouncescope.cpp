@@ -8,16 +8,20 @@
 #include "ball.h"
 #include "walls.h"
 #include "ballssim.h"
+#include "rasterizer.h"
+#include "simthread.h"
+#include "scenariogenerator.h"
 #include <windows.h>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <time.h>
+#include <vector>
 using namespace std;
 
 // CONSTANTS
 const UINT FRAME_DT = 10; // Frame duration in milliseconds
-const DWORD OVERFLOW_THRESHOLD = 1000; // Threshold for detecting DWORD subtraction overflow (i.e., 1 - 1000 = 4294966297). Must be greater than FRAME_DT
 const unsigned int MAX_NUM_BALLS = 60000; // Maximum number of balls in the simulator
 const unsigned char LIGHT_COLOR_THRESHOLD = 0xE0; // If the R, G, and B components of color for a ball are greater than this, issue a notice
 const int GET_INPUT_BUFFER_LEN = 100; // Length of buffer for reading text from edit controls
@@ -39,7 +43,7 @@ const double MAX_RANDOM_V = 200; // Maximum velocity (x or y) to be used in gene
 const double MIN_RANDOM_R = 5; // Minimum radius to be used in generating random balls
 const double MAX_RANDOM_R = 20; // Maximum radius to be used in generating random balls
 const double M_TO_A_RATIO = .1; // Ratio of mass to area used in generating random balls
-const UINT WMU_UPDATESIM = WM_USER + 0; // Message meaning the simulator should be updated by calling g_bsim.advanceSim()
+const UINT WMU_UPDATESIM = WM_USER + 0; // Message meaning the display should be updated with the latest state of g_bsim
 const UINT WMU_PAUSESIM = WM_USER + 1; // Message meaning pause the simulation
 const UINT WMU_RESUMESIM = WM_USER + 2; // Message meaning resume the simulation
 
@@ -48,6 +52,9 @@ const UINT WMU_RESUMESIM = WM_USER + 2; // Message meaning resume the simulation
 BallsSim g_bsim = BallsSim(); // Note: it is absolutely vital to say = BallsSim() because otherwise
 										// the constructor will not be called.
 Ball g_bAdd = Ball(); // Stores settings of last ball added from "Add a ball" dialog box
+SimThread g_simThread(g_bsim); // Runs g_bsim. While it runs, g_bsim must only be used through it.
+Rasterizer g_raster; // Draws the balls of g_bsim into a bitmap
+ScenarioGenerator g_placer; // Finds free places for new balls. Only used by commands of g_simThread.
 										
 // Set up defaults for ball to be added
 void initAddBall() {
@@ -57,88 +64,96 @@ void initAddBall() {
 	// Color is already black
 }
 
-// hdc = DC to draw on
-// x, y = coordinates of circle center
-// r = radius
-// color = fairly self explanatory
-void drawSolidCircle(const HDC hdc, const double x, const double y, const double r, const COLORREF color) {
-	HPEN hPen = CreatePen(PS_SOLID, 0, color); // Create pen
-	HPEN hPenOld = (HPEN)SelectObject(hdc, hPen); // Select new pen, save old
-	HBRUSH hBrush = CreateSolidBrush(color); // Create brush
-	HBRUSH hBrushOld = (HBRUSH)SelectObject(hdc, hBrush); // Select new brush, save old
-
-	Ellipse(hdc, int((x - r)+.5), int((y - r) + .5), int((x + r) + .5), int((y + r) +.5)); // Draw circle
-
-	SelectObject(hdc, hPenOld); // Replace with old pen
-	DeleteObject(hPen); // Delete new pen
-	SelectObject(hdc, hBrushOld); // Replace with old brush
-	DeleteObject(hBrush); // Delete new brush
-}
-
-// Draw every ball in the ball simulator g_bsim
-void drawAllBalls(const HDC hdc) {
-	for (unsigned long i = 0; i < g_bsim.numBalls(); i++) {
-		const Ball &b = g_bsim.getBall(i);
-		drawSolidCircle(hdc, b.x(), b.y(), b.r(), (COLORREF)b.color());
+// Draw every ball of the latest snapshot of the ball simulator g_bsim over
+// a white background, filling the width x height area at the top left of
+// hdc. The balls are drawn into a bitmap by g_raster and copied to hdc in one
+// call, so there is no flicker and no GDI pen or brush per ball.
+void drawAllBalls(const HDC hdc, const int width, const int height) {
+	const BallSnapshot *snapshot = g_simThread.latest();
+	if (width <= 0 || height <= 0 || snapshot == 0) return;
+	if (g_raster.getWidth() != unsigned(width) || g_raster.getHeight() != unsigned(height)) {
+		g_raster.setSize(width, height);
 	}
+	g_raster.drawBalls(*snapshot);
+
+	BITMAPINFO bmi;
+	ZeroMemory(&bmi, sizeof(bmi));
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = width;
+	bmi.bmiHeader.biHeight = -height; // Negative: the first row is the top one
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+	SetDIBitsToDevice(hdc, 0, 0, width, height, 0, 0, 0, height, g_raster.pixels(), &bmi, DIB_RGB_COLORS);
 }
 
-// Redraw the client area using double buffering
+// Redraw the client area
 void updateDisplay(const HWND hWnd) {
 	HDC hdcWindow = GetDC(hWnd);
-	HDC hdcBuffer = CreateCompatibleDC(hdcWindow);
 
 	RECT windowRect;
 	GetClientRect(hWnd, &windowRect);
+	drawAllBalls(hdcWindow, windowRect.right, windowRect.bottom);
 
-	HBITMAP hbmBuffer = CreateCompatibleBitmap(hdcWindow, windowRect.right, windowRect.bottom);
-	HBITMAP hbmBufferOld = (HBITMAP)SelectObject(hdcBuffer, hbmBuffer);
-
-	FillRect(hdcBuffer, &windowRect, (HBRUSH)GetStockObject(WHITE_BRUSH));
-	drawAllBalls(hdcBuffer);
-	BitBlt(hdcWindow, 0, 0, windowRect.right, windowRect.bottom, hdcBuffer, 0, 0, SRCCOPY);
-	
-	// Cleanup:
-	SelectObject(hdcBuffer, hbmBufferOld);
-	DeleteObject(hbmBuffer);
-	DeleteDC(hdcBuffer);
 	ReleaseDC(hWnd, hdcWindow);
 }
 
-// Returns a random number in the range [min, max]
-double getRandomNumber(double min, double max) {
-	return (max - min) * rand() / RAND_MAX + min;
-}
-
 // Displays message that the maximum number of balls has been reached
 // hWnd is the handle of the window displaying this message
 void maxNumBallsMsg(HWND hWnd) {
 	MessageBox(hWnd, "The maximum number of balls has been reached.", "Note", MB_ICONWARNING);
 }
 
+// Adds up to n balls to bsim at random places inside its walls where they
+// overlap neither each other nor the balls already there. If like is 0 the
+// balls are random, as from "Add 10 random balls"; otherwise they are copies
+// of *like. Returns the number of balls added, less than n if there was no
+// room for all. Must run as a command of g_simThread, so that no frame runs
+// between finding the places and adding the balls.
+unsigned long addBallsAtFreePlaces(BallsSim &bsim, unsigned long n, unsigned int seed, const Ball *like) {
+	unsigned long numBalls = bsim.numBalls();
+	vector<double> x(numBalls), y(numBalls), r(numBalls);
+	for (unsigned long i = 0; i < numBalls; i++) {
+		ConstBallRef b = bsim.getBall(i);
+		x[i] = b.x();
+		y[i] = b.y();
+		r[i] = b.r();
+	}
+	g_placer.setObstacles(x.data(), y.data(), r.data(), numBalls);
+	g_placer.setSeed(seed);
+	if (like != 0) g_placer.setRadiusRange(like->r(), like->r());
+	else {
+		g_placer.setRadiusRange(MIN_RANDOM_R, MAX_RANDOM_R);
+		g_placer.setVelocityRange(MIN_RANDOM_V, MAX_RANDOM_V);
+		g_placer.setMassToAreaRatio(M_TO_A_RATIO);
+	}
+
+	const Walls &w = bsim.getWalls();
+	vector<BallT<double> > placed;
+	g_placer.generate(n, WallsT<double>(w.x1(), w.y1(), w.x2(), w.y2()), placed);
+	g_placer.clearObstacles();
+	vector<Ball> newBalls;
+	for (unsigned long i = 0; i < placed.size(); i++) {
+		Ball b = like != 0 ? *like : Ball(placed[i]);
+		b.setXY(placed[i].x(), placed[i].y());
+		newBalls.push_back(b);
+	}
+	bsim.addBalls(newBalls.begin(), newBalls.end());
+	return (unsigned long)newBalls.size();
+}
+
 // Adds 10 random balls to the simulator
 // hWnd is the handle of the window calling this function (used to display message in case of error)
 void add10RandomBalls(HWND hWnd) {
-	for (unsigned char i = 0; i < 10; i++) {
-		if (g_bsim.numBalls() >= MAX_NUM_BALLS) {
-			maxNumBallsMsg(hWnd);
-			break;
-		}
-
-		double vx = getRandomNumber(MIN_RANDOM_V, MAX_RANDOM_V);
-		double vy = getRandomNumber(MIN_RANDOM_V, MAX_RANDOM_V);
-		double r = getRandomNumber(MIN_RANDOM_R, MAX_RANDOM_R);
-		double area = M_PI * r * r;
-		double m = M_TO_A_RATIO * area;
-		unsigned int color = (unsigned int)getRandomNumber(0, 0xE0E0E0);
-		
-		Ball b;
-		b.setVXY(vx, vy);
-		b.setR(r);
-		b.setM(m);
-		b.setColor(color);
-		g_bsim.addBall(b);
+	unsigned long numBalls = 0;
+	g_simThread.runSync([&numBalls](BallsSim &bsim) { numBalls = bsim.numBalls(); });
+	unsigned long numNew = 10;
+	if (numBalls + numNew > MAX_NUM_BALLS) {
+		maxNumBallsMsg(hWnd);
+		numNew = numBalls < MAX_NUM_BALLS ? MAX_NUM_BALLS - numBalls : 0;
 	}
+	unsigned int seed = (unsigned int)rand();
+	g_simThread.post([numNew, seed](BallsSim &bsim) { addBallsAtFreePlaces(bsim, numNew, seed, 0); });
 }
 		
 
@@ -148,13 +163,12 @@ void add10RandomBalls(HWND hWnd) {
 // This function displays a message box on error.
 // Parameters retrieved: diameter, mass, x velocity, y velocity
 // These parameters are stored in ball g_bAdd.
-// If the parameters are retrieved successfully, the ball is added to BallSim g_bsim.
+// If the parameters are retrieved successfully, the ball is added to BallSim g_bsim at a
+// free place, if there is one.
 bool addBallFromDlg(HWND hWnd) {
 	const unsigned int bufLen = GET_INPUT_BUFFER_LEN;
 	char buf[bufLen];
 	
-	g_bAdd.setXY(0., 0.); // Set coordinates to (0, 0)
-
 	// Get x velocity
 	GetWindowText(GetDlgItem(hWnd, IDC_VXENTRY), buf, bufLen);
 	double vx = atof(buf);
@@ -199,7 +213,14 @@ bool addBallFromDlg(HWND hWnd) {
 		return false;
 	}
 	
-	g_bsim.addBall(g_bAdd);
+	Ball b = g_bAdd;
+	unsigned int seed = (unsigned int)rand();
+	unsigned long added = 0;
+	g_simThread.runSync([&](BallsSim &bsim) { added = addBallsAtFreePlaces(bsim, 1, seed, &b); });
+	if (added == 0) {
+		MessageBox(hWnd, "There is no room for the ball.", "Note", MB_ICONWARNING);
+		return false;
+	}
 	return true;
 }
 
@@ -302,7 +323,6 @@ BOOL CALLBACK aboutDlgProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 // Process all messages to the main window
 LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 	const UINT_PTR TIMER_ID_FRAME_DT = 1; // ID of the frame update timer
-	static DWORD timeAtLastUpdateSim = 0; // time when the last WM_TIMER message with an ID of TIMER_ID_FRAME_DT was received
 	static bool timerRunning = false; // Keeps track of whether or not the timer is running
 
 	switch (msg) {
@@ -313,9 +333,9 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 				PAINTSTRUCT ps;
 				HDC hdc = BeginPaint(hWnd, &ps);
 
-				// No need for double buffering here because we're just drawing on top of what's
-				// already there, not clearing the display and drawing new circles
-				drawAllBalls(hdc);
+				RECT clientRect;
+				GetClientRect(hWnd, &clientRect);
+				drawAllBalls(hdc, clientRect.right, clientRect.bottom);
 
 				EndPaint(hWnd, &ps);
 			}
@@ -327,22 +347,15 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 		break;
 
 		case WMU_UPDATESIM:
-		{
-			DWORD timeSinceLastFrame;
-			const DWORD currentTime = timeGetTime();
-			if (timeAtLastUpdateSim == 0) timeSinceLastFrame = FRAME_DT; // Account for uninitialized timeAtLastWM_TIMER
-			else timeSinceLastFrame = currentTime - timeAtLastUpdateSim; // Normal calculation
-			if (timeSinceLastFrame > OVERFLOW_THRESHOLD) timeSinceLastFrame = FRAME_DT; // Account for timer wrap-around
-			timeAtLastUpdateSim = currentTime; // Update timeAtLastUpdateSim
-			g_bsim.advanceSim(timeSinceLastFrame / 1000.); // Convert from milliseconds (timeSinceLastFrame) to sec.
-			updateDisplay(hWnd);
-		}
+			// g_simThread advances the simulation on its own; only draw its latest frame
+			if (g_simThread.hasNewSnapshot()) updateDisplay(hWnd);
 		break;
 		
 		case WMU_PAUSESIM:
 			if (timerRunning) {
 				KillTimer(hWnd, TIMER_ID_FRAME_DT);
 				timerRunning = false;
+				g_simThread.setPaused(true);
 			}
 		break;
 		
@@ -350,6 +363,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 			if (!timerRunning) {
 				SetTimer(hWnd, TIMER_ID_FRAME_DT, FRAME_DT, NULL);
 				timerRunning = true;
+				g_simThread.setPaused(false);
 			}
 		break;
 
@@ -364,7 +378,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 				// of the bottom-right pixel, the wall coordinates must be set one beyond the coordinates of the
 				// bottom-right pixel.
 				Walls w(0, 0, LOWORD(lParam), HIWORD(lParam));
-				g_bsim.moveWalls(w);
+				g_simThread.post([w](BallsSim &bsim) { bsim.moveWalls(w); });
 				PostMessage(hWnd, WMU_RESUMESIM, 0, 0);
 			}
 		}
@@ -379,9 +393,14 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 			unsigned long extraWidth = windowRC.right - windowRC.left - clientRC.right;
 			unsigned long extraHeight = windowRC.bottom - windowRC.top - clientRC.bottom;
 			MINMAXINFO &mmi = *((MINMAXINFO*)lParam);
+			double minWidth, minHeight;
+			g_simThread.runSync([&](BallsSim &bsim) {
+				minWidth = bsim.getMinWallDimension(clientRC.bottom);
+				minHeight = bsim.getMinWallDimension(clientRC.right);
+			});
 			POINT pt;
-			pt.x = long(ceil(extraWidth + g_bsim.getMinWallDimension(clientRC.bottom)));
-			pt.y = long(ceil(extraHeight + g_bsim.getMinWallDimension(clientRC.right)));
+			pt.x = long(ceil(extraWidth + minWidth));
+			pt.y = long(ceil(extraHeight + minHeight));
 			mmi.ptMinTrackSize = pt;
 		}
 		break;
@@ -390,8 +409,12 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 		{
 			switch (LOWORD(wParam)) {
 				case IDMI_MENU_ADDBALL:
-					if (g_bsim.numBalls() >= MAX_NUM_BALLS) maxNumBallsMsg(hWnd);
-               else DialogBox(GetModuleHandle(NULL), MAKEINTRESOURCE(IDD_ADDBALL), hWnd, addBallDlgProc);
+				{
+					unsigned long numBalls = 0;
+					g_simThread.runSync([&numBalls](BallsSim &bsim) { numBalls = bsim.numBalls(); });
+					if (numBalls >= MAX_NUM_BALLS) maxNumBallsMsg(hWnd);
+					else DialogBox(GetModuleHandle(NULL), MAKEINTRESOURCE(IDD_ADDBALL), hWnd, addBallDlgProc);
+				}
 				break;
 				
 				case IDMI_MENU_ADD10BALLS:
@@ -399,7 +422,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 				break;
 				
 				case IDMI_MENU_REMOVEALLBALLS:
-					g_bsim.resetBalls();
+					g_simThread.post([](BallsSim &bsim) { bsim.resetBalls(); });
 				break;
 				
 				case IDMI_MENU_ABOUT:
@@ -428,9 +451,25 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 // Entry point of the whole program
 int WINAPI WinMain(HINSTANCE hInst, HINSTANCE hPrevInst, LPSTR lpCmdLine, int nCmdShow) {
 	initAddBall(); // Set default values for the ball to be added
+	g_bsim.setBroadPhase(BallsSim::AABB_TREE); // Needed to keep up with large numbers of balls of any mix of diameters
+	g_bsim.setNumThreads(0); // Use all processors
+	g_bsim.setReorderInterval(BallsSim::REORDER_ADAPTIVE); // Keep neighbouring balls close in memory
+	g_raster.setPixelOrder(Rasterizer::BGRA); // As in 32-bit DIBs
+	g_raster.setNumThreads(0); // Use all processors
+	g_simThread.setFrameDt(FRAME_DT / 1000.); // Convert from milliseconds to seconds
+	g_simThread.setRealTime(true); // Keep pace with the clock
+	g_simThread.setPaused(true); // Until the window is shown (see WMU_RESUMESIM)
 	
-	srand(unsigned(timeGetTime())); // Initialize random number generator
+	// "-seed N" on the command line makes a session reproducible: the random
+	// balls are drawn from seed N and the simulator runs in deterministic mode
+	const char *seedArg = strstr(lpCmdLine, "-seed");
+	if (seedArg != 0) {
+		srand((unsigned int)strtoul(seedArg + strlen("-seed"), 0, 10));
+		g_bsim.setDeterministic(true);
+	}
+	else srand(unsigned(timeGetTime())); // Initialize random number generator
 	// srand(unsigned(time(NULL))); // Initialize random number generator
+	g_simThread.start();
 
 	const char mainWndClassName[] = "main";
 	
@@ -491,5 +530,6 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE hPrevInst, LPSTR lpCmdLine, int nC
 			}
 		}
 	}
+	g_simThread.stop();
 	return msg.wParam;
 }
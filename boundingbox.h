@@ -0,0 +1,80 @@
+// boundingbox.h - version 1.1
+// Axis-aligned bounding box used by the broad phase of the simulator.
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - added contains(), perimeter() and grow() for AabbTree
+
+#ifndef BOUNDINGBOX_H
+#define BOUNDINGBOX_H
+
+#include "ball.h"
+
+// Like Walls, x1 / y1 are the lowest coordinates and x2 / y2 the highest.
+class BoundingBox {
+	public:
+
+		// Constructors
+		BoundingBox() {
+			ix1 = ix2 = iy1 = iy2 = 0.;
+		}
+
+		BoundingBox(double sx1, double sy1, double sx2, double sy2) {
+			ix1 = sx1;
+			iy1 = sy1;
+			ix2 = sx2;
+			iy2 = sy2;
+		}
+
+		// Box covering everything ball b touches while it moves with its
+		// current velocity for time dt (dt >= 0). B is Ball or a reference
+		// to a ball in a BallStore.
+		template <class B> static BoundingBox swept(const B &b, const double dt) {
+			double dx = b.vx() * dt;
+			double dy = b.vy() * dt;
+			return BoundingBox(b.x() - b.r() + (dx < 0. ? dx : 0.), b.y() - b.r() + (dy < 0. ? dy : 0.),
+				b.x() + b.r() + (dx > 0. ? dx : 0.), b.y() + b.r() + (dy > 0. ? dy : 0.));
+		}
+
+		// Get methods
+		double x1() const { return ix1; }
+		double y1() const { return iy1; }
+		double x2() const { return ix2; }
+		double y2() const { return iy2; }
+
+		// Do the two boxes share any point?
+		bool overlaps(const BoundingBox &o) const {
+			return ix1 <= o.ix2 && o.ix1 <= ix2 && iy1 <= o.iy2 && o.iy1 <= iy2;
+		}
+
+		// Is o entirely inside this box?
+		bool contains(const BoundingBox &o) const {
+			return ix1 <= o.ix1 && iy1 <= o.iy1 && o.ix2 <= ix2 && o.iy2 <= iy2;
+		}
+
+		// Length of the boundary, the measure of the cost of a box in 2D
+		double perimeter() const {
+			return 2. * ((ix2 - ix1) + (iy2 - iy1));
+		}
+
+		// Box extended by dx on the left and right and dy at the top and bottom
+		BoundingBox grow(double dx, double dy) const {
+			return BoundingBox(ix1 - dx, iy1 - dy, ix2 + dx, iy2 + dy);
+		}
+
+		// Smallest box containing both boxes
+		BoundingBox merge(const BoundingBox &o) const {
+			return BoundingBox(ix1 < o.ix1 ? ix1 : o.ix1, iy1 < o.iy1 ? iy1 : o.iy1,
+				ix2 > o.ix2 ? ix2 : o.ix2, iy2 > o.iy2 ? iy2 : o.iy2);
+		}
+
+	private:
+		// Note: i stands for internal
+		double ix1;
+		double iy1;
+		double ix2;
+		double iy2;
+};
+
+#endif
@@ -0,0 +1,549 @@
+// bsbench.cpp - version 1.1
+// Microbenchmarks for the functions in collision.cpp, the Vector2D
+// operators and the broad phases of BallsSim. Each function is run on sets of inputs drawn from the cases the
+// simulator meets (balls that hit, miss, move apart, move together or
+// overlap), with warm-up and repeated measurements. Results are printed as a
+// table and can also be written as JSON so runs can be compared by scripts.
+// Revisions:
+//   1.1:
+//     - added BallsSim::findEarliestCollision() with each broad phase on
+//       scenes of balls of equal, widely spread and bimodal sizes
+
+#include "ball.h"
+#include "walls.h"
+#include "vector2d.h"
+#include "ballstore.h"
+#include "collision.h"
+#include "ballssim.h"
+#include "scenariogenerator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+// CONSTANTS
+// Input distributions match those of the Windows front end (see bouncescope.cpp)
+const double MAX_RANDOM_V = 200; // Maximum speed along x or y
+const double MIN_RANDOM_R = 5; // Minimum radius
+const double MAX_RANDOM_R = 20; // Maximum radius
+const double M_TO_A_RATIO = .1; // Ratio of mass to area
+const double BOX_SIZE = 1000; // Size of the walls
+const double PI = 3.141592653589793;
+const unsigned long NUM_INPUTS = 4096; // Inputs per set. Small enough to stay in the L2 cache.
+const unsigned long NUM_SCENE_BALLS = 2000; // Balls of a broad phase scene
+const double SCENE_FRACTION = .3; // Fraction of the area of a scene covered by balls
+const double SCENE_HORIZON = .01; // Horizon of the collision search in a scene
+
+// Command line settings
+struct Options {
+	unsigned int reps; // Measured repetitions
+	unsigned int warmup; // Repetitions run and discarded after calibration
+	double minTime; // Minimum duration of one repetition in seconds
+	const char *filter; // Only run benchmarks whose name contains this, or 0
+	const char *jsonFile; // File to write JSON results to ("-" for stdout), or 0
+	unsigned long seed;
+};
+
+// Statistics of one benchmark, in nanoseconds per operation
+struct Result {
+	string name;
+	unsigned long opsPerRep;
+	unsigned int reps;
+	double minNs;
+	double medianNs;
+	double meanNs;
+	double stddevNs;
+	double opsPerSec; // From the median
+};
+
+// Keeps the compiler from removing the work being measured
+static volatile double g_sink;
+
+void printUsage(const char *prog) {
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -reps N       measured repetitions per benchmark (default 15)\n"
+		"  -warmup N     repetitions discarded before measuring (default 3)\n"
+		"  -mintime S    minimum duration of one repetition in seconds (default 0.02)\n"
+		"  -filter TEXT  only run benchmarks whose name contains TEXT\n"
+		"  -json FILE    also write the results as JSON to FILE (- for stdout)\n"
+		"  -seed S       random seed for the inputs (default 1)\n",
+		prog);
+}
+
+// Parses the command line into opt. Returns false on error.
+bool parseOptions(int argc, char **argv, Options &opt) {
+	opt.reps = 15;
+	opt.warmup = 3;
+	opt.minTime = .02;
+	opt.filter = 0;
+	opt.jsonFile = 0;
+	opt.seed = 1;
+
+	for (int k = 1; k < argc; k++) {
+		const char *arg = argv[k];
+		if (k + 1 >= argc) {
+			fprintf(stderr, "Unknown option or missing value: %s\n", arg);
+			return false;
+		}
+		else if (strcmp(arg, "-reps") == 0) opt.reps = (unsigned int)strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-warmup") == 0) opt.warmup = (unsigned int)strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-mintime") == 0) opt.minTime = atof(argv[++k]);
+		else if (strcmp(arg, "-filter") == 0) opt.filter = argv[++k];
+		else if (strcmp(arg, "-json") == 0) opt.jsonFile = argv[++k];
+		else if (strcmp(arg, "-seed") == 0) opt.seed = strtoul(argv[++k], 0, 10);
+		else {
+			fprintf(stderr, "Unknown option: %s\n", arg);
+			return false;
+		}
+	}
+
+	if (opt.reps == 0 || !(opt.minTime > 0.)) {
+		fprintf(stderr, "The number of repetitions and the minimum time must be positive.\n");
+		return false;
+	}
+	return true;
+}
+
+// INPUT GENERATION
+
+// Kinds of ball pairs
+enum PairKind { HIT, MISS, RECEDING, ZERO_VELOCITY, OVERLAPPING };
+const char *const PAIR_KIND_NAMES[] = { "hit", "miss", "receding", "zerovel", "overlap" };
+const int NUM_PAIR_KINDS = 5;
+
+// Generates a ball with a random radius and matching mass and a random
+// velocity, at position pos
+static Ball randomBall(mt19937 &rng, const Vector2D &pos) {
+	uniform_real_distribution<double> vDist(-MAX_RANDOM_V, MAX_RANDOM_V);
+	uniform_real_distribution<double> rDist(MIN_RANDOM_R, MAX_RANDOM_R);
+	Ball b;
+	double r = rDist(rng);
+	b.setPos(pos);
+	b.setVXY(vDist(rng), vDist(rng));
+	b.setR(r);
+	b.setM(M_TO_A_RATIO * PI * r * r);
+	return b;
+}
+
+// Generates a pair of balls of the given kind. The second ball is placed at
+// a random distance and direction from the first and its velocity is chosen
+// so that, relative to the first ball, it heads for it (HIT), passes it by
+// (MISS) or moves away from it (RECEDING).
+static void randomPair(mt19937 &rng, PairKind kind, Ball &b1, Ball &b2) {
+	uniform_real_distribution<double> posDist(MAX_RANDOM_R, BOX_SIZE - MAX_RANDOM_R);
+	uniform_real_distribution<double> angleDist(0., 2. * PI);
+	uniform_real_distribution<double> unitDist(0., 1.);
+
+	b1 = randomBall(rng, Vector2D(posDist(rng), posDist(rng)));
+	b2 = randomBall(rng, Vector2D());
+	double sumR = b1.r() + b2.r();
+
+	// Distance between centres, and direction from b1 to b2
+	double dist = kind == OVERLAPPING ? sumR * (.1 + .8 * unitDist(rng)) : sumR * (1.05 + 4. * unitDist(rng));
+	double angle = angleDist(rng);
+	Vector2D dir(cos(angle), sin(angle));
+	b2.setPos(b1.pos() + dist * dir);
+
+	// Relative speed, and direction of the relative velocity of b2
+	double speed = MAX_RANDOM_V * (.1 + unitDist(rng));
+	double relAngle;
+	if (kind == HIT) {
+		// Aim within the cone in which the balls touch
+		double maxOffset = asin(sumR / dist);
+		relAngle = angle + PI + maxOffset * (.9 * (2. * unitDist(rng) - 1.));
+	}
+	else if (kind == MISS) {
+		// Approach, but aim outside the cone
+		double maxOffset = asin(sumR / dist);
+		double side = unitDist(rng) < .5 ? -1. : 1.;
+		relAngle = angle + PI + side * (maxOffset + (PI / 2. - maxOffset) * (.05 + .9 * unitDist(rng)));
+	}
+	else if (kind == ZERO_VELOCITY) {
+		speed = 0.;
+		relAngle = 0.;
+	}
+	else {
+		// RECEDING, or OVERLAPPING with any direction
+		relAngle = kind == RECEDING ? angle + (PI / 2.) * (1.8 * unitDist(rng) - .9) : angleDist(rng);
+	}
+	b2.setV(b1.v() + speed * Vector2D(cos(relAngle), sin(relAngle)));
+}
+
+static void randomPairs(mt19937 &rng, PairKind kind, vector<Ball> &pairs) {
+	pairs.resize(2 * NUM_INPUTS);
+	for (unsigned long k = 0; k < NUM_INPUTS; k++) {
+		randomPair(rng, kind, pairs[2 * k], pairs[2 * k + 1]);
+	}
+}
+
+// Balls inside the walls. If moving is false they all stand still, so no
+// ball hits a wall.
+static void randomWallBalls(mt19937 &rng, bool moving, vector<Ball> &balls) {
+	uniform_real_distribution<double> posDist(MAX_RANDOM_R, BOX_SIZE - MAX_RANDOM_R);
+	balls.resize(NUM_INPUTS);
+	for (unsigned long k = 0; k < NUM_INPUTS; k++) {
+		balls[k] = randomBall(rng, Vector2D(posDist(rng), posDist(rng)));
+		if (!moving) balls[k].setVXY(0., 0.);
+	}
+}
+
+static void randomVectors(mt19937 &rng, vector<Vector2D> &vectors) {
+	uniform_real_distribution<double> dist(-MAX_RANDOM_V, MAX_RANDOM_V);
+	vectors.resize(NUM_INPUTS + 1);
+	for (unsigned long k = 0; k < vectors.size(); k++) {
+		vectors[k].setXY(dist(rng), dist(rng));
+	}
+}
+
+// Scenes for the broad phases
+enum SceneKind { SCENE_EQUAL, SCENE_WIDE, SCENE_BIMODAL };
+const char *const SCENE_KIND_NAMES[] = { "equal", "wide", "bimodal" };
+const int NUM_SCENE_KINDS = 3;
+
+// Generates NUM_SCENE_BALLS balls in walls. EQUAL has the radii of the other
+// benchmarks; WIDE spreads them over the whole range of the dialog of the
+// Windows front end (diameters 2 to 500); BIMODAL places a few large balls
+// first and fills the space around them with small ones.
+static void randomScene(unsigned long seed, SceneKind kind, WallsT<double> &walls, vector<BallT<double> > &balls) {
+	ScenarioGenerator gen;
+	gen.setSeed(seed);
+	gen.setVelocityRange(-MAX_RANDOM_V, MAX_RANDOM_V);
+	gen.setMassToAreaRatio(M_TO_A_RATIO);
+	balls.clear();
+	if (kind == SCENE_BIMODAL) {
+		const unsigned long numLarge = 20;
+		gen.setRadiusRange(100., 250.);
+		double largeArea = numLarge * gen.meanArea();
+		gen.setRadiusRange(1., 5.);
+		double side = sqrt((largeArea + (NUM_SCENE_BALLS - numLarge) * gen.meanArea()) / SCENE_FRACTION);
+		walls = WallsT<double>(0., 0., side, side);
+		gen.setRadiusRange(100., 250.);
+		gen.generate(numLarge, walls, balls);
+		vector<double> x(balls.size()), y(balls.size()), r(balls.size());
+		for (unsigned long k = 0; k < balls.size(); k++) {
+			x[k] = balls[k].x();
+			y[k] = balls[k].y();
+			r[k] = balls[k].r();
+		}
+		gen.setObstacles(&x[0], &y[0], &r[0], balls.size());
+		gen.setRadiusRange(1., 5.);
+		gen.generate(NUM_SCENE_BALLS - balls.size(), walls, balls);
+		return;
+	}
+	if (kind == SCENE_WIDE) gen.setRadiusRange(1., 250.);
+	else gen.setRadiusRange(MIN_RANDOM_R, MAX_RANDOM_R);
+	walls = gen.wallsForPackingFraction(NUM_SCENE_BALLS, SCENE_FRACTION);
+	gen.generate(NUM_SCENE_BALLS, walls, balls);
+}
+
+// MEASUREMENT
+
+// Runs a benchmark. body(passes) must perform passes * opsPerPass operations
+// and return a value that depends on all of them. The number of passes per
+// repetition is doubled until a repetition lasts at least opt.minTime, then
+// opt.warmup repetitions are discarded and opt.reps are measured.
+template <class F> Result runBenchmark(const Options &opt, const string &name, unsigned long opsPerPass, F body) {
+	typedef chrono::steady_clock Clock;
+	unsigned long passes = 1;
+	for (;;) {
+		Clock::time_point start = Clock::now();
+		g_sink = g_sink + body(passes);
+		double elapsed = chrono::duration<double>(Clock::now() - start).count();
+		if (elapsed >= opt.minTime || passes >= (1ul << 30)) break;
+		passes *= 2;
+	}
+	for (unsigned int rep = 0; rep < opt.warmup; rep++) {
+		g_sink = g_sink + body(passes);
+	}
+
+	unsigned long ops = passes * opsPerPass;
+	vector<double> ns(opt.reps);
+	for (unsigned int rep = 0; rep < opt.reps; rep++) {
+		Clock::time_point start = Clock::now();
+		g_sink = g_sink + body(passes);
+		ns[rep] = chrono::duration<double, nano>(Clock::now() - start).count() / ops;
+	}
+
+	Result res;
+	res.name = name;
+	res.opsPerRep = ops;
+	res.reps = opt.reps;
+	vector<double> sorted(ns);
+	sort(sorted.begin(), sorted.end());
+	res.minNs = sorted[0];
+	res.medianNs = opt.reps % 2 ? sorted[opt.reps / 2] : .5 * (sorted[opt.reps / 2 - 1] + sorted[opt.reps / 2]);
+	double sum = 0.;
+	for (unsigned int rep = 0; rep < opt.reps; rep++) sum += ns[rep];
+	res.meanNs = sum / opt.reps;
+	double sumSq = 0.;
+	for (unsigned int rep = 0; rep < opt.reps; rep++) sumSq += (ns[rep] - res.meanNs) * (ns[rep] - res.meanNs);
+	res.stddevNs = opt.reps > 1 ? sqrt(sumSq / (opt.reps - 1)) : 0.;
+	res.opsPerSec = res.medianNs > 0. ? 1e9 / res.medianNs : 0.;
+	return res;
+}
+
+// Sum of the collision times (0 if none) found for all pairs, passes times
+template <class B> struct TwoBallsTimeBench {
+	const vector<B> *pairs;
+	double operator()(unsigned long passes) const {
+		const vector<B> &p = *pairs;
+		double sum = 0.;
+		for (unsigned long pass = 0; pass < passes; pass++) {
+			for (unsigned long k = 0; k < NUM_INPUTS; k++) {
+				sum += findTimeUntilTwoBallsCollide(p[2 * k], p[2 * k + 1]).getTimeToCollision();
+			}
+		}
+		return sum;
+	}
+};
+
+// As TwoBallsTimeBench, for balls held in a BallStore
+struct TwoBallsTimeStoreBench {
+	const BallStore *store;
+	double operator()(unsigned long passes) const {
+		double sum = 0.;
+		for (unsigned long pass = 0; pass < passes; pass++) {
+			for (unsigned long k = 0; k < NUM_INPUTS; k++) {
+				sum += findTimeUntilTwoBallsCollide((*store)[2 * k], (*store)[2 * k + 1]).getTimeToCollision();
+			}
+		}
+		return sum;
+	}
+};
+
+struct WallTimeBench {
+	const vector<Ball> *balls;
+	Walls walls;
+	double operator()(unsigned long passes) const {
+		const vector<Ball> &b = *balls;
+		double sum = 0.;
+		for (unsigned long pass = 0; pass < passes; pass++) {
+			for (unsigned long k = 0; k < NUM_INPUTS; k++) {
+				Collision c = findTimeUntilBallCollidesWithWall(b[k], walls);
+				sum += c.getTimeToCollision() + c.getCollisionWall();
+			}
+		}
+		return sum;
+	}
+};
+
+// Collides every pair in turn. The collisions conserve energy, so repeating
+// them keeps the velocities in range.
+struct ElasticTwoBallsBench {
+	vector<Ball> *pairs;
+	double operator()(unsigned long passes) const {
+		vector<Ball> &p = *pairs;
+		for (unsigned long pass = 0; pass < passes; pass++) {
+			for (unsigned long k = 0; k < NUM_INPUTS; k++) {
+				doElasticCollisionTwoBalls(p[2 * k], p[2 * k + 1]);
+			}
+		}
+		return p[0].vx() + p[2 * NUM_INPUTS - 1].vy();
+	}
+};
+
+// Bounces every ball off each wall in turn
+struct ElasticWallBench {
+	vector<Ball> *balls;
+	double operator()(unsigned long passes) const {
+		vector<Ball> &b = *balls;
+		for (unsigned long pass = 0; pass < passes; pass++) {
+			for (unsigned long k = 0; k < NUM_INPUTS; k++) {
+				doElasticCollisionWithWall(b[k], Walls::Wall(Walls::X1 + (k + pass) % 4));
+			}
+		}
+		return b[0].vx() + b[NUM_INPUTS - 1].vy();
+	}
+};
+
+// Vector2D operations on consecutive vectors of the input
+enum VectorOp { VEC_ADD, VEC_SUB, VEC_DOT, VEC_SCALE, VEC_MAGNITUDE, VEC_UNIT };
+const char *const VECTOR_OP_NAMES[] = { "operator+", "operator-", "operator*(dot)", "operator*(scalar)", "magnitude",
+	"unitVector" };
+const int NUM_VECTOR_OPS = 6;
+
+struct VectorBench {
+	const vector<Vector2D> *vectors;
+	VectorOp op;
+	double operator()(unsigned long passes) const {
+		const vector<Vector2D> &v = *vectors;
+		Vector2D acc;
+		double sum = 0.;
+		for (unsigned long pass = 0; pass < passes; pass++) {
+			for (unsigned long k = 0; k < NUM_INPUTS; k++) {
+				switch (op) {
+					case VEC_ADD: acc = acc + (v[k] + v[k + 1]); break;
+					case VEC_SUB: acc = acc + (v[k] - v[k + 1]); break;
+					case VEC_DOT: sum += v[k] * v[k + 1]; break;
+					case VEC_SCALE: acc = acc + v[k + 1].x() * v[k]; break;
+					case VEC_MAGNITUDE: sum += v[k].magnitude(); break;
+					case VEC_UNIT: acc = acc + v[k].unitVector(); break;
+				}
+			}
+		}
+		return sum + acc.x() + acc.y();
+	}
+};
+
+// Searches a scene for its earliest collision within SCENE_HORIZON, which
+// rebuilds (or, for the AABB tree, refits) the broad phase each time
+struct EarliestCollisionBench {
+	BallsSim *sim;
+	double operator()(unsigned long passes) const {
+		double sum = 0.;
+		for (unsigned long pass = 0; pass < passes; pass++) {
+			unsigned long b1 = 0, b2 = 0;
+			sum += sim->findEarliestCollision(b1, b2, SimScalar(SCENE_HORIZON)).getTimeToCollision() + b1 + b2;
+		}
+		return sum;
+	}
+};
+const BallsSim::BroadPhase BROAD_PHASES[] = { BallsSim::BRUTE_FORCE, BallsSim::CELL_GRID, BallsSim::SWEEP_AND_PRUNE,
+	BallsSim::AABB_TREE };
+const char *const BROAD_PHASE_NAMES[] = { "brute", "grid", "sap", "tree" };
+const int NUM_BROAD_PHASES = 4;
+
+// OUTPUT
+
+static void printResult(const Result &res) {
+	printf("%-52s %10.2f %10.2f %10.2f %8.2f %14.0f\n", res.name.c_str(), res.medianNs, res.minNs, res.meanNs,
+		res.stddevNs, res.opsPerSec);
+	fflush(stdout);
+}
+
+static bool writeJson(const char *fileName, const Options &opt, const vector<Result> &results) {
+	bool toStdout = strcmp(fileName, "-") == 0;
+	FILE *f = toStdout ? stdout : fopen(fileName, "w");
+	if (f == 0) {
+		fprintf(stderr, "Cannot create %s\n", fileName);
+		return false;
+	}
+	fprintf(f, "{\n");
+	fprintf(f, "  \"benchmark\": \"bsbench\",\n");
+	fprintf(f, "  \"inputs_per_set\": %lu,\n", NUM_INPUTS);
+	fprintf(f, "  \"repetitions\": %u,\n", opt.reps);
+	fprintf(f, "  \"warmup\": %u,\n", opt.warmup);
+	fprintf(f, "  \"min_time_s\": %g,\n", opt.minTime);
+	fprintf(f, "  \"seed\": %lu,\n", opt.seed);
+	fprintf(f, "  \"results\": [");
+	for (size_t k = 0; k < results.size(); k++) {
+		const Result &res = results[k];
+		fprintf(f, "%s\n    {\"name\": \"%s\", \"ops_per_rep\": %lu, \"reps\": %u, \"ns_per_op\": "
+			"{\"median\": %.4f, \"min\": %.4f, \"mean\": %.4f, \"stddev\": %.4f}, \"ops_per_s\": %.1f}",
+			k ? "," : "", res.name.c_str(), res.opsPerRep, res.reps, res.medianNs, res.minNs, res.meanNs,
+			res.stddevNs, res.opsPerSec);
+	}
+	fprintf(f, "\n  ]\n}\n");
+	if (!toStdout) fclose(f);
+	return true;
+}
+
+int main(int argc, char **argv) {
+	Options opt;
+	if (!parseOptions(argc, argv, opt)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	mt19937 rng((unsigned int)opt.seed);
+	vector<Result> results;
+	bool jsonToStdout = opt.jsonFile != 0 && strcmp(opt.jsonFile, "-") == 0;
+	if (!jsonToStdout) {
+		printf("%-52s %10s %10s %10s %8s %14s\n", "benchmark", "median ns", "min ns", "mean ns", "stddev", "ops/s");
+	}
+
+	// Runs one benchmark unless filtered out
+#define BENCH(name, opsPerPass, body) \
+	do { \
+		string benchName = (name); \
+		if (opt.filter == 0 || benchName.find(opt.filter) != string::npos) { \
+			results.push_back(runBenchmark(opt, benchName, (opsPerPass), (body))); \
+			if (!jsonToStdout) printResult(results.back()); \
+		} \
+	} while (0)
+
+	// findTimeUntilTwoBallsCollide, on Ball and on the BallStore layout
+	for (int kind = 0; kind < NUM_PAIR_KINDS; kind++) {
+		vector<Ball> pairs;
+		randomPairs(rng, PairKind(kind), pairs);
+		BallStore store;
+		store.reserve(pairs.size());
+		for (unsigned long k = 0; k < pairs.size(); k++) store.push_back(pairs[k]);
+
+		TwoBallsTimeBench<Ball> ballBench = { &pairs };
+		BENCH(string("findTimeUntilTwoBallsCollide/Ball/") + PAIR_KIND_NAMES[kind], NUM_INPUTS, ballBench);
+		TwoBallsTimeStoreBench storeBench = { &store };
+		BENCH(string("findTimeUntilTwoBallsCollide/BallStore/") + PAIR_KIND_NAMES[kind], NUM_INPUTS, storeBench);
+	}
+
+	// findTimeUntilBallCollidesWithWall
+	Walls walls(0., 0., BOX_SIZE, BOX_SIZE);
+	for (int moving = 1; moving >= 0; moving--) {
+		vector<Ball> balls;
+		randomWallBalls(rng, moving != 0, balls);
+		WallTimeBench bench = { &balls, walls };
+		BENCH(string("findTimeUntilBallCollidesWithWall/") + (moving ? "moving" : "zerovel"), NUM_INPUTS, bench);
+	}
+
+	// doElasticCollisionTwoBalls on touching pairs
+	{
+		vector<Ball> pairs;
+		randomPairs(rng, HIT, pairs);
+		for (unsigned long k = 0; k < NUM_INPUTS; k++) {
+			Collision c = findTimeUntilTwoBallsCollide(pairs[2 * k], pairs[2 * k + 1]);
+			pairs[2 * k].advanceBallPosition(c.getTimeToCollision());
+			pairs[2 * k + 1].advanceBallPosition(c.getTimeToCollision());
+		}
+		ElasticTwoBallsBench bench = { &pairs };
+		BENCH("doElasticCollisionTwoBalls/touching", NUM_INPUTS, bench);
+	}
+
+	// doElasticCollisionWithWall
+	{
+		vector<Ball> balls;
+		randomWallBalls(rng, true, balls);
+		ElasticWallBench bench = { &balls };
+		BENCH("doElasticCollisionWithWall/cycle", NUM_INPUTS, bench);
+	}
+
+	// Vector2D operators
+	{
+		vector<Vector2D> vectors;
+		randomVectors(rng, vectors);
+		vectors[NUM_INPUTS / 2].setXY(0., 0.); // unitVector() of the zero vector
+		for (int op = 0; op < NUM_VECTOR_OPS; op++) {
+			VectorBench bench = { &vectors, VectorOp(op) };
+			BENCH(string("Vector2D/") + VECTOR_OP_NAMES[op], NUM_INPUTS, bench);
+		}
+	}
+
+	// BallsSim::findEarliestCollision() with each broad phase. The brute
+	// force search runs on one thread like the others.
+	for (int kind = 0; kind < NUM_SCENE_KINDS; kind++) {
+		WallsT<double> sceneWalls;
+		vector<BallT<double> > sceneBalls;
+		randomScene(opt.seed, SceneKind(kind), sceneWalls, sceneBalls);
+		for (int bp = 0; bp < NUM_BROAD_PHASES; bp++) {
+			BallsSim sim;
+			sim.setNumThreads(1);
+			sim.setBroadPhase(BROAD_PHASES[bp]);
+			sim.addWalls(Walls(SimScalar(sceneWalls.x1()), SimScalar(sceneWalls.y1()), SimScalar(sceneWalls.x2()),
+				SimScalar(sceneWalls.y2())));
+			sim.addBalls(sceneBalls.begin(), sceneBalls.end());
+			EarliestCollisionBench bench = { &sim };
+			BENCH(string("findEarliestCollision/") + SCENE_KIND_NAMES[kind] + "/" + BROAD_PHASE_NAMES[bp], 1, bench);
+		}
+	}
+
+#undef BENCH
+
+	if (opt.jsonFile != 0 && !writeJson(opt.jsonFile, opt, results)) return 1;
+	return 0;
+}
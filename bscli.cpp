@@ -0,0 +1,939 @@
+// bscli.cpp - version 1.19
+// Headless command-line driver for the ball simulator. Loads balls from a
+// file or generates them, runs BallsSim::advanceSim() for a given simulated
+// time with a fixed frame duration, and reports the throughput.
+// Revisions:
+//   1.1:
+//     - added -stats to print the performance counters of BallsSim
+//   1.2:
+//     - added -reorder
+//   1.3:
+//     - added -broad to select any broad phase
+//   1.4:
+//     - added -float and -double to select the scalar type of the simulator
+//   1.5:
+//     - added -save and -load for checkpoint files
+//   1.6:
+//     - added -traj, -trajprec and -keyframe to write a trajectory file
+//   1.7:
+//     - added -render, -every and -res to write images of the frames
+//   1.8:
+//     - added -async to run the simulation on its own thread, with the main thread
+//       reading its snapshots
+//   1.9:
+//     - balls are added with BallsSim::addBalls()
+//   1.10:
+//     - added -place and -fraction to generate the balls with ScenarioGenerator
+//   1.11:
+//     - added -sectors to process the collisions of a frame in sectors on several threads
+//   1.12:
+//     - added -ranks and -transport to split the walls into slabs simulated by
+//       several processes (DomainSim), not on Windows
+//   1.13:
+//     - added the tree broad phase (-broad tree)
+//   1.14:
+//     - added -batch to process independent collisions in batches
+//   1.15:
+//     - added -ensemble to run the scenarios of a file in one process (EnsembleRunner)
+//   1.16:
+//     - added -observe to print the observables of the balls (BallsSim::getObservables())
+//   1.17:
+//     - added -rdf, -rdfbins and -rdfevery to print the pair correlation g(r) and the
+//       structure factor S(k) of the balls (PairCorrelation)
+//   1.18:
+//     - added -deterministic
+//   1.19:
+//     - added -cpb to set the collision limit of a frame
+
+#include "ball.h"
+#include "walls.h"
+#include "ballssim.h"
+#include "trajectorywriter.h"
+#include "rasterizer.h"
+#include "simthread.h"
+#include "scenariogenerator.h"
+#include "ensemblerunner.h"
+#include "paircorrelation.h"
+#ifndef _WIN32
+#include "domainsim.h"
+#include "sharedmemorytransport.h"
+#include "sockettransport.h"
+#include <memory>
+#include <unistd.h>
+#endif
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
+using namespace std;
+
+// CONSTANTS
+// Defaults match the Windows front end (see bouncescope.cpp)
+const double DEF_FRAME_DT = .01; // Frame duration in seconds
+const double DEF_SIM_TIME = 10.; // Simulated time in seconds
+const unsigned long DEF_NUM_BALLS = 1000; // Number of balls to generate
+const double MIN_RANDOM_V = 0; // Minimum velocity (x or y) to be used in generating random balls
+const double MAX_RANDOM_V = 200; // Maximum velocity (x or y) to be used in generating random balls
+const double MIN_RANDOM_R = 5; // Minimum radius to be used in generating random balls
+const double MAX_RANDOM_R = 20; // Maximum radius to be used in generating random balls
+const double M_TO_A_RATIO = .1; // Ratio of mass to area used in generating random balls
+const double PI = 3.141592653589793;
+const double DEF_TRAJ_PRECISION = 1e-3; // Precision of the positions and velocities in a trajectory
+const unsigned int DEF_KEYFRAME_INTERVAL = 100; // Frames from one keyframe of a trajectory to the next
+const unsigned int DEF_IMAGE_WIDTH = 1920; // Size of rendered frames in pixels
+const unsigned int DEF_IMAGE_HEIGHT = 1080;
+const double DEF_PACKING_FRACTION = .3; // Fraction of the area covered by balls placed with -place
+const unsigned int DEF_COLLISIONS_PER_BALL = 10; // Collisions per ball a frame may process, as in BallsSim
+const char *const BROAD_PHASE_NAMES[] = { "brute force", "grid", "sweep and prune", "AABB tree" }; // Indexed by BallsSim::BroadPhase
+
+// Command line settings
+struct Options {
+	unsigned long numBalls;
+	const char *inFile; // Balls to load, or 0 to generate numBalls balls
+	const char *outFile; // File to save the final state to, or 0
+	const char *loadFile; // Checkpoint to start from, or 0
+	const char *saveFile; // Checkpoint to write at the end, or 0
+	const char *trajFile; // Trajectory to write, or 0
+	double trajPrecision; // Precision of the positions and velocities in the trajectory
+	unsigned int keyframeInterval; // Frames from one keyframe of the trajectory to the next
+	const char *renderPattern; // printf pattern of the image file names, given the frame number, or 0
+	unsigned int renderEvery; // Render every n-th frame
+	unsigned int imageWidth; // Size of the images in pixels
+	unsigned int imageHeight;
+	double simTime;
+	double frameDt;
+	double width; // Wall dimensions, or 0 to size the walls to fit the balls
+	double height;
+	unsigned int threads;
+	BallsSim::BroadPhase broadPhase;
+	unsigned int sectors; // See BallsSim::setNumSectors()
+	unsigned int batch; // See BallsSim::setMaxBatchSize()
+	unsigned int collisionsPerBall; // See BallsSim::setMaxCollisionsPerBall()
+	unsigned int observe; // See BallsSim::setObservablesInterval()
+	unsigned int reorder; // Reorder interval, see BallsSim::setReorderInterval()
+	unsigned long seed;
+	bool place; // Generate the balls with a ScenarioGenerator rather than generateBalls()
+	ScenarioGenerator::Method placeMethod;
+	double packingFraction; // Of the generated balls, when the walls are not given
+	bool quiet;
+	bool stats; // Print the performance counters
+	bool singlePrecision; // Simulate with BallsSimT<float> rather than BallsSimT<double>
+	bool async; // Simulate on a SimThread; the main thread reads its snapshots
+	bool deterministic; // See BallsSim::setDeterministic()
+	unsigned int ranks; // Processes to split the walls between, see DomainSim
+	bool socketTransport; // Connect the ranks by sockets rather than shared memory
+	const char *ensembleFile; // Scenarios to run with an EnsembleRunner, or 0
+	double rdfRange; // Largest distance of g(r), or 0 for none
+	unsigned int rdfBins;
+	unsigned int rdfEvery; // Sample g(r) every n-th frame, or only at the end if 0
+};
+
+void printUsage(const char *prog) {
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -n N        generate N random balls (default %lu)\n"
+		"  -place M    place the generated balls by M: rsa (random sequential addition),\n"
+		"              square or hex (lattice) (default: a square lattice fitting the largest ball)\n"
+		"  -fraction F fraction of the area covered by the balls placed with -place, which\n"
+		"              sizes the walls unless -w and -h are given (default %g)\n"
+		"  -i FILE     load balls from FILE instead, one per line: x y vx vy m r [color]\n"
+		"  -o FILE     save the final state of the balls to FILE in the same format\n"
+		"  -load FILE  start from a checkpoint written by -save (walls included)\n"
+		"  -save FILE  write a binary checkpoint of the simulator at the end\n"
+		"  -traj FILE  write the balls at every frame to a compressed trajectory file\n"
+		"  -trajprec P precision of the positions and velocities in the trajectory (default %g)\n"
+		"  -keyframe N write a keyframe of the trajectory every N frames (default %u)\n"
+		"  -render PAT draw the frames to image files named by the printf pattern PAT\n"
+		"              given the frame number, e.g. f%%05lu.png; PNG if it ends in .png, else PPM\n"
+		"  -every N    render every N-th frame only (default 1)\n"
+		"  -res WxH    size of the rendered images (default %ux%u)\n"
+		"  -t SECONDS  simulated time (default %g)\n"
+		"  -dt SECONDS fixed frame duration (default %g)\n"
+		"  -w WIDTH    wall width (default: fit the balls)\n"
+		"  -h HEIGHT   wall height (default: fit the balls)\n"
+		"  -threads N  number of threads, 0 = all processors (default 1)\n"
+		"  -broad B    broad phase: brute, grid, sap (sweep and prune) or tree (AABB tree)\n"
+		"              (default brute)\n"
+		"  -grid       same as -broad grid\n"
+		"  -sectors N  process the collisions of a frame in N sectors of the walls on the\n"
+		"              threads, 0 = one per thread (default 1)\n"
+		"  -batch N    process up to N independent collisions as a batch, re-predicting\n"
+		"              their balls on the threads (default 1)\n"
+		"  -cpb N      stop a frame after N collisions per ball (default %u; with -load,\n"
+		"              that of the checkpoint)\n"
+		"  -observe N  sample the energy, momentum and velocities of the balls every N\n"
+		"              frames, record the collisions, and print the observables at the end\n"
+		"              (default 0 = off)\n"
+		"  -reorder N  reorder the balls in memory every N frames, or as they mix\n"
+		"              if N is \"adaptive\" (default 0 = never)\n"
+		"  -seed S     random seed (default 1)\n"
+		"  -q          only print the summary\n"
+		"  -stats      print the performance counters of the simulator\n"
+		"  -float      simulate in single precision\n"
+		"  -double     simulate in double precision (default %s)\n"
+		"  -deterministic give bit-identical results on any number of threads\n"
+		"  -async      simulate on a thread of its own; the main thread reads and renders\n"
+		"              the latest snapshot of the balls without stalling it\n"
+		"  -ranks N    split the walls into N slabs simulated by N processes that exchange\n"
+		"              the balls near their edges (default 1)\n"
+		"  -transport T connect the processes by shm (shared memory) or socket (Unix\n"
+		"              sockets) (default shm)\n"
+		"  -ensemble FILE run the scenarios of FILE, one per line, each a list of key=value\n"
+		"              settings of n, rmin, rmax, vmin, vmax, massarea, heavy (fraction of heavy\n"
+		"              balls), massratio, fraction, aspect, place, t, dt, broad, seed and repeat\n"
+		"              (number of runs of the line), on the threads of -threads, and print\n"
+		"              a summary of each run as a line of CSV\n"
+		"  -rdf R      print the pair correlation g(r) of the balls up to distance R, and\n"
+		"              the structure factor S(k), at the end (from a checkpoint with -load\n"
+		"              and -t 0)\n"
+		"  -rdfbins N  bins of g(r) (default %u)\n"
+		"  -rdfevery N also sample g(r) every N frames, from the snapshots with -async\n"
+		"              (default 0 = only at the end)\n",
+		prog, DEF_NUM_BALLS, DEF_PACKING_FRACTION, DEF_TRAJ_PRECISION, DEF_KEYFRAME_INTERVAL, DEF_IMAGE_WIDTH, DEF_IMAGE_HEIGHT, DEF_SIM_TIME, DEF_FRAME_DT,
+		DEF_COLLISIONS_PER_BALL, is_same<SimScalar, float>::value ? "-float" : "-double", PairCorrelation::DEFAULT_BINS);
+}
+
+// Parses the command line into opt. Returns false on error.
+bool parseOptions(int argc, char **argv, Options &opt) {
+	opt.numBalls = DEF_NUM_BALLS;
+	opt.inFile = 0;
+	opt.outFile = 0;
+	opt.loadFile = 0;
+	opt.saveFile = 0;
+	opt.trajFile = 0;
+	opt.trajPrecision = DEF_TRAJ_PRECISION;
+	opt.keyframeInterval = DEF_KEYFRAME_INTERVAL;
+	opt.renderPattern = 0;
+	opt.renderEvery = 1;
+	opt.imageWidth = DEF_IMAGE_WIDTH;
+	opt.imageHeight = DEF_IMAGE_HEIGHT;
+	opt.simTime = DEF_SIM_TIME;
+	opt.frameDt = DEF_FRAME_DT;
+	opt.width = 0.;
+	opt.height = 0.;
+	opt.threads = 1;
+	opt.broadPhase = BallsSim::BRUTE_FORCE;
+	opt.sectors = 1;
+	opt.batch = 1;
+	opt.collisionsPerBall = DEF_COLLISIONS_PER_BALL;
+	opt.observe = 0;
+	opt.reorder = 0;
+	opt.seed = 1;
+	opt.place = false;
+	opt.placeMethod = ScenarioGenerator::RANDOM_SEQUENTIAL;
+	opt.packingFraction = DEF_PACKING_FRACTION;
+	opt.quiet = false;
+	opt.stats = false;
+	opt.singlePrecision = is_same<SimScalar, float>::value;
+	opt.async = false;
+	opt.deterministic = false;
+	opt.ranks = 1;
+	opt.socketTransport = false;
+	opt.ensembleFile = 0;
+	opt.rdfRange = 0.;
+	opt.rdfBins = PairCorrelation::DEFAULT_BINS;
+	opt.rdfEvery = 0;
+
+	for (int k = 1; k < argc; k++) {
+		const char *arg = argv[k];
+		bool hasValue = k + 1 < argc;
+		if (strcmp(arg, "-grid") == 0) opt.broadPhase = BallsSim::CELL_GRID;
+		else if (strcmp(arg, "-q") == 0) opt.quiet = true;
+		else if (strcmp(arg, "-stats") == 0) opt.stats = true;
+		else if (strcmp(arg, "-float") == 0) opt.singlePrecision = true;
+		else if (strcmp(arg, "-double") == 0) opt.singlePrecision = false;
+		else if (strcmp(arg, "-async") == 0) opt.async = true;
+		else if (strcmp(arg, "-deterministic") == 0) opt.deterministic = true;
+		else if (!hasValue) {
+			fprintf(stderr, "Unknown option or missing value: %s\n", arg);
+			return false;
+		}
+		else if (strcmp(arg, "-n") == 0) opt.numBalls = strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-i") == 0) opt.inFile = argv[++k];
+		else if (strcmp(arg, "-o") == 0) opt.outFile = argv[++k];
+		else if (strcmp(arg, "-load") == 0) opt.loadFile = argv[++k];
+		else if (strcmp(arg, "-save") == 0) opt.saveFile = argv[++k];
+		else if (strcmp(arg, "-traj") == 0) opt.trajFile = argv[++k];
+		else if (strcmp(arg, "-trajprec") == 0) opt.trajPrecision = atof(argv[++k]);
+		else if (strcmp(arg, "-keyframe") == 0) opt.keyframeInterval = (unsigned int)strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-render") == 0) opt.renderPattern = argv[++k];
+		else if (strcmp(arg, "-every") == 0) {
+			opt.renderEvery = (unsigned int)strtoul(argv[++k], 0, 10);
+			if (opt.renderEvery == 0) opt.renderEvery = 1;
+		}
+		else if (strcmp(arg, "-res") == 0) {
+			if (sscanf(argv[++k], "%ux%u", &opt.imageWidth, &opt.imageHeight) != 2 || opt.imageWidth == 0 ||
+				opt.imageHeight == 0) {
+				fprintf(stderr, "Bad image size: %s\n", argv[k]);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "-t") == 0) opt.simTime = atof(argv[++k]);
+		else if (strcmp(arg, "-dt") == 0) opt.frameDt = atof(argv[++k]);
+		else if (strcmp(arg, "-w") == 0) opt.width = atof(argv[++k]);
+		else if (strcmp(arg, "-h") == 0) opt.height = atof(argv[++k]);
+		else if (strcmp(arg, "-threads") == 0) opt.threads = (unsigned int)strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-sectors") == 0) opt.sectors = (unsigned int)strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-batch") == 0) opt.batch = (unsigned int)strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-cpb") == 0) opt.collisionsPerBall = (unsigned int)strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-observe") == 0) opt.observe = (unsigned int)strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-broad") == 0) {
+			k++;
+			if (strcmp(argv[k], "brute") == 0) opt.broadPhase = BallsSim::BRUTE_FORCE;
+			else if (strcmp(argv[k], "grid") == 0) opt.broadPhase = BallsSim::CELL_GRID;
+			else if (strcmp(argv[k], "sap") == 0) opt.broadPhase = BallsSim::SWEEP_AND_PRUNE;
+			else if (strcmp(argv[k], "tree") == 0) opt.broadPhase = BallsSim::AABB_TREE;
+			else {
+				fprintf(stderr, "Unknown broad phase: %s\n", argv[k]);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "-reorder") == 0) {
+			k++;
+			if (strcmp(argv[k], "adaptive") == 0) opt.reorder = BallsSim::REORDER_ADAPTIVE;
+			else opt.reorder = (unsigned int)strtoul(argv[k], 0, 10);
+		}
+		else if (strcmp(arg, "-seed") == 0) opt.seed = strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-place") == 0) {
+			k++;
+			opt.place = true;
+			if (strcmp(argv[k], "rsa") == 0) opt.placeMethod = ScenarioGenerator::RANDOM_SEQUENTIAL;
+			else if (strcmp(argv[k], "square") == 0) opt.placeMethod = ScenarioGenerator::SQUARE_LATTICE;
+			else if (strcmp(argv[k], "hex") == 0) opt.placeMethod = ScenarioGenerator::HEX_LATTICE;
+			else {
+				fprintf(stderr, "Unknown placement: %s\n", argv[k]);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "-fraction") == 0) opt.packingFraction = atof(argv[++k]);
+		else if (strcmp(arg, "-ensemble") == 0) opt.ensembleFile = argv[++k];
+		else if (strcmp(arg, "-rdf") == 0) opt.rdfRange = atof(argv[++k]);
+		else if (strcmp(arg, "-rdfbins") == 0) opt.rdfBins = (unsigned int)strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-rdfevery") == 0) opt.rdfEvery = (unsigned int)strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-ranks") == 0) opt.ranks = (unsigned int)strtoul(argv[++k], 0, 10);
+		else if (strcmp(arg, "-transport") == 0) {
+			k++;
+			if (strcmp(argv[k], "shm") == 0) opt.socketTransport = false;
+			else if (strcmp(argv[k], "socket") == 0) opt.socketTransport = true;
+			else {
+				fprintf(stderr, "Unknown transport: %s\n", argv[k]);
+				return false;
+			}
+		}
+		else {
+			fprintf(stderr, "Unknown option: %s\n", arg);
+			return false;
+		}
+	}
+
+	if (!(opt.frameDt > 0.) || !(opt.simTime >= 0.)) {
+		fprintf(stderr, "The frame duration must be positive and the simulated time non-negative.\n");
+		return false;
+	}
+	if (!(opt.packingFraction > 0. && opt.packingFraction < 1.)) {
+		fprintf(stderr, "The packing fraction must be between 0 and 1.\n");
+		return false;
+	}
+	if (opt.ranks == 0) opt.ranks = 1;
+	if (opt.ranks > 1 && (opt.loadFile != 0 || opt.saveFile != 0 || opt.trajFile != 0 || opt.renderPattern != 0 ||
+		opt.async)) {
+		fprintf(stderr, "-ranks cannot be combined with -load, -save, -traj, -render or -async.\n");
+		return false;
+	}
+#ifdef _WIN32
+	if (opt.ranks > 1) {
+		fprintf(stderr, "-ranks is not available on Windows.\n");
+		return false;
+	}
+#endif
+	return true;
+}
+
+// Reads balls from a text file. Returns false if the file cannot be read
+// or a line is malformed.
+bool loadBalls(const char *fileName, vector<BallT<double> > &balls) {
+	FILE *f = fopen(fileName, "r");
+	if (f == 0) {
+		fprintf(stderr, "Cannot open %s\n", fileName);
+		return false;
+	}
+	char line[512];
+	unsigned long lineNo = 0;
+	bool ok = true;
+	while (fgets(line, sizeof(line), f) != 0) {
+		lineNo++;
+		if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') continue; // Comment or blank
+		double x, y, vx, vy, m, r;
+		unsigned long color = 0;
+		int n = sscanf(line, "%lf %lf %lf %lf %lf %lf %lu", &x, &y, &vx, &vy, &m, &r, &color);
+		if (n < 6) {
+			fprintf(stderr, "%s:%lu: expected x y vx vy m r [color]\n", fileName, lineNo);
+			ok = false;
+			break;
+		}
+		BallT<double> b;
+		b.setXY(x, y);
+		b.setVXY(vx, vy);
+		b.setM(m);
+		b.setR(r);
+		b.setColor(color);
+		balls.push_back(b);
+	}
+	fclose(f);
+	return ok;
+}
+
+// Writes the balls of the simulator to a text file readable by loadBalls()
+template <class T>
+bool saveBalls(const char *fileName, const BallsSimT<T> &bsim) {
+	FILE *f = fopen(fileName, "w");
+	if (f == 0) {
+		fprintf(stderr, "Cannot create %s\n", fileName);
+		return false;
+	}
+	fprintf(f, "# x y vx vy m r color\n");
+	for (unsigned long i = 0; i < bsim.numBalls(); i++) {
+		ConstBallRefT<T> b = bsim.getBall(i);
+		fprintf(f, "%.17g %.17g %.17g %.17g %.17g %.17g %lu\n", double(b.x()), double(b.y()), double(b.vx()),
+			double(b.vy()), double(b.m()), double(b.r()), b.color());
+	}
+	fclose(f);
+	return true;
+}
+
+// Generates n balls with the same distributions as "Add 10 random balls" in
+// the Windows front end, placed on a square lattice so none overlap
+void generateBalls(unsigned long n, unsigned long seed, vector<BallT<double> > &balls) {
+	mt19937 rng((unsigned int)seed);
+	uniform_real_distribution<double> vDist(MIN_RANDOM_V, MAX_RANDOM_V);
+	uniform_real_distribution<double> rDist(MIN_RANDOM_R, MAX_RANDOM_R);
+	uniform_real_distribution<double> colorDist(0, 0xE0E0E0);
+	const double spacing = 2. * MAX_RANDOM_R + 1.;
+	unsigned long perRow = (unsigned long)ceil(sqrt(double(n)));
+	for (unsigned long i = 0; i < n; i++) {
+		double vx = vDist(rng);
+		double vy = vDist(rng);
+		double r = rDist(rng);
+		BallT<double> b;
+		b.setXY(spacing * (i % perRow + .5), spacing * (i / perRow + .5));
+		b.setVXY(vx, vy);
+		b.setR(r);
+		b.setM(M_TO_A_RATIO * PI * r * r);
+		b.setColor((unsigned long)colorDist(rng));
+		balls.push_back(b);
+	}
+}
+
+// Generates n balls with the same distributions as generateBalls() but
+// placed by a ScenarioGenerator, inside walls of the given size or, for a
+// size of 0, of the size at which they cover opt.packingFraction of the area.
+// Sets width and height to the size of the walls.
+void placeBalls(const Options &opt, vector<BallT<double> > &balls, double &width, double &height) {
+	ScenarioGenerator gen;
+	gen.setMethod(opt.placeMethod);
+	gen.setSeed(opt.seed);
+	gen.setRadiusRange(MIN_RANDOM_R, MAX_RANDOM_R);
+	gen.setVelocityRange(MIN_RANDOM_V, MAX_RANDOM_V);
+	gen.setMassToAreaRatio(M_TO_A_RATIO);
+	gen.setNumThreads(opt.threads);
+
+	double area = double(opt.numBalls) * gen.meanArea() / opt.packingFraction;
+	width = opt.width;
+	height = opt.height;
+	if (width <= 0. && height <= 0.) width = height = sqrt(area);
+	else if (width <= 0.) width = area / height;
+	else if (height <= 0.) height = area / width;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	unsigned long placed = gen.generate(opt.numBalls, WallsT<double>(0., 0., width, height), balls);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if (!opt.quiet) printf("Placed %lu of %lu balls in %gx%g in %.3f s\n", placed, opt.numBalls, width, height, seconds);
+	else if (placed < opt.numBalls) printf("Placed only %lu of %lu balls\n", placed, opt.numBalls);
+}
+
+// Reads the scenarios of an ensemble from a text file (see printUsage()).
+// Returns false if the file cannot be read or a setting is malformed.
+bool loadSpecs(const char *fileName, vector<ScenarioSpec> &specs) {
+	FILE *f = fopen(fileName, "r");
+	if (f == 0) {
+		fprintf(stderr, "Cannot open %s\n", fileName);
+		return false;
+	}
+	char line[1024];
+	unsigned long lineNo = 0;
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), f) != 0) {
+		lineNo++;
+		if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') continue; // Comment or blank
+		ScenarioSpec spec;
+		unsigned long repeat = 1;
+		for (char *item = strtok(line, " \t\r\n"); item != 0 && ok; item = strtok(0, " \t\r\n")) {
+			char *value = strchr(item, '=');
+			if (value == 0) {
+				fprintf(stderr, "%s:%lu: expected key=value: %s\n", fileName, lineNo, item);
+				ok = false;
+				break;
+			}
+			*value++ = '\0';
+			if (strcmp(item, "n") == 0) spec.numBalls = strtoul(value, 0, 10);
+			else if (strcmp(item, "rmin") == 0) spec.minRadius = atof(value);
+			else if (strcmp(item, "rmax") == 0) spec.maxRadius = atof(value);
+			else if (strcmp(item, "vmin") == 0) spec.minVelocity = atof(value);
+			else if (strcmp(item, "vmax") == 0) spec.maxVelocity = atof(value);
+			else if (strcmp(item, "massarea") == 0) spec.massToArea = atof(value);
+			else if (strcmp(item, "heavy") == 0) spec.heavyFraction = atof(value);
+			else if (strcmp(item, "massratio") == 0) spec.massRatio = atof(value);
+			else if (strcmp(item, "fraction") == 0) spec.packingFraction = atof(value);
+			else if (strcmp(item, "aspect") == 0) spec.aspect = atof(value);
+			else if (strcmp(item, "t") == 0) spec.simTime = atof(value);
+			else if (strcmp(item, "dt") == 0) spec.frameDt = atof(value);
+			else if (strcmp(item, "seed") == 0) spec.seed = strtoull(value, 0, 10);
+			else if (strcmp(item, "repeat") == 0) repeat = strtoul(value, 0, 10);
+			else if (strcmp(item, "place") == 0 && strcmp(value, "rsa") == 0) spec.method = ScenarioGenerator::RANDOM_SEQUENTIAL;
+			else if (strcmp(item, "place") == 0 && strcmp(value, "square") == 0) spec.method = ScenarioGenerator::SQUARE_LATTICE;
+			else if (strcmp(item, "place") == 0 && strcmp(value, "hex") == 0) spec.method = ScenarioGenerator::HEX_LATTICE;
+			else if (strcmp(item, "broad") == 0 && strcmp(value, "brute") == 0) spec.broadPhase = BallsSim::BRUTE_FORCE;
+			else if (strcmp(item, "broad") == 0 && strcmp(value, "grid") == 0) spec.broadPhase = BallsSim::CELL_GRID;
+			else if (strcmp(item, "broad") == 0 && strcmp(value, "sap") == 0) spec.broadPhase = BallsSim::SWEEP_AND_PRUNE;
+			else if (strcmp(item, "broad") == 0 && strcmp(value, "tree") == 0) spec.broadPhase = BallsSim::AABB_TREE;
+			else {
+				fprintf(stderr, "%s:%lu: unknown setting: %s=%s\n", fileName, lineNo, item, value);
+				ok = false;
+			}
+		}
+		if (ok && (spec.frameDt <= 0. || spec.packingFraction <= 0. || spec.aspect <= 0.)) {
+			fprintf(stderr, "%s:%lu: dt, fraction and aspect must be positive\n", fileName, lineNo);
+			ok = false;
+		}
+		// Repeated runs of a line with a seed get consecutive seeds
+		for (unsigned long r = 0; ok && r < repeat; r++) {
+			specs.push_back(spec);
+			if (spec.seed != 0) spec.seed++;
+		}
+	}
+	fclose(f);
+	return ok;
+}
+
+// Prints the performance counters of one or more frames
+void printStats(const char *title, const SimStats &s) {
+	double frames = s.frames() > 0 ? double(s.frames()) : 1.;
+	printf("%s:\n", title);
+	printf("  pair tests: %llu (%.0f per frame)  wall tests: %llu\n", s.pairTests(), s.pairTests() / frames,
+		s.wallTests());
+	printf("  events queued: %llu  stale: %llu\n", s.eventsQueued(), s.staleEvents());
+	printf("  ball collisions: %llu  wall collisions: %llu\n", s.ballCollisions(), s.wallCollisions());
+	printf("  frames cut short by the collision cap: %llu (%llu events left)\n", s.capHits(), s.eventsLeftAtCap());
+	printf("  reorders: %llu  ms reordering: %.3f\n", s.reorders(), s.reorderNs() * 1e-6);
+	printf("  ms predicting: %.3f (broad phase %.3f)  processing events: %.3f  advancing: %.3f  total: %.3f\n",
+		s.predictNs() * 1e-6, s.broadPhaseNs() * 1e-6, s.eventNs() * 1e-6, s.advanceNs() * 1e-6, s.totalNs() * 1e-6);
+	if (s.sectorRounds() > 0 || s.sectorFallbacks() > 0) {
+		printf("  sector rounds: %llu  boundary events: %llu  rolled back: %llu  frames run serially: %llu\n",
+			s.sectorRounds(), s.boundaryEvents(), s.rolledBackEvents(), s.sectorFallbacks());
+	}
+	if (s.batches() > 0) {
+		printf("  batches: %llu  mean size: %.2f  largest: %llu  cut short: %llu (%llu collisions put back)\n",
+			s.batches(), double(s.batchedCollisions()) / s.batches(), s.largestBatch(), s.cutBatches(),
+			s.putBackEvents());
+	}
+}
+
+// Prints the observables of the balls and their speed histogram
+void printObservables(const Observables &o) {
+	printf("observables over %.6g s, %llu samples:\n", o.observedTime(), o.samples());
+	printf("  kinetic energy: %.6g (mean %.6g)  temperature: %.6g  momentum: (%.6g, %.6g)\n", o.kineticEnergy(),
+		o.meanKineticEnergy(), o.temperature(), o.momentumX(), o.momentumY());
+	printf("  pressure: %.6g (x1 %.6g, y1 %.6g, x2 %.6g, y2 %.6g)  wall collisions: %llu\n", o.pressure(),
+		o.pressure(Walls::X1), o.pressure(Walls::Y1), o.pressure(Walls::X2), o.pressure(Walls::Y2),
+		o.wallCollisions());
+	printf("  ball collisions: %llu  collision frequency: %.6g per ball per s\n", o.ballCollisions(),
+		o.collisionFrequency());
+	printf("  mean free path: %.6g  mean free time: %.6g (%llu paths)\n", o.meanFreePath(), o.meanFreeTime(),
+		o.freePaths());
+	const Histogram &h = o.speedHistogram();
+	if (h.total() == 0) return;
+	printf("  speed histogram (bin centre, density):\n");
+	for (unsigned int b = 0; b < h.bins(); b++) printf("    %10.4g %12.6g\n", h.binCentre(b), h.density(b));
+	if (h.overflow() > 0) printf("    above %.4g: %llu\n", h.hi(), h.overflow());
+}
+
+// Prints g(r) and S(k) at as many wavenumbers, up to that of the bin width
+void printPairCorrelation(const PairCorrelation &pc, double seconds) {
+	printf("pair correlation over %lu samples (%.3f ms per sample), density %.6g:\n", pc.samples(),
+		pc.samples() > 0 ? seconds * 1e3 / pc.samples() : 0., pc.density());
+	printf("  %10s %10s %10s %10s\n", "r", "g(r)", "k", "S(k)");
+	double kMax = 3.14159265358979323846 / pc.binWidth();
+	for (unsigned int b = 0; b < pc.bins(); b++) {
+		double k = kMax * (b + 1) / pc.bins();
+		printf("  %10.4g %10.4f %10.4g %10.4f\n", pc.binCentre(b), pc.g(b), k, pc.structureFactor(k));
+	}
+}
+
+// Draws balls (a BallsSimT or BallSnapshot) to the image file for frame
+// frame named by pattern, adding the time taken to drawTime and writeTime
+template <class S>
+bool renderImage(Rasterizer &raster, const S &balls, const char *pattern, unsigned long frame, double &drawTime,
+	double &writeTime) {
+	chrono::steady_clock::time_point drawStart = chrono::steady_clock::now();
+	raster.drawBalls(balls);
+	chrono::steady_clock::time_point writeStart = chrono::steady_clock::now();
+	char fileName[1024];
+	snprintf(fileName, sizeof(fileName), pattern, frame);
+	if (!raster.writeImage(fileName)) {
+		fprintf(stderr, "Cannot write image %s\n", fileName);
+		return false;
+	}
+	chrono::steady_clock::time_point writeEnd = chrono::steady_clock::now();
+	drawTime += chrono::duration<double>(writeStart - drawStart).count();
+	writeTime += chrono::duration<double>(writeEnd - writeStart).count();
+	return true;
+}
+
+// Runs the simulation with scalar type T and reports the results
+template <class T>
+int run(const Options &opt, const vector<BallT<double> > &balls, double width, double height) {
+	BallsSimT<T> bsim;
+	bsim.setNumThreads(opt.threads);
+	bsim.setBroadPhase(opt.broadPhase);
+	bsim.setNumSectors(opt.sectors);
+	bsim.setMaxBatchSize(opt.batch);
+	bsim.setMaxCollisionsPerBall(opt.collisionsPerBall);
+	bsim.setObservablesInterval(opt.observe);
+	bsim.setReorderInterval(opt.reorder);
+	bsim.setDeterministic(opt.deterministic);
+	if (opt.loadFile != 0) {
+		const char *error;
+		chrono::steady_clock::time_point loadStart = chrono::steady_clock::now();
+		if (!bsim.loadCheckpoint(opt.loadFile, &error)) {
+			fprintf(stderr, "Cannot load checkpoint %s: %s\n", opt.loadFile, error);
+			return 1;
+		}
+		double loadTime = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
+		if (!opt.quiet) printf("loaded %s in %.3f ms\n", opt.loadFile, loadTime * 1e3);
+		width = bsim.getWalls().x2();
+		height = bsim.getWalls().y2();
+	}
+	else {
+		bsim.addWalls(WallsT<T>(T(0), T(0), T(width), T(height)));
+		bsim.addBalls(balls.begin(), balls.end());
+	}
+
+	// The whole trajectory is wanted, so the simulation waits for the writer
+	// rather than dropping frames
+	TrajectoryWriter trajectory;
+	if (opt.trajFile != 0) {
+		trajectory.setPositionPrecision(opt.trajPrecision);
+		trajectory.setVelocityPrecision(opt.trajPrecision);
+		trajectory.setKeyframeInterval(opt.keyframeInterval);
+		trajectory.setWaitWhenFull(true);
+		if (!trajectory.open(opt.trajFile)) {
+			fprintf(stderr, "Cannot create trajectory %s\n", opt.trajFile);
+			return 1;
+		}
+		bsim.setTrajectoryWriter(&trajectory);
+	}
+
+	unsigned long numFrames = (unsigned long)ceil(opt.simTime / opt.frameDt - 1e-9);
+	if (!opt.quiet) {
+		printf("%lu balls, walls %g x %g, %lu frames of %g s, %u threads, %s broad phase, %s\n", bsim.numBalls(), width,
+			height, numFrames, opt.frameDt, bsim.getNumThreads(), BROAD_PHASE_NAMES[opt.broadPhase],
+			is_same<T, float>::value ? "float" : "double");
+	}
+
+	Rasterizer raster;
+	if (opt.renderPattern != 0) {
+		raster.setNumThreads(opt.threads);
+		raster.setSize(opt.imageWidth, opt.imageHeight);
+		raster.fitView(0., 0., width, height);
+	}
+	double drawTime = 0., writeTime = 0.; // Time spent rendering, not simulating
+	unsigned long numRendered = 0;
+
+	// Counters of each frame, collected on the thread running the simulation
+	unsigned long long totalCollisions = 0;
+	SimStats slowestFrame; // Counters of the frame that took longest
+	unsigned long slowestFrameNo = 0;
+	unsigned long framesCounted = 0;
+	function<void(const BallsSimT<T> &)> countFrame = [&](const BallsSimT<T> &sim) {
+		totalCollisions += sim.getNumCollisionsLastFrame();
+		if (sim.getLastFrameStats().totalNs() > slowestFrame.totalNs()) {
+			slowestFrame = sim.getLastFrameStats();
+			slowestFrameNo = framesCounted;
+		}
+		framesCounted++;
+	};
+
+	PairCorrelation pairCorrelation;
+	double rdfTime = 0.; // Time spent sampling g(r), not simulating
+	if (opt.rdfRange > 0.) {
+		pairCorrelation.setNumThreads(opt.threads);
+		pairCorrelation.setRange(opt.rdfRange, opt.rdfBins);
+	}
+	bool sampleRdf = opt.rdfRange > 0. && opt.rdfEvery > 0;
+
+	unsigned long numSnapshots = 0; // Snapshots read by the main thread with -async
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if (opt.async) {
+		SimThreadT<T> simThread(bsim);
+		simThread.setFrameDt(opt.frameDt);
+		simThread.setFrameCallback(countFrame);
+		simThread.start(numFrames);
+		// Headless consumer: reads the latest snapshot whenever one is published,
+		// skipping those published while it was busy
+		unsigned long nextRender = 0; // First frame that may be rendered next
+		unsigned long nextRdf = 0; // First frame that may be sampled for g(r) next
+		while (simThread.isRunning() || simThread.hasNewSnapshot()) {
+			if (!simThread.hasNewSnapshot()) {
+				this_thread::sleep_for(chrono::microseconds(100));
+				continue;
+			}
+			const BallSnapshot *snapshot = simThread.latest();
+			numSnapshots++;
+			if (snapshot->frames == 0) continue; // State before the first frame
+			unsigned long frame = (unsigned long)snapshot->frames - 1;
+			if (opt.renderPattern != 0 && frame >= nextRender) {
+				if (!renderImage(raster, *snapshot, opt.renderPattern, frame, drawTime, writeTime)) {
+					simThread.stop();
+					return 1;
+				}
+				numRendered++;
+				nextRender = frame + opt.renderEvery;
+			}
+			if (sampleRdf && frame >= nextRdf) {
+				chrono::steady_clock::time_point rdfStart = chrono::steady_clock::now();
+				pairCorrelation.addSample(*snapshot);
+				rdfTime += chrono::duration<double>(chrono::steady_clock::now() - rdfStart).count();
+				nextRdf = frame + opt.rdfEvery;
+			}
+		}
+		simThread.stop();
+	}
+	else {
+		for (unsigned long frame = 0; frame < numFrames; frame++) {
+			bsim.advanceSim(T(opt.frameDt));
+			countFrame(bsim);
+			if (opt.renderPattern != 0 && frame % opt.renderEvery == 0) {
+				if (!renderImage(raster, bsim, opt.renderPattern, frame, drawTime, writeTime)) return 1;
+				numRendered++;
+			}
+			if (sampleRdf && frame % opt.rdfEvery == 0) {
+				chrono::steady_clock::time_point rdfStart = chrono::steady_clock::now();
+				pairCorrelation.addSample(bsim);
+				rdfTime += chrono::duration<double>(chrono::steady_clock::now() - rdfStart).count();
+			}
+		}
+	}
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if (!opt.async) elapsed -= drawTime + writeTime + rdfTime; // Rendering overlaps the simulation with -async
+
+	printf("frames: %lu  collisions: %llu  wall time: %.3f s\n", numFrames, totalCollisions, elapsed);
+	if (elapsed > 0.) {
+		printf("frames/s: %.2f  collisions/s: %.0f  simulated s per wall s: %.3f\n", numFrames / elapsed,
+			totalCollisions / elapsed, numFrames * opt.frameDt / elapsed);
+	}
+
+	if (opt.async) printf("snapshots read: %lu of %lu frames\n", numSnapshots, numFrames);
+	if (numRendered > 0) {
+		printf("rendered %lu images of %ux%u: %.3f ms drawing, %.3f ms writing per image\n", numRendered,
+			opt.imageWidth, opt.imageHeight, drawTime * 1e3 / numRendered, writeTime * 1e3 / numRendered);
+	}
+
+	if (opt.stats) {
+		if (BallsSimT<T>::statsEnabled()) {
+			printStats("all frames", bsim.getTotalStats());
+			char title[64];
+			sprintf(title, "slowest frame (%lu)", slowestFrameNo);
+			printStats(title, slowestFrame);
+		}
+		else printf("The simulator was built without performance counters (BALLSSIM_STATS).\n");
+	}
+	if (opt.observe > 0) printObservables(bsim.getObservables());
+	if (opt.rdfRange > 0.) {
+		chrono::steady_clock::time_point rdfStart = chrono::steady_clock::now();
+		pairCorrelation.addSample(bsim); // The final state
+		rdfTime += chrono::duration<double>(chrono::steady_clock::now() - rdfStart).count();
+		printPairCorrelation(pairCorrelation, rdfTime);
+	}
+
+	if (opt.trajFile != 0) {
+		bsim.setTrajectoryWriter(0);
+		if (!trajectory.close()) {
+			fprintf(stderr, "Cannot write trajectory %s\n", opt.trajFile);
+			return 1;
+		}
+		if (!opt.quiet) {
+			printf("trajectory: %llu frames, %llu bytes (%.2f bytes per ball per frame)\n", trajectory.framesAdded(),
+				trajectory.bytesWritten(), trajectory.framesAdded() > 0 && bsim.numBalls() > 0 ?
+				double(trajectory.bytesWritten()) / trajectory.framesAdded() / bsim.numBalls() : 0.);
+		}
+	}
+
+	if (opt.outFile != 0 && !saveBalls(opt.outFile, bsim)) return 1;
+	if (opt.saveFile != 0) {
+		const char *error;
+		if (!bsim.saveCheckpoint(opt.saveFile, &error)) {
+			fprintf(stderr, "Cannot write checkpoint %s: %s\n", opt.saveFile, error);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+#ifndef _WIN32
+// Runs the simulation split over opt.ranks processes and reports the results
+// and the load of each rank. Returns in rank 0 only.
+template <class T>
+int runRanks(const Options &opt, const vector<BallT<double> > &balls, double width, double height) {
+	unique_ptr<Transport> transport;
+	if (opt.socketTransport) {
+		SocketTransport *sockets = new SocketTransport(opt.ranks);
+		transport.reset(sockets);
+		if (!sockets->isOpen()) {
+			fprintf(stderr, "Cannot create the sockets between the ranks\n");
+			return 1;
+		}
+	}
+	else {
+		SharedMemoryTransport *shm = new SharedMemoryTransport(opt.ranks);
+		transport.reset(shm);
+		if (!shm->isOpen()) {
+			fprintf(stderr, "Cannot map the shared memory between the ranks\n");
+			return 1;
+		}
+	}
+	fflush(stdout); // Or the children would print it again
+	unsigned int rank = transport->launch();
+	if (rank == opt.ranks) {
+		fprintf(stderr, "Cannot start the ranks\n");
+		return 1;
+	}
+
+	DomainSimT<T> domain(*transport);
+	domain.getSim().setNumThreads(opt.threads);
+	domain.getSim().setBroadPhase(opt.broadPhase);
+	domain.getSim().setDeterministic(opt.deterministic);
+	domain.getSim().setNumSectors(opt.sectors);
+	domain.getSim().setMaxBatchSize(opt.batch);
+	domain.getSim().setMaxCollisionsPerBall(opt.collisionsPerBall);
+	domain.setBalls(WallsT<T>(T(0), T(0), T(width), T(height)), balls);
+	unsigned long numFrames = (unsigned long)ceil(opt.simTime / opt.frameDt - 1e-9);
+	if (rank == 0 && !opt.quiet) {
+		printf("%lu balls, walls %g x %g, %lu frames of %g s, %u ranks over %s, %u threads each, %s broad phase, %s\n",
+			(unsigned long)balls.size(), width, height, numFrames, opt.frameDt, opt.ranks,
+			opt.socketTransport ? "sockets" : "shared memory", domain.getSim().getNumThreads(),
+			BROAD_PHASE_NAMES[opt.broadPhase], is_same<T, float>::value ? "float" : "double");
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	bool ok = true;
+	for (unsigned long frame = 0; frame < numFrames && ok; frame++) {
+		ok = domain.advance(T(opt.frameDt));
+	}
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	vector<RankStats> stats;
+	vector<BallT<T> > all;
+	ok = ok && domain.gatherStats(stats) && domain.gatherBalls(all);
+	if (rank != 0) {
+		transport.reset(); // Lets rank 0 see that this rank has gone
+		_exit(ok ? 0 : 1);
+	}
+	if (!transport->join()) ok = false;
+	if (!ok) {
+		fprintf(stderr, "The ranks lost contact with each other\n");
+		return 1;
+	}
+
+	// Collisions of ghosts are counted by both ranks
+	unsigned long long totalCollisions = 0;
+	for (unsigned int r = 0; r < stats.size(); r++) {
+		totalCollisions += stats[r].collisions();
+	}
+	printf("frames: %lu  collisions (ghosts included): %llu  wall time: %.3f s\n", numFrames, totalCollisions, elapsed);
+	if (elapsed > 0.) {
+		printf("frames/s: %.2f  simulated s per wall s: %.3f\n", numFrames / elapsed, numFrames * opt.frameDt / elapsed);
+	}
+	printf("rank  slab x              balls  ghosts/frame  handed out  simulate s  exchange s  MB sent  ghost misses\n");
+	for (unsigned int r = 0; r < stats.size(); r++) {
+		const RankStats &s = stats[r];
+		double frames = s.frames() > 0 ? double(s.frames()) : 1.;
+		printf("%4u  %8.1f-%-8.1f %7lu  %12.1f  %10llu  %10.3f  %10.3f  %7.2f  %12llu\n", s.rank(), s.slabX1(),
+			s.slabX2(), s.ownedBalls(), s.ghostBalls() / frames, s.ballsSent(), s.simulateNs() * 1e-9,
+			s.exchangeNs() * 1e-9, s.bytesSent() / 1048576., s.ghostMismatches());
+	}
+
+	if (opt.outFile != 0) {
+		BallsSimT<T> result;
+		result.setBallsVector(all);
+		if (!saveBalls(opt.outFile, result)) return 1;
+	}
+	return 0;
+}
+#endif
+
+// Runs the scenarios of opt.ensembleFile and prints the summary of each
+// run as a line of CSV as the runs finish, in the order of the runs
+template <class T>
+int runEnsemble(const Options &opt) {
+	vector<ScenarioSpec> specs;
+	if (!loadSpecs(opt.ensembleFile, specs)) return 1;
+
+	EnsembleRunnerT<T> runner;
+	runner.setNumThreads(opt.threads);
+	runner.setSeed(opt.seed);
+	runner.setSummaryCallback([](const RunSummary &s) {
+		printf("%lu,%llu,%lu,%.6g,%.6g,%lu,%llu,%.6g,%.10g,%.10g,%.6g,%.6f,%u\n", s.run, (unsigned long long)s.seed,
+			s.numBalls, s.width, s.height, s.frames, s.collisions, s.collisionRate, s.initialEnergy, s.finalEnergy,
+			s.meanSpeed, s.seconds, s.worker);
+	});
+	printf("run,seed,balls,width,height,frames,collisions,collision_rate,initial_energy,final_energy,mean_speed,"
+		"seconds,worker\n");
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	runner.run(specs);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if (!opt.quiet) {
+		printf("# %lu runs on %u threads in %.3f s (%.1f runs/s), %lu runs stolen, %s\n", (unsigned long)specs.size(),
+			runner.getNumThreads(), seconds, seconds > 0. ? specs.size() / seconds : 0., runner.runsStolen(),
+			is_same<T, float>::value ? "float" : "double");
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	Options opt;
+	if (!parseOptions(argc, argv, opt)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	if (opt.ensembleFile != 0) return opt.singlePrecision ? runEnsemble<float>(opt) : runEnsemble<double>(opt);
+
+	vector<BallT<double> > balls;
+	if (opt.loadFile == 0) { // Otherwise the balls and walls come from the checkpoint
+		if (opt.inFile != 0) {
+			if (!loadBalls(opt.inFile, balls)) return 1;
+		}
+		else if (!opt.place) generateBalls(opt.numBalls, opt.seed, balls);
+	}
+
+	// Size the walls to enclose all the balls unless given
+	double width = opt.width;
+	double height = opt.height;
+	if (opt.place && opt.loadFile == 0 && opt.inFile == 0) placeBalls(opt, balls, width, height);
+	else for (unsigned long i = 0; i < balls.size(); i++) {
+		if (opt.width <= 0. && balls[i].x() + balls[i].r() > width) width = balls[i].x() + balls[i].r();
+		if (opt.height <= 0. && balls[i].y() + balls[i].r() > height) height = balls[i].y() + balls[i].r();
+	}
+
+#ifndef _WIN32
+	if (opt.ranks > 1) {
+		return opt.singlePrecision ? runRanks<float>(opt, balls, width, height) :
+			runRanks<double>(opt, balls, width, height);
+	}
+#endif
+	return opt.singlePrecision ? run<float>(opt, balls, width, height) : run<double>(opt, balls, width, height);
+}
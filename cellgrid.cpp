@@ -0,0 +1,82 @@
+// cellgrid.cpp - version 1.1
+// Functions declared in cellgrid.h.
+// See cellgrid.h for documentation of functions.
+
+#include "cellgrid.h"
+#include <cmath>
+
+void CellGrid::rebuild(const BoundingBox &bounds, double cellSize, const std::vector<BoundingBox> &newBoxes) {
+	double width = bounds.x2() - bounds.x1();
+	double height = bounds.y2() - bounds.y1();
+	if (!(width > 0.)) width = 1.;
+	if (!(height > 0.)) height = 1.;
+
+	// Keep the number of cells within a small multiple of the number of
+	// balls, so a few tiny balls in a huge box do not allocate a huge grid
+	double maxCells = 4. * newBoxes.size() + 16.;
+	double minCellSize = std::sqrt(width * height / maxCells);
+	if (!(cellSize > minCellSize)) cellSize = minCellSize;
+
+	originX = bounds.x1();
+	originY = bounds.y1();
+	invCellSize = 1. / cellSize;
+	nx = (unsigned long)std::ceil(width * invCellSize);
+	ny = (unsigned long)std::ceil(height * invCellSize);
+	if (nx == 0) nx = 1;
+	if (ny == 0) ny = 1;
+
+	// Clear the cells but keep their storage for the next rebuild
+	if (cells.size() > nx * ny) cells.resize(nx * ny);
+	for (unsigned long c = 0; c < cells.size(); c++) {
+		cells[c].clear();
+	}
+	cells.resize(nx * ny);
+
+	boxes = newBoxes;
+	for (unsigned long i = 0; i < boxes.size(); i++) {
+		insert(i);
+	}
+}
+
+void CellGrid::update(unsigned long i, const BoundingBox &box) {
+	remove(i);
+	boxes[i] = box;
+	insert(i);
+}
+
+void CellGrid::add(const BoundingBox &box) {
+	boxes.push_back(box);
+	insert(boxes.size() - 1);
+}
+
+void CellGrid::removeLast() {
+	remove(boxes.size() - 1);
+	boxes.pop_back();
+}
+
+void CellGrid::insert(unsigned long i) {
+	unsigned long lx, ly, hx, hy;
+	cellRange(boxes[i], lx, ly, hx, hy);
+	for (unsigned long cy = ly; cy <= hy; cy++) {
+		for (unsigned long cx = lx; cx <= hx; cx++) {
+			cells[cy * nx + cx].push_back(i);
+		}
+	}
+}
+
+void CellGrid::remove(unsigned long i) {
+	unsigned long lx, ly, hx, hy;
+	cellRange(boxes[i], lx, ly, hx, hy);
+	for (unsigned long cy = ly; cy <= hy; cy++) {
+		for (unsigned long cx = lx; cx <= hx; cx++) {
+			std::vector<unsigned long> &cell = cells[cy * nx + cx];
+			for (unsigned long k = 0; k < cell.size(); k++) {
+				if (cell[k] == i) {
+					cell[k] = cell.back(); // Order within a cell does not matter
+					cell.pop_back();
+					break;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,148 @@
+// cellgrid.h - version 1.1
+// Uniform grid of square cells used as a broad phase by BallsSim to limit
+// the pairs of balls passed to findTimeUntilTwoBallsCollide().
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - added add(), removeLast(), box(), numBoxes() and forEachOverlap(), so a
+//       grid can hold a changing subset of the balls
+
+#ifndef CELLGRID_H
+#define CELLGRID_H
+
+#include "boundingbox.h"
+#include <vector>
+
+// Each ball is represented by a bounding box (normally the box swept by the
+// ball over the rest of the frame) and is registered in every cell its box
+// overlaps. Two balls are candidates for a collision only if their boxes
+// overlap. Each candidate pair is reported exactly once, from the cell that
+// contains the lowest corner of the intersection of the two boxes.
+// Boxes outside the grid bounds are clamped into the edge cells, so the grid
+// is always correct; the bounds and cell size only affect speed.
+class CellGrid {
+	public:
+
+		// Constructors
+		CellGrid() {
+			originX = originY = 0.;
+			invCellSize = 1.;
+			nx = ny = 0;
+		}
+
+		// Rebuilds the grid to cover bounds with cells of size cellSize
+		// (enlarged if needed to keep the number of cells proportional to
+		// the number of boxes) and registers boxes. Box i belongs to ball i.
+		void rebuild(const BoundingBox &bounds, double cellSize, const std::vector<BoundingBox> &newBoxes);
+
+		// Replaces the box of ball i, moving it between cells as needed
+		void update(unsigned long i, const BoundingBox &box);
+
+		// Registers box as the box of a new ball, numbered numBoxes() - 1 after the call
+		void add(const BoundingBox &box);
+
+		// Unregisters the box of ball numBoxes() - 1
+		void removeLast();
+
+		// Current box of ball i
+		const BoundingBox &box(unsigned long i) const { return boxes[i]; }
+
+		// Number of balls registered
+		unsigned long numBoxes() const { return boxes.size(); }
+
+		// Calls f(i, j) with i < j for each pair of balls whose boxes overlap
+		template <class F> void forEachPair(F f) const {
+			for (unsigned long c = 0; c < cells.size(); c++) {
+				const std::vector<unsigned long> &cell = cells[c];
+				for (unsigned long a = 0; a + 1 < cell.size(); a++) {
+					for (unsigned long b = a + 1; b < cell.size(); b++) {
+						if (isReferenceCell(c, cell[a], cell[b])) {
+							if (cell[a] < cell[b]) f(cell[a], cell[b]);
+							else f(cell[b], cell[a]);
+						}
+					}
+				}
+			}
+		}
+
+		// Calls f(j) for each ball j != i whose box overlaps the box of ball i
+		template <class F> void forEachCandidate(unsigned long i, F f) const {
+			unsigned long lx, ly, hx, hy;
+			cellRange(boxes[i], lx, ly, hx, hy);
+			for (unsigned long cy = ly; cy <= hy; cy++) {
+				for (unsigned long cx = lx; cx <= hx; cx++) {
+					unsigned long c = cy * nx + cx;
+					const std::vector<unsigned long> &cell = cells[c];
+					for (unsigned long k = 0; k < cell.size(); k++) {
+						if (cell[k] != i && isReferenceCell(c, i, cell[k])) f(cell[k]);
+					}
+				}
+			}
+		}
+
+		// Calls f(i) once for each ball i whose box overlaps box, which need
+		// not belong to a ball of this grid
+		template <class F> void forEachOverlap(const BoundingBox &box, F f) const {
+			unsigned long lx, ly, hx, hy;
+			cellRange(box, lx, ly, hx, hy);
+			for (unsigned long cy = ly; cy <= hy; cy++) {
+				for (unsigned long cx = lx; cx <= hx; cx++) {
+					unsigned long c = cy * nx + cx;
+					const std::vector<unsigned long> &cell = cells[c];
+					for (unsigned long k = 0; k < cell.size(); k++) {
+						if (isReferenceCell(c, box, boxes[cell[k]])) f(cell[k]);
+					}
+				}
+			}
+		}
+
+		// Number of cells in the grid
+		unsigned long numCells() const { return cells.size(); }
+
+	private:
+		double originX; // Lowest x and y coordinates covered by the grid
+		double originY;
+		double invCellSize; // 1 / cell size
+		unsigned long nx; // Number of cells in the x and y directions
+		unsigned long ny;
+		std::vector<std::vector<unsigned long> > cells; // Indices of the balls in each cell, row by row
+		std::vector<BoundingBox> boxes; // Current box of each ball
+
+		// Cell coordinate of x (or y), clamped to the grid
+		unsigned long cellCoord(double x, double origin, unsigned long n) const {
+			double c = (x - origin) * invCellSize;
+			if (!(c > 0.)) return 0; // Also catches NaN
+			if (c >= double(n - 1)) return n - 1;
+			return (unsigned long)c;
+		}
+
+		// Range of cells overlapped by box
+		void cellRange(const BoundingBox &box, unsigned long &lx, unsigned long &ly, unsigned long &hx, unsigned long &hy) const {
+			lx = cellCoord(box.x1(), originX, nx);
+			ly = cellCoord(box.y1(), originY, ny);
+			hx = cellCoord(box.x2(), originX, nx);
+			hy = cellCoord(box.y2(), originY, ny);
+		}
+
+		// Do the boxes of balls i and j overlap, and is c the cell from which
+		// the pair should be reported?
+		bool isReferenceCell(unsigned long c, unsigned long i, unsigned long j) const {
+			return isReferenceCell(c, boxes[i], boxes[j]);
+		}
+
+		// Do boxes bi and bj overlap, and is c the cell from which the pair
+		// should be reported?
+		bool isReferenceCell(unsigned long c, const BoundingBox &bi, const BoundingBox &bj) const {
+			if (!bi.overlaps(bj)) return false;
+			unsigned long rx = cellCoord(bi.x1() > bj.x1() ? bi.x1() : bj.x1(), originX, nx);
+			unsigned long ry = cellCoord(bi.y1() > bj.y1() ? bi.y1() : bj.y1(), originY, ny);
+			return c == ry * nx + rx;
+		}
+
+		// Add / remove ball i to / from the cells overlapped by its box
+		void insert(unsigned long i);
+		void remove(unsigned long i);
+};
+
+#endif
@@ -0,0 +1,182 @@
+// checkpoint.cpp - version 1.1
+// Functions declared in checkpoint.h.
+// See checkpoint.h for documentation of functions.
+
+#include "checkpoint.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char Checkpoint::CHECKPOINT_MAGIC[8] = { 'B', 'S', 'I', 'M', 'C', 'K', 'P', 'T' };
+
+Checkpoint::Checkpoint() {
+	data = 0;
+	size = 0;
+	error = "";
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = 0;
+#endif
+}
+
+Checkpoint::~Checkpoint() {
+	close();
+}
+
+uint32_t Checkpoint::elementSize(int a, uint32_t scalarSize) {
+	return a == COLOR ? sizeof(uint32_t) : a == ID ? sizeof(int32_t) : scalarSize;
+}
+
+uint64_t Checkpoint::arrayOffset(int a, uint64_t n, uint32_t scalarSize) {
+	uint64_t offset = sizeof(CheckpointHeader);
+	for (int k = 0; k < a; k++) {
+		uint64_t bytes = n * elementSize(k, scalarSize);
+		offset += (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	}
+	return offset;
+}
+
+uint64_t Checkpoint::checksum(uint64_t h, const void *p, std::size_t size) {
+	// FNV-1a taken a 64-bit word at a time rather than a byte at a time, so
+	// checking a large file costs about as much as reading it
+	const unsigned char *bytes = static_cast<const unsigned char *>(p);
+	for (std::size_t k = 0; k + 8 <= size; k += 8) {
+		uint64_t w;
+		memcpy(&w, bytes + k, 8);
+		h = (h ^ w) * 1099511628211ULL;
+	}
+	return h;
+}
+
+uint64_t Checkpoint::headerChecksum(const CheckpointHeader &h) {
+	CheckpointHeader zeroed = h;
+	zeroed.checksum = 0;
+	return checksum(CHECKSUM_SEED, &zeroed, sizeof(zeroed));
+}
+
+bool Checkpoint::write(const char *fileName, const CheckpointHeader &h, const void *const arrays[NUM_ARRAYS]) {
+	CheckpointHeader out = h;
+	memcpy(out.magic, CHECKPOINT_MAGIC, sizeof(out.magic));
+	out.version = CHECKPOINT_VERSION;
+	out.byteOrder = CHECKPOINT_BYTE_ORDER;
+	out.headerSize = sizeof(CheckpointHeader);
+	out.fileSize = arrayOffset(NUM_ARRAYS, h.numBalls, h.scalarSize);
+	memset(out.reserved, 0, sizeof(out.reserved));
+
+	// Each array is written as its whole blocks of ALIGNMENT bytes followed
+	// by one zero-padded block holding the rest
+	uint64_t fullBytes[NUM_ARRAYS];
+	unsigned char tails[NUM_ARRAYS][ALIGNMENT];
+	uint64_t sum = headerChecksum(out);
+	for (int a = 0; a < NUM_ARRAYS; a++) {
+		uint64_t bytes = h.numBalls * elementSize(a, h.scalarSize);
+		fullBytes[a] = bytes / ALIGNMENT * ALIGNMENT;
+		memset(tails[a], 0, ALIGNMENT);
+		if (bytes > fullBytes[a]) memcpy(tails[a], static_cast<const char *>(arrays[a]) + fullBytes[a], bytes - fullBytes[a]);
+		sum = checksum(sum, arrays[a], fullBytes[a]);
+		if (bytes > fullBytes[a]) sum = checksum(sum, tails[a], ALIGNMENT);
+	}
+	out.checksum = sum;
+
+	FILE *f = fopen(fileName, "wb");
+	if (f == 0) {
+		error = "cannot create file";
+		return false;
+	}
+	bool ok = fwrite(&out, sizeof(out), 1, f) == 1;
+	for (int a = 0; a < NUM_ARRAYS && ok; a++) {
+		uint64_t bytes = h.numBalls * elementSize(a, h.scalarSize);
+		if (fullBytes[a] > 0) ok = fwrite(arrays[a], 1, fullBytes[a], f) == fullBytes[a];
+		if (ok && bytes > fullBytes[a]) ok = fwrite(tails[a], 1, ALIGNMENT, f) == ALIGNMENT;
+	}
+	if (fclose(f) != 0) ok = false;
+	if (!ok) error = "cannot write file";
+	return ok;
+}
+
+bool Checkpoint::open(const char *fileName) {
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE) {
+		error = "cannot open file";
+		return false;
+	}
+	fileHandle = file;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || (unsigned long long)fileSize.QuadPart < sizeof(CheckpointHeader)) {
+		error = "file too short";
+		close();
+		return false;
+	}
+	size = (std::size_t)fileSize.QuadPart;
+	mappingHandle = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (mappingHandle != 0) data = static_cast<const unsigned char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+	int fd = ::open(fileName, O_RDONLY);
+	if (fd < 0) {
+		error = "cannot open file";
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (unsigned long long)st.st_size < sizeof(CheckpointHeader)) {
+		::close(fd);
+		error = "file too short";
+		return false;
+	}
+	size = (std::size_t)st.st_size;
+	void *p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // The mapping keeps the file open
+	if (p != MAP_FAILED) data = static_cast<const unsigned char *>(p);
+#endif
+	if (data == 0) {
+		error = "cannot map file";
+		close();
+		return false;
+	}
+
+	// Check the header before trusting any size in it
+	const CheckpointHeader &h = header();
+	const char *problem = 0;
+	if (memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0) problem = "not a checkpoint file";
+	else if (h.byteOrder != CHECKPOINT_BYTE_ORDER) problem = "checkpoint written on a machine of another byte order";
+	else if (h.version != CHECKPOINT_VERSION) problem = "unsupported checkpoint version";
+	else if (h.headerSize != sizeof(CheckpointHeader) || (h.scalarSize != 4 && h.scalarSize != 8)) problem = "corrupt header";
+	else if (h.numBalls > size / 8 || h.fileSize != size || arrayOffset(NUM_ARRAYS, h.numBalls, h.scalarSize) != size) {
+		problem = "file size does not match header";
+	}
+	else if (checksum(headerChecksum(h), data + sizeof(CheckpointHeader), size - sizeof(CheckpointHeader)) != h.checksum) {
+		problem = "checksum mismatch";
+	}
+	if (problem != 0) {
+		error = problem;
+		close();
+		return false;
+	}
+	error = "";
+	return true;
+}
+
+void Checkpoint::close() {
+#ifdef _WIN32
+	if (data != 0) UnmapViewOfFile(data);
+	if (mappingHandle != 0) CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+	mappingHandle = 0;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data != 0) munmap(const_cast<unsigned char *>(data), size);
+#endif
+	data = 0;
+	size = 0;
+}
@@ -0,0 +1,109 @@
+// checkpoint.h - version 1.1
+// Binary checkpoint files holding the state of a simulator, written by
+// BallsSim::saveCheckpoint() and read by BallsSim::loadCheckpoint().
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - the checksum covers the header too, and the header is 128 bytes as
+//       documented, so the arrays are aligned (version 2)
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Layout of the start of a checkpoint file. All numbers are in the byte
+// order of the machine that wrote the file; byteOrder tells readers on the
+// other kind of machine to reject it.
+struct CheckpointHeader {
+	char magic[8]; // CHECKPOINT_MAGIC
+	uint32_t version; // CHECKPOINT_VERSION
+	uint32_t byteOrder; // CHECKPOINT_BYTE_ORDER as written
+	uint32_t headerSize; // sizeof(CheckpointHeader); the arrays start here
+	uint32_t scalarSize; // Size in bytes of the scalars of the arrays, 4 (float) or 8 (double)
+	uint64_t numBalls;
+	uint64_t fileSize;
+	uint64_t checksum; // Checkpoint::checksum() of the whole file, with this field taken as 0
+	int32_t nextID; // ID the simulator gives the next ball added
+	uint32_t maxCollisionsPerBall;
+	uint32_t maxCollisions;
+	uint32_t hasWalls;
+	double walls[4]; // x1, y1, x2, y2
+	uint8_t reserved[32]; // 0, pads the header to 128 bytes
+};
+
+// A checkpoint file mapped into memory. After the header come, in the order
+// of Checkpoint::Array, the arrays of each property of the balls, indexed by
+// ball. Each array starts on a multiple of ALIGNMENT bytes from the start of
+// the file and is padded with zeros to the next one, so once the file is
+// mapped the arrays can be used in place.
+class Checkpoint {
+	public:
+
+		// Constants
+		static const char CHECKPOINT_MAGIC[8];
+		static const uint32_t CHECKPOINT_VERSION = 2;
+		static const uint32_t CHECKPOINT_BYTE_ORDER = 0x01020304;
+		static const std::size_t ALIGNMENT = 64;
+		static const uint64_t CHECKSUM_SEED = 14695981039346656037ULL;
+
+		// Arrays of a checkpoint. X through M hold scalars of
+		// header().scalarSize bytes, COLOR uint32_t and ID int32_t.
+		enum Array { X, Y, VX, VY, R, M, COLOR, ID, NUM_ARRAYS };
+
+		// Constructors
+		Checkpoint();
+		~Checkpoint();
+
+		// Maps a checkpoint file and checks its header, size and checksum.
+		// Returns false, with the reason in getError(), if it cannot be
+		// mapped or is not a valid checkpoint.
+		bool open(const char *fileName);
+
+		// Unmaps the file
+		void close();
+
+		// Get methods. Valid only after open() has succeeded.
+		const CheckpointHeader &header() const { return *reinterpret_cast<const CheckpointHeader *>(data); }
+		const void *array(Array a) const { return data + arrayOffset(a, header().numBalls, header().scalarSize); }
+
+		// Reason the last open() or write() failed
+		const char *getError() const { return error; }
+
+		// Writes a checkpoint file in one pass. h gives everything but magic,
+		// version, byteOrder, headerSize, fileSize and checksum, which are
+		// filled in. arrays[a] points to array a, with h.numBalls elements.
+		bool write(const char *fileName, const CheckpointHeader &h, const void *const arrays[NUM_ARRAYS]);
+
+		// Offset of array a from the start of a file of n balls with scalars
+		// of scalarSize bytes. arrayOffset(NUM_ARRAYS, ...) is the file size.
+		static uint64_t arrayOffset(int a, uint64_t n, uint32_t scalarSize);
+
+		// Checksum of size bytes (a multiple of 8) at p, continuing from
+		// the checksum h of the bytes before them. Start with h = CHECKSUM_SEED.
+		static uint64_t checksum(uint64_t h, const void *p, std::size_t size);
+
+	private:
+		const unsigned char *data; // Start of the mapped file, or 0
+		std::size_t size; // Size of the mapping
+		const char *error;
+#ifdef _WIN32
+		void *fileHandle;
+		void *mappingHandle;
+#endif
+
+		// Not copyable: the mapping belongs to one object
+		Checkpoint(const Checkpoint &);
+		Checkpoint &operator=(const Checkpoint &);
+
+		// Size in bytes of an element of array a
+		static uint32_t elementSize(int a, uint32_t scalarSize);
+
+		// Checksum of header h with its checksum field taken as 0, to
+		// continue with the arrays
+		static uint64_t headerChecksum(const CheckpointHeader &h);
+};
+
+#endif
@@ -1,60 +1,84 @@
-// collision.cpp version 1.0
+// collision.cpp version 1.2
 // Implementation of collision functions.
 // Copyright 2006 Chad Berchek
 // See collision.h for documentation of what these functions do.
+// Revisions:
+//   1.1:
+//     - functions are templates on the ball type, explicitly instantiated below
+//   1.2:
+//     - calculations are done in the scalar type of the balls, with a contact tolerance
+//       for overlapping balls (see collision.h)
 
 #include "collision.h"
 #include "vector2d.h"
 #include "walls.h"
 #include "ball.h"
+#include "ballstore.h"
+#include "scalar.h"
 #include <cmath>
 using namespace std;
 
 // Utility function to compute x squared
-inline double square(double x) { return x * x; }
+template <class T> inline T square(T x) { return x * x; }
 
-Collision findTimeUntilTwoBallsCollide(const Ball &b1, const Ball &b2) {
-	Collision clsn;
+// Time t until a ball moving at velocity v along one axis reaches a wall. If
+// the ball is already past the wall (t < 0) by less than the contact
+// tolerance times its radius r, it is in contact now and the time is 0.
+template <class T> inline T wallContactTime(T t, T v, T r) {
+	if (t < 0 && -t * fabs(v) <= ScalarTraits<T>::contactTolerance() * r) return 0;
+	return t;
+}
+
+template <class B> CollisionT<typename B::Scalar> findTimeUntilTwoBallsCollide(const B &b1, const B &b2) {
+	typedef typename B::Scalar T;
+	CollisionT<T> clsn;
 	
 	// Compute parts of quadratic formula
 	// a = (v2x - v1x) ^ 2 + (v2y - v1y) ^ 2
-	double a = square(b2.vx() - b1.vx()) + square(b2.vy() - b1.vy());
+	T a = square(b2.vx() - b1.vx()) + square(b2.vy() - b1.vy());
 	// b = 2 * ((x20 - x10) * (v2x - v1x) + (y20 - y10) * (v2y - v1y))
-	double b = 2. * ((b2.x() - b1.x()) * (b2.vx() - b1.vx()) + (b2.y() - b1.y()) * (b2.vy() - b1.vy()));
+	T b = T(2) * ((b2.x() - b1.x()) * (b2.vx() - b1.vx()) + (b2.y() - b1.y()) * (b2.vy() - b1.vy()));
 	// c = (x20 - x10) ^ 2 + (y20 - y10) ^ 2 - (r1 + r2) ^ 2
-	double c = square(b2.x() - b1.x()) + square(b2.y() - b1.y()) - square(b1.r() + b2.r());
+	T rs = b1.r() + b2.r();
+	T c = square(b2.x() - b1.x()) + square(b2.y() - b1.y()) - square(rs);
 	
 	// Determinant = b^2 - 4ac
-	double det = square(b) - 4 * a * c;
+	T det = square(b) - T(4) * a * c;
 	
-	if (a != 0.) { // If a == 0 then v2x==v1x and v2y==v1y and there will be no collision
-		double t = (-b - sqrt(det)) / (2. * a); // Quadratic formula. t = time to collision
-		if (t >= 0.) { // If collision occurs...
+	if (a != 0) { // If a == 0 then v2x==v1x and v2y==v1y and there will be no collision
+		T t = (-b - sqrt(det)) / (T(2) * a); // Quadratic formula. t = time to collision
+		if (t >= 0) { // If collision occurs...
 			clsn.setCollisionWithBall(t);
 		}
+		else if (c < 0 && b < 0 && c > -ScalarTraits<T>::contactTolerance() * square(rs)) {
+			// Overlapping slightly (c < 0) and approaching (b < 0): in contact now
+			clsn.setCollisionWithBall(0);
+		}
 	}
 	
 	return clsn;
 }
 
-Collision findTimeUntilBallCollidesWithWall(const Ball &b, const Walls &w) {
-	double timeToCollision = 0.;
+template <class B>
+CollisionT<typename B::Scalar> findTimeUntilBallCollidesWithWall(const B &b, const WallsT<typename B::Scalar> &w) {
+	typedef typename B::Scalar T;
+	T timeToCollision = 0;
 	Walls::Wall whichWall = Walls::NONE;
-	Collision clsn;
+	CollisionT<T> clsn;
 	
 	// Check for collision with wall X1
-	if (b.vx() < 0.) {
-		double t = (b.r() - b.x() + w.x1()) / b.vx();
-		if (t >= 0.) { // If t < 0 then ball is headed away from wall
+	if (b.vx() < 0) {
+		T t = wallContactTime((b.r() - b.x() + w.x1()) / b.vx(), b.vx(), b.r());
+		if (t >= 0) { // If t < 0 then ball is headed away from wall
 			timeToCollision = t;
 			whichWall = Walls::X1;
 		}
 	}
 	
 	// Check for collision with wall Y1
-	if (b.vy() < 0.) {
-		double t = (b.r() - b.y() + w.y1()) / b.vy();
-		if (t >= 0.) {
+	if (b.vy() < 0) {
+		T t = wallContactTime((b.r() - b.y() + w.y1()) / b.vy(), b.vy(), b.r());
+		if (t >= 0) {
 			if (whichWall == Walls::NONE || t < timeToCollision) {
 				timeToCollision = t;
 				whichWall = Walls::Y1;
@@ -63,9 +87,9 @@ Collision findTimeUntilBallCollidesWithWall(const Ball &b, const Walls &w) {
 	}
 	
 	// Check for collision with wall X2
-	if (b.vx() > 0.) {
-		double t = (w.x2() - b.r() - b.x()) / b.vx();
-		if (t >= 0.) {
+	if (b.vx() > 0) {
+		T t = wallContactTime((w.x2() - b.r() - b.x()) / b.vx(), b.vx(), b.r());
+		if (t >= 0) {
 			if (whichWall == Walls::NONE || t < timeToCollision) {
 				timeToCollision = t;
 				whichWall = Walls::X2;
@@ -74,9 +98,9 @@ Collision findTimeUntilBallCollidesWithWall(const Ball &b, const Walls &w) {
 	}
 	
 	// Check for collision with wall Y2
-	if (b.vy() > 0.) {
-		double t = (w.y2() - b.r() - b.y()) / b.vy();
-		if (t >= 0.) {
+	if (b.vy() > 0) {
+		T t = wallContactTime((w.y2() - b.r() - b.y()) / b.vy(), b.vy(), b.r());
+		if (t >= 0) {
 			if (whichWall == Walls::NONE || t < timeToCollision) {
 				timeToCollision = t;
 				whichWall = Walls::Y2;
@@ -92,36 +116,38 @@ Collision findTimeUntilBallCollidesWithWall(const Ball &b, const Walls &w) {
 	return clsn;
 }
 
-void doElasticCollisionTwoBalls(Ball &b1, Ball &b2) {
+template <class B> void doElasticCollisionTwoBalls(B &b1, B &b2) {
+	typedef typename B::Scalar T;
+	
 	// Avoid division by zero below in computing new normal velocities
 	// Doing a collision where both balls have no mass makes no sense anyway
-	if (b1.m() == 0. && b2.m() == 0.) return;
+	if (b1.m() == 0 && b2.m() == 0) return;
 
 	// Compute unit normal and unit tangent vectors
-	Vector2D v_n = b2.pos() - b1.pos(); // v_n = normal vec. - a vector normal to the collision surface
-	Vector2D v_un = v_n.unitVector(); // unit normal vector
-	Vector2D v_ut(-v_un.y(), v_un.x()); // unit tangent vector
+	Vector2DT<T> v_n = b2.pos() - b1.pos(); // v_n = normal vec. - a vector normal to the collision surface
+	Vector2DT<T> v_un = v_n.unitVector(); // unit normal vector
+	Vector2DT<T> v_ut(-v_un.y(), v_un.x()); // unit tangent vector
 	
 	// Compute scalar projections of velocities onto v_un and v_ut
-	double v1n = v_un * b1.v(); // Dot product
-	double v1t = v_ut * b1.v();
-	double v2n = v_un * b2.v();
-	double v2t = v_ut * b2.v();
+	T v1n = v_un * b1.v(); // Dot product
+	T v1t = v_ut * b1.v();
+	T v2n = v_un * b2.v();
+	T v2t = v_ut * b2.v();
 	
 	// Compute new tangential velocities
-	double v1tPrime = v1t; // Note: in reality, the tangential velocities do not change after the collision
-	double v2tPrime = v2t;
+	T v1tPrime = v1t; // Note: in reality, the tangential velocities do not change after the collision
+	T v2tPrime = v2t;
 	
 	// Compute new normal velocities using one-dimensional elastic collision equations in the normal direction
 	// Division by zero avoided. See early return above.
-	double v1nPrime = (v1n * (b1.m() - b2.m()) + 2. * b2.m() * v2n) / (b1.m() + b2.m());
-	double v2nPrime = (v2n * (b2.m() - b1.m()) + 2. * b1.m() * v1n) / (b1.m() + b2.m());
+	T v1nPrime = (v1n * (b1.m() - b2.m()) + T(2) * b2.m() * v2n) / (b1.m() + b2.m());
+	T v2nPrime = (v2n * (b2.m() - b1.m()) + T(2) * b1.m() * v1n) / (b1.m() + b2.m());
 	
 	// Compute new normal and tangential velocity vectors
-	Vector2D v_v1nPrime = v1nPrime * v_un; // Multiplication by a scalar
-	Vector2D v_v1tPrime = v1tPrime * v_ut;
-	Vector2D v_v2nPrime = v2nPrime * v_un;
-	Vector2D v_v2tPrime = v2tPrime * v_ut;
+	Vector2DT<T> v_v1nPrime = v1nPrime * v_un; // Multiplication by a scalar
+	Vector2DT<T> v_v1tPrime = v1tPrime * v_ut;
+	Vector2DT<T> v_v2nPrime = v2nPrime * v_un;
+	Vector2DT<T> v_v2tPrime = v2tPrime * v_ut;
 	
 	// Set new velocities in x and y coordinates
 	b1.setVX(v_v1nPrime.x() + v_v1tPrime.x());
@@ -130,7 +156,7 @@ void doElasticCollisionTwoBalls(Ball &b1, Ball &b2) {
 	b2.setVY(v_v2nPrime.y() + v_v2tPrime.y());
 }
 
-void doElasticCollisionWithWall(Ball &b, const Walls::Wall w) {
+template <class B> void doElasticCollisionWithWall(B &b, const WallsBase::Wall w) {
 	switch (w) {
 		case (Walls::X1):
 			b.setVX(fabs(b.vx()));
@@ -146,3 +172,21 @@ void doElasticCollisionWithWall(Ball &b, const Walls::Wall w) {
 			break;
 	}
 }
+
+// Explicit instantiations for the ball types in use
+#define INSTANTIATE_COLLISION_FUNCTIONS(T) \
+	template CollisionT<T> findTimeUntilTwoBallsCollide<BallT<T> >(const BallT<T> &b1, const BallT<T> &b2); \
+	template CollisionT<T> findTimeUntilTwoBallsCollide<ConstBallRefT<T> >(const ConstBallRefT<T> &b1, \
+		const ConstBallRefT<T> &b2); \
+	template CollisionT<T> findTimeUntilTwoBallsCollide<BallRefT<T> >(const BallRefT<T> &b1, const BallRefT<T> &b2); \
+	template CollisionT<T> findTimeUntilBallCollidesWithWall<BallT<T> >(const BallT<T> &b, const WallsT<T> &w); \
+	template CollisionT<T> findTimeUntilBallCollidesWithWall<ConstBallRefT<T> >(const ConstBallRefT<T> &b, \
+		const WallsT<T> &w); \
+	template CollisionT<T> findTimeUntilBallCollidesWithWall<BallRefT<T> >(const BallRefT<T> &b, const WallsT<T> &w); \
+	template void doElasticCollisionTwoBalls<BallT<T> >(BallT<T> &b1, BallT<T> &b2); \
+	template void doElasticCollisionTwoBalls<BallRefT<T> >(BallRefT<T> &b1, BallRefT<T> &b2); \
+	template void doElasticCollisionWithWall<BallT<T> >(BallT<T> &b, const WallsBase::Wall w); \
+	template void doElasticCollisionWithWall<BallRefT<T> >(BallRefT<T> &b, const WallsBase::Wall w);
+
+INSTANTIATE_COLLISION_FUNCTIONS(double)
+INSTANTIATE_COLLISION_FUNCTIONS(float)
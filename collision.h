@@ -1,4 +1,4 @@
-// collision.h - version 2.0
+// collision.h - version 2.2
 // A class to describe a collision and functions for detecting
 // and calculating collisions.
 // Copyright 2006 Chad Berchek
@@ -6,26 +6,36 @@
 //   2.0:
 //     - removed Ball and *Ball from this class, along with getBall1() and getBall2()
 //       and removed any method arguments that take Ball
+//   2.1:
+//     - made the collision functions templates on the ball type so they work on
+//       Ball as well as on ConstBallRef / BallRef views of balls in a BallStore
+//   2.2:
+//     - made Collision a template on the scalar type, CollisionT. Collision is CollisionT<SimScalar>.
+//     - the collision time functions work in the scalar type of the balls and treat balls that
+//       overlap by less than ScalarTraits::contactTolerance() as colliding now
 
 #ifndef COLLISION_H
 #define COLLISION_H
 
 #include "walls.h"
 #include "ball.h"
+#include "ballstore.h"
+#include "scalar.h"
 
 // Class to describe a collision. Collisions can be between ball 1 and a wall
 // or between balls 1 and 2, or there may be no collision at all.
-class Collision {
+template <class T>
+class CollisionT {
 	public:
 
 		// Constructors
-		Collision() { reset(); }
+		CollisionT() { reset(); }
 		
 		// Get / set methods
 		// Signal that there will be a collision with a wall
 		// w = which wall it is colliding with (from Walls::Wall enum)
 		// t = time until collision
-		void setCollisionWithWall(const Walls::Wall w, const double t) {
+		void setCollisionWithWall(const WallsBase::Wall w, const T t) {
 			whichWall = w;
 			timeToCollision = t;
 			collisionType = WALL;
@@ -33,17 +43,17 @@ class Collision {
 		
 		// Signal that two balls will collide
 		// t = time until collision
-		void setCollisionWithBall(const double t) {
+		void setCollisionWithBall(const T t) {
 			timeToCollision = t;
 			collisionType = BALL;
-			whichWall = Walls::NONE;
+			whichWall = WallsBase::NONE;
 		}
 		
 		// Clear the current collision settings. Set collision to NONE
 		void reset() {
 			collisionType = NONE;
-			whichWall = Walls::NONE;
-			timeToCollision = 0.;
+			whichWall = WallsBase::NONE;
+			timeToCollision = 0;
 		}
 		
 		// Will there be a collision?
@@ -59,30 +69,43 @@ class Collision {
 		bool ball1HasCollisionWithBall() const { return collisionType == BALL; }
 		
 		// With which wall will there be a collision?
-		Walls::Wall getCollisionWall() const { return whichWall; }
+		WallsBase::Wall getCollisionWall() const { return whichWall; }
 		
-		double getTimeToCollision() const { return timeToCollision; }
+		T getTimeToCollision() const { return timeToCollision; }
 		
 	private:
 		enum Type { NONE, WALL, BALL };
 		Type collisionType;
-		Walls::Wall whichWall;
-		double timeToCollision;
+		WallsBase::Wall whichWall;
+		T timeToCollision;
 };
 
+typedef CollisionT<SimScalar> Collision;
+
+// The functions below accept any ball type B with the get (and, where balls are
+// modified, set) methods of Ball, and do their calculations in B::Scalar.
+// They are instantiated in collision.cpp for BallT, ConstBallRefT and BallRefT
+// of float and double.
+
 // Finds the time until two specified balls collide. If they don't collide,
 // the returned Collision will indicate that. If the balls are overlapping
-// a collision is NOT detected.
+// a collision is NOT detected, unless they are approaching each other and
+// overlap by less than ScalarTraits<B::Scalar>::contactTolerance() (a
+// fraction of the square of the sum of their radii), in which case they
+// collide at time 0. The tolerance is 0 for double.
 // Implemented in collision.cpp
-Collision findTimeUntilTwoBallsCollide(const Ball &b1, const Ball &b2);
+template <class B> CollisionT<typename B::Scalar> findTimeUntilTwoBallsCollide(const B &b1, const B &b2);
 
 // Finds time until specified ball collides with any wall. If they
 // don't collide, the returned Collision indicates that. If there
 // will be collisions with more than one wall, this function returns
 // the earliest collision. IMPORTANT: This function assumes that the
-// ball is bounded within the specified walls.
+// ball is bounded within the specified walls. A ball that is past a wall,
+// moving away from the walls, by less than contactTolerance() times its
+// radius collides with that wall at time 0.
 // Implemented in collision.cpp
-Collision findTimeUntilBallCollidesWithWall(const Ball &b, const Walls &w);
+template <class B>
+CollisionT<typename B::Scalar> findTimeUntilBallCollidesWithWall(const B &b, const WallsT<typename B::Scalar> &w);
 
 // Updates the velocities of b1 and b2 to reflect the effect of an elastic
 // collision between the two. IMPORTANT: This function does NOT check the
@@ -90,7 +113,7 @@ Collision findTimeUntilBallCollidesWithWall(const Ball &b, const Walls &w);
 // assumes that they are. Use findTimeUntilTwoBallsCollide() to see
 // if the balls are colliding.
 // Implemented in collision.cpp
-void doElasticCollisionTwoBalls(Ball &b1, Ball &b2);
+template <class B> void doElasticCollisionTwoBalls(B &b1, B &b2);
 
 // Updates the velocity of the ball to reflect the effect of an elastic
 // collision with a specified wall. IMPORTANT: This function does NOT
@@ -100,6 +123,6 @@ void doElasticCollisionTwoBalls(Ball &b1, Ball &b2);
 // that the ball is within the area specified by the walls and sets
 // the velocities accordingly.
 // Implemented in collision.cpp
-void doElasticCollisionWithWall(Ball &b, const Walls::Wall w);
+template <class B> void doElasticCollisionWithWall(B &b, const WallsBase::Wall w);
 
 #endif
@@ -0,0 +1,100 @@
+// collisionavx2.cpp - version 1.1
+// AVX2 collision kernels. This file must be compiled with AVX2 code
+// generation enabled (-mavx2 or /arch:AVX2) but without fused multiply-add
+// contraction, so the results match the scalar kernels bit for bit. Without
+// AVX2 code generation it provides no kernels.
+// See collisionsimd.h for documentation of functions.
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - added float kernels
+
+#include "collisionsimd.h"
+
+#ifdef __AVX2__
+#include "collisionsimdimpl.h"
+#include <immintrin.h>
+
+// Ops for an AVX register of T
+template <class T> struct Avx2Ops;
+
+// Four doubles
+template <>
+struct Avx2Ops<double> {
+	typedef double S;
+	typedef __m256d V;
+	typedef __m256d M; // All bits set in lanes where the comparison is true
+	enum { width = 4 };
+
+	static V load(const double *p) { return _mm256_loadu_pd(p); }
+	static void store(double *p, V a) { _mm256_storeu_pd(p, a); }
+	static V set1(double a) { return _mm256_set1_pd(a); }
+	static V iota(double base) { return _mm256_setr_pd(base, base + 1., base + 2., base + 3.); }
+	static V add(V a, V b) { return _mm256_add_pd(a, b); }
+	static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+	static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+	static V div(V a, V b) { return _mm256_div_pd(a, b); }
+	static V sqrt(V a) { return _mm256_sqrt_pd(a); }
+	static V neg(V a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.)); }
+	static M lt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+	static M le(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+	static M gt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+	static M ge(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+	static M neq(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_NEQ_UQ); }
+	static M andm(M a, M b) { return _mm256_and_pd(a, b); }
+	static M orm(M a, M b) { return _mm256_or_pd(a, b); }
+	static M notm(M a) { return _mm256_xor_pd(a, _mm256_castsi256_pd(_mm256_set1_epi64x(-1))); }
+	static M falsem() { return _mm256_setzero_pd(); }
+	static V select(M m, V a, V b) { return _mm256_blendv_pd(b, a, m); }
+};
+
+// Eight floats
+template <>
+struct Avx2Ops<float> {
+	typedef float S;
+	typedef __m256 V;
+	typedef __m256 M; // All bits set in lanes where the comparison is true
+	enum { width = 8 };
+
+	static V load(const float *p) { return _mm256_loadu_ps(p); }
+	static void store(float *p, V a) { _mm256_storeu_ps(p, a); }
+	static V set1(float a) { return _mm256_set1_ps(a); }
+	static V iota(float base) {
+		return _mm256_add_ps(_mm256_set1_ps(base), _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f));
+	}
+	static V add(V a, V b) { return _mm256_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm256_div_ps(a, b); }
+	static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+	static V neg(V a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.f)); }
+	static M lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static M le(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static M gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static M ge(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+	static M neq(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+	static M andm(M a, M b) { return _mm256_and_ps(a, b); }
+	static M orm(M a, M b) { return _mm256_or_ps(a, b); }
+	static M notm(M a) { return _mm256_xor_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+	static M falsem() { return _mm256_setzero_ps(); }
+	static V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+};
+
+template <class T>
+const CollisionKernelsT<T> *getAvx2CollisionKernels() {
+	static const CollisionKernelsT<T> kernels = makeCollisionKernels<Avx2Ops<T> >("AVX2");
+	return &kernels;
+}
+
+#else
+
+template <class T>
+const CollisionKernelsT<T> *getAvx2CollisionKernels() {
+	return 0;
+}
+
+#endif
+
+template const CollisionKernelsT<double> *getAvx2CollisionKernels<double>();
+template const CollisionKernelsT<float> *getAvx2CollisionKernels<float>();
@@ -0,0 +1,108 @@
+// collisionavx512.cpp - version 1.1
+// AVX-512 collision kernels. This file must be compiled with AVX-512F code
+// generation enabled (-mavx512f or /arch:AVX512) but without fused
+// multiply-add contraction, so the results match the scalar kernels bit for
+// bit. Without AVX-512F code generation it provides no kernels.
+// See collisionsimd.h for documentation of functions.
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - added float kernels
+
+#include "collisionsimd.h"
+
+#ifdef __AVX512F__
+#include "collisionsimdimpl.h"
+#include <immintrin.h>
+
+// Ops for an AVX-512 register of T
+template <class T> struct Avx512Ops;
+
+// Eight doubles
+template <>
+struct Avx512Ops<double> {
+	typedef double S;
+	typedef __m512d V;
+	typedef __mmask8 M; // One bit per lane
+	enum { width = 8 };
+
+	static V load(const double *p) { return _mm512_loadu_pd(p); }
+	static void store(double *p, V a) { _mm512_storeu_pd(p, a); }
+	static V set1(double a) { return _mm512_set1_pd(a); }
+	static V iota(double base) {
+		return _mm512_add_pd(_mm512_set1_pd(base), _mm512_setr_pd(0., 1., 2., 3., 4., 5., 6., 7.));
+	}
+	static V add(V a, V b) { return _mm512_add_pd(a, b); }
+	static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+	static V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+	static V div(V a, V b) { return _mm512_div_pd(a, b); }
+	static V sqrt(V a) { return _mm512_sqrt_pd(a); }
+	static V neg(V a) {
+		// AVX-512F has no floating point xor, so flip the sign bit as an integer
+		return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a), _mm512_set1_epi64((long long)0x8000000000000000ULL)));
+	}
+	static M lt(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+	static M le(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+	static M gt(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+	static M ge(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+	static M neq(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_NEQ_UQ); }
+	static M andm(M a, M b) { return M(a & b); }
+	static M orm(M a, M b) { return M(a | b); }
+	static M notm(M a) { return M(~a); }
+	static M falsem() { return 0; }
+	static V select(M m, V a, V b) { return _mm512_mask_blend_pd(m, b, a); }
+};
+
+// Sixteen floats
+template <>
+struct Avx512Ops<float> {
+	typedef float S;
+	typedef __m512 V;
+	typedef __mmask16 M; // One bit per lane
+	enum { width = 16 };
+
+	static V load(const float *p) { return _mm512_loadu_ps(p); }
+	static void store(float *p, V a) { _mm512_storeu_ps(p, a); }
+	static V set1(float a) { return _mm512_set1_ps(a); }
+	static V iota(float base) {
+		return _mm512_add_ps(_mm512_set1_ps(base), _mm512_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f,
+			8.f, 9.f, 10.f, 11.f, 12.f, 13.f, 14.f, 15.f));
+	}
+	static V add(V a, V b) { return _mm512_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm512_div_ps(a, b); }
+	static V sqrt(V a) { return _mm512_sqrt_ps(a); }
+	static V neg(V a) {
+		return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_set1_epi32((int)0x80000000U)));
+	}
+	static M lt(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+	static M le(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+	static M gt(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+	static M ge(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+	static M neq(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_NEQ_UQ); }
+	static M andm(M a, M b) { return M(a & b); }
+	static M orm(M a, M b) { return M(a | b); }
+	static M notm(M a) { return M(~a); }
+	static M falsem() { return 0; }
+	static V select(M m, V a, V b) { return _mm512_mask_blend_ps(m, b, a); }
+};
+
+template <class T>
+const CollisionKernelsT<T> *getAvx512CollisionKernels() {
+	static const CollisionKernelsT<T> kernels = makeCollisionKernels<Avx512Ops<T> >("AVX-512");
+	return &kernels;
+}
+
+#else
+
+template <class T>
+const CollisionKernelsT<T> *getAvx512CollisionKernels() {
+	return 0;
+}
+
+#endif
+
+template const CollisionKernelsT<double> *getAvx512CollisionKernels<double>();
+template const CollisionKernelsT<float> *getAvx512CollisionKernels<float>();
@@ -0,0 +1,178 @@
+// collisionsimd.cpp - version 1.1
+// Scalar and SSE2 collision kernels, and selection of the kernels at run time.
+// The AVX2 and AVX-512 kernels are in collisionavx2.cpp and collisionavx512.cpp,
+// which are compiled with the matching compiler options.
+// See collisionsimd.h for documentation of functions.
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - added float kernels
+
+#include "collisionsimd.h"
+#include "collisionsimdimpl.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLLISIONSIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+// Kernels in collisionavx2.cpp and collisionavx512.cpp. They return 0 if
+// the compiler could not build them.
+template <class T> const CollisionKernelsT<T> *getAvx2CollisionKernels();
+template <class T> const CollisionKernelsT<T> *getAvx512CollisionKernels();
+
+#ifdef COLLISIONSIMD_SSE2
+// Ops for an SSE2 register of T
+template <class T> struct Sse2Ops;
+
+// Two doubles
+template <>
+struct Sse2Ops<double> {
+	typedef double S;
+	typedef __m128d V;
+	typedef __m128d M; // All bits set in lanes where the comparison is true
+	enum { width = 2 };
+
+	static V load(const double *p) { return _mm_loadu_pd(p); }
+	static void store(double *p, V a) { _mm_storeu_pd(p, a); }
+	static V set1(double a) { return _mm_set1_pd(a); }
+	static V iota(double base) { return _mm_setr_pd(base, base + 1.); }
+	static V add(V a, V b) { return _mm_add_pd(a, b); }
+	static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+	static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+	static V div(V a, V b) { return _mm_div_pd(a, b); }
+	static V sqrt(V a) { return _mm_sqrt_pd(a); }
+	static V neg(V a) { return _mm_xor_pd(a, _mm_set1_pd(-0.)); }
+	static M lt(V a, V b) { return _mm_cmplt_pd(a, b); }
+	static M le(V a, V b) { return _mm_cmple_pd(a, b); }
+	static M gt(V a, V b) { return _mm_cmpgt_pd(a, b); }
+	static M ge(V a, V b) { return _mm_cmpge_pd(a, b); }
+	static M neq(V a, V b) { return _mm_cmpneq_pd(a, b); }
+	static M andm(M a, M b) { return _mm_and_pd(a, b); }
+	static M orm(M a, M b) { return _mm_or_pd(a, b); }
+	static M notm(M a) { return _mm_xor_pd(a, _mm_castsi128_pd(_mm_set1_epi32(-1))); }
+	static M falsem() { return _mm_setzero_pd(); }
+	static V select(M m, V a, V b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+};
+
+// Four floats
+template <>
+struct Sse2Ops<float> {
+	typedef float S;
+	typedef __m128 V;
+	typedef __m128 M; // All bits set in lanes where the comparison is true
+	enum { width = 4 };
+
+	static V load(const float *p) { return _mm_loadu_ps(p); }
+	static void store(float *p, V a) { _mm_storeu_ps(p, a); }
+	static V set1(float a) { return _mm_set1_ps(a); }
+	static V iota(float base) { return _mm_setr_ps(base, base + 1.f, base + 2.f, base + 3.f); }
+	static V add(V a, V b) { return _mm_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm_div_ps(a, b); }
+	static V sqrt(V a) { return _mm_sqrt_ps(a); }
+	static V neg(V a) { return _mm_xor_ps(a, _mm_set1_ps(-0.f)); }
+	static M lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+	static M le(V a, V b) { return _mm_cmple_ps(a, b); }
+	static M gt(V a, V b) { return _mm_cmpgt_ps(a, b); }
+	static M ge(V a, V b) { return _mm_cmpge_ps(a, b); }
+	static M neq(V a, V b) { return _mm_cmpneq_ps(a, b); }
+	static M andm(M a, M b) { return _mm_and_ps(a, b); }
+	static M orm(M a, M b) { return _mm_or_ps(a, b); }
+	static M notm(M a) { return _mm_xor_ps(a, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+	static M falsem() { return _mm_setzero_ps(); }
+	static V select(M m, V a, V b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+};
+#endif
+
+// Does the CPU (and operating system) support the instruction set?
+static bool cpuSupports(SimdLevel level) {
+	switch (level) {
+		case SIMD_SCALAR:
+			return true;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+		case SIMD_SSE2:
+			return __builtin_cpu_supports("sse2");
+		case SIMD_AVX2:
+			return __builtin_cpu_supports("avx2");
+		case SIMD_AVX512:
+			return __builtin_cpu_supports("avx512f");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		case SIMD_SSE2:
+		{
+			int info[4];
+			__cpuid(info, 1);
+			return (info[3] & (1 << 26)) != 0;
+		}
+		case SIMD_AVX2:
+		case SIMD_AVX512:
+		{
+			int info[4];
+			__cpuid(info, 1);
+			if ((info[2] & (1 << 27)) == 0) return false; // No OSXSAVE, so no AVX state
+			unsigned long long xcr0 = _xgetbv(0);
+			__cpuidex(info, 7, 0);
+			if (level == SIMD_AVX2) return (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+			return (xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)) != 0;
+		}
+#endif
+		default:
+			return false;
+	}
+}
+
+// Kernels of T for a level, or 0 if this build has none
+template <class T>
+static const CollisionKernelsT<T> *kernelsForLevel(SimdLevel level) {
+	static const CollisionKernelsT<T> scalarKernels = makeCollisionKernels<ScalarOps<T> >("scalar");
+#ifdef COLLISIONSIMD_SSE2
+	static const CollisionKernelsT<T> sse2Kernels = makeCollisionKernels<Sse2Ops<T> >("SSE2");
+#endif
+	switch (level) {
+		case SIMD_SCALAR:
+			return &scalarKernels;
+#ifdef COLLISIONSIMD_SSE2
+		case SIMD_SSE2:
+			return &sse2Kernels;
+#endif
+		case SIMD_AVX2:
+			return getAvx2CollisionKernels<T>();
+		case SIMD_AVX512:
+			return getAvx512CollisionKernels<T>();
+		default:
+			return 0;
+	}
+}
+
+// Best available level that is at most maxLevel
+static SimdLevel bestLevel(SimdLevel maxLevel) {
+	for (int level = maxLevel; level > SIMD_SCALAR; level--) {
+		if (kernelsForLevel<double>(SimdLevel(level)) != 0 && cpuSupports(SimdLevel(level))) return SimdLevel(level);
+	}
+	return SIMD_SCALAR;
+}
+
+static SimdLevel currentLevel = bestLevel(SIMD_AVX512);
+
+template <class T>
+const CollisionKernelsT<T> &getCollisionKernels() {
+	return *kernelsForLevel<T>(currentLevel);
+}
+
+template const CollisionKernelsT<double> &getCollisionKernels<double>();
+template const CollisionKernelsT<float> &getCollisionKernels<float>();
+
+SimdLevel getMaxSimdLevel() {
+	return bestLevel(SIMD_AVX512);
+}
+
+SimdLevel setSimdLevel(SimdLevel level) {
+	currentLevel = bestLevel(level);
+	return currentLevel;
+}
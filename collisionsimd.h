@@ -0,0 +1,82 @@
+// collisionsimd.h - version 1.1
+// Batched versions of findTimeUntilTwoBallsCollide() and
+// findTimeUntilBallCollidesWithWall() that test a block of balls at a time
+// with SIMD instructions. The instruction set (SSE2, AVX2 or AVX-512) is
+// chosen at run time according to what the CPU supports. There are kernels
+// for float and for double; float kernels test twice as many balls at once.
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - made BallArrays and CollisionKernels templates on the scalar type and added float kernels
+
+#ifndef COLLISIONSIMD_H
+#define COLLISIONSIMD_H
+
+#include "walls.h"
+#include "scalar.h"
+
+// The arrays a batched kernel reads. x, y, vx, vy and r are the arrays of a
+// BallStore. t[i] is the time to which the position of ball i refers; a
+// ball's position is moved along its velocity to the time of the other ball
+// before two balls are compared, exactly as BallsSim does in its scalar code.
+template <class T>
+struct BallArraysT {
+	const T *x;
+	const T *y;
+	const T *vx;
+	const T *vy;
+	const T *r;
+	const T *t;
+};
+
+typedef BallArraysT<SimScalar> BallArrays;
+
+// Table of kernel functions for one instruction set. All kernels give
+// bit-for-bit the same results as the scalar functions in collision.cpp:
+// they do the same floating point operations in the same order.
+template <class T>
+struct CollisionKernelsT {
+	// Name of the instruction set, for reporting
+	const char *name;
+
+	// For each ball j in [j0, j1), sets out[j - j0] to the absolute time at
+	// which balls i and j collide, or to +infinity if they do not.
+	void (*twoBallsTimes)(const BallArraysT<T> &a, unsigned long i, unsigned long j0, unsigned long j1, T *out);
+
+	// Finds the ball j in [j0, j1) that collides earliest with ball i before
+	// absolute time horizon. Returns false if there is none. Ties go to the
+	// lowest j.
+	bool (*earliestTwoBalls)(const BallArraysT<T> &a, unsigned long i, unsigned long j0, unsigned long j1, T horizon,
+		T &tOut, unsigned long &jOut);
+
+	// For each ball i in [i0, i1), sets tOut[i - i0] to the absolute time at
+	// which it collides with one of the walls, or to +infinity if it does not,
+	// and wallOut[i - i0] to the wall (Walls::NONE if no collision).
+	void (*wallTimes)(const BallArraysT<T> &a, const WallsT<T> &w, unsigned long i0, unsigned long i1, T *tOut,
+		WallsBase::Wall *wallOut);
+
+	// Finds the ball i in [i0, i1) that collides earliest with a wall before
+	// absolute time horizon. Returns false if there is none. Ties go to the
+	// lowest i.
+	bool (*earliestWall)(const BallArraysT<T> &a, const WallsT<T> &w, unsigned long i0, unsigned long i1, T horizon,
+		T &tOut, unsigned long &iOut, WallsBase::Wall &wallOut);
+};
+
+typedef CollisionKernelsT<SimScalar> CollisionKernels;
+
+// Instruction sets for which kernels exist
+enum SimdLevel { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512 };
+
+// Kernels for the best instruction set supported by this CPU, or for the
+// level set with setSimdLevel(). T is float or double.
+template <class T> const CollisionKernelsT<T> &getCollisionKernels();
+
+// Best instruction set supported by both this build and this CPU
+SimdLevel getMaxSimdLevel();
+
+// Restricts the kernels to at most the given instruction set (for testing
+// and benchmarking). Returns the level actually selected.
+SimdLevel setSimdLevel(SimdLevel level);
+
+#endif
@@ -0,0 +1,385 @@
+// collisionsimdimpl.h - version 1.1
+// Kernel templates for collisionsimd.h. Each kernel is written once in terms
+// of an "Ops" class that wraps the vector type and instructions of one
+// instruction set and scalar type; the .cpp file for that instruction set
+// instantiates them. Only include this from the collisionsimd / collision*.cpp
+// files.
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - kernels are generic in the scalar type Ops::S, for float kernels
+//     - added the contact tolerance of the collision functions (see scalar.h)
+//     - lanes hold indices relative to the start of ranges of at most
+//       MAX_LANE_RANGE balls, so float lanes count them exactly
+
+#ifndef COLLISIONSIMDIMPL_H
+#define COLLISIONSIMDIMPL_H
+
+#include "collisionsimd.h"
+#include "walls.h"
+#include "scalar.h"
+#include <cmath>
+#include <limits>
+
+// Ops for plain scalars, used for the remainder of a block that does not
+// fill a whole vector and on CPUs without SIMD support.
+template <class T>
+struct ScalarOps {
+	typedef T S; // Scalar type
+	typedef T V; // Vector of scalars
+	typedef bool M; // Mask, the result of a comparison
+	enum { width = 1 };
+
+	static V load(const S *p) { return *p; }
+	static void store(S *p, V a) { *p = a; }
+	static V set1(S a) { return a; }
+	static V iota(S base) { return base; } // base, base + 1, ... in each lane
+	static V add(V a, V b) { return a + b; }
+	static V sub(V a, V b) { return a - b; }
+	static V mul(V a, V b) { return a * b; }
+	static V div(V a, V b) { return a / b; }
+	static V sqrt(V a) { return std::sqrt(a); }
+	static V neg(V a) { return -a; }
+	static M lt(V a, V b) { return a < b; }
+	static M le(V a, V b) { return a <= b; }
+	static M gt(V a, V b) { return a > b; }
+	static M ge(V a, V b) { return a >= b; }
+	static M neq(V a, V b) { return a != b; }
+	static M andm(M a, M b) { return a && b; }
+	static M orm(M a, M b) { return a || b; }
+	static M notm(M a) { return !a; }
+	static M falsem() { return false; }
+	static V select(M m, V a, V b) { return m ? a : b; } // a where m is set, b elsewhere
+};
+
+// Longest range of balls searched with lane indices relative to one start.
+// A float holds every integer up to 2^24 exactly.
+const unsigned long MAX_LANE_RANGE = 1ul << 24;
+
+// Time from the later of the two balls' times until balls 1 and 2 collide,
+// as in findTimeUntilTwoBallsCollide(). hit is set in the lanes where they do.
+template <class Ops>
+inline typename Ops::V twoBallsTime(typename Ops::V x1, typename Ops::V y1, typename Ops::V vx1, typename Ops::V vy1,
+	typename Ops::V r1, typename Ops::V x2, typename Ops::V y2, typename Ops::V vx2, typename Ops::V vy2,
+	typename Ops::V r2, typename Ops::M &hit) {
+	typedef typename Ops::S S;
+	typedef typename Ops::V V;
+	V dvx = Ops::sub(vx2, vx1);
+	V dvy = Ops::sub(vy2, vy1);
+	V dx = Ops::sub(x2, x1);
+	V dy = Ops::sub(y2, y1);
+	V rs = Ops::add(r1, r2);
+	// a = (v2x - v1x) ^ 2 + (v2y - v1y) ^ 2
+	V a = Ops::add(Ops::mul(dvx, dvx), Ops::mul(dvy, dvy));
+	// b = 2 * ((x20 - x10) * (v2x - v1x) + (y20 - y10) * (v2y - v1y))
+	V b = Ops::mul(Ops::set1(S(2)), Ops::add(Ops::mul(dx, dvx), Ops::mul(dy, dvy)));
+	// c = (x20 - x10) ^ 2 + (y20 - y10) ^ 2 - (r1 + r2) ^ 2
+	V c = Ops::sub(Ops::add(Ops::mul(dx, dx), Ops::mul(dy, dy)), Ops::mul(rs, rs));
+	// Determinant = b^2 - 4ac
+	V det = Ops::sub(Ops::mul(b, b), Ops::mul(Ops::mul(Ops::set1(S(4)), a), c));
+	V t = Ops::div(Ops::sub(Ops::neg(b), Ops::sqrt(det)), Ops::mul(Ops::set1(S(2)), a));
+	// No collision if a == 0, and none if t < 0 or t is NaN (det < 0)
+	V zero = Ops::set1(S(0));
+	typename Ops::M moving = Ops::neq(a, zero);
+	hit = Ops::andm(moving, Ops::ge(t, zero));
+	if (ScalarTraits<S>::contactTolerance() > 0) {
+		// Overlapping by less than the tolerance (c < 0) and approaching
+		// (b < 0): the balls are in contact now
+		V minC = Ops::mul(Ops::set1(-ScalarTraits<S>::contactTolerance()), Ops::mul(rs, rs));
+		typename Ops::M contact = Ops::andm(Ops::andm(moving, Ops::notm(hit)),
+			Ops::andm(Ops::andm(Ops::lt(c, zero), Ops::lt(b, zero)), Ops::gt(c, minC)));
+		t = Ops::select(contact, zero, t);
+		hit = Ops::orm(hit, contact);
+	}
+	return t;
+}
+
+// Absolute collision times of ball i with Ops::width balls starting at j
+template <class Ops>
+inline typename Ops::V twoBallsTimeAt(const BallArraysT<typename Ops::S> &a, unsigned long i, unsigned long j,
+	typename Ops::M &hit) {
+	typedef typename Ops::V V;
+	V ti = Ops::set1(a.t[i]);
+	V tj = Ops::load(a.t + j);
+	V tRef = Ops::select(Ops::gt(ti, tj), ti, tj);
+	V vxi = Ops::set1(a.vx[i]);
+	V vyi = Ops::set1(a.vy[i]);
+	V vxj = Ops::load(a.vx + j);
+	V vyj = Ops::load(a.vy + j);
+	// Move both balls to the later of their times
+	V dti = Ops::sub(tRef, ti);
+	V dtj = Ops::sub(tRef, tj);
+	V xi = Ops::add(Ops::set1(a.x[i]), Ops::mul(vxi, dti));
+	V yi = Ops::add(Ops::set1(a.y[i]), Ops::mul(vyi, dti));
+	V xj = Ops::add(Ops::load(a.x + j), Ops::mul(vxj, dtj));
+	V yj = Ops::add(Ops::load(a.y + j), Ops::mul(vyj, dtj));
+	V t = twoBallsTime<Ops>(xi, yi, vxi, vyi, Ops::set1(a.r[i]), xj, yj, vxj, vyj, Ops::load(a.r + j), hit);
+	return Ops::add(tRef, t);
+}
+
+// Collision time with the walls of Ops::width balls starting at i, as in
+// findTimeUntilBallCollidesWithWall(). wall gets the Walls::Wall values.
+template <class Ops>
+inline typename Ops::V wallTime(const BallArraysT<typename Ops::S> &a, const WallsT<typename Ops::S> &w,
+	unsigned long i, typename Ops::M &found, typename Ops::V &wall) {
+	typedef typename Ops::S S;
+	typedef typename Ops::V V;
+	typedef typename Ops::M M;
+	V x = Ops::load(a.x + i);
+	V y = Ops::load(a.y + i);
+	V vx = Ops::load(a.vx + i);
+	V vy = Ops::load(a.vy + i);
+	V r = Ops::load(a.r + i);
+	V zero = Ops::set1(S(0));
+	V best = zero;
+	wall = Ops::set1(S(WallsBase::NONE));
+	found = Ops::falsem();
+
+	// Candidate times for walls X1, Y1, X2 and Y2, in the order the scalar
+	// function checks them
+	V t[4];
+	M moving[4];
+	t[0] = Ops::div(Ops::add(Ops::sub(r, x), Ops::set1(w.x1())), vx);
+	moving[0] = Ops::lt(vx, zero);
+	t[1] = Ops::div(Ops::add(Ops::sub(r, y), Ops::set1(w.y1())), vy);
+	moving[1] = Ops::lt(vy, zero);
+	t[2] = Ops::div(Ops::sub(Ops::sub(Ops::set1(w.x2()), r), x), vx);
+	moving[2] = Ops::gt(vx, zero);
+	t[3] = Ops::div(Ops::sub(Ops::sub(Ops::set1(w.y2()), r), y), vy);
+	moving[3] = Ops::gt(vy, zero);
+	const WallsBase::Wall which[4] = { WallsBase::X1, WallsBase::Y1, WallsBase::X2, WallsBase::Y2 };
+
+	if (ScalarTraits<S>::contactTolerance() > 0) {
+		// A ball past a wall by no more than the tolerance times its radius
+		// is in contact with it now
+		V speedX = Ops::select(Ops::lt(vx, zero), Ops::neg(vx), vx);
+		V speedY = Ops::select(Ops::lt(vy, zero), Ops::neg(vy), vy);
+		V maxDepth = Ops::mul(Ops::set1(ScalarTraits<S>::contactTolerance()), r);
+		for (int k = 0; k < 4; k++) {
+			V depth = Ops::mul(Ops::neg(t[k]), k % 2 == 0 ? speedX : speedY);
+			t[k] = Ops::select(Ops::andm(Ops::lt(t[k], zero), Ops::le(depth, maxDepth)), zero, t[k]);
+		}
+	}
+
+	for (int k = 0; k < 4; k++) {
+		// If t < 0 then ball is headed away from wall
+		M take = Ops::andm(Ops::andm(moving[k], Ops::ge(t[k], zero)), Ops::orm(Ops::notm(found), Ops::lt(t[k], best)));
+		best = Ops::select(take, t[k], best);
+		wall = Ops::select(take, Ops::set1(S(which[k])), wall);
+		found = Ops::orm(found, take);
+	}
+	return Ops::add(Ops::load(a.t + i), best);
+}
+
+template <class Ops>
+void twoBallsTimesKernel(const BallArraysT<typename Ops::S> &a, unsigned long i, unsigned long j0, unsigned long j1,
+	typename Ops::S *out) {
+	typedef typename Ops::S S;
+	const S inf = std::numeric_limits<S>::infinity();
+	unsigned long j = j0;
+	for (; j + Ops::width <= j1; j += Ops::width) {
+		typename Ops::M hit;
+		typename Ops::V t = twoBallsTimeAt<Ops>(a, i, j, hit);
+		Ops::store(out + (j - j0), Ops::select(hit, t, Ops::set1(inf)));
+	}
+	for (; j < j1; j++) {
+		bool hit;
+		S t = twoBallsTimeAt<ScalarOps<S> >(a, i, j, hit);
+		out[j - j0] = hit ? t : inf;
+	}
+}
+
+// Picks the lane with the lowest time, lowest index on ties
+template <class Ops>
+inline bool reduceLanes(typename Ops::V best, typename Ops::V bestIndex, bool found, typename Ops::S &tOut,
+	typename Ops::S &indexOut) {
+	typedef typename Ops::S S;
+	S t[Ops::width];
+	S index[Ops::width];
+	Ops::store(t, best);
+	Ops::store(index, bestIndex);
+	for (int k = 0; k < Ops::width; k++) {
+		if (t[k] == std::numeric_limits<S>::infinity()) continue; // Lane found nothing
+		if (!found || t[k] < tOut || (t[k] == tOut && index[k] < indexOut)) {
+			tOut = t[k];
+			indexOut = index[k];
+			found = true;
+		}
+	}
+	return found;
+}
+
+// earliestTwoBallsKernel() for a range of at most MAX_LANE_RANGE balls
+template <class Ops>
+bool earliestTwoBallsRange(const BallArraysT<typename Ops::S> &a, unsigned long i, unsigned long j0, unsigned long j1,
+	typename Ops::S horizon, typename Ops::S &tOut, unsigned long &jOut) {
+	typedef typename Ops::S S;
+	typedef typename Ops::V V;
+	const S inf = std::numeric_limits<S>::infinity();
+	V best = Ops::set1(inf);
+	V bestIndex = Ops::set1(S(0));
+	V h = Ops::set1(horizon);
+	unsigned long j = j0;
+	for (; j + Ops::width <= j1; j += Ops::width) {
+		typename Ops::M hit;
+		V t = twoBallsTimeAt<Ops>(a, i, j, hit);
+		typename Ops::M take = Ops::andm(Ops::andm(hit, Ops::lt(t, h)), Ops::lt(t, best));
+		best = Ops::select(take, t, best);
+		bestIndex = Ops::select(take, Ops::iota(S(j - j0)), bestIndex);
+	}
+	S t = inf;
+	S index = 0;
+	bool found = reduceLanes<Ops>(best, bestIndex, false, t, index);
+	for (; j < j1; j++) {
+		bool hit;
+		S tj = twoBallsTimeAt<ScalarOps<S> >(a, i, j, hit);
+		if (hit && tj < horizon && (!found || tj < t)) {
+			t = tj;
+			index = S(j - j0);
+			found = true;
+		}
+	}
+	if (found) {
+		tOut = t;
+		jOut = j0 + (unsigned long)index;
+	}
+	return found;
+}
+
+template <class Ops>
+bool earliestTwoBallsKernel(const BallArraysT<typename Ops::S> &a, unsigned long i, unsigned long j0, unsigned long j1,
+	typename Ops::S horizon, typename Ops::S &tOut, unsigned long &jOut) {
+	bool found = false;
+	for (unsigned long jb = j0; jb < j1; jb += MAX_LANE_RANGE) {
+		unsigned long je = j1 - jb > MAX_LANE_RANGE ? jb + MAX_LANE_RANGE : j1;
+		typename Ops::S t;
+		unsigned long j;
+		// Ranges are searched in order, so ties still go to the lowest j
+		if (earliestTwoBallsRange<Ops>(a, i, jb, je, horizon, t, j) && (!found || t < tOut)) {
+			tOut = t;
+			jOut = j;
+			found = true;
+		}
+	}
+	return found;
+}
+
+template <class Ops>
+void wallTimesKernel(const BallArraysT<typename Ops::S> &a, const WallsT<typename Ops::S> &w, unsigned long i0,
+	unsigned long i1, typename Ops::S *tOut, WallsBase::Wall *wallOut) {
+	typedef typename Ops::S S;
+	const S inf = std::numeric_limits<S>::infinity();
+	unsigned long i = i0;
+	for (; i + Ops::width <= i1; i += Ops::width) {
+		typename Ops::M found;
+		typename Ops::V wall;
+		typename Ops::V t = wallTime<Ops>(a, w, i, found, wall);
+		Ops::store(tOut + (i - i0), Ops::select(found, t, Ops::set1(inf)));
+		S walls[Ops::width];
+		Ops::store(walls, wall);
+		for (int k = 0; k < Ops::width; k++) {
+			wallOut[i - i0 + k] = WallsBase::Wall(int(walls[k]));
+		}
+	}
+	for (; i < i1; i++) {
+		bool found;
+		S wall;
+		S t = wallTime<ScalarOps<S> >(a, w, i, found, wall);
+		tOut[i - i0] = found ? t : inf;
+		wallOut[i - i0] = WallsBase::Wall(int(wall));
+	}
+}
+
+// earliestWallKernel() for a range of at most MAX_LANE_RANGE balls
+template <class Ops>
+bool earliestWallRange(const BallArraysT<typename Ops::S> &a, const WallsT<typename Ops::S> &w, unsigned long i0,
+	unsigned long i1, typename Ops::S horizon, typename Ops::S &tOut, unsigned long &iOut, WallsBase::Wall &wallOut) {
+	typedef typename Ops::S S;
+	typedef typename Ops::V V;
+	const S inf = std::numeric_limits<S>::infinity();
+	V best = Ops::set1(inf);
+	V bestIndex = Ops::set1(S(0));
+	V bestWall = Ops::set1(S(WallsBase::NONE));
+	V h = Ops::set1(horizon);
+	unsigned long i = i0;
+	for (; i + Ops::width <= i1; i += Ops::width) {
+		typename Ops::M found;
+		V wall;
+		V t = wallTime<Ops>(a, w, i, found, wall);
+		typename Ops::M take = Ops::andm(Ops::andm(found, Ops::lt(t, h)), Ops::lt(t, best));
+		best = Ops::select(take, t, best);
+		bestIndex = Ops::select(take, Ops::iota(S(i - i0)), bestIndex);
+		bestWall = Ops::select(take, wall, bestWall);
+	}
+	// Reduce the lanes, keeping track of the wall of the winning lane
+	S t[Ops::width];
+	S index[Ops::width];
+	S walls[Ops::width];
+	Ops::store(t, best);
+	Ops::store(index, bestIndex);
+	Ops::store(walls, bestWall);
+	bool found = false;
+	S tBest = inf;
+	S iBest = 0;
+	S wBest = S(WallsBase::NONE);
+	for (int k = 0; k < Ops::width; k++) {
+		if (t[k] == inf) continue;
+		if (!found || t[k] < tBest || (t[k] == tBest && index[k] < iBest)) {
+			tBest = t[k];
+			iBest = index[k];
+			wBest = walls[k];
+			found = true;
+		}
+	}
+	for (; i < i1; i++) {
+		bool hit;
+		S wall;
+		S ti = wallTime<ScalarOps<S> >(a, w, i, hit, wall);
+		if (hit && ti < horizon && (!found || ti < tBest)) {
+			tBest = ti;
+			iBest = S(i - i0);
+			wBest = wall;
+			found = true;
+		}
+	}
+	if (found) {
+		tOut = tBest;
+		iOut = i0 + (unsigned long)iBest;
+		wallOut = WallsBase::Wall(int(wBest));
+	}
+	return found;
+}
+
+template <class Ops>
+bool earliestWallKernel(const BallArraysT<typename Ops::S> &a, const WallsT<typename Ops::S> &w, unsigned long i0,
+	unsigned long i1, typename Ops::S horizon, typename Ops::S &tOut, unsigned long &iOut, WallsBase::Wall &wallOut) {
+	bool found = false;
+	for (unsigned long ib = i0; ib < i1; ib += MAX_LANE_RANGE) {
+		unsigned long ie = i1 - ib > MAX_LANE_RANGE ? ib + MAX_LANE_RANGE : i1;
+		typename Ops::S t;
+		unsigned long i;
+		WallsBase::Wall wall;
+		if (earliestWallRange<Ops>(a, w, ib, ie, horizon, t, i, wall) && (!found || t < tOut)) {
+			tOut = t;
+			iOut = i;
+			wallOut = wall;
+			found = true;
+		}
+	}
+	return found;
+}
+
+// Fills in a kernel table with the kernels for Ops
+template <class Ops>
+CollisionKernelsT<typename Ops::S> makeCollisionKernels(const char *name) {
+	CollisionKernelsT<typename Ops::S> k;
+	k.name = name;
+	k.twoBallsTimes = twoBallsTimesKernel<Ops>;
+	k.earliestTwoBalls = earliestTwoBallsKernel<Ops>;
+	k.wallTimes = wallTimesKernel<Ops>;
+	k.earliestWall = earliestWallKernel<Ops>;
+	return k;
+}
+
+#endif
@@ -0,0 +1,51 @@
+// counterrng.h - version 1.0
+// Counter-based random numbers, for parallel code that must give the same
+// results from the same seed whatever the number of threads.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef COUNTERRNG_H
+#define COUNTERRNG_H
+
+#include <cstdint>
+
+// The k-th number of stream s is a hash of (seed, s, k), so any thread can
+// draw the numbers of, e.g., ball s without sharing the state of a
+// generator or drawing the numbers of other balls first. The hash is the
+// finaliser of SplitMix64, applied twice.
+class CounterRng {
+	public:
+
+		// Constructors
+		explicit CounterRng(uint64_t seed = 0) : iseed(seed) { }
+
+		// 64 random bits
+		uint64_t bits(uint64_t stream, uint64_t k) const {
+			return mix(mix(iseed + stream * 0x9E3779B97F4A7C15ULL) ^ (k * 0xD1B54A32D192ED03ULL + 0x8CB92BA72F3D8DD7ULL));
+		}
+
+		// Uniform in [0, 1), with 53 random bits
+		double uniform(uint64_t stream, uint64_t k) const {
+			return double(bits(stream, k) >> 11) * (1. / 9007199254740992.);
+		}
+
+		// Uniform in [lo, hi)
+		double uniform(uint64_t stream, uint64_t k, double lo, double hi) const {
+			return lo + (hi - lo) * uniform(stream, k);
+		}
+
+		// Get methods
+		uint64_t seed() const { return iseed; }
+
+	private:
+		uint64_t iseed;
+
+		static uint64_t mix(uint64_t z) {
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			return z ^ (z >> 31);
+		}
+};
+
+#endif
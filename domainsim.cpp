@@ -0,0 +1,307 @@
+// domainsim.cpp - version 1.0
+// Functions declared in domainsim.h.
+// See domainsim.h for documentation of functions.
+
+#include "domainsim.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+template <class T>
+const double DomainSimT<T>::DEFAULT_GHOST_MARGIN = 2.;
+
+template <class T>
+const unsigned long DomainSimT<T>::NONE;
+
+// Time since an arbitrary start in nanoseconds
+static unsigned long long nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Sorts balls by ID
+template <class T>
+static bool lessID(const BallT<T> &a, const BallT<T> &b) {
+	return a.id() < b.id();
+}
+
+template <class T>
+DomainSimT<T>::DomainSimT(Transport &transport) : transport(transport) {
+	ghostMargin = DEFAULT_GHOST_MARGIN;
+	slabX1 = -HUGE_VAL;
+	slabX2 = HUGE_VAL;
+	numTotal = 0;
+	neighbourR[0] = neighbourR[1] = 0.;
+	neighbourSpeed[0] = neighbourSpeed[1] = 0.;
+	ghostDt = 0;
+	ghostsValid = false;
+	stats.irank = transport.rank();
+}
+
+template <class T>
+void DomainSimT<T>::setWalls(const WallsT<T> &walls, unsigned long numBalls) {
+	unsigned int n = transport.numRanks();
+	unsigned int r = transport.rank();
+	std::vector<double> edges = slabEdges;
+	if (edges.size() != n - 1) {
+		edges.resize(n - 1);
+		for (unsigned int k = 1; k < n; k++) {
+			edges[k - 1] = walls.x1() + (double(walls.x2()) - walls.x1()) * k / n;
+		}
+	}
+	slabX1 = r > 0 ? edges[r - 1] : -HUGE_VAL;
+	slabX2 = r + 1 < n ? edges[r] : HUGE_VAL;
+
+	sim.resetBalls();
+	sim.addWalls(walls);
+	numTotal = numBalls;
+	owned.clear();
+	ghosts.clear();
+	isGhost.assign(numBalls, 0);
+	ghostEnd.clear();
+	ghostEndSlot.assign(numBalls, NONE);
+	ghostsValid = false;
+	stats.reset();
+	stats.irank = r;
+	stats.islabX1 = r > 0 ? slabX1 : double(walls.x1());
+	stats.islabX2 = r + 1 < n ? slabX2 : double(walls.x2());
+}
+
+template <class T>
+bool DomainSimT<T>::advance(T dt) {
+	// The first frame, or one of another length, needs its own ghosts
+	if (!ghostsValid || dt != ghostDt) {
+		if (!exchange(dt)) return false;
+	}
+
+	frameBalls.assign(owned.begin(), owned.end());
+	frameBalls.insert(frameBalls.end(), ghosts.begin(), ghosts.end());
+	sim.setBallsVector(frameBalls);
+	unsigned long long start = nowNs();
+	sim.advanceSim(dt);
+	stats.isimulateNs += nowNs() - start;
+	stats.iframes++;
+	stats.ighostBalls += ghosts.size();
+	stats.icollisions += sim.getNumCollisionsLastFrame();
+
+	// Keep the balls of this rank, and the ghosts that could have met them
+	// to compare with their owners'
+	owned.clear();
+	ghostEnd.clear();
+	for (unsigned long i = 0; i < sim.numBalls(); i++) {
+		BallT<T> b = sim.getBall(i);
+		if (isGhost[b.id()] == NEAR_GHOST) {
+			ghostEndSlot[b.id()] = ghostEnd.size();
+			ghostEnd.push_back(b);
+		}
+		if (isGhost[b.id()] == NOT_GHOST) owned.push_back(b);
+		isGhost[b.id()] = NOT_GHOST;
+	}
+	return exchange(dt);
+}
+
+template <class T>
+bool DomainSimT<T>::exchange(T dt) {
+	unsigned long long start = nowNs();
+	unsigned long long sent = transport.bytesSent();
+	unsigned long long received = transport.bytesReceived();
+
+	// Hand over the balls that have left the slab, with the largest radius
+	// and speed of the balls of this rank
+	double maxR = 0., maxSpeed = 0.;
+	for (unsigned long k = 0; k < owned.size(); k++) {
+		maxR = std::max(maxR, double(owned[k].r()));
+		maxSpeed = std::max(maxSpeed, std::sqrt(double(owned[k].vx()) * owned[k].vx() + double(owned[k].vy()) * owned[k].vy()));
+	}
+	unsigned long leaving[2] = { 0, 0 };
+	for (unsigned long k = 0; k < owned.size(); k++) {
+		if (owned[k].x() < slabX1) leaving[0]++;
+		else if (owned[k].x() >= slabX2) leaving[1]++;
+	}
+	for (int side = 0; side < 2; side++) {
+		startMessage(out[side], leaving[side]);
+		Header *h = (Header *)&out[side][0];
+		h->maxR = maxR;
+		h->maxSpeed = maxSpeed;
+	}
+	unsigned long kept = 0;
+	for (unsigned long k = 0; k < owned.size(); k++) {
+		if (owned[k].x() < slabX1) addBall(out[0], owned[k]);
+		else if (owned[k].x() >= slabX2) addBall(out[1], owned[k]);
+		else owned[kept++] = owned[k];
+	}
+	owned.resize(kept);
+	stats.iballsSent += leaving[0] + leaving[1];
+	if (!exchangeNeighbours()) return false;
+	for (int side = 0; side < 2; side++) {
+		if (in[side].empty()) continue; // No neighbour
+		unsigned long before = (unsigned long)owned.size();
+		Header h = readMessage(in[side], owned);
+		stats.iballsReceived += owned.size() - before;
+		neighbourR[side] = h.maxR;
+		neighbourSpeed[side] = h.maxSpeed;
+	}
+
+	// Send as ghosts the balls that can reach a ball of the neighbour: those
+	// within the sum of their radii and of the distances both travel
+	std::vector<unsigned long> selected[2];
+	for (unsigned long k = 0; k < owned.size(); k++) {
+		const BallT<T> &b = owned[k];
+		double speed = std::sqrt(double(b.vx()) * b.vx() + double(b.vy()) * b.vy());
+		for (int side = 0; side < 2; side++) {
+			double reach = ghostMargin * (b.r() + neighbourR[side] + (speed + neighbourSpeed[side]) * dt);
+			double distance = side == 0 ? b.x() - slabX1 : slabX2 - b.x();
+			if (distance <= reach) selected[side].push_back(k);
+		}
+	}
+	for (int side = 0; side < 2; side++) {
+		startMessage(out[side], (unsigned long)selected[side].size());
+		for (unsigned long k = 0; k < selected[side].size(); k++) {
+			addBall(out[side], owned[selected[side][k]]);
+		}
+	}
+	if (!exchangeNeighbours()) return false;
+	for (unsigned long k = 0; k < ghosts.size(); k++) {
+		isGhost[ghosts[k].id()] = NOT_GHOST;
+	}
+	ghosts.clear();
+	maxR = maxSpeed = 0.;
+	for (unsigned long k = 0; k < owned.size(); k++) {
+		maxR = std::max(maxR, double(owned[k].r()));
+		maxSpeed = std::max(maxSpeed, std::sqrt(double(owned[k].vx()) * owned[k].vx() + double(owned[k].vy()) * owned[k].vy()));
+	}
+	for (int side = 0; side < 2; side++) {
+		if (in[side].empty()) continue;
+		unsigned long first = (unsigned long)ghosts.size();
+		readMessage(in[side], ghosts);
+
+		// Only ghosts within reach of a ball of this slab can change them
+		for (unsigned long k = first; k < ghosts.size(); k++) {
+			const BallT<T> &b = ghosts[k];
+			double speed = std::sqrt(double(b.vx()) * b.vx() + double(b.vy()) * b.vy());
+			double reach = b.r() + maxR + (speed + maxSpeed) * dt;
+			double distance = side == 0 ? slabX1 - b.x() : b.x() - slabX2;
+			isGhost[b.id()] = distance <= reach ? NEAR_GHOST : FAR_GHOST;
+		}
+	}
+	for (unsigned long k = 0; k < ghostEnd.size(); k++) {
+		ghostEndSlot[ghostEnd[k].id()] = NONE;
+	}
+	ghostEnd.clear();
+	ghostDt = dt;
+	ghostsValid = true;
+
+	stats.iownedBalls = (unsigned long)owned.size();
+	stats.iexchangeNs += nowNs() - start;
+	stats.ibytesSent += transport.bytesSent() - sent;
+	stats.ibytesReceived += transport.bytesReceived() - received;
+	return true;
+}
+
+template <class T>
+bool DomainSimT<T>::exchangeNeighbours() {
+	unsigned int r = transport.rank();
+	for (int phase = 0; phase < 2; phase++) {
+		// Even ranks talk to the right in the first phase, odd ranks to the left
+		int side = (r % 2 == 0) == (phase == 0) ? 1 : 0;
+		if (side == 0 && r == 0) {
+			in[0].clear();
+			continue;
+		}
+		if (side == 1 && r + 1 == transport.numRanks()) {
+			in[1].clear();
+			continue;
+		}
+		if (!transport.exchange(side == 0 ? r - 1 : r + 1, out[side], in[side])) return false;
+	}
+	return true;
+}
+
+template <class T>
+void DomainSimT<T>::startMessage(std::vector<char> &message, unsigned long numBalls) const {
+	message.resize(sizeof(Header));
+	message.reserve(sizeof(Header) + numBalls * sizeof(WireBall));
+	Header h;
+	memset(&h, 0, sizeof(h));
+	h.numBalls = numBalls;
+	memcpy(&message[0], &h, sizeof(h));
+}
+
+template <class T>
+void DomainSimT<T>::addBall(std::vector<char> &message, const BallT<T> &b) {
+	WireBall w;
+	memset(&w, 0, sizeof(w)); // No stray bytes in the padding
+	w.x = b.x();
+	w.y = b.y();
+	w.vx = b.vx();
+	w.vy = b.vy();
+	w.m = b.m();
+	w.r = b.r();
+	w.color = b.color();
+	w.id = b.id();
+	const char *bytes = (const char *)&w;
+	message.insert(message.end(), bytes, bytes + sizeof(w));
+}
+
+template <class T>
+typename DomainSimT<T>::Header DomainSimT<T>::readMessage(const std::vector<char> &message,
+	std::vector<BallT<T> > &balls) {
+	Header h;
+	memcpy(&h, &message[0], sizeof(h));
+	for (unsigned long long k = 0; k < h.numBalls; k++) {
+		WireBall w;
+		memcpy(&w, &message[sizeof(h) + k * sizeof(w)], sizeof(w));
+		BallT<T> b;
+		b.setXY(w.x, w.y);
+		b.setVXY(w.vx, w.vy);
+		b.setM(w.m);
+		b.setR(w.r);
+		b.setColor(w.color);
+		b.setID(w.id);
+		balls.push_back(b);
+
+		// Was it a ghost here, which should have ended where its owner put it?
+		unsigned long slot = ghostEndSlot[w.id];
+		if (slot != NONE) {
+			const BallT<T> &g = ghostEnd[slot];
+			if (g.x() != w.x || g.y() != w.y || g.vx() != w.vx || g.vy() != w.vy) stats.ighostMismatches++;
+			ghostEndSlot[w.id] = NONE;
+		}
+	}
+	return h;
+}
+
+template <class T>
+bool DomainSimT<T>::gatherBalls(std::vector<BallT<T> > &all) {
+	all.clear();
+	if (transport.rank() != 0) {
+		startMessage(out[0], (unsigned long)owned.size());
+		for (unsigned long k = 0; k < owned.size(); k++) {
+			addBall(out[0], owned[k]);
+		}
+		return transport.sendMessage(0, out[0]);
+	}
+	all = owned;
+	for (unsigned int r = 1; r < transport.numRanks(); r++) {
+		if (!transport.receiveMessage(r, in[0])) return false;
+		readMessage(in[0], all);
+	}
+	std::sort(all.begin(), all.end(), lessID<T>);
+	return true;
+}
+
+template <class T>
+bool DomainSimT<T>::gatherStats(std::vector<RankStats> &all) {
+	all.clear();
+	if (transport.rank() != 0) return transport.send(0, &stats, sizeof(stats));
+	all.resize(transport.numRanks());
+	all[0] = stats;
+	for (unsigned int r = 1; r < transport.numRanks(); r++) {
+		if (!transport.receive(r, &all[r], sizeof(RankStats))) return false;
+	}
+	return true;
+}
+
+template class DomainSimT<double>;
+template class DomainSimT<float>;
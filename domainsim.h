@@ -0,0 +1,166 @@
+// domainsim.h - version 1.0
+// Runs one BallsSim domain split into slabs over several processes.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef DOMAINSIM_H
+#define DOMAINSIM_H
+
+#include "ballssim.h"
+#include "rankstats.h"
+#include "transport.h"
+#include <vector>
+
+// Each rank of a Transport owns the balls whose centres lie in its slab of
+// the walls, a band of x from slabX1() to slabX2(), and simulates them with
+// a BallsSim of its own. Ranks are ordered from left to right, so the
+// neighbours of a rank are the ranks before and after it.
+//
+// Before each frame the neighbours send each other copies of their balls
+// that are close enough to the common edge to reach a ball of the other
+// slab during the frame: the ghosts. A rank simulates its balls together
+// with the ghosts and then keeps its own balls only; the neighbour computes
+// the ghosts again as its own balls. After the frame each rank hands the
+// balls that have left its slab over to the neighbour on that side.
+//
+// A ghost behaves as it does for its owner unless, during the frame, it
+// meets a ball of its owner that is not a ghost here. Ghosts are therefore
+// taken from a margin several times wider than the distance a ball can
+// reach; such misses are counted (RankStats::ghostMismatches()) so the
+// margin can be checked. Otherwise the results are those of a single
+// BallsSim, except that collisions at exactly the same time may be
+// processed in another order.
+template <class T>
+class DomainSimT {
+	public:
+
+		// Default of setGhostMargin()
+		static const double DEFAULT_GHOST_MARGIN;
+
+		// Constructors
+		// The simulator runs on the rank of transport, which must have been launched
+		explicit DomainSimT(Transport &transport);
+
+		// Get the simulator of this rank, to set its number of threads,
+		// broad phase, etc. Its balls are replaced at every frame; do not set
+		// a reorder interval or a trajectory writer.
+		BallsSimT<T> &getSim() { return sim; }
+
+		// Set the x coordinates of the edges between the slabs, numRanks() - 1
+		// in increasing order. The default (an empty vector, or one of the wrong
+		// size) divides the width of the walls equally. Takes effect at the
+		// next setBalls().
+		void setSlabEdges(const std::vector<double> &edges) { slabEdges = edges; }
+
+		// Set the width of the band of ghosts along each edge, as a multiple
+		// of the largest distance at which a ball can meet a ball of the
+		// other slab in a frame. Must be at least 1.
+		void setGhostMargin(double margin) { ghostMargin = margin < 1. ? 1. : margin; }
+
+		// Sets the walls and the balls of the whole domain, of which this rank
+		// keeps those of its slab. All ranks must pass the same balls, which
+		// get their indices in all as IDs.
+		template <class U> void setBalls(const WallsT<T> &walls, const std::vector<BallT<U> > &all) {
+			setWalls(walls, (unsigned long)all.size());
+			for (unsigned long i = 0; i < all.size(); i++) {
+				if (all[i].x() >= slabX1 && all[i].x() < slabX2) {
+					owned.push_back(BallT<T>(all[i]));
+					owned.back().setID((int)i);
+				}
+			}
+			stats.iownedBalls = (unsigned long)owned.size();
+		}
+
+		// Advances the domain by time dt. All ranks must call it together.
+		// Returns false if the transport failed.
+		bool advance(T dt);
+
+		// Collects the balls of all ranks in rank 0, sorted by ID, into all.
+		// All ranks must call it together; the others leave all empty.
+		// Returns false if the transport failed.
+		bool gatherBalls(std::vector<BallT<T> > &all);
+
+		// Collects the counters of all ranks in rank 0, by rank. All ranks
+		// must call it together; the others leave all empty. Returns false if
+		// the transport failed.
+		bool gatherStats(std::vector<RankStats> &all);
+
+		// Get methods
+		// Balls owned by this rank, in no particular order
+		const std::vector<BallT<T> > &getBalls() const { return owned; }
+		// Counters of this rank
+		const RankStats &getStats() const { return stats; }
+
+	private:
+		// A ball as sent between ranks
+		struct WireBall {
+			T x, y, vx, vy, m, r;
+			unsigned long color;
+			int id;
+		};
+
+		// Start of a message between neighbours
+		struct Header {
+			double maxR; // Largest radius of the balls of the sender
+			double maxSpeed; // Largest speed of the balls of the sender
+			unsigned long long numBalls; // Balls following
+		};
+
+		static const unsigned long NONE = ~0UL; // No ghost in ghostEndSlot
+
+		// Values of isGhost
+		enum GhostKind {
+			NOT_GHOST,
+			FAR_GHOST, // Too far to reach a ball of this rank during the frame
+			NEAR_GHOST
+		};
+
+		Transport &transport;
+		BallsSimT<T> sim;
+		std::vector<double> slabEdges; // See setSlabEdges()
+		double ghostMargin; // See setGhostMargin()
+		double slabX1, slabX2; // Slab of this rank, infinite at the outer walls
+		unsigned long numTotal; // Balls in the whole domain
+		std::vector<BallT<T> > owned; // Balls of this rank
+		std::vector<BallT<T> > ghosts; // Ghosts of the neighbours for the next frame
+		std::vector<BallT<T> > frameBalls; // Scratch space for the balls of a frame
+		std::vector<unsigned char> isGhost; // GhostKind of each ID, for the next frame
+		std::vector<BallT<T> > ghostEnd; // Near ghosts at the end of the last frame
+		std::vector<unsigned long> ghostEndSlot; // Index of each ID in ghostEnd, or NONE
+		double neighbourR[2], neighbourSpeed[2]; // Largest radius and speed of the balls of the neighbour on each side
+		T ghostDt; // Frame length the ghosts were chosen for
+		bool ghostsValid;
+		std::vector<char> out[2], in[2]; // Messages to and from the neighbour on each side
+		RankStats stats;
+
+		// Sets the walls and the slab of this rank, with no balls yet
+		void setWalls(const WallsT<T> &walls, unsigned long numBalls);
+
+		// Hands over the balls that have left the slab and exchanges the
+		// ghosts for a frame of length dt
+		bool exchange(T dt);
+
+		// Sends out[side] to the neighbour on each side and receives in[side]
+		// from it: first between ranks 2k and 2k + 1, then between 2k + 1
+		// and 2k + 2, so each pair exchanges in parallel with the others
+		bool exchangeNeighbours();
+
+		// Starts message with a header for numBalls balls
+		void startMessage(std::vector<char> &message, unsigned long numBalls) const;
+
+		// Adds ball b to message
+		static void addBall(std::vector<char> &message, const BallT<T> &b);
+
+		// Adds the balls of message to balls and returns its header, after
+		// counting those that were ghosts here and differ
+		Header readMessage(const std::vector<char> &message, std::vector<BallT<T> > &balls);
+
+		// Not copyable: bound to the transport of this rank
+		DomainSimT(const DomainSimT &other);
+		DomainSimT &operator=(const DomainSimT &other);
+};
+
+typedef DomainSimT<SimScalar> DomainSim;
+
+#endif
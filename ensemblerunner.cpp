@@ -0,0 +1,183 @@
+// ensemblerunner.cpp - version 1.0
+// Functions declared in ensemblerunner.h.
+// See ensemblerunner.h for documentation of functions.
+
+#include "ensemblerunner.h"
+#include <chrono>
+#include <cmath>
+
+template <class T>
+EnsembleRunnerT<T>::EnsembleRunnerT() {
+	iseed = 1;
+	inOrder = true;
+	runSpecs = 0;
+	nextSummary = 0;
+	stolen = 0;
+}
+
+template <class T>
+void EnsembleRunnerT<T>::run(const std::vector<ScenarioSpec> &specs) {
+	// Workers are kept from one call to the next, so their storage is too
+	unsigned int numWorkers = pool.numThreads();
+	while (workers.size() < numWorkers) {
+		workers.emplace_back();
+		workers.back().sim.setNumThreads(1);
+		workers.back().gen.setNumThreads(1);
+	}
+	while (workers.size() > numWorkers) workers.pop_back();
+
+	unsigned long n = specs.size();
+	for (unsigned int w = 0; w < numWorkers; w++) {
+		workers[w].first = (unsigned long)((unsigned long long)n * w / numWorkers);
+		workers[w].last = (unsigned long)((unsigned long long)n * (w + 1) / numWorkers);
+	}
+	runSpecs = &specs;
+	summaries.clear();
+	finished.clear();
+	if (inOrder) {
+		summaries.resize(n);
+		finished.assign(n, 0);
+	}
+	nextSummary = 0;
+	stolen = 0;
+
+	pool.run(numWorkers, [&](unsigned long w) { work((unsigned int)w); });
+	runSpecs = 0;
+}
+
+template <class T>
+void EnsembleRunnerT<T>::work(unsigned int w) {
+	unsigned long k;
+	while (nextRun(w, k)) {
+		RunSummary summary = runOne(workers[w], k);
+		summary.worker = w;
+		report(summary);
+	}
+}
+
+template <class T>
+bool EnsembleRunnerT<T>::nextRun(unsigned int w, unsigned long &k) {
+	Worker &self = workers[w];
+	for (;;) {
+		{
+			std::lock_guard<std::mutex> lock(self.mutex);
+			if (self.first < self.last) {
+				k = self.first++;
+				return true;
+			}
+		}
+
+		// Steal the back half of the largest range left. Ranges only shrink
+		// while the workers run, so if none is left there is nothing to do.
+		unsigned int victim = w;
+		unsigned long most = 0;
+		for (unsigned int v = 0; v < workers.size(); v++) {
+			if (v == w) continue;
+			std::lock_guard<std::mutex> lock(workers[v].mutex);
+			if (workers[v].last - workers[v].first > most) {
+				most = workers[v].last - workers[v].first;
+				victim = v;
+			}
+		}
+		if (victim == w) return false;
+		unsigned long first, last;
+		{
+			std::lock_guard<std::mutex> lock(workers[victim].mutex);
+			Worker &v = workers[victim];
+			if (v.first >= v.last) continue; // Taken by its owner or another thief meanwhile
+			last = v.last;
+			first = v.last - (v.last - v.first + 1) / 2;
+			v.last = first;
+		}
+		{
+			std::lock_guard<std::mutex> lock(self.mutex);
+			self.first = first;
+			self.last = last;
+		}
+		{
+			std::lock_guard<std::mutex> lock(summaryMutex);
+			stolen += last - first;
+		}
+	}
+}
+
+template <class T>
+RunSummary EnsembleRunnerT<T>::runOne(Worker &w, unsigned long k) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const ScenarioSpec &spec = (*runSpecs)[k];
+	RunSummary summary;
+	summary.run = k;
+	summary.seed = spec.seed != 0 ? spec.seed : runSeed(k);
+
+	// Generate the balls, then make the heavy ones heavier
+	ScenarioGenerator &gen = w.gen;
+	gen.setMethod(spec.method);
+	gen.setSeed(summary.seed);
+	gen.setRadiusRange(spec.minRadius, spec.maxRadius);
+	gen.setVelocityRange(spec.minVelocity, spec.maxVelocity);
+	gen.setMassToAreaRatio(spec.massToArea);
+	WallsT<double> walls = gen.wallsForPackingFraction(spec.numBalls, spec.packingFraction, spec.aspect);
+	w.balls.clear();
+	gen.generate(spec.numBalls, walls, w.balls);
+	if (spec.heavyFraction > 0.) {
+		CounterRng rng(summary.seed);
+		for (unsigned long i = 0; i < w.balls.size(); i++) {
+			if (rng.uniform(HEAVY_STREAM, i) < spec.heavyFraction) w.balls[i].setM(w.balls[i].m() * spec.massRatio);
+		}
+	}
+
+	BallsSimT<T> &sim = w.sim;
+	sim.resetBalls();
+	sim.setBroadPhase(spec.broadPhase);
+	sim.addWalls(WallsT<T>(T(walls.x1()), T(walls.y1()), T(walls.x2()), T(walls.y2())));
+	sim.addBalls(w.balls.begin(), w.balls.end());
+	summary.numBalls = sim.numBalls();
+	summary.width = walls.x2() - walls.x1();
+	summary.height = walls.y2() - walls.y1();
+
+	summary.initialEnergy = 0.;
+	for (unsigned long i = 0; i < sim.numBalls(); i++) {
+		ConstBallRefT<T> b = sim.getBall(i);
+		summary.initialEnergy += .5 * double(b.m()) * (double(b.vx()) * b.vx() + double(b.vy()) * b.vy());
+	}
+
+	summary.frames = (unsigned long)ceil(spec.simTime / spec.frameDt - 1e-9);
+	summary.collisions = 0;
+	for (unsigned long f = 0; f < summary.frames; f++) {
+		sim.advanceSim(T(spec.frameDt));
+		summary.collisions += sim.getNumCollisionsLastFrame();
+	}
+
+	summary.finalEnergy = 0.;
+	double speeds = 0.;
+	for (unsigned long i = 0; i < sim.numBalls(); i++) {
+		ConstBallRefT<T> b = sim.getBall(i);
+		double v2 = double(b.vx()) * b.vx() + double(b.vy()) * b.vy();
+		summary.finalEnergy += .5 * double(b.m()) * v2;
+		speeds += sqrt(v2);
+	}
+	summary.meanSpeed = sim.numBalls() > 0 ? speeds / sim.numBalls() : 0.;
+	double simulated = summary.frames * spec.frameDt;
+	summary.collisionRate = sim.numBalls() > 0 && simulated > 0. ? summary.collisions / (sim.numBalls() * simulated) : 0.;
+	summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	summary.worker = 0;
+	return summary;
+}
+
+template <class T>
+void EnsembleRunnerT<T>::report(const RunSummary &summary) {
+	std::lock_guard<std::mutex> lock(summaryMutex);
+	if (!inOrder) {
+		if (summaryCallback) summaryCallback(summary);
+		return;
+	}
+	summaries[summary.run] = summary;
+	finished[summary.run] = 1;
+	while (nextSummary < finished.size() && finished[nextSummary]) {
+		if (summaryCallback) summaryCallback(summaries[nextSummary]);
+		nextSummary++;
+	}
+}
+
+template class EnsembleRunnerT<double>;
+template class EnsembleRunnerT<float>;
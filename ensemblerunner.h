@@ -0,0 +1,161 @@
+// ensemblerunner.h - version 1.0
+// Runs many small, independent simulations in one process, spread over the
+// threads by work stealing, and reports a summary of each.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef ENSEMBLERUNNER_H
+#define ENSEMBLERUNNER_H
+
+#include "ballssim.h"
+#include "scenariogenerator.h"
+#include "threadpool.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Settings of one run: the balls are generated by a ScenarioGenerator in
+// walls sized for the packing fraction, then simulated for simTime in
+// frames of frameDt
+struct ScenarioSpec {
+	unsigned long numBalls;
+	double minRadius, maxRadius;
+	double minVelocity, maxVelocity; // Of each velocity component
+	double massToArea; // Mass of a light ball = massToArea * area
+	double heavyFraction; // Fraction of the balls, chosen at random, that are heavy
+	double massRatio; // Mass of a heavy ball / mass of a light ball of the same size
+	double packingFraction; // Fraction of the area of the walls covered by the balls
+	double aspect; // Width / height of the walls
+	ScenarioGenerator::Method method;
+	double simTime;
+	double frameDt;
+	BallsSimBase::BroadPhase broadPhase;
+	uint64_t seed; // 0 to derive the seed from that of the ensemble and the index of the run
+
+	// Constructors
+	// The balls default to those of ScenarioGenerator, all light
+	ScenarioSpec() {
+		numBalls = 100;
+		minRadius = 5.;
+		maxRadius = 20.;
+		minVelocity = 0.;
+		maxVelocity = 200.;
+		massToArea = .1;
+		heavyFraction = 0.;
+		massRatio = 1.;
+		packingFraction = .3;
+		aspect = 1.;
+		method = ScenarioGenerator::RANDOM_SEQUENTIAL;
+		simTime = 1.;
+		frameDt = .01;
+		broadPhase = BallsSimBase::BRUTE_FORCE;
+		seed = 0;
+	}
+};
+
+// Observables of one run
+struct RunSummary {
+	unsigned long run; // Index of the spec
+	uint64_t seed; // Seed the balls were generated from
+	unsigned long numBalls; // Balls placed, fewer than asked for if there was no room
+	double width, height; // Of the walls
+	unsigned long frames;
+	unsigned long long collisions; // Of balls with balls or walls
+	double collisionRate; // Collisions per ball per simulated second
+	double initialEnergy, finalEnergy; // Kinetic energy of the balls
+	double meanSpeed; // At the end
+	double seconds; // Wall time of the run, generating the balls included
+	unsigned int worker; // Worker that ran it
+};
+
+// Each worker owns a simulator, a generator and a vector of balls, which
+// keep their storage from one run to the next, and a range of the runs.
+// Workers start with equal shares of consecutive runs and take their next
+// run from the front of their range; a worker whose range is empty steals
+// the back half of the largest range left, so runs of unequal cost keep
+// all the threads busy. Each simulator runs on one thread.
+//
+// The seed of run k, unless its spec gives one, is drawn from stream k of
+// a CounterRng with the seed of the ensemble, so the results do not depend
+// on the number of threads or on which worker ran which run.
+template <class T>
+class EnsembleRunnerT {
+	public:
+
+		// Constructors
+		EnsembleRunnerT();
+
+		// Set methods
+		// Set the number of threads. 0 means one per hardware thread.
+		void setNumThreads(unsigned int n) { pool.setNumThreads(n); }
+		// Seed from which the seeds of the runs are drawn (default 1)
+		void setSeed(uint64_t s) { iseed = s; }
+		// Function called with the summary of each run, one call at a time,
+		// on the thread of a worker. It should return quickly.
+		void setSummaryCallback(const std::function<void(const RunSummary &)> &callback) { summaryCallback = callback; }
+		// If true (the default) summaries are passed on in the order of the
+		// runs, each once the runs before it have finished; otherwise as
+		// the runs finish
+		void setInOrder(bool order) { inOrder = order; }
+
+		// Runs each of specs and returns when all have finished
+		void run(const std::vector<ScenarioSpec> &specs);
+
+		// Get methods
+		unsigned int getNumThreads() const { return pool.numThreads(); }
+		uint64_t getSeed() const { return iseed; }
+		// Seed of run k when its spec does not give one
+		uint64_t runSeed(unsigned long k) const { return CounterRng(iseed).bits(SEED_STREAM, k); }
+		// Runs stolen from another worker during the last run()
+		unsigned long runsStolen() const { return stolen; }
+
+	private:
+		// Streams of the CounterRngs of the ensemble and of a run that do
+		// not belong to a ball
+		static const uint64_t SEED_STREAM = ~0ULL;
+		static const uint64_t HEAVY_STREAM = ~0ULL;
+
+		struct Worker {
+			BallsSimT<T> sim;
+			ScenarioGenerator gen;
+			std::vector<BallT<double> > balls;
+			std::mutex mutex; // Protects first and last
+			unsigned long first, last; // Runs not yet started
+		};
+
+		ThreadPool pool;
+		uint64_t iseed;
+		std::function<void(const RunSummary &)> summaryCallback;
+		bool inOrder;
+		std::deque<Worker> workers; // A deque, as workers cannot be moved
+		const std::vector<ScenarioSpec> *runSpecs; // Specs of the current run()
+		std::mutex summaryMutex; // Serialises the calls to summaryCallback and protects the members below
+		std::vector<RunSummary> summaries; // Finished runs waiting for earlier ones, if inOrder
+		std::vector<char> finished; // Which runs are in summaries
+		unsigned long nextSummary; // First run not yet passed on, if inOrder
+		unsigned long stolen;
+
+		// Runs the runs of worker w, then those it can steal
+		void work(unsigned int w);
+
+		// Takes the next run of worker w, or steals some. Returns false if
+		// none is left.
+		bool nextRun(unsigned int w, unsigned long &k);
+
+		// Runs run k on worker w
+		RunSummary runOne(Worker &w, unsigned long k);
+
+		// Passes on the summary of a finished run
+		void report(const RunSummary &summary);
+
+		// Not copyable: the workers hold mutexes
+		EnsembleRunnerT(const EnsembleRunnerT &other);
+		EnsembleRunnerT &operator=(const EnsembleRunnerT &other);
+};
+
+typedef EnsembleRunnerT<SimScalar> EnsembleRunner;
+
+#endif
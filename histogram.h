@@ -0,0 +1,90 @@
+// histogram.h - version 1.0
+// Streaming histogram of values in equal bins over a range.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <vector>
+
+// Values are added one at a time and only their counts are kept, so a
+// histogram costs the same however many values it has seen. Values below
+// or above the range are counted apart.
+class Histogram {
+	public:
+
+		// Constructors
+		Histogram() {
+			iunderflow = 0;
+			ioverflow = 0;
+			setRange(0., 1., 1);
+		}
+
+		// Sets the range [lo, hi) and the number of bins, and clears the counts
+		void setRange(double lo, double hi, unsigned int bins) {
+			ilo = lo;
+			ihi = hi > lo ? hi : lo + 1.;
+			counts.assign(bins > 0 ? bins : 1, 0);
+			scale = counts.size() / (ihi - ilo);
+			clear();
+		}
+
+		// Sets the counts to 0
+		void clear() {
+			counts.assign(counts.size(), 0);
+			iunderflow = 0;
+			ioverflow = 0;
+		}
+
+		// Counts value v
+		void add(double v) {
+			if (v < ilo) iunderflow++;
+			else if (!(v < ihi)) ioverflow++;
+			else {
+				unsigned long bin = (unsigned long)((v - ilo) * scale);
+				counts[bin < counts.size() ? bin : counts.size() - 1]++; // Rounding may put v just below hi in bin bins()
+			}
+		}
+
+		// Adds the counts of other, which must have the same range and bins
+		Histogram &operator+=(const Histogram &other) {
+			for (unsigned long k = 0; k < counts.size() && k < other.counts.size(); k++) counts[k] += other.counts[k];
+			iunderflow += other.iunderflow;
+			ioverflow += other.ioverflow;
+			return *this;
+		}
+
+		// Get methods
+		double lo() const { return ilo; }
+		double hi() const { return ihi; }
+		unsigned int bins() const { return (unsigned int)counts.size(); }
+		double binWidth() const { return (ihi - ilo) / counts.size(); }
+		double binCentre(unsigned int bin) const { return ilo + (bin + .5) * binWidth(); }
+		unsigned long long count(unsigned int bin) const { return counts[bin]; }
+		// Values below lo() and at or above hi()
+		unsigned long long underflow() const { return iunderflow; }
+		unsigned long long overflow() const { return ioverflow; }
+		// All values counted, in the range or not
+		unsigned long long total() const {
+			unsigned long long n = iunderflow + ioverflow;
+			for (unsigned long k = 0; k < counts.size(); k++) n += counts[k];
+			return n;
+		}
+		// Fraction of all values that fell in bin, divided by the bin width:
+		// an estimate of the probability density at its centre
+		double density(unsigned int bin) const {
+			unsigned long long n = total();
+			return n > 0 ? counts[bin] / (n * binWidth()) : 0.;
+		}
+
+	private:
+		// Note: i stands for internal
+		double ilo, ihi;
+		double scale; // Bins per unit
+		std::vector<unsigned long long> counts;
+		unsigned long long iunderflow, ioverflow;
+};
+
+#endif
@@ -0,0 +1,149 @@
+// observables.h - version 1.0
+// Physical observables accumulated by BallsSim::advanceSim()
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef OBSERVABLES_H
+#define OBSERVABLES_H
+
+#include "walls.h"
+#include "histogram.h"
+
+template <class T> class BallsSimT;
+
+// While observables are enabled (see BallsSim::setObservablesInterval()),
+// the simulator adds to them in two ways:
+// - Every collision it processes: the impulse a ball gives a wall, the
+//   number of collisions between balls, and the free path of each ball,
+//   the distance it travels from one collision with a ball to the next.
+//   Collisions with the walls keep the speed of a ball, so they do not end
+//   a free path.
+// - Every n-th frame, a sample of all the balls at the end of the frame:
+//   their kinetic energy and momentum, summed in one pass over the arrays of
+//   the balls, and the histograms of their speeds and velocity components.
+// Averages over time are taken over the frames run while enabled.
+class Observables {
+	public:
+
+		// Constructors
+		Observables() {
+			ihistogramBins = DEFAULT_HISTOGRAM_BINS;
+			imaxSpeed = 0.;
+			reset();
+		}
+
+		// Constants
+		static const unsigned int DEFAULT_HISTOGRAM_BINS = 50;
+
+		// Clears all observables. The histograms keep their ranges.
+		void reset() {
+			isamples = 0;
+			inumBalls = 0;
+			ikineticEnergy = 0.;
+			imomentumX = 0.;
+			imomentumY = 0.;
+			ienergySum = 0.;
+			ispeeds.clear();
+			ivx.clear();
+			ivy.clear();
+			iobservedTime = 0.;
+			iballTime = 0.;
+			iballCollisions = 0;
+			iwallCollisions = 0;
+			for (int w = 0; w < NUM_WALLS; w++) {
+				iwallImpulse[w] = 0.;
+				iwallLengthTime[w] = 0.;
+			}
+			ifreePaths = 0;
+			ifreePathSum = 0.;
+			ifreeTimeSum = 0.;
+		}
+
+		// Get methods
+		// Samples taken
+		unsigned long long samples() const { return isamples; }
+		// Kinetic energy, momentum and number of the balls at the last sample
+		double kineticEnergy() const { return ikineticEnergy; }
+		double momentumX() const { return imomentumX; }
+		double momentumY() const { return imomentumY; }
+		unsigned long numBalls() const { return inumBalls; }
+		// Kinetic energy per ball at the last sample: the temperature of the
+		// balls in units where Boltzmann's constant is 1 (two degrees of freedom)
+		double temperature() const { return inumBalls > 0 ? ikineticEnergy / inumBalls : 0.; }
+		// Mean of the kinetic energy over the samples
+		double meanKineticEnergy() const { return isamples > 0 ? ienergySum / isamples : 0.; }
+		// Histograms of the speeds and of the x and y components of the
+		// velocities of the balls, over all samples
+		const Histogram &speedHistogram() const { return ispeeds; }
+		const Histogram &vxHistogram() const { return ivx; }
+		const Histogram &vyHistogram() const { return ivy; }
+		// Largest speed of the histograms (see BallsSim::setHistogramRange()),
+		// 0 until the first sample if it was not set
+		double histogramMaxSpeed() const { return imaxSpeed; }
+		unsigned int histogramBins() const { return ihistogramBins; }
+		// Simulated time observed
+		double observedTime() const { return iobservedTime; }
+		// Collisions processed between balls, and with the walls
+		unsigned long long ballCollisions() const { return iballCollisions; }
+		unsigned long long wallCollisions() const { return iwallCollisions; }
+		// Momentum given to wall w by the balls
+		double wallImpulse(WallsBase::Wall w) const { return w > WallsBase::NONE ? iwallImpulse[w - 1] : 0.; }
+		// Mean force per unit length on wall w (the pressure in two dimensions)
+		double pressure(WallsBase::Wall w) const {
+			return w > WallsBase::NONE && iwallLengthTime[w - 1] > 0. ? iwallImpulse[w - 1] / iwallLengthTime[w - 1] : 0.;
+		}
+		// Mean force per unit length on all the walls
+		double pressure() const {
+			double impulse = 0., lengthTime = 0.;
+			for (int w = 0; w < NUM_WALLS; w++) {
+				impulse += iwallImpulse[w];
+				lengthTime += iwallLengthTime[w];
+			}
+			return lengthTime > 0. ? impulse / lengthTime : 0.;
+		}
+		// Mean number of collisions with other balls per ball per unit time
+		double collisionFrequency() const { return iballTime > 0. ? 2. * iballCollisions / iballTime : 0.; }
+		// Free paths ended by a collision, and their mean length and duration
+		unsigned long long freePaths() const { return ifreePaths; }
+		double meanFreePath() const { return ifreePaths > 0 ? ifreePathSum / ifreePaths : 0.; }
+		double meanFreeTime() const { return ifreePaths > 0 ? ifreeTimeSum / ifreePaths : 0.; }
+
+	private:
+		template <class T> friend class BallsSimT; // Updates the observables directly
+
+		static const int NUM_WALLS = 4; // Walls X1, Y1, X2 and Y2, at index wall - 1
+
+		// Note: i stands for internal
+		unsigned long long isamples;
+		unsigned long inumBalls;
+		double ikineticEnergy;
+		double imomentumX;
+		double imomentumY;
+		double ienergySum;
+		Histogram ispeeds;
+		Histogram ivx;
+		Histogram ivy;
+		unsigned int ihistogramBins;
+		double imaxSpeed; // 0 until set
+		double iobservedTime;
+		double iballTime; // Sum over frames of the number of balls times the frame duration
+		unsigned long long iballCollisions;
+		unsigned long long iwallCollisions;
+		double iwallImpulse[NUM_WALLS];
+		double iwallLengthTime[NUM_WALLS]; // Sum over frames of the length of the wall times the frame duration
+		unsigned long long ifreePaths;
+		double ifreePathSum;
+		double ifreeTimeSum;
+
+		// Sets the range of the histograms and clears them
+		void setHistogramRange(double maxSpeed, unsigned int bins) {
+			imaxSpeed = maxSpeed;
+			ihistogramBins = bins > 0 ? bins : 1;
+			ispeeds.setRange(0., maxSpeed, ihistogramBins);
+			ivx.setRange(-maxSpeed, maxSpeed, ihistogramBins);
+			ivy.setRange(-maxSpeed, maxSpeed, ihistogramBins);
+		}
+};
+
+#endif
@@ -0,0 +1,174 @@
+// paircorrelation.cpp - version 1.0
+// Functions declared in paircorrelation.h.
+// See paircorrelation.h for documentation of functions.
+
+#include "paircorrelation.h"
+#include <algorithm>
+#include <cmath>
+
+static const double PI = 3.14159265358979323846;
+
+// Bessel function J0(x), from (1 / pi) int_0^pi cos(x sin t) dt. The
+// integrand is smooth and periodic, so the midpoint rule converges faster
+// than any power of the number of points once they outnumber x / 2.
+static double besselJ0(double x) {
+	int m = 16 + int(std::fabs(x));
+	double sum = 0.;
+	for (int k = 0; k < m; k++) sum += std::cos(x * std::sin(PI * (k + .5) / m));
+	return sum / m;
+}
+
+PairCorrelation::PairCorrelation() {
+	setRange(1., DEFAULT_BINS);
+}
+
+void PairCorrelation::setRange(double rMax, unsigned int bins) {
+	irMax = rMax > 0. ? rMax : 1.;
+	counts.assign(bins > 0 ? bins : 1, 0);
+	expected.assign(counts.size(), 0.);
+	clear();
+}
+
+void PairCorrelation::clear() {
+	counts.assign(counts.size(), 0);
+	expected.assign(counts.size(), 0.);
+	isamples = 0;
+	centres = 0.;
+	area = 0.;
+}
+
+void PairCorrelation::addSample(const BallSnapshot &snapshot) {
+	unsigned long n = snapshot.size();
+	x.assign(snapshot.x.begin(), snapshot.x.end());
+	y.assign(snapshot.y.begin(), snapshot.y.end());
+	if (snapshot.wallX2 > 0. && snapshot.wallY2 > 0.) {
+		double radiusSum = 0.;
+		for (unsigned long i = 0; i < n; i++) radiusSum += snapshot.r[i];
+		sample(0., 0., snapshot.wallX2, snapshot.wallY2, n > 0 ? radiusSum / n : 0.);
+	}
+	else sampleInBounds();
+}
+
+void PairCorrelation::addSample(const double *xs, const double *ys, unsigned long n, double x1, double y1, double x2,
+	double y2, double meanRadius) {
+	x.assign(xs, xs + n);
+	y.assign(ys, ys + n);
+	sample(x1, y1, x2, y2, meanRadius);
+}
+
+void PairCorrelation::sampleInBounds() {
+	if (x.empty()) {
+		sample(0., 0., 0., 0., 0.);
+		return;
+	}
+	double x1 = *std::min_element(x.begin(), x.end()), x2 = *std::max_element(x.begin(), x.end());
+	double y1 = *std::min_element(y.begin(), y.end()), y2 = *std::max_element(y.begin(), y.end());
+	sample(x1, y1, x2, y2, 0.);
+}
+
+void PairCorrelation::sample(double x1, double y1, double x2, double y2, double meanRadius) {
+	// Box the centres can reach
+	double bx1 = x1 + meanRadius, by1 = y1 + meanRadius;
+	double lx = x2 - x1 - 2. * meanRadius, ly = y2 - y1 - 2. * meanRadius;
+	unsigned long n = x.size();
+	if (!(lx > 0.) || !(ly > 0.) || n < 2) return;
+
+	// Cells at least rMax wide, but no more cells than about four per
+	// centre, so sparse samples with a small rMax do not visit empty cells
+	double cellSize = irMax;
+	double maxCells = 4. * n;
+	if ((lx / cellSize) * (ly / cellSize) > maxCells) cellSize = std::sqrt(lx * ly / maxCells);
+	unsigned long nx = (unsigned long)(lx / cellSize) + 1;
+	unsigned long ny = (unsigned long)(ly / cellSize) + 1;
+	double invCellSize = 1. / cellSize;
+
+	// Counting sort of the centres by cell, keeping their order within a
+	// cell. Centres slightly outside the box go to the edge cells.
+	cellOf.resize(n);
+	cellStart.assign(nx * ny + 1, 0);
+	for (unsigned long i = 0; i < n; i++) {
+		double cx = (x[i] - bx1) * invCellSize, cy = (y[i] - by1) * invCellSize;
+		unsigned long ix = cx > 0. ? (cx < double(nx - 1) ? (unsigned long)cx : nx - 1) : 0;
+		unsigned long iy = cy > 0. ? (cy < double(ny - 1) ? (unsigned long)cy : ny - 1) : 0;
+		cellOf[i] = iy * nx + ix;
+		cellStart[cellOf[i] + 1]++;
+	}
+	for (unsigned long c = 0; c < nx * ny; c++) cellStart[c + 1] += cellStart[c];
+	sortedX.resize(n);
+	sortedY.resize(n);
+	cellNext.assign(cellStart.begin(), cellStart.end() - 1);
+	for (unsigned long i = 0; i < n; i++) {
+		unsigned long k = cellNext[cellOf[i]]++;
+		sortedX[k] = x[i];
+		sortedY[k] = y[i];
+	}
+
+	// Each cell counts its own pairs and those with the cells to its right
+	// and in the row above, so each pair of neighbouring cells is visited once
+	unsigned long numBins = counts.size();
+	unsigned long numChunks = std::min((unsigned long)pool.numThreads() * CHUNKS_PER_THREAD, ny);
+	chunkCounts.resize(numChunks);
+	pool.run(numChunks, [&](unsigned long k) {
+		std::vector<unsigned long long> &h = chunkCounts[k];
+		h.assign(numBins, 0);
+		for (unsigned long cy = ny * k / numChunks; cy < ny * (k + 1) / numChunks; cy++) {
+			for (unsigned long cx = 0; cx < nx; cx++) {
+				unsigned long c = cy * nx + cx;
+				countCells(c, c, h.data());
+				if (cx + 1 < nx) countCells(c, c + 1, h.data());
+				if (cy + 1 < ny) {
+					if (cx > 0) countCells(c, c + nx - 1, h.data());
+					countCells(c, c + nx, h.data());
+					if (cx + 1 < nx) countCells(c, c + nx + 1, h.data());
+				}
+			}
+		}
+	});
+	for (unsigned long k = 0; k < numChunks; k++) {
+		for (unsigned long b = 0; b < numBins; b++) counts[b] += chunkCounts[k][b];
+	}
+
+	// Pairs expected in each bin for evenly spread centres, in the bins
+	// that fit in the box
+	double pairsPerArea2 = .5 * double(n) * double(n - 1) / (lx * ly * lx * ly);
+	double rLimit = std::min(lx, ly);
+	double width = binWidth();
+	for (unsigned long b = 0; b < numBins; b++) {
+		double r1 = b * width, r2 = (b + 1) * width;
+		if (r2 > rLimit) break;
+		double shell = PI * lx * ly * (r2 * r2 - r1 * r1) - 4. / 3. * (lx + ly) * (r2 * r2 * r2 - r1 * r1 * r1) +
+			.5 * (r2 * r2 * r2 * r2 - r1 * r1 * r1 * r1);
+		expected[b] += pairsPerArea2 * shell;
+	}
+	centres += double(n);
+	area += lx * ly;
+	isamples++;
+}
+
+void PairCorrelation::countCells(unsigned long c, unsigned long d, unsigned long long *h) const {
+	double r2Max = irMax * irMax;
+	double scale = counts.size() / irMax;
+	unsigned long numBins = counts.size();
+	for (unsigned long i = cellStart[c]; i < cellStart[c + 1]; i++) {
+		double xi = sortedX[i], yi = sortedY[i];
+		for (unsigned long j = c == d ? i + 1 : cellStart[d]; j < cellStart[d + 1]; j++) {
+			double dx = sortedX[j] - xi, dy = sortedY[j] - yi;
+			double d2 = dx * dx + dy * dy;
+			if (d2 < r2Max) {
+				unsigned long b = (unsigned long)(std::sqrt(d2) * scale);
+				h[b < numBins ? b : numBins - 1]++; // Rounding may put a distance just below rMax in bin bins()
+			}
+		}
+	}
+}
+
+double PairCorrelation::structureFactor(double k) const {
+	double width = binWidth();
+	double sum = 0.;
+	for (unsigned int b = 0; b < bins(); b++) {
+		if (!(expected[b] > 0.)) break; // Beyond the box
+		double r = binCentre(b);
+		sum += (g(b) - 1.) * besselJ0(k * r) * r * width;
+	}
+	return 1. + 2. * PI * density() * sum;
+}
@@ -0,0 +1,137 @@
+// paircorrelation.h - version 1.0
+// Radial distribution function g(r) and structure factor S(k) of the
+// centres of the balls, averaged over samples of live simulations or of
+// saved states, for characterising their packing.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef PAIRCORRELATION_H
+#define PAIRCORRELATION_H
+
+#include "ballssim.h"
+#include "snapshotbuffer.h"
+#include "threadpool.h"
+#include <vector>
+
+// Each sample sorts the centres into square cells at least rMax wide, so
+// every pair closer than rMax lies in the same or neighbouring cells, and
+// counts the distances of those pairs into a histogram. The rows of cells
+// are split into chunks counted on the threads, each into a histogram of
+// its own; the histograms are added up in chunk order at the end. A sample
+// costs about N times the number of balls within rMax of a ball.
+//
+// g(r) is the number of pairs counted at distance r divided by the number
+// expected at that distance if the centres were spread evenly over the box
+// they can reach, the walls shrunk by the mean radius of the balls. Counting
+// the pairs of evenly spread points in a rectangle Lx by Ly, rather than
+// N rho 2 pi r dr, corrects for the shells of the balls near the walls
+// that reach outside: the expected number of pairs in the shell from r1 to
+// r2 is
+//   N (N - 1) / 2 / (Lx Ly)^2 * (pi Lx Ly (r2^2 - r1^2) - 4/3 (Lx + Ly) (r2^3 - r1^3) + 1/2 (r2^4 - r1^4))
+// for r2 up to the smaller of Lx and Ly. Bins beyond it are not counted
+// and g is 0 there.
+class PairCorrelation {
+	public:
+
+		// Constants
+		static const unsigned int DEFAULT_BINS = 100;
+
+		// Constructors
+		PairCorrelation();
+
+		// Modifier methods
+		// Sets the largest distance counted and the number of bins, and
+		// clears the samples
+		void setRange(double rMax, unsigned int bins = DEFAULT_BINS);
+
+		// Set the number of threads, including the calling thread. 0 means
+		// one per hardware thread.
+		void setNumThreads(unsigned int n) { pool.setNumThreads(n); }
+
+		// Clears the samples, keeping the range
+		void clear();
+
+		// Adds the balls of sim as a sample. Without walls, the box is the
+		// one bounding the centres.
+		template <class T> void addSample(const BallsSimT<T> &sim) {
+			unsigned long n = sim.numBalls();
+			x.resize(n);
+			y.resize(n);
+			double radiusSum = 0.;
+			for (unsigned long i = 0; i < n; i++) {
+				ConstBallRefT<T> b = sim.getBall(i);
+				x[i] = b.x();
+				y[i] = b.y();
+				radiusSum += b.r();
+			}
+			if (sim.hasWalls()) {
+				const WallsT<T> &w = sim.getWalls();
+				sample(w.x1(), w.y1(), w.x2(), w.y2(), n > 0 ? radiusSum / n : 0.);
+			}
+			else sampleInBounds();
+		}
+
+		// Adds the balls of a snapshot, such as those of a SimThread, as a
+		// sample. Without walls, the box is the one bounding the centres.
+		void addSample(const BallSnapshot &snapshot);
+
+		// Adds n centres as a sample, in walls from (x1, y1) to (x2, y2) and
+		// with balls of mean radius meanRadius; for instance the frames of a
+		// trajectory file, which hold no walls or radii
+		void addSample(const double *xs, const double *ys, unsigned long n, double x1, double y1, double x2, double y2,
+			double meanRadius);
+
+		// Get methods
+		double rMax() const { return irMax; }
+		unsigned int bins() const { return (unsigned int)counts.size(); }
+		double binWidth() const { return irMax / counts.size(); }
+		double binCentre(unsigned int bin) const { return (bin + .5) * binWidth(); }
+		unsigned long samples() const { return isamples; }
+		// Pairs counted in bin over all samples
+		unsigned long long pairs(unsigned int bin) const { return counts[bin]; }
+		// Pair correlation in bin, 0 if no pairs are expected there
+		double g(unsigned int bin) const { return expected[bin] > 0. ? counts[bin] / expected[bin] : 0.; }
+		// Mean number of centres per unit area of the boxes they can reach
+		double density() const { return area > 0. ? centres / area : 0.; }
+		// Structure factor at wavenumber k, from the Fourier transform of
+		// g(r) - 1 over the bins, S(k) = 1 + 2 pi rho int (g(r) - 1) J0(k r) r dr.
+		// Cutting g off at rMax ripples S(k) for k below about 2 pi / rMax.
+		double structureFactor(double k) const;
+		unsigned int getNumThreads() const { return pool.numThreads(); }
+
+	private:
+		// Number of chunks of rows of cells per thread, so threads that
+		// finish early can take more work
+		static const unsigned long CHUNKS_PER_THREAD = 4;
+
+		// Note: i stands for internal
+		double irMax;
+		unsigned long isamples;
+		double centres; // Centres over all samples
+		double area; // Area of the boxes of the centres over all samples
+		std::vector<unsigned long long> counts; // Pairs counted in each bin
+		std::vector<double> expected; // Pairs expected in each bin over all samples
+		ThreadPool pool;
+
+		// Centres of the sample being added, and sorted by cell
+		std::vector<double> x, y;
+		std::vector<double> sortedX, sortedY;
+		std::vector<unsigned long> cellOf; // Cell of each centre
+		std::vector<unsigned long> cellStart; // First sorted centre of each cell, and the number of centres at the end
+		std::vector<unsigned long> cellNext; // Next free place of each cell while sorting
+		std::vector<std::vector<unsigned long long> > chunkCounts; // Pairs counted by each chunk
+
+		// Counts the pairs of the centres in x and y, which are in walls
+		// from (x1, y1) to (x2, y2) with balls of mean radius meanRadius
+		void sample(double x1, double y1, double x2, double y2, double meanRadius);
+
+		// Like sample(), in the box bounding the centres in x and y
+		void sampleInBounds();
+
+		// Adds the pairs of the centres in cell c with those in cell d,
+		// or among themselves if d is c, to counts
+		void countCells(unsigned long c, unsigned long d, unsigned long long *counts) const;
+};
+
+#endif
@@ -0,0 +1,92 @@
+// rankstats.h - version 1.0
+// Load and communication counters of one rank of a DomainSim
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef RANKSTATS_H
+#define RANKSTATS_H
+
+template <class T> class DomainSimT;
+
+// Counts the work of one rank over the frames since it was set up. The
+// time spent exchanging includes waiting for the neighbours to finish their
+// frame, so a rank with a light slab shows a high share of exchange time;
+// comparing the simulation times of the ranks shows how to move the slab
+// edges (DomainSim::setSlabEdges()). The counters are plain numbers, so
+// DomainSim::gatherStats() sends them between ranks as they are.
+class RankStats {
+	public:
+
+		// Constructors
+		RankStats() { reset(); }
+
+		// Set all counters to 0
+		void reset() {
+			irank = 0;
+			islabX1 = islabX2 = 0.;
+			iframes = 0;
+			iownedBalls = 0;
+			ighostBalls = 0;
+			iballsSent = 0;
+			iballsReceived = 0;
+			icollisions = 0;
+			ighostMismatches = 0;
+			isimulateNs = 0;
+			iexchangeNs = 0;
+			ibytesSent = 0;
+			ibytesReceived = 0;
+		}
+
+		// Get methods
+		unsigned int rank() const { return irank; }
+		// Slab of the walls owned by the rank: slabX1() <= x < slabX2()
+		double slabX1() const { return islabX1; }
+		double slabX2() const { return islabX2; }
+		// Number of calls to DomainSim::advance()
+		unsigned long long frames() const { return iframes; }
+		// Balls owned by the rank now
+		unsigned long ownedBalls() const { return iownedBalls; }
+		// Ghost balls of the neighbours simulated by the rank, summed over
+		// the frames
+		unsigned long long ghostBalls() const { return ighostBalls; }
+		// Balls handed over to the neighbours, and taken over from them
+		unsigned long long ballsSent() const { return iballsSent; }
+		unsigned long long ballsReceived() const { return iballsReceived; }
+		// Collisions processed, ghosts included
+		unsigned long long collisions() const { return icollisions; }
+		// Ghost balls close enough to meet a ball of this rank whose state at
+		// the end of a frame differed from the state their owner computed,
+		// because they met balls of the owner that were not ghosts here.
+		// Not all of them meet one, but balls of this rank that met such a
+		// ghost differ from a single-process run; widen the ghost margin
+		// (DomainSim::setGhostMargin()) if this grows.
+		unsigned long long ghostMismatches() const { return ighostMismatches; }
+		// Time spent in BallsSim::advanceSim()
+		unsigned long long simulateNs() const { return isimulateNs; }
+		// Time spent exchanging balls with the neighbours, waiting included
+		unsigned long long exchangeNs() const { return iexchangeNs; }
+		// Bytes sent to and received from other ranks
+		unsigned long long bytesSent() const { return ibytesSent; }
+		unsigned long long bytesReceived() const { return ibytesReceived; }
+
+	private:
+		template <class T> friend class DomainSimT; // Updates the counters directly
+
+		// Note: i stands for internal
+		unsigned int irank;
+		double islabX1, islabX2;
+		unsigned long long iframes;
+		unsigned long iownedBalls;
+		unsigned long long ighostBalls;
+		unsigned long long iballsSent;
+		unsigned long long iballsReceived;
+		unsigned long long icollisions;
+		unsigned long long ighostMismatches;
+		unsigned long long isimulateNs;
+		unsigned long long iexchangeNs;
+		unsigned long long ibytesSent;
+		unsigned long long ibytesReceived;
+};
+
+#endif
@@ -0,0 +1,374 @@
+// rasterizer.cpp - version 1.1
+// Functions declared in rasterizer.h.
+// See rasterizer.h for documentation of functions.
+
+#include "rasterizer.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTERIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+Rasterizer::Rasterizer() {
+	width = height = 0;
+	tilesX = tilesY = 0;
+	pixelOrder = RGBA;
+	background = 0xFFFFFF;
+	viewX = viewY = 0.;
+	viewScale = 1.;
+}
+
+void Rasterizer::setSize(unsigned int w, unsigned int h) {
+	width = w;
+	height = h;
+	tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+	framebuffer.resize((std::size_t)w * h);
+}
+
+void Rasterizer::fitView(double x1, double y1, double x2, double y2) {
+	double w = x2 - x1, h = y2 - y1;
+	if (w <= 0. || h <= 0. || width == 0 || height == 0) {
+		setView(x1, y1, 1.);
+		return;
+	}
+	double scale = std::min(width / w, height / h);
+	setView(x1 - (width / scale - w) / 2., y1 - (height / scale - h) / 2., scale);
+}
+
+uint32_t Rasterizer::toPixel(unsigned long color) const {
+	unsigned char r = (unsigned char)(color & 0xFF);
+	unsigned char g = (unsigned char)((color >> 8) & 0xFF);
+	unsigned char b = (unsigned char)((color >> 16) & 0xFF);
+	unsigned char bytes[4] = { r, g, b, 0xFF };
+	if (pixelOrder == BGRA) std::swap(bytes[0], bytes[2]);
+	uint32_t pixel;
+	memcpy(&pixel, bytes, 4);
+	return pixel;
+}
+
+// Sets n pixels from p to pixel
+static inline void fillSpan(uint32_t *p, long n, uint32_t pixel) {
+#ifdef RASTERIZER_SSE2
+	__m128i v = _mm_set1_epi32(int(pixel));
+	for (; n >= 8; n -= 8, p += 8) {
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(p + 4), v);
+	}
+	if (n >= 4) {
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+		n -= 4;
+		p += 4;
+	}
+#endif
+	for (; n > 0; n--) *p++ = pixel;
+}
+
+void Rasterizer::drawBalls(const BallSnapshot &snapshot) {
+	unsigned long n = snapshot.size();
+	circles.resize(n);
+	for (unsigned long i = 0; i < n; i++) {
+		Circle &c = circles[i];
+		c.x = float((snapshot.x[i] - viewX) * viewScale);
+		c.y = float((snapshot.y[i] - viewY) * viewScale);
+		c.r = float(snapshot.r[i] * viewScale);
+		c.pixel = toPixel(snapshot.color[i]);
+	}
+	render();
+}
+
+// Smallest integer >= v, but at least lo. Clamping first keeps a huge v
+// (a zoomed-in circle) in range, and then conversion to an integer, which
+// rounds towards 0, is enough, without the cost of calling ceil().
+static inline long ceilClamped(double v, long lo) {
+	if (!(v > double(lo))) return lo; // Also catches NaN
+	long k = long(v);
+	return k < v ? k + 1 : k;
+}
+
+// Largest integer <= v, but at most hi
+static inline long floorClamped(double v, long hi) {
+	if (!(v < double(hi))) return hi;
+	if (v < -1.) return -1; // Below any pixel; only compared with a lower bound >= 0
+	long k = long(v);
+	return k > v ? k - 1 : k;
+}
+
+void Rasterizer::render() {
+	unsigned long n = circles.size();
+	unsigned long numTiles = (unsigned long)tilesX * tilesY;
+	if (numTiles == 0) return;
+
+	// Bin the circles in blocks, so each tile can draw them in index order
+	// by going through the blocks in order
+	unsigned long numChunks = std::min((unsigned long)pool.numThreads() * CHUNKS_PER_THREAD, n / MIN_CHUNK_BALLS);
+	if (numChunks < 1) numChunks = 1;
+	bins.resize(numChunks * numTiles);
+	std::function<void(unsigned long)> bin = [this, n, numChunks](unsigned long chunk) {
+		binCircles(chunk, n * chunk / numChunks, n * (chunk + 1) / numChunks);
+	};
+	if (numChunks > 1) pool.run(numChunks, bin);
+	else bin(0);
+
+	std::function<void(unsigned long)> draw = [this, numChunks](unsigned long tile) {
+		drawTile(tile, numChunks);
+	};
+	pool.run(numTiles, draw);
+}
+
+void Rasterizer::binCircles(unsigned long chunk, unsigned long begin, unsigned long end) {
+	unsigned long numTiles = (unsigned long)tilesX * tilesY;
+	std::vector<uint32_t> *chunkBins = &bins[chunk * numTiles];
+	for (unsigned long t = 0; t < numTiles; t++) chunkBins[t].clear();
+	for (unsigned long i = begin; i < end; i++) {
+		const Circle &c = circles[i];
+		// Bounding box in pixels, clipped to the image; skip if empty
+		double x0 = std::max(double(c.x) - c.r, 0.), x1 = std::min(double(c.x) + c.r, double(width) - 1.);
+		double y0 = std::max(double(c.y) - c.r, 0.), y1 = std::min(double(c.y) + c.r, double(height) - 1.);
+		if (!(x0 <= x1 && y0 <= y1)) continue;
+		unsigned int tx0 = (unsigned int)x0 / TILE_SIZE, tx1 = (unsigned int)x1 / TILE_SIZE;
+		unsigned int ty0 = (unsigned int)y0 / TILE_SIZE, ty1 = (unsigned int)y1 / TILE_SIZE;
+		for (unsigned int ty = ty0; ty <= ty1; ty++) {
+			for (unsigned int tx = tx0; tx <= tx1; tx++) chunkBins[ty * tilesX + tx].push_back((uint32_t)i);
+		}
+	}
+}
+
+void Rasterizer::drawTile(unsigned long tile, unsigned long numChunks) {
+	unsigned long numTiles = (unsigned long)tilesX * tilesY;
+	long tx0 = long(tile % tilesX) * TILE_SIZE, ty0 = long(tile / tilesX) * TILE_SIZE;
+	long tx1 = std::min(tx0 + long(TILE_SIZE), long(width)), ty1 = std::min(ty0 + long(TILE_SIZE), long(height));
+	uint32_t *image = framebuffer.data();
+
+	uint32_t back = toPixel(background);
+	for (long y = ty0; y < ty1; y++) fillSpan(image + y * width + tx0, tx1 - tx0, back);
+
+	for (unsigned long chunk = 0; chunk < numChunks; chunk++) {
+		const std::vector<uint32_t> &list = bins[chunk * numTiles + tile];
+		for (std::size_t k = 0; k < list.size(); k++) {
+			const Circle &c = circles[list[k]];
+			double cx = c.x, cy = c.y, r = c.r;
+			// Rows whose pixel centres (y + .5) are within the circle
+			long y0 = ceilClamped(cy - r - .5, ty0), y1 = floorClamped(cy + r - .5, ty1 - 1);
+			for (long y = y0; y <= y1; y++) {
+				double dy = y + .5 - cy;
+				double d2 = r * r - dy * dy;
+				if (d2 < 0.) continue;
+				double dx = std::sqrt(d2);
+				long x0 = ceilClamped(cx - dx - .5, tx0), x1 = floorClamped(cx + dx - .5, tx1 - 1);
+				if (x0 <= x1) fillSpan(image + y * width + x0, x1 - x0 + 1, c.pixel);
+			}
+		}
+	}
+}
+
+void Rasterizer::rowBytes(unsigned int y, bool alpha, unsigned char *out) const {
+	const unsigned char *in = reinterpret_cast<const unsigned char *>(framebuffer.data() + (std::size_t)y * width);
+	int r = pixelOrder == RGBA ? 0 : 2, b = 2 - r;
+	for (unsigned int x = 0; x < width; x++, in += 4) {
+		*out++ = in[r];
+		*out++ = in[1];
+		*out++ = in[b];
+		if (alpha) *out++ = in[3];
+	}
+}
+
+bool Rasterizer::writePPM(const char *fileName) const {
+	FILE *file = fopen(fileName, "wb");
+	if (file == 0) return false;
+	bool ok = fprintf(file, "P6\n%u %u\n255\n", width, height) > 0;
+	std::vector<unsigned char> row((std::size_t)width * 3);
+	for (unsigned int y = 0; y < height && ok; y++) {
+		rowBytes(y, false, row.data());
+		ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+	}
+	if (fclose(file) != 0) ok = false;
+	return ok;
+}
+
+// PNG encoding. The image data is compressed with a single deflate block of
+// fixed Huffman codes whose only matches are with the previous pixel or the
+// pixel above. That is simple and fast, and the flat colors of the balls
+// compress well.
+namespace {
+
+// Writes bits least significant first, as deflate requires
+class BitWriter {
+	public:
+		explicit BitWriter(std::vector<unsigned char> &o) : out(o), bits(0), numBits(0) { }
+
+		void put(uint32_t value, int n) {
+			bits |= uint64_t(value) << numBits;
+			numBits += n;
+			while (numBits >= 8) {
+				out.push_back((unsigned char)bits);
+				bits >>= 8;
+				numBits -= 8;
+			}
+		}
+
+		// Writes a Huffman code, which is stored most significant bit first
+		void putCode(uint32_t code, int n) {
+			uint32_t reversed = 0;
+			for (int k = 0; k < n; k++) reversed |= ((code >> k) & 1) << (n - 1 - k);
+			put(reversed, n);
+		}
+
+		void flush() {
+			if (numBits > 0) out.push_back((unsigned char)bits);
+			bits = 0;
+			numBits = 0;
+		}
+
+	private:
+		std::vector<unsigned char> &out;
+		uint64_t bits;
+		int numBits;
+};
+
+const unsigned int LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67,
+	83, 99, 115, 131, 163, 195, 227, 258 };
+const int LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const unsigned int DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+	769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const int DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+	12, 12, 13, 13 };
+const unsigned int MAX_MATCH = 258;
+const unsigned int MAX_DISTANCE = 32768;
+
+// Writes literal/length symbol s with the fixed Huffman code
+void putLiteral(BitWriter &w, unsigned int s) {
+	if (s < 144) w.putCode(0x30 + s, 8);
+	else if (s < 256) w.putCode(0x190 + s - 144, 9);
+	else if (s < 280) w.putCode(s - 256, 7);
+	else w.putCode(0xC0 + s - 280, 8);
+}
+
+void putMatch(BitWriter &w, unsigned int length, unsigned int distance) {
+	int code = 28;
+	while (LENGTH_BASE[code] > length) code--;
+	putLiteral(w, 257 + code);
+	w.put(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+	code = 29;
+	while (DISTANCE_BASE[code] > distance) code--;
+	w.putCode(code, 5);
+	w.put(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+}
+
+// Length of the match of data[i...] with the bytes distance before, up to MAX_MATCH
+unsigned int matchLength(const std::vector<unsigned char> &data, std::size_t i, std::size_t distance) {
+	if (distance == 0 || distance > i || distance > MAX_DISTANCE) return 0;
+	std::size_t end = std::min(data.size(), i + MAX_MATCH);
+	std::size_t k = i;
+	while (k < end && data[k] == data[k - distance]) k++;
+	return (unsigned int)(k - i);
+}
+
+// zlib stream of data
+void deflate(const std::vector<unsigned char> &data, std::size_t rowDistance, std::vector<unsigned char> &out) {
+	out.push_back(0x78); // Deflate, 32K window
+	out.push_back(0x01); // No dictionary, fastest compression
+	BitWriter w(out);
+	w.put(1, 1); // Last block
+	w.put(1, 2); // Fixed Huffman codes
+	for (std::size_t i = 0; i < data.size();) {
+		unsigned int pixelMatch = matchLength(data, i, 4);
+		unsigned int rowMatch = matchLength(data, i, rowDistance);
+		if (pixelMatch >= 3 || rowMatch >= 3) {
+			if (pixelMatch >= rowMatch) putMatch(w, pixelMatch, 4);
+			else putMatch(w, rowMatch, (unsigned int)rowDistance);
+			i += std::max(pixelMatch, rowMatch);
+		}
+		else putLiteral(w, data[i++]);
+	}
+	putLiteral(w, 256); // End of block
+	w.flush();
+
+	uint32_t a = 1, b = 0; // Adler-32
+	for (std::size_t i = 0; i < data.size(); i++) {
+		a = (a + data[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	uint32_t adler = (b << 16) | a;
+	for (int shift = 24; shift >= 0; shift -= 8) out.push_back((unsigned char)(adler >> shift));
+}
+
+// CRC-32 of each byte value
+struct CrcTable {
+	uint32_t t[256];
+
+	CrcTable() {
+		for (uint32_t k = 0; k < 256; k++) {
+			uint32_t c = k;
+			for (int j = 0; j < 8; j++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			t[k] = c;
+		}
+	}
+};
+
+uint32_t crc32(const unsigned char *p, std::size_t n, uint32_t crc) {
+	static const CrcTable table;
+	crc = ~crc;
+	for (std::size_t i = 0; i < n; i++) crc = table.t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+void putBE32(std::vector<unsigned char> &out, uint32_t v) {
+	for (int shift = 24; shift >= 0; shift -= 8) out.push_back((unsigned char)(v >> shift));
+}
+
+// Appends a PNG chunk
+void putChunk(std::vector<unsigned char> &out, const char *type, const std::vector<unsigned char> &data) {
+	putBE32(out, (uint32_t)data.size());
+	std::size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	putBE32(out, crc32(&out[start], out.size() - start, 0));
+}
+
+}
+
+bool Rasterizer::writePNG(const char *fileName) const {
+	// Rows of RGBA bytes, each after a filter type byte of 0 (none)
+	std::size_t rowSize = (std::size_t)width * 4 + 1;
+	std::vector<unsigned char> data(rowSize * height);
+	for (unsigned int y = 0; y < height; y++) {
+		data[y * rowSize] = 0;
+		rowBytes(y, true, &data[y * rowSize + 1]);
+	}
+
+	static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	std::vector<unsigned char> png(SIGNATURE, SIGNATURE + 8);
+	std::vector<unsigned char> chunk;
+	putBE32(chunk, width);
+	putBE32(chunk, height);
+	chunk.push_back(8); // Bits per channel
+	chunk.push_back(6); // RGBA
+	chunk.push_back(0); // Compression, filter and interlace methods
+	chunk.push_back(0);
+	chunk.push_back(0);
+	putChunk(png, "IHDR", chunk);
+	chunk.clear();
+	deflate(data, rowSize, chunk);
+	putChunk(png, "IDAT", chunk);
+	chunk.clear();
+	putChunk(png, "IEND", chunk);
+
+	FILE *file = fopen(fileName, "wb");
+	if (file == 0) return false;
+	bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+	if (fclose(file) != 0) ok = false;
+	return ok;
+}
+
+bool Rasterizer::writeImage(const char *fileName) const {
+	std::size_t n = strlen(fileName);
+	const char *ext = n >= 4 ? fileName + n - 4 : "";
+	bool png = ext[0] == '.' && tolower(ext[1]) == 'p' && tolower(ext[2]) == 'n' && tolower(ext[3]) == 'g';
+	return png ? writePNG(fileName) : writePPM(fileName);
+}
@@ -0,0 +1,140 @@
+// rasterizer.h - version 1.1
+// Portable software renderer that draws the balls of a simulator into a
+// 32-bit framebuffer, for writing frames without a window.
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - added drawBalls() of a BallSnapshot
+
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include "ballssim.h"
+#include "ballstore.h"
+#include "threadpool.h"
+#include "snapshotbuffer.h"
+#include <vector>
+#include <cstdint>
+
+// The image is divided into square tiles. drawBalls() first sorts the balls
+// into lists of the tiles each overlaps, in parallel over blocks of balls,
+// then fills the tiles in parallel, one thread per tile at a time, so no two
+// threads write the same pixels. Within a tile the balls are drawn in index
+// order, so later balls cover earlier ones as in the Windows front end. A
+// pixel belongs to a ball if its centre is inside the ball.
+class Rasterizer {
+	public:
+
+		// Constants
+		// Byte order of a pixel in memory. Alpha is always 255.
+		// RGBA - as in PNG files
+		// BGRA - as in Windows 32-bit DIBs
+		enum PixelOrder { RGBA, BGRA };
+
+		// Width and height of a tile in pixels
+		static const unsigned int TILE_SIZE = 64;
+
+		// Constructors
+		Rasterizer();
+
+		// Modifier methods
+		// Sets the size of the image in pixels. The pixels are undefined
+		// until the next call to drawBalls().
+		void setSize(unsigned int width, unsigned int height);
+
+		void setPixelOrder(PixelOrder order) { pixelOrder = order; }
+
+		// Color of the pixels not covered by a ball, in the format of
+		// Ball::color() (a Windows COLORREF, 0x00BBGGRR). Default white.
+		void setBackground(unsigned long color) { background = color; }
+
+		// Maps the point (x, y) of the simulation to the top left corner of
+		// the image, with scale pixels per unit of length. The default, (0, 0)
+		// and scale 1, is that of the Windows front end.
+		void setView(double x, double y, double scale) {
+			viewX = x;
+			viewY = y;
+			viewScale = scale;
+		}
+
+		// Sets the view to show the rectangle from (x1, y1) to (x2, y2) as
+		// large as possible, centred in the image
+		void fitView(double x1, double y1, double x2, double y2);
+
+		// Set the number of threads, including the calling thread. 0 means
+		// one per hardware thread.
+		void setNumThreads(unsigned int n) { pool.setNumThreads(n); }
+
+		// Draws the balls of sim over the background
+		template <class T> void drawBalls(const BallsSimT<T> &sim) {
+			unsigned long n = sim.numBalls();
+			circles.resize(n);
+			for (unsigned long i = 0; i < n; i++) {
+				ConstBallRefT<T> b = sim.getBall(i);
+				Circle &c = circles[i];
+				c.x = float((double(b.x()) - viewX) * viewScale);
+				c.y = float((double(b.y()) - viewY) * viewScale);
+				c.r = float(double(b.r()) * viewScale);
+				c.pixel = toPixel(b.color());
+			}
+			render();
+		}
+
+		// Draws the balls of a snapshot over the background
+		void drawBalls(const BallSnapshot &snapshot);
+
+		// Writes the image to a binary PPM file (RGB, alpha dropped)
+		bool writePPM(const char *fileName) const;
+
+		// Writes the image to an RGBA PNG file
+		bool writePNG(const char *fileName) const;
+
+		// Writes a PNG file if fileName ends in .png, otherwise a PPM file
+		bool writeImage(const char *fileName) const;
+
+		// Get methods
+		unsigned int getWidth() const { return width; }
+		unsigned int getHeight() const { return height; }
+		PixelOrder getPixelOrder() const { return pixelOrder; }
+		unsigned int getNumThreads() const { return pool.numThreads(); }
+		// Pixels, row by row from the top, getWidth() per row
+		const uint32_t *pixels() const { return framebuffer.data(); }
+
+	private:
+		// A ball in pixel coordinates
+		struct Circle {
+			float x, y, r;
+			uint32_t pixel;
+		};
+
+		// Number of blocks of balls per thread the binning is split into
+		static const unsigned long CHUNKS_PER_THREAD = 4;
+		// Minimum number of balls in a block
+		static const unsigned long MIN_CHUNK_BALLS = 4096;
+
+		unsigned int width, height;
+		unsigned int tilesX, tilesY; // Number of tiles across and down
+		PixelOrder pixelOrder;
+		unsigned long background;
+		double viewX, viewY, viewScale; // See setView()
+		std::vector<uint32_t, AlignedAllocator<uint32_t> > framebuffer;
+		std::vector<Circle> circles; // Balls of the frame being drawn
+		// Indices of the circles overlapping each tile, found by each block
+		// of balls: bins[chunk * numTiles + tile]
+		std::vector<std::vector<uint32_t> > bins;
+		ThreadPool pool;
+
+		// Pixel of the given Ball::color()
+		uint32_t toPixel(unsigned long color) const;
+		// Bins and draws circles
+		void render();
+		// Adds circles [begin, end) to the bins of chunk
+		void binCircles(unsigned long chunk, unsigned long begin, unsigned long end);
+		// Fills one tile with the background and the circles binned to it
+		void drawTile(unsigned long tile, unsigned long numChunks);
+		// Copies row y of the image to out as RGB or RGBA bytes
+		void rowBytes(unsigned int y, bool alpha, unsigned char *out) const;
+};
+
+#endif
@@ -0,0 +1,37 @@
+// scalar.h - version 1.0
+// Floating point type of the simulator
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef SCALAR_H
+#define SCALAR_H
+
+// Vector2DT, BallT, WallsT, CollisionT, BallsSimT and the other simulator
+// templates work with float or double. SimScalar is the type used by the
+// plain names (Vector2D, Ball, Walls, Collision, BallsSim, ...), double
+// unless the library is built with BALLSSIM_SCALAR defined to float.
+#ifndef BALLSSIM_SCALAR
+#define BALLSSIM_SCALAR double
+#endif
+typedef BALLSSIM_SCALAR SimScalar;
+
+// Properties of a scalar type that the collision code depends on
+template <class T> struct ScalarTraits;
+
+template <> struct ScalarTraits<double> {
+	// Overlap, as a fraction of the contact distance, up to which two
+	// approaching balls (or an approaching ball and a wall) are taken to be
+	// in contact now rather than missed. Rounding in double is too small to
+	// matter, so overlapping balls are never in contact, as in version 1.0
+	// of the collision functions.
+	static double contactTolerance() { return 0.; }
+};
+
+template <> struct ScalarTraits<float> {
+	// Positions in float are only good to about 1e-7 of the size of the
+	// walls, so balls that have just touched often overlap a little
+	static float contactTolerance() { return 1e-3f; }
+};
+
+#endif
@@ -0,0 +1,291 @@
+// scenariogenerator.cpp - version 1.0
+// Functions declared in scenariogenerator.h.
+// See scenariogenerator.h for documentation of functions.
+
+#include "scenariogenerator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	const double PI = 3.141592653589793;
+	// Balls per task of the loops over balls
+	const unsigned long CHUNK_BALLS = 4096;
+	// Stream of the numbers that deal the balls to the cells, past those of any ball
+	const uint64_t CELL_ORDER_STREAM = ~0ULL;
+	// Passes of random sequential addition, each retrying the balls the
+	// last left out
+	const unsigned int MAX_PASSES = 8;
+	// Iterations of the search for the spacing of a lattice
+	const int SPACING_ITERATIONS = 60;
+}
+
+ScenarioGenerator::ScenarioGenerator() {
+	method = RANDOM_SEQUENTIAL;
+	minRadius = 5.;
+	maxRadius = 20.;
+	minVelocity = 0.;
+	maxVelocity = 200.;
+	massToArea = .1;
+	maxColor = 0xE0E0E0;
+	maxAttempts = 100;
+	maxObstacleR = 0.;
+}
+
+void ScenarioGenerator::setObstacles(const double *x, const double *y, const double *r, unsigned long n) {
+	obstacleX.assign(x, x + n);
+	obstacleY.assign(y, y + n);
+	obstacleR.assign(r, r + n);
+	maxObstacleR = 0.;
+	for (unsigned long i = 0; i < n; i++) maxObstacleR = std::max(maxObstacleR, r[i]);
+}
+
+double ScenarioGenerator::meanArea() const {
+	// Mean of r^2 for r uniform in [a, b] is (a^2 + ab + b^2) / 3
+	return PI * (minRadius * minRadius + minRadius * maxRadius + maxRadius * maxRadius) / 3.;
+}
+
+WallsT<double> ScenarioGenerator::wallsForPackingFraction(unsigned long n, double fraction, double aspect) const {
+	double area = double(n) * meanArea() / fraction;
+	double width = std::sqrt(area * aspect);
+	return WallsT<double>(0., 0., width, area / width);
+}
+
+unsigned long ScenarioGenerator::generate(unsigned long n, const WallsT<double> &walls, std::vector<BallT<double> > &balls) {
+	if (n == 0) return 0;
+	std::vector<BallT<double> > out(n);
+	std::vector<char> placed(n, 0); // Not vector<bool>: threads write neighbouring elements
+
+	unsigned long numChunks = (n + CHUNK_BALLS - 1) / CHUNK_BALLS;
+	pool.run(numChunks, [&](unsigned long chunk) {
+		unsigned long end = std::min(n, (chunk + 1) * CHUNK_BALLS);
+		for (unsigned long i = chunk * CHUNK_BALLS; i < end; i++) drawBall(i, out[i]);
+	});
+
+	if (walls.x2() - walls.x1() < 2. * minRadius || walls.y2() - walls.y1() < 2. * minRadius) return 0;
+	if (method == RANDOM_SEQUENTIAL) placeRandom(walls, out, placed);
+	else placeLattice(walls, out, placed);
+
+	unsigned long numPlaced = 0;
+	for (unsigned long i = 0; i < n; i++) {
+		if (!placed[i]) continue;
+		out[i].setID(int(numPlaced++));
+		balls.push_back(out[i]);
+	}
+	return numPlaced;
+}
+
+void ScenarioGenerator::drawBall(unsigned long i, BallT<double> &b) const {
+	double r = rng.uniform(i, DRAW_R, minRadius, maxRadius);
+	b.setR(r);
+	b.setM(massToArea * PI * r * r);
+	b.setVXY(rng.uniform(i, DRAW_VX, minVelocity, maxVelocity), rng.uniform(i, DRAW_VY, minVelocity, maxVelocity));
+	b.setColor((unsigned long)rng.uniform(i, DRAW_COLOR, 0., double(maxColor)));
+	b.setID(int(i));
+}
+
+void ScenarioGenerator::placeRandom(const WallsT<double> &walls, std::vector<BallT<double> > &out, std::vector<char> &placed) {
+	const unsigned long n = (unsigned long)out.size();
+	const double width = walls.x2() - walls.x1();
+	const double height = walls.y2() - walls.y1();
+
+	// Cells at least as wide as the largest ball, so balls of cells that are
+	// not neighbours cannot overlap, and at least as wide as the sum of the
+	// radii of a new ball and an obstacle, so only the fixed balls of the
+	// neighbouring cells need checking
+	Grid grid;
+	double minCell = std::max(2. * maxRadius, maxRadius + maxObstacleR);
+	grid.x1 = walls.x1();
+	grid.y1 = walls.y1();
+	grid.nx = std::max(1UL, (unsigned long)(width / minCell));
+	grid.ny = std::max(1UL, (unsigned long)(height / minCell));
+	grid.cellW = width / double(grid.nx);
+	grid.cellH = height / double(grid.ny);
+	const unsigned long numCells = grid.nx * grid.ny;
+	grid.fixedX = obstacleX;
+	grid.fixedY = obstacleY;
+	grid.fixedR = obstacleR;
+
+	std::vector<unsigned long> pending(n); // Balls still to place, in increasing order
+	for (unsigned long i = 0; i < n; i++) pending[i] = i;
+	std::vector<unsigned long> order(numCells), rank(numCells), failed;
+
+	for (unsigned int pass = 0; pass < MAX_PASSES && !pending.empty(); pass++) {
+		sortFixed(grid);
+
+		// Deal the pending balls to the cells in a random order of the
+		// cells, so that when there are fewer balls than cells in the last
+		// round they are spread evenly. The q-th pending ball goes to the
+		// cell of rank q % numCells, in round q / numCells; conversely the
+		// ball of cell c in round p is the (p * numCells + rank[c])-th.
+		const unsigned long numPending = (unsigned long)pending.size();
+		for (unsigned long c = 0; c < numCells; c++) order[c] = c;
+		for (unsigned long c = numCells - 1; c > 0; c--)
+			std::swap(order[c], order[rng.bits(CELL_ORDER_STREAM - pass, c) % (c + 1)]);
+		for (unsigned long c = 0; c < numCells; c++) rank[order[c]] = c;
+		const unsigned long numRounds = (numPending + numCells - 1) / numCells;
+
+		// Places the ball of cell (cx, cy) in round p
+		auto placeInCell = [&](unsigned long cx, unsigned long cy, unsigned long p) {
+			unsigned long q = p * numCells + rank[cy * grid.nx + cx];
+			if (q >= numPending) return;
+			unsigned long i = pending[q];
+			BallT<double> &b = out[i];
+			double r = b.r();
+			double cellX = grid.x1 + double(cx) * grid.cellW;
+			double cellY = grid.y1 + double(cy) * grid.cellH;
+			double loX = std::max(cellX, walls.x1() + r), hiX = std::min(cellX + grid.cellW, walls.x2() - r);
+			double loY = std::max(cellY, walls.y1() + r), hiY = std::min(cellY + grid.cellH, walls.y2() - r);
+			if (loX > hiX || loY > hiY) return;
+			unsigned long cx1 = cx > 0 ? cx - 1 : 0, cx2 = std::min(cx + 1, grid.nx - 1);
+			unsigned long cy1 = cy > 0 ? cy - 1 : 0, cy2 = std::min(cy + 1, grid.ny - 1);
+
+			for (unsigned int a = 0; a < maxAttempts; a++) {
+				uint64_t draw = (uint64_t(pass) * maxAttempts + a) * DRAWS_PER_TRY;
+				double x = rng.uniform(i, DRAW_X + draw, loX, hiX);
+				double y = rng.uniform(i, DRAW_Y + draw, loY, hiY);
+				bool free = !hitsFixed(grid, cx, cy, x, y, r);
+				// Balls of this pass in the neighbouring cells, which are of
+				// other colours and so not being placed now, and in earlier
+				// rounds of this cell
+				for (unsigned long ny = cy1; free && ny <= cy2; ny++) {
+					for (unsigned long nx = cx1; free && nx <= cx2; nx++) {
+						for (unsigned long q2 = rank[ny * grid.nx + nx]; q2 < numPending; q2 += numCells) {
+							unsigned long j = pending[q2];
+							if (!placed[j]) continue;
+							double dx = out[j].x() - x, dy = out[j].y() - y, sr = out[j].r() + r;
+							if (dx * dx + dy * dy <= sr * sr) {
+								free = false;
+								break;
+							}
+						}
+					}
+				}
+				if (free) {
+					b.setXY(x, y);
+					placed[i] = 1;
+					return;
+				}
+			}
+		};
+
+		// In each round, the four colours of cells in turn, each in parallel
+		// over the rows of cells of that colour
+		for (unsigned long p = 0; p < numRounds; p++) {
+			for (unsigned int colour = 0; colour < 4; colour++) {
+				unsigned long ox = colour & 1, oy = colour >> 1;
+				if (oy >= grid.ny || ox >= grid.nx) continue;
+				pool.run((grid.ny - oy + 1) / 2, [&](unsigned long row) {
+					unsigned long cy = oy + 2 * row;
+					for (unsigned long cx = ox; cx < grid.nx; cx += 2) placeInCell(cx, cy, p);
+				});
+			}
+		}
+
+		// The balls placed become fixed; the others try again in the next
+		// pass, most likely in other cells
+		failed.clear();
+		for (unsigned long q = 0; q < numPending; q++) {
+			unsigned long i = pending[q];
+			if (placed[i]) {
+				grid.fixedX.push_back(out[i].x());
+				grid.fixedY.push_back(out[i].y());
+				grid.fixedR.push_back(out[i].r());
+			}
+			else failed.push_back(i);
+		}
+		if (failed.size() == pending.size()) break;
+		pending.swap(failed);
+	}
+}
+
+void ScenarioGenerator::sortFixed(Grid &grid) {
+	unsigned long numCells = grid.nx * grid.ny;
+	unsigned long numFixed = (unsigned long)grid.fixedX.size();
+	std::vector<unsigned long> fixedCell(numFixed);
+	grid.fixedStart.assign(numCells + 1, 0);
+	for (unsigned long k = 0; k < numFixed; k++) {
+		double fx = std::floor((grid.fixedX[k] - grid.x1) / grid.cellW);
+		double fy = std::floor((grid.fixedY[k] - grid.y1) / grid.cellH);
+		unsigned long cx = (unsigned long)std::min(std::max(fx, 0.), double(grid.nx - 1));
+		unsigned long cy = (unsigned long)std::min(std::max(fy, 0.), double(grid.ny - 1));
+		fixedCell[k] = cy * grid.nx + cx;
+		grid.fixedStart[fixedCell[k] + 1]++;
+	}
+	for (unsigned long c = 0; c < numCells; c++) grid.fixedStart[c + 1] += grid.fixedStart[c];
+	grid.cellFixed.resize(numFixed);
+	std::vector<unsigned long> fill(grid.fixedStart.begin(), grid.fixedStart.end() - 1);
+	for (unsigned long k = 0; k < numFixed; k++) grid.cellFixed[fill[fixedCell[k]]++] = k;
+}
+
+bool ScenarioGenerator::hitsFixed(const Grid &grid, unsigned long cx, unsigned long cy, double x, double y, double r) const {
+	if (grid.cellFixed.empty()) return false;
+	unsigned long cx1 = cx > 0 ? cx - 1 : 0, cx2 = std::min(cx + 1, grid.nx - 1);
+	unsigned long cy1 = cy > 0 ? cy - 1 : 0, cy2 = std::min(cy + 1, grid.ny - 1);
+	for (unsigned long ny = cy1; ny <= cy2; ny++) {
+		for (unsigned long nx = cx1; nx <= cx2; nx++) {
+			unsigned long c = ny * grid.nx + nx;
+			for (unsigned long s = grid.fixedStart[c]; s < grid.fixedStart[c + 1]; s++) {
+				unsigned long k = grid.cellFixed[s];
+				double dx = grid.fixedX[k] - x, dy = grid.fixedY[k] - y, sr = grid.fixedR[k] + r;
+				if (dx * dx + dy * dy <= sr * sr) return true;
+			}
+		}
+	}
+	return false;
+}
+
+void ScenarioGenerator::placeLattice(const WallsT<double> &walls, std::vector<BallT<double> > &out, std::vector<char> &placed) {
+	const unsigned long n = (unsigned long)out.size();
+	const double width = walls.x2() - walls.x1();
+	const double height = walls.y2() - walls.y1();
+	const bool hex = method == HEX_LATTICE;
+	const double rowRatio = hex ? std::sqrt(3.) / 2. : 1.; // Row spacing / spacing
+
+	// Sites across and down for spacing s. Odd rows of the hexagonal lattice
+	// are shifted by s / 2.
+	auto siteCounts = [&](double s, unsigned long &cols, unsigned long &rows) {
+		double usableW = hex ? width - s / 2. : width;
+		cols = usableW >= s ? (unsigned long)(usableW / s) : 0;
+		rows = height >= s ? (unsigned long)((height - s) / (s * rowRatio)) + 1 : 0;
+	};
+
+	// Widest spacing with room for n sites, by bisection: the number of
+	// sites only falls as the spacing grows
+	double lo = 2. * maxRadius, hi = std::max(width, height);
+	unsigned long cols, rows;
+	siteCounts(lo, cols, rows);
+	if (double(cols) * double(rows) >= double(n)) {
+		for (int k = 0; k < SPACING_ITERATIONS && hi > lo; k++) {
+			double mid = .5 * (lo + hi);
+			siteCounts(mid, cols, rows);
+			if (double(cols) * double(rows) >= double(n)) lo = mid;
+			else hi = mid;
+		}
+	}
+	const double s = lo;
+	siteCounts(s, cols, rows);
+	if (cols == 0 || rows == 0) return;
+	const unsigned long numSites = std::min(n, cols * rows);
+
+	// Centre the lattice in the walls
+	double usedW = double(cols) * s + (hex && rows > 1 ? s / 2. : 0.);
+	double usedH = double(rows - 1) * s * rowRatio + s;
+	const double originX = walls.x1() + (width - usedW) / 2. + s / 2.;
+	const double originY = walls.y1() + (height - usedH) / 2. + s / 2.;
+
+	unsigned long numChunks = (numSites + CHUNK_BALLS - 1) / CHUNK_BALLS;
+	pool.run(numChunks, [&](unsigned long chunk) {
+		unsigned long end = std::min(numSites, (chunk + 1) * CHUNK_BALLS);
+		for (unsigned long i = chunk * CHUNK_BALLS; i < end; i++) {
+			unsigned long row = i / cols, col = i % cols;
+			double x = originX + double(col) * s + (hex && (row & 1) ? s / 2. : 0.);
+			double y = originY + double(row) * s * rowRatio;
+			// Neighbouring sites are s apart, so moving each ball by at most
+			// s / 2 - r keeps it clear of its neighbours and the walls
+			double jitter = std::max(0., s / 2. - out[i].r()) * std::sqrt(rng.uniform(i, DRAW_X));
+			double angle = 2. * PI * rng.uniform(i, DRAW_Y);
+			out[i].setXY(x + jitter * std::cos(angle), y + jitter * std::sin(angle));
+			placed[i] = 1;
+		}
+	});
+}
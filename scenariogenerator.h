@@ -0,0 +1,129 @@
+// scenariogenerator.h - version 1.0
+// Generates initial states: balls with random radii, velocities and colors,
+// placed inside the walls without overlapping each other.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef SCENARIOGENERATOR_H
+#define SCENARIOGENERATOR_H
+
+#include "ball.h"
+#include "walls.h"
+#include "counterrng.h"
+#include "threadpool.h"
+#include <cstdint>
+#include <vector>
+
+// Ball i takes its radius, velocity and color from the numbers of stream i
+// of a CounterRng, and its position from further numbers of the same
+// stream, so the result depends only on the settings and the seed, not on
+// the number of threads.
+//
+// Placement methods:
+// RANDOM_SEQUENTIAL - random sequential addition: each ball is tried at
+//   random positions until it overlaps no ball placed before it. The walls
+//   are divided into cells at least as wide as the largest ball, which are
+//   given the balls in turn and coloured in a 2x2 pattern; cells of one
+//   colour are never neighbours, so all of them place a ball at the same
+//   time on separate threads. A ball that finds no room in its cell after
+//   getMaxAttempts() tries is dealt to another cell in the next pass, and
+//   left out if the passes run out. Random packings jam at a fraction of
+//   about .55 for equal balls, so higher fractions need a lattice.
+// SQUARE_LATTICE, HEX_LATTICE - balls on the sites of a lattice as widely
+//   spaced as the walls allow for the number of balls, each moved at random
+//   within the space the spacing leaves around it. Equal balls fill at most
+//   .785 of the area on a square lattice and .907 on a hexagonal one.
+class ScenarioGenerator {
+	public:
+
+		// Constants
+		enum Method { RANDOM_SEQUENTIAL, SQUARE_LATTICE, HEX_LATTICE };
+
+		// Constructors
+		// The defaults are those of "Add 10 random balls" in the Windows
+		// front end
+		ScenarioGenerator();
+
+		// Set methods
+		void setMethod(Method m) { method = m; }
+		void setSeed(uint64_t seed) { rng = CounterRng(seed); }
+		// Radii uniform in [minR, maxR] (default 5 to 20)
+		void setRadiusRange(double minR, double maxR) { minRadius = minR; maxRadius = maxR; }
+		// Each velocity component uniform in [minV, maxV] (default 0 to 200)
+		void setVelocityRange(double minV, double maxV) { minVelocity = minV; maxVelocity = maxV; }
+		// Mass of a ball = ratio * area (default .1)
+		void setMassToAreaRatio(double ratio) { massToArea = ratio; }
+		// Colors uniform in [0, maxColor] (default 0xE0E0E0, never white)
+		void setMaxColor(unsigned long c) { maxColor = c; }
+		// Tries per ball of RANDOM_SEQUENTIAL (default 100)
+		void setMaxAttempts(unsigned int n) { maxAttempts = n; }
+		// Set the number of threads, including the calling thread. 0 means
+		// one per hardware thread.
+		void setNumThreads(unsigned int n) { pool.setNumThreads(n); }
+
+		// Balls already in the walls that new balls must not overlap, e.g.
+		// those of a running simulation. The arrays are copied. Only
+		// RANDOM_SEQUENTIAL avoids obstacles.
+		void setObstacles(const double *x, const double *y, const double *r, unsigned long n);
+		void clearObstacles() { setObstacles(0, 0, 0, 0); }
+
+		// Other methods
+		// Appends up to n balls placed inside walls to balls, with IDs
+		// numbered from 0 (BallsSim::addBalls() gives them new ones). Returns the
+		// number of balls placed, less than n if there was no room for all.
+		unsigned long generate(unsigned long n, const WallsT<double> &walls, std::vector<BallT<double> > &balls);
+
+		// Walls from (0, 0) with width / height = aspect in which n balls
+		// fill the given fraction of the area, on average
+		WallsT<double> wallsForPackingFraction(unsigned long n, double fraction, double aspect = 1.) const;
+
+		// Get methods
+		Method getMethod() const { return method; }
+		uint64_t getSeed() const { return rng.seed(); }
+		unsigned int getMaxAttempts() const { return maxAttempts; }
+		unsigned int getNumThreads() const { return pool.numThreads(); }
+		// Mean area of a ball
+		double meanArea() const;
+
+	private:
+		// Numbers of the stream of a ball
+		enum { DRAW_R, DRAW_VX, DRAW_VY, DRAW_COLOR, DRAW_X, DRAW_Y };
+		// Stride between the numbers of successive tries of RANDOM_SEQUENTIAL
+		static const uint64_t DRAWS_PER_TRY = 2;
+
+		Method method;
+		CounterRng rng;
+		double minRadius, maxRadius;
+		double minVelocity, maxVelocity;
+		double massToArea;
+		unsigned long maxColor;
+		unsigned int maxAttempts;
+		ThreadPool pool;
+
+		std::vector<double> obstacleX, obstacleY, obstacleR; // See setObstacles()
+		double maxObstacleR;
+
+		// Cells of a random sequential addition
+		struct Grid {
+			double x1, y1; // Corner of cell (0, 0)
+			double cellW, cellH;
+			unsigned long nx, ny;
+			// Obstacles and balls placed in earlier passes. Those of cell c
+			// are cellFixed[fixedStart[c]] to cellFixed[fixedStart[c + 1] - 1].
+			std::vector<double> fixedX, fixedY, fixedR;
+			std::vector<unsigned long> fixedStart, cellFixed;
+		};
+
+		// Sets the properties of ball i other than its position
+		void drawBall(unsigned long i, BallT<double> &b) const;
+		// Placement methods. Set placed[i] for the balls placed.
+		void placeRandom(const WallsT<double> &walls, std::vector<BallT<double> > &out, std::vector<char> &placed);
+		void placeLattice(const WallsT<double> &walls, std::vector<BallT<double> > &out, std::vector<char> &placed);
+		// Sorts the fixed balls of grid into its cells
+		static void sortFixed(Grid &grid);
+		// Does a ball at (x, y) of radius r overlap a fixed ball near cell (cx, cy)?
+		bool hitsFixed(const Grid &grid, unsigned long cx, unsigned long cy, double x, double y, double r) const;
+};
+
+#endif
@@ -0,0 +1,647 @@
+// sectorsim.cpp - version 1.2
+// Functions declared in sectorsim.h.
+// See sectorsim.h for documentation of functions.
+
+#include "sectorsim.h"
+#include "ballssim.h"
+#include "boundingbox.h"
+#include "collision.h"
+#include <algorithm>
+#include <cassert>
+
+// STATS(statement) runs statement only if the performance counters are enabled
+#ifdef BALLSSIM_STATS
+#include <chrono>
+#define STATS(statement) statement
+
+// Current time in nanoseconds, for the phase timers
+static unsigned long long nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#else
+#define STATS(statement)
+#endif
+
+template <class T>
+const double SectorSimT<T>::ZONE_DIAMETERS = 1.05;
+
+template <class T>
+bool SectorSimT<T>::advance(BallsSimT<T> &owner, T dt, unsigned int &numCollisions) {
+	sim = &owner;
+	horizon = dt;
+	if (!split()) return false;
+	STATS(unsigned long long start = nowNs());
+
+	unsigned long n = sim->numBalls();
+	savedX.assign(sim->balls.x(), sim->balls.x() + n);
+	savedY.assign(sim->balls.y(), sim->balls.y() + n);
+	savedVX.assign(sim->balls.vx(), sim->balls.vx() + n);
+	savedVY.assign(sim->balls.vy(), sim->balls.vy() + n);
+	maxCount.assign(n, 0);
+	strips.resize(numStrips);
+	for (unsigned int s = 0; s < numStrips; s++) {
+		Strip &strip = strips[s];
+		strip.events = EventQueue();
+		strip.outbox.clear();
+		strip.undo.clear();
+		strip.readMark = -HUGE_VAL;
+		strip.collisions = 0;
+		strip.stats.reset();
+	}
+	zones.assign(numStrips - 1, EventQueue());
+	std::vector<std::atomic<double> >(numStrips - 1).swap(floors);
+	serialCollisions = 0;
+	serialStats.reset();
+	roundStats.reset();
+
+	assignRegions();
+	predictAll();
+	STATS(unsigned long long predicted = nowNs());
+
+	if (!runRounds()) {
+		restoreFrame();
+		STATS(sim->frameStats.isectorFallbacks = 1);
+		return false;
+	}
+
+	numCollisions = serialCollisions;
+	SimStats &stats = sim->frameStats;
+	for (unsigned int r = 0; r < numRegions(); r++) {
+		stats += regions[r].stats;
+	}
+	for (unsigned int s = 0; s < numStrips; s++) {
+		numCollisions += strips[s].collisions;
+		stats += strips[s].stats;
+	}
+	stats += serialStats;
+	stats += roundStats;
+	STATS(stats.ipredictNs = predicted - start);
+	STATS(stats.ieventNs = nowNs() - predicted);
+	return true;
+}
+
+template <class T>
+bool SectorSimT<T>::split() {
+	unsigned int n = numRequested == 0 ? sim->pool.numThreads() : numRequested;
+	if (n < 2 || !sim->hasWalls() || !(sim->maxDiameter > 0)) return false;
+
+	// Each strip must leave room for more than a ball between its zones
+	double x1 = sim->walls.x1();
+	double width = sim->walls.x2() - x1;
+	double diameter = sim->maxDiameter;
+	double fit = std::floor(width / (MIN_STRIP_DIAMETERS * diameter));
+	if (fit < n) n = (unsigned int)fit;
+	if (n < 2) return false;
+	numStrips = n;
+
+	double halfZone = 0.5 * ZONE_DIAMETERS * diameter;
+	edge.resize(2 * n);
+	edge[0] = -HUGE_VAL;
+	for (unsigned int k = 1; k < n; k++) {
+		double boundary = x1 + width * k / n;
+		edge[2 * k - 1] = boundary - halfZone;
+		edge[2 * k] = boundary + halfZone;
+	}
+	edge[2 * n - 1] = HUGE_VAL;
+	return true;
+}
+
+template <class T>
+void SectorSimT<T>::assignRegions() {
+	STATS(unsigned long long start = nowNs());
+	unsigned long n = sim->numBalls();
+	regions.resize(numRegions());
+	for (unsigned int r = 0; r < numRegions(); r++) {
+		regions[r].members.clear();
+	}
+	region.resize(n);
+	slot.resize(n);
+	const T *x = sim->balls.x();
+	for (unsigned long i = 0; i < n; i++) {
+		unsigned int r = (unsigned int)(std::upper_bound(edge.begin(), edge.end(), double(x[i])) - edge.begin()) - 1;
+		region[i] = r;
+		slot[i] = regions[r].members.size();
+		regions[r].members.push_back(i);
+	}
+
+	// The grid of a region covers its part of the walls; boxes reaching out
+	// of it are clamped into its edge cells
+	const WallsT<T> &walls = sim->walls;
+	sim->pool.run(numRegions(), [&](unsigned long r) {
+		Region &g = regions[r];
+		g.boxes.resize(g.members.size());
+		for (unsigned long k = 0; k < g.members.size(); k++) {
+			g.boxes[k] = BoundingBox::swept(sim->balls[g.members[k]], horizon);
+		}
+		BoundingBox bounds(std::max(edge[r], double(walls.x1())), walls.y1(), std::min(edge[r + 1], double(walls.x2())),
+			walls.y2());
+		g.grid.rebuild(bounds, sim->maxDiameter, g.boxes);
+	});
+	STATS(roundStats.ibroadPhaseNs += nowNs() - start);
+}
+
+template <class T>
+void SectorSimT<T>::predictAll() {
+	// Each region predicts the events of its balls and the collisions of its
+	// balls with those of the next region. Local events go straight to the
+	// queue of the strip, which only this region fills; boundary events are
+	// queued afterwards, in region order.
+	sim->pool.run(numRegions(), [&](unsigned long r) {
+		Region &g = regions[r];
+		g.found.clear();
+		g.stats.reset();
+		EventQueue *local = r % 2 == 0 ? &strips[r / 2].events : 0;
+		SimEvent e;
+		for (unsigned long k = 0; k < g.members.size(); k++) {
+			unsigned long i = g.members[k];
+			STATS(g.stats.iwallTests++);
+			if (sim->findWallEvent(i, horizon, e)) {
+				if (local != 0) local->push(e);
+				else g.found.push_back(e);
+				STATS(g.stats.ieventsQueued++);
+			}
+			if (findCrossing(i, e)) {
+				g.found.push_back(e);
+				STATS(g.stats.ieventsQueued++);
+			}
+		}
+		g.grid.forEachPair([&](unsigned long a, unsigned long b) {
+			unsigned long i = std::min(g.members[a], g.members[b]);
+			unsigned long j = std::max(g.members[a], g.members[b]);
+			STATS(g.stats.ipairTests++);
+			if (sim->findPairEvent(i, j, horizon, e)) {
+				if (local != 0) local->push(e);
+				else g.found.push_back(e);
+				STATS(g.stats.ieventsQueued++);
+			}
+		});
+		if (r + 1 < numRegions()) {
+			const Region &next = regions[r + 1];
+			for (unsigned long b = 0; b < next.members.size(); b++) {
+				g.grid.forEachOverlap(next.grid.box(b), [&](unsigned long a) {
+					unsigned long i = std::min(g.members[a], next.members[b]);
+					unsigned long j = std::max(g.members[a], next.members[b]);
+					STATS(g.stats.ipairTests++);
+					if (sim->findPairEvent(i, j, horizon, e)) {
+						g.found.push_back(e);
+						STATS(g.stats.ieventsQueued++);
+					}
+				});
+			}
+		}
+	});
+	for (unsigned int r = 0; r < numRegions(); r++) {
+		const std::vector<SimEvent> &found = regions[r].found;
+		for (unsigned long k = 0; k < found.size(); k++) {
+			zones[zoneOf(found[k])].push(found[k]);
+		}
+	}
+}
+
+template <class T>
+bool SectorSimT<T>::runRounds() {
+	for (;;) {
+		// Parallel part: the strips run up to the boundary events next to them
+		for (unsigned int k = 0; k + 1 < numStrips; k++) {
+			floors[k].store(zoneTop(k), std::memory_order_relaxed);
+		}
+		roundBudget = sim->maxCollisions - collisionsSoFar();
+		sim->pool.run(numStrips, [&](unsigned long s) { runStrip((unsigned int)s); });
+		for (unsigned int s = 0; s < numStrips; s++) {
+			std::vector<SimEvent> &outbox = strips[s].outbox;
+			for (unsigned long k = 0; k < outbox.size(); k++) {
+				zones[zoneOf(outbox[k])].push(outbox[k]);
+			}
+			outbox.clear();
+		}
+		STATS(roundStats.isectorRounds++);
+
+		// The serial simulator would have stopped at its limit
+		if (collisionsSoFar() > sim->maxCollisions) return false;
+
+		// Serial part
+		if (!runBoundary()) return false;
+
+		// No event can be rolled back to before the earliest event left
+		double earliest = HUGE_VAL;
+		for (unsigned int k = 0; k + 1 < numStrips; k++) {
+			earliest = std::min(earliest, zoneTop(k));
+		}
+		for (unsigned int s = 0; s < numStrips; s++) {
+			earliest = std::min(earliest, nextLocal(s));
+		}
+		if (earliest == HUGE_VAL) return true;
+		for (unsigned int s = 0; s < numStrips; s++) {
+			std::deque<Undo> &undo = strips[s].undo;
+			while (!undo.empty() && undo.front().time < earliest) undo.pop_front();
+		}
+	}
+}
+
+template <class T>
+void SectorSimT<T>::runStrip(unsigned int s) {
+	Strip &strip = strips[s];
+	unsigned long limit = strip.collisions + roundBudget; // Over it, the frame is over the limit whatever the others do
+	while (!strip.events.empty() && strip.collisions <= limit) {
+		const SimEvent e = strip.events.top();
+		double cap = horizon;
+		if (s > 0) cap = std::min(cap, floors[s - 1].load(std::memory_order_relaxed));
+		if (s + 1 < numStrips) cap = std::min(cap, floors[s].load(std::memory_order_relaxed));
+		if (!(e.time() < cap)) break;
+		strip.events.pop();
+		if (!sim->isEventValid(e)) {
+			STATS(strip.stats.istaleEvents++);
+			continue;
+		}
+
+		// One of the balls has moved into a zone since the event was predicted
+		unsigned int home;
+		if (!isLocal(e, home) || home != s) {
+			strip.outbox.push_back(e);
+			lowerFloor(zoneOf(e), e.time());
+			continue;
+		}
+		if (processEvent(e, s)) strip.collisions++;
+	}
+}
+
+template <class T>
+bool SectorSimT<T>::runBoundary() {
+	for (;;) {
+		// Find the earliest boundary event that is ready, dropping stale ones.
+		// An event made stale by a collision of a strip that may be rolled
+		// back is kept until the strip has caught up.
+		movedEvents = false;
+		unsigned int best = numStrips;
+		double bestTime = HUGE_VAL;
+		for (unsigned int k = 0; k + 1 < numStrips && !movedEvents; k++) {
+			while (!zones[k].empty()) {
+				const SimEvent &e = zones[k].top();
+				if (sim->isEventValid(e) || sim->ballTime[e.ball1()] > e.time() ||
+					sim->ballTime[e.ball2()] > e.time()) break;
+				zones[k].pop();
+				STATS(serialStats.istaleEvents++);
+			}
+			if (zones[k].empty() || !(zones[k].top().time() < bestTime)) continue;
+			if (isReady(zones[k].top())) {
+				best = k;
+				bestTime = zones[k].top().time();
+			}
+		}
+		if (movedEvents) continue;
+		if (best == numStrips) return true;
+
+		SimEvent e = zones[best].top();
+		unsigned int lo, hi;
+		touchedStrips(e, lo, hi);
+		for (unsigned int s = lo; s <= hi; s++) {
+			// A boundary event already processed depends on the strip as it
+			// was after this event
+			if (strips[s].readMark > e.time()) return false;
+		}
+		bool rolledBack = false;
+		for (unsigned int s = lo; s <= hi; s++) {
+			if (!strips[s].undo.empty() && strips[s].undo.back().time > e.time()) {
+				rollBack(s, e.time());
+				rolledBack = true;
+			}
+		}
+		if (rolledBack) continue; // The rollback may have queued earlier events
+
+		zones[best].pop();
+		if (!sim->isEventValid(e)) {
+			STATS(serialStats.istaleEvents++);
+			continue;
+		}
+		for (unsigned int s = lo; s <= hi; s++) {
+			strips[s].readMark = e.time();
+		}
+		if (processEvent(e, SERIAL)) {
+			serialCollisions++;
+			STATS(serialStats.iboundaryEvents++);
+
+			// The serial simulator would have stopped at its limit
+			if (collisionsSoFar() > sim->maxCollisions) return false;
+		}
+	}
+}
+
+template <class T>
+bool SectorSimT<T>::isReady(const SimEvent &e) {
+	// The strips the event depends on must have processed their events
+	// before it, and so must those next to them, which could otherwise
+	// still queue earlier boundary events in the zones between
+	unsigned int lo, hi;
+	touchedStrips(e, lo, hi);
+	unsigned int first = lo > 0 ? lo - 1 : 0;
+	unsigned int last = hi + 1 < numStrips ? hi + 1 : hi;
+	for (unsigned int s = first; s <= last; s++) {
+		double next = nextLocal(s);
+		if (movedEvents || next < e.time()) return false;
+	}
+	for (unsigned int k = first; k < last; k++) {
+		if (zoneTop(k) < e.time()) return false;
+	}
+	return true;
+}
+
+template <class T>
+bool SectorSimT<T>::processEvent(const SimEvent &e, unsigned int owner) {
+	SimStats &stats = statsOf(owner);
+	unsigned long b1 = e.ball1();
+	if (e.isCrossingEvent()) {
+		// A rollback may have predicted the same crossing again; only the
+		// crossing the ball is due for now moves it
+		SimEvent due;
+		if (!findCrossing(b1, due) || due.time() != e.time()) {
+			STATS(stats.istaleEvents++);
+			return false;
+		}
+		bool right = sim->balls.vx()[b1] > 0;
+		unsigned int to = right ? region[b1] + 1 : region[b1] - 1;
+		moveToRegion(b1, to);
+
+		// The ball keeps its events; only the region beyond its new one is new to it
+		if (right && to + 1 < numRegions()) predictBall(b1, b1, to + 1, to + 1, owner);
+		else if (!right && to > 0) predictBall(b1, b1, to - 1, to - 1, owner);
+		if (findCrossing(b1, due)) {
+			queue(due, owner);
+			STATS(stats.ieventsQueued++);
+		}
+		return false;
+	}
+	if (!e.isWallEvent() && sim->isRepeatContact(b1, e.ball2())) { // Contact just handled, found again after rounding
+		STATS(stats.istaleEvents++);
+		return false;
+	}
+
+	// As in BallsSim::advanceSim()
+	if (owner != SERIAL) save(owner, e.time(), b1, e.isWallEvent() ? WALL_COLLISION : BALL_COLLISION);
+	sim->advanceBallTo(b1, e.time());
+	BallRefT<T> r1 = sim->balls[b1];
+	if (e.isWallEvent()) {
+		doElasticCollisionWithWall(r1, e.wall());
+		newCount(b1);
+		sim->lastPartner[b1] = sim->numBalls();
+		updateBox(b1);
+		predictBall(b1, b1, owner);
+		STATS(stats.iwallCollisions++);
+	}
+	else {
+		unsigned long b2 = e.ball2();
+		if (owner != SERIAL) save(owner, e.time(), b2, SECOND_BALL);
+		sim->advanceBallTo(b2, e.time());
+		BallRefT<T> r2 = sim->balls[b2];
+		doElasticCollisionTwoBalls(r1, r2);
+		newCount(b1);
+		newCount(b2);
+		sim->lastPartner[b1] = b2;
+		sim->lastPartner[b2] = b1;
+		updateBox(b1);
+		updateBox(b2);
+		predictBall(b1, b1, owner);
+		predictBall(b2, b1, owner);
+		STATS(stats.iballCollisions++);
+	}
+	return true;
+}
+
+template <class T>
+void SectorSimT<T>::moveToRegion(unsigned long i, unsigned int to) {
+	// The last ball of the old region takes the place of ball i
+	Region &from = regions[region[i]];
+	unsigned long k = slot[i];
+	BoundingBox box = from.grid.box(k);
+	unsigned long last = from.members.back();
+	if (last != i) {
+		BoundingBox lastBox = from.grid.box(from.members.size() - 1);
+		from.members[k] = last;
+		slot[last] = k;
+		from.grid.update(k, lastBox);
+	}
+	from.members.pop_back();
+	from.grid.removeLast();
+
+	Region &into = regions[to];
+	region[i] = to;
+	slot[i] = into.members.size();
+	into.members.push_back(i);
+	into.grid.add(box);
+}
+
+template <class T>
+void SectorSimT<T>::predictBall(unsigned long i, unsigned long exclude, unsigned int first, unsigned int last,
+	unsigned int owner) {
+	SimStats &stats = statsOf(owner);
+	BoundingBox box = regions[region[i]].grid.box(slot[i]);
+	SimEvent e;
+	for (unsigned int r = first; r <= last; r++) {
+		const Region &g = regions[r];
+		g.grid.forEachOverlap(box, [&](unsigned long a) {
+			unsigned long j = g.members[a];
+			if (j == i || j == exclude) return;
+			STATS(stats.ipairTests++);
+			if (sim->findPairEvent(i, j, horizon, e)) {
+				queue(e, owner);
+				STATS(stats.ieventsQueued++);
+			}
+		});
+	}
+}
+
+template <class T>
+void SectorSimT<T>::predictBall(unsigned long i, unsigned long exclude, unsigned int owner) {
+	SimStats &stats = statsOf(owner);
+	SimEvent e;
+	STATS(stats.iwallTests++);
+	if (sim->findWallEvent(i, horizon, e)) {
+		queue(e, owner);
+		STATS(stats.ieventsQueued++);
+	}
+	if (findCrossing(i, e)) {
+		queue(e, owner);
+		STATS(stats.ieventsQueued++);
+	}
+	unsigned int r = region[i];
+	predictBall(i, exclude, r > 0 ? r - 1 : 0, r + 1 < numRegions() ? r + 1 : r, owner);
+}
+
+template <class T>
+bool SectorSimT<T>::findCrossing(unsigned long i, SimEvent &e) const {
+	T vx = sim->balls.vx()[i];
+	unsigned int r = region[i];
+	double target;
+	if (vx > 0) target = edge[r + 1];
+	else if (vx < 0) target = edge[r];
+	else return false;
+	double t = double(sim->ballTime[i]) + (target - double(sim->balls.x()[i])) / double(vx);
+	if (!(t < horizon)) return false; // Also the outer edges, which are infinite
+	if (t < sim->ballTime[i]) t = sim->ballTime[i];
+
+	// Zone k is region 2k + 1, between strips k and k + 1
+	unsigned int zone = vx < 0 && r % 2 == 0 ? r / 2 - 1 : r / 2;
+	e = SimEvent(t, i, sim->collisionCount[i], zone);
+	return true;
+}
+
+template <class T>
+void SectorSimT<T>::queue(const SimEvent &e, unsigned int owner) {
+	unsigned int s;
+	if (isLocal(e, s)) {
+		strips[s].events.push(e);
+		return;
+	}
+	unsigned int k = zoneOf(e);
+	if (owner == SERIAL) zones[k].push(e);
+	else {
+		strips[owner].outbox.push_back(e);
+		lowerFloor(k, e.time());
+	}
+}
+
+template <class T>
+bool SectorSimT<T>::isLocal(const SimEvent &e, unsigned int &s) const {
+	if (e.isCrossingEvent()) return false;
+	unsigned int r = region[e.ball1()];
+	if (r % 2 != 0) return false;
+	if (!e.isWallEvent() && region[e.ball2()] != r) return false;
+	s = r / 2;
+	return true;
+}
+
+template <class T>
+unsigned int SectorSimT<T>::zoneOf(const SimEvent &e) const {
+	// Zone k is region 2k + 1, between strips k and k + 1. A crossing keeps
+	// the zone it was predicted in: the ball may have changed direction
+	// since, in an event that can still be rolled back.
+	unsigned int k;
+	unsigned int r1 = region[e.ball1()];
+	unsigned int r2 = e.isWallEvent() || e.isCrossingEvent() ? r1 : region[e.ball2()];
+	if (e.isCrossingEvent()) k = e.zone();
+	else if (r1 % 2 != 0) k = r1 / 2;
+	else if (r2 % 2 != 0) k = r2 / 2;
+	else k = std::min(std::min(r1, r2) / 2, numStrips - 2);
+	assert(k + 1 < numStrips);
+	return k;
+}
+
+template <class T>
+void SectorSimT<T>::touchedStrips(const SimEvent &e, unsigned int &lo, unsigned int &hi) const {
+	// A ball of a strip is seen by its own strip only; a ball of zone k by
+	// strips k and k + 1, as is a crossing into or out of zone k
+	if (e.isCrossingEvent()) {
+		lo = e.zone();
+		hi = e.zone() + 1;
+		return;
+	}
+	unsigned int r[2];
+	unsigned int n = 0;
+	r[n++] = region[e.ball1()];
+	if (!e.isWallEvent()) r[n++] = region[e.ball2()];
+	lo = numStrips;
+	hi = 0;
+	for (unsigned int k = 0; k < n; k++) {
+		lo = std::min(lo, r[k] / 2);
+		hi = std::max(hi, (r[k] + 1) / 2);
+	}
+}
+
+template <class T>
+double SectorSimT<T>::nextLocal(unsigned int s) {
+	EventQueue &events = strips[s].events;
+	while (!events.empty()) {
+		const SimEvent e = events.top();
+		unsigned int home;
+		if (!sim->isEventValid(e)) {
+			STATS(strips[s].stats.istaleEvents++);
+			events.pop();
+		}
+		else if (!isLocal(e, home) || home != s) {
+			events.pop();
+			zones[zoneOf(e)].push(e);
+			movedEvents = true;
+		}
+		else return e.time();
+	}
+	return HUGE_VAL;
+}
+
+template <class T>
+void SectorSimT<T>::lowerFloor(unsigned int k, double t) {
+	double floor = floors[k].load(std::memory_order_relaxed);
+	while (t < floor && !floors[k].compare_exchange_weak(floor, t, std::memory_order_relaxed)) { }
+}
+
+template <class T>
+void SectorSimT<T>::rollBack(unsigned int s, double t) {
+	Strip &strip = strips[s];
+	restored.clear();
+	while (!strip.undo.empty() && strip.undo.back().time > t) {
+		const Undo &u = strip.undo.back();
+		unsigned long i = u.ball;
+		sim->balls.x()[i] = u.x;
+		sim->balls.y()[i] = u.y;
+		sim->balls.vx()[i] = u.vx;
+		sim->balls.vy()[i] = u.vy;
+		sim->ballTime[i] = u.t;
+		sim->collisionCount[i] = u.count;
+		sim->lastPartner[i] = u.partner;
+		restored.push_back(i);
+		if (u.kind != SECOND_BALL) {
+			strip.collisions--;
+			STATS(if (u.kind == WALL_COLLISION) strip.stats.iwallCollisions--);
+			STATS(if (u.kind == BALL_COLLISION) strip.stats.iballCollisions--);
+			STATS(strip.stats.irolledBackEvents++);
+		}
+		strip.undo.pop_back();
+	}
+
+	// Events of the restored balls that were processed or dropped since are
+	// gone, so predict them again. Those still queued from the same states
+	// are valid again, and are processed first.
+	std::sort(restored.begin(), restored.end());
+	restored.erase(std::unique(restored.begin(), restored.end()), restored.end());
+	for (unsigned long k = 0; k < restored.size(); k++) {
+		updateBox(restored[k]);
+	}
+	for (unsigned long k = 0; k < restored.size(); k++) {
+		predictBall(restored[k], restored[k], SERIAL);
+	}
+}
+
+template <class T>
+void SectorSimT<T>::save(unsigned int s, double t, unsigned long i, Kind kind) {
+	Undo u;
+	u.time = t;
+	u.ball = i;
+	u.x = sim->balls.x()[i];
+	u.y = sim->balls.y()[i];
+	u.vx = sim->balls.vx()[i];
+	u.vy = sim->balls.vy()[i];
+	u.t = sim->ballTime[i];
+	u.count = sim->collisionCount[i];
+	u.partner = sim->lastPartner[i];
+	u.kind = kind;
+	strips[s].undo.push_back(u);
+}
+
+template <class T>
+void SectorSimT<T>::updateBox(unsigned long i) {
+	regions[region[i]].grid.update(slot[i], BoundingBox::swept(sim->balls[i], horizon - sim->ballTime[i]));
+}
+
+template <class T>
+void SectorSimT<T>::restoreFrame() {
+	unsigned long n = sim->numBalls();
+	std::copy(savedX.begin(), savedX.end(), sim->balls.x());
+	std::copy(savedY.begin(), savedY.end(), sim->balls.y());
+	std::copy(savedVX.begin(), savedVX.end(), sim->balls.vx());
+	std::copy(savedVY.begin(), savedVY.end(), sim->balls.vy());
+	sim->ballTime.assign(n, 0.);
+	sim->collisionCount.assign(n, 0);
+	sim->lastPartner.assign(n, n);
+}
+
+template class SectorSimT<double>;
+template class SectorSimT<float>;
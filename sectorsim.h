@@ -0,0 +1,264 @@
+// sectorsim.h - version 1.1
+// Processes the collisions of a frame of BallsSim in sectors of the walls,
+// on several threads.
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - the collisions of the strips count towards the collision limit
+
+#ifndef SECTORSIM_H
+#define SECTORSIM_H
+
+#include "simevent.h"
+#include "cellgrid.h"
+#include "simstats.h"
+#include <vector>
+#include <deque>
+#include <queue>
+#include <atomic>
+#include <cmath>
+
+template <class T> class BallsSimT;
+
+// The walls are cut into vertical strips, the sectors, one per task of the
+// thread pool of the simulator. A zone of about one ball diameter is set
+// aside on each boundary between two strips, so the walls are divided into
+// regions: strip 0, zone 0, strip 1, zone 1, ... A ball belongs to the
+// region that holds its centre and moves to the next one by a crossing
+// event. Regions are wider than the largest ball, so a ball can only touch
+// balls of its own region and the two next to it, and each region has a
+// cell grid of its own to find them.
+//
+// A collision between balls of the same strip, or of one ball of a strip
+// with a wall, is local to that strip. Every other event, i.e. those of
+// balls in a zone and the crossings, is a boundary event. The frame is run
+// in rounds:
+// - In parallel, each strip processes its local events in time order until
+//   it reaches the earliest boundary event of the zones next to it, which
+//   may change the balls its events depend on.
+// - Serially, boundary events are processed in time order once the strips
+//   around them have caught up with them. A strip that has gone past the
+//   time of a boundary event next to it, because the event was found after
+//   the strip passed it, is rolled back to that time from a log of the
+//   balls before each of its events.
+// Each event is thus processed on the same states as the serial simulator
+// would, and gives the same results. Collisions at exactly the same time
+// may be processed in another order.
+//
+// The boundary events are processed on one thread, so the speedup is
+// bounded by the fraction of the balls near the boundaries, about
+// (sectors - 1) * diameter / width, and by the length of the rounds. Frames
+// in which a boundary event turns out to precede one processed before it,
+// which needs a chain of collisions across a whole strip between them, or
+// which reach the collision limit of the simulator, are run again serially.
+template <class T>
+class SectorSimT {
+	public:
+
+		// Constructors
+		SectorSimT() {
+			numRequested = 1;
+			sim = 0;
+			horizon = 0;
+			numStrips = 0;
+		}
+
+		// Copying copies the number of sectors only; the rest is only valid
+		// during advance()
+		SectorSimT(const SectorSimT &other) {
+			numRequested = other.numRequested;
+			sim = 0;
+			horizon = 0;
+			numStrips = 0;
+		}
+
+		SectorSimT &operator=(const SectorSimT &other) {
+			numRequested = other.numRequested;
+			return *this;
+		}
+
+		// Set the number of sectors; see BallsSim::setNumSectors()
+		void setNumSectors(unsigned int n) { numRequested = n; }
+
+		// Get the number of sectors set
+		unsigned int getNumSectors() const { return numRequested; }
+
+		// Predicts and processes the collisions of a frame of length dt of
+		// owner, whose balls must all be at time 0 with no collisions yet.
+		// On return the balls are at various times within the frame, as after
+		// the event loop of BallsSim::advanceSim(), numCollisions is set to
+		// the number of collisions processed and the counters of the frame
+		// are added to owner's. Returns false, with the balls as they were,
+		// if the frame must be run serially: there are fewer than 2 sectors,
+		// no walls, or the walls are too narrow for them, or the frame failed
+		// as described above.
+		bool advance(BallsSimT<T> &owner, T dt, unsigned int &numCollisions);
+
+	private:
+		typedef std::priority_queue<SimEvent, std::vector<SimEvent>, SimEvent::Later> EventQueue;
+
+		// Minimum width of a strip in diameters of the largest ball
+		static const unsigned int MIN_STRIP_DIAMETERS = 4;
+		// Width of a zone in diameters of the largest ball. A little over 1,
+		// so rounding in the crossing times cannot bring two balls of regions
+		// that are not next to each other into contact.
+		static const double ZONE_DIAMETERS;
+		// Strip index meaning "the serial part of a round"
+		static const unsigned int SERIAL = 0xFFFFFFFFu;
+
+		// Kinds of event in the undo log
+		enum Kind { SECOND_BALL, WALL_COLLISION, BALL_COLLISION };
+
+		// State of a ball before an event of a strip, to roll the event back
+		struct Undo {
+			double time; // Time of the event
+			unsigned long ball;
+			T x, y, vx, vy, t;
+			unsigned long count, partner;
+			Kind kind; // Of the event, in its first record only
+		};
+
+		// Events of one strip
+		struct Strip {
+			EventQueue events; // Local events
+			std::vector<SimEvent> outbox; // Boundary events found in the parallel part of a round
+			std::deque<Undo> undo; // Balls before each local event processed, oldest first
+			double readMark; // Time of the latest boundary event processed that depends on the strip
+			unsigned long collisions; // Collisions processed and not rolled back
+			SimStats stats;
+		};
+
+		// Balls of one region
+		struct Region {
+			CellGrid grid; // Box swept by each ball of the region
+			std::vector<unsigned long> members; // Ball of each box of the grid
+			std::vector<BoundingBox> boxes; // Scratch space to build the grid
+			std::vector<SimEvent> found; // Boundary events found by the initial predictions
+			SimStats stats; // Counters of the initial predictions
+		};
+
+		unsigned int numRequested; // See setNumSectors()
+
+		// State of a frame, valid only during advance()
+		BallsSimT<T> *sim;
+		T horizon; // Length of the frame
+		unsigned int numStrips;
+		std::vector<double> edge; // Region r holds the balls with edge[r] <= x < edge[r + 1]
+		std::vector<Region> regions;
+		std::vector<Strip> strips;
+		std::vector<EventQueue> zones; // Boundary events, by zone
+		std::vector<std::atomic<double> > floors; // Earliest boundary event known of each zone in the parallel part
+		std::vector<unsigned int> region; // Region of each ball
+		std::vector<unsigned long> slot; // Index of each ball in the grid of its region
+		std::vector<T> savedX, savedY, savedVX, savedVY; // Balls at the start of the frame
+		std::vector<unsigned long> maxCount; // Highest collision count given to each ball
+		std::vector<unsigned long> restored; // Scratch list of the balls restored by a rollback
+		unsigned long serialCollisions; // Collisions processed in the serial parts
+		unsigned long roundBudget; // Collisions each strip may process in the parallel part of a round
+		SimStats serialStats;
+		SimStats roundStats; // Counters of the rounds themselves
+		bool movedEvents; // Set by nextLocal() when it moves events to the zones
+
+		// Chooses the number of strips and the region edges. Returns false if
+		// the frame must be run serially.
+		bool split();
+
+		// Sorts the balls into regions and builds the grids of the regions
+		void assignRegions();
+
+		// Predicts all events of the frame
+		void predictAll();
+
+		// Runs the rounds. Returns false if the frame must be run serially.
+		bool runRounds();
+
+		// Processes the local events of strip s up to its cap, or until it has
+		// processed more than roundBudget collisions. Runs in parallel with
+		// the other strips.
+		void runStrip(unsigned int s);
+
+		// Processes the boundary events that are ready, in time order. Returns
+		// false if the frame must be run serially.
+		bool runBoundary();
+
+		// Processes a valid event. owner is the strip processing it, or
+		// SERIAL. Returns true if it was a collision.
+		bool processEvent(const SimEvent &e, unsigned int owner);
+
+		// Moves ball i into region to
+		void moveToRegion(unsigned long i, unsigned int to);
+
+		// Predicts the events of ball i, except a collision with ball exclude,
+		// against the balls of regions first to last
+		void predictBall(unsigned long i, unsigned long exclude, unsigned int first, unsigned int last, unsigned int owner);
+
+		// Predicts all events of ball i, except a collision with ball exclude
+		void predictBall(unsigned long i, unsigned long exclude, unsigned int owner);
+
+		// Predicts the crossing of ball i into the next region. Returns true,
+		// with e set to the crossing, if it happens before the end of the frame.
+		bool findCrossing(unsigned long i, SimEvent &e) const;
+
+		// Queues an event found by strip owner, or by the serial part if owner
+		// is SERIAL
+		void queue(const SimEvent &e, unsigned int owner);
+
+		// Is e a local event? If so, s is set to its strip.
+		bool isLocal(const SimEvent &e, unsigned int &s) const;
+
+		// Zone whose queue holds boundary event e
+		unsigned int zoneOf(const SimEvent &e) const;
+
+		// Strips lo to hi hold the balls event e depends on
+		void touchedStrips(const SimEvent &e, unsigned int &lo, unsigned int &hi) const;
+
+		// Time of the first event of strip s (or HUGE_VAL if none), after
+		// dropping stale events from the top of its queue and moving to the
+		// zones those that are no longer local. Only for the serial part.
+		double nextLocal(unsigned int s);
+
+		// Time of the first event of zone k, or HUGE_VAL if none
+		double zoneTop(unsigned int k) const { return zones[k].empty() ? HUGE_VAL : zones[k].top().time(); }
+
+		// Lowers the floor of zone k to t
+		void lowerFloor(unsigned int k, double t);
+
+		// Undoes the local events of strip s after time t and predicts the
+		// balls restored again
+		void rollBack(unsigned int s, double t);
+
+		// Is boundary event e ready to be processed: have the strips around it
+		// caught up with it, and are the zones around it not behind it?
+		bool isReady(const SimEvent &e);
+
+		// Records ball i before an event of strip s at time t
+		void save(unsigned int s, double t, unsigned long i, Kind kind);
+
+		// Sets the box of ball i in the grid of its region
+		void updateBox(unsigned long i);
+
+		// Gives ball i a collision count it has never had, so that events
+		// predicted from states that were rolled back stay stale
+		void newCount(unsigned long i) { sim->collisionCount[i] = ++maxCount[i]; }
+
+		// Collisions processed in the frame so far
+		unsigned long collisionsSoFar() const {
+			unsigned long total = serialCollisions;
+			for (unsigned int s = 0; s < numStrips; s++) {
+				total += strips[s].collisions;
+			}
+			return total;
+		}
+
+		// Number of regions
+		unsigned int numRegions() const { return 2 * numStrips - 1; }
+
+		// Counters of strip owner, or of the serial part
+		SimStats &statsOf(unsigned int owner) { return owner == SERIAL ? serialStats : strips[owner].stats; }
+
+		// Puts the balls back as they were at the start of the frame
+		void restoreFrame();
+};
+
+#endif
@@ -0,0 +1,133 @@
+// sharedmemorytransport.cpp - version 1.1
+// Functions declared in sharedmemorytransport.h.
+// See sharedmemorytransport.h for documentation of functions.
+
+#include "sharedmemorytransport.h"
+#include <new>
+#include <cstring>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+SharedMemoryTransport::SharedMemoryTransport(unsigned int numRanks, unsigned long channelSize) :
+	Transport(numRanks), channelSize(channelSize > 0 ? channelSize : DEFAULT_CHANNEL_SIZE) {
+	unsigned long n = this->numRanks();
+	channelStride = (sizeof(Channel) + this->channelSize + 63) & ~63UL;
+	mapSize = n * n * channelStride + n * sizeof(Closed);
+	void *map = mmap(0, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		base = 0;
+		return;
+	}
+	base = (char *)map;
+	for (unsigned int i = 0; i < n; i++) {
+		for (unsigned int j = 0; j < n; j++) {
+			Channel *c = new (&channel(i, j)) Channel;
+			c->written.store(0);
+			c->read.store(0);
+		}
+		new (&closed(i)) Closed;
+		closed(i).flag.store(0);
+		closed(i).pid.store(0);
+	}
+}
+
+SharedMemoryTransport::~SharedMemoryTransport() {
+	if (base == 0) return;
+	closed(rank()).flag.store(1, std::memory_order_release);
+	munmap(base, mapSize);
+}
+
+void SharedMemoryTransport::attach(unsigned int rank) {
+	if (base != 0) closed(rank).pid.store(getpid(), std::memory_order_release);
+}
+
+bool SharedMemoryTransport::write(unsigned int to, const char *data, unsigned long size) {
+	if (base == 0) return false;
+	Channel &c = channel(rank(), to);
+	char *ring = channelData(rank(), to);
+	unsigned long long written = c.written.load(std::memory_order_relaxed);
+	unsigned long spins = 0;
+	while (size > 0) {
+		unsigned long long free = channelSize - (written - c.read.load(std::memory_order_acquire));
+		if (free == 0) {
+			if (!wait(to, spins++)) return false;
+			continue;
+		}
+		spins = 0;
+
+		// Copy up to the end of the ring, then wrap around on the next pass
+		unsigned long at = (unsigned long)(written % channelSize);
+		unsigned long count = size;
+		if (count > free) count = (unsigned long)free;
+		if (count > channelSize - at) count = channelSize - at;
+		memcpy(ring + at, data, count);
+		written += count;
+		c.written.store(written, std::memory_order_release);
+		data += count;
+		size -= count;
+	}
+	return true;
+}
+
+bool SharedMemoryTransport::read(unsigned int from, char *data, unsigned long size) {
+	if (base == 0) return false;
+	Channel &c = channel(from, rank());
+	const char *ring = channelData(from, rank());
+	unsigned long long read = c.read.load(std::memory_order_relaxed);
+	unsigned long spins = 0;
+	while (size > 0) {
+		unsigned long long ready = c.written.load(std::memory_order_acquire) - read;
+		if (ready == 0) {
+			if (!wait(from, spins++)) return false;
+			continue;
+		}
+		spins = 0;
+		unsigned long at = (unsigned long)(read % channelSize);
+		unsigned long count = size;
+		if (count > ready) count = (unsigned long)ready;
+		if (count > channelSize - at) count = channelSize - at;
+		memcpy(data, ring + at, count);
+		read += count;
+		c.read.store(read, std::memory_order_release);
+		data += count;
+		size -= count;
+	}
+	return true;
+}
+
+bool SharedMemoryTransport::wait(unsigned int peer, unsigned long spins) const {
+	// Messages between neighbours usually follow each other closely, so
+	// spin first rather than give up the processor
+	const unsigned long SPINS_BEFORE_YIELD = 1000;
+	// Yields from one check of the processes of the ranks to the next
+	const unsigned long YIELDS_PER_CHECK = 1024;
+	if (spins < SPINS_BEFORE_YIELD) return true;
+	if ((spins - SPINS_BEFORE_YIELD) % YIELDS_PER_CHECK == 0) checkPeers();
+	if (closed(peer).flag.load(std::memory_order_acquire) != 0) return false;
+	sched_yield();
+	return true;
+}
+
+void SharedMemoryTransport::checkPeers() const {
+	for (unsigned int r = 0; r < numRanks(); r++) {
+		pid_t pid = closed(r).pid.load(std::memory_order_acquire);
+		if (r == rank() || pid == 0 || closed(r).flag.load(std::memory_order_acquire) != 0) continue;
+		bool ended;
+		if (rank() == 0) {
+			// The other ranks are children of rank 0, which keeps them as
+			// zombies until join(). WNOWAIT leaves their status to join().
+			siginfo_t info;
+			info.si_pid = 0;
+			ended = waitid(P_PID, (id_t)pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid;
+		}
+		else {
+			// A zombie still exists for kill(); rank 0 marks those
+			ended = kill(pid, 0) != 0 && errno == ESRCH;
+		}
+		if (ended) closed(r).flag.store(1, std::memory_order_release);
+	}
+}
@@ -0,0 +1,85 @@
+// sharedmemorytransport.h - version 1.1
+// Transport between the ranks of a DomainSim through ring buffers in
+// shared memory.
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - a rank that dies without closing its transport counts as gone
+
+#ifndef SHAREDMEMORYTRANSPORT_H
+#define SHAREDMEMORYTRANSPORT_H
+
+#include "transport.h"
+#include <atomic>
+#include <sys/types.h>
+
+// One anonymous shared mapping, created before launch(), holds a ring
+// buffer for each ordered pair of ranks. The sender copies bytes in and
+// the receiver copies them out; each advances its own counter of the bytes
+// passed, so no locks are needed. A rank waiting for its peer spins for a
+// while and then yields the processor. Copying avoids the system calls of
+// SocketTransport, which matters for the many small messages of a frame.
+//
+// A rank that closes its transport marks itself as gone. One that is
+// killed or crashes cannot, so a waiting rank also checks now and then
+// whether the processes of the others have ended, and marks those as gone.
+class SharedMemoryTransport : public Transport {
+	public:
+
+		// Default size of each ring buffer in bytes
+		static const unsigned long DEFAULT_CHANNEL_SIZE = 1UL << 20;
+
+		// Constructors
+		// Maps the buffers of numRanks ranks, of channelSize bytes each.
+		// Check isOpen() for failure.
+		explicit SharedMemoryTransport(unsigned int numRanks, unsigned long channelSize = DEFAULT_CHANNEL_SIZE);
+		~SharedMemoryTransport();
+
+		// Was the shared memory mapped?
+		bool isOpen() const { return base != 0; }
+
+	protected:
+		void attach(unsigned int rank);
+		bool write(unsigned int to, const char *data, unsigned long size);
+		bool read(unsigned int from, char *data, unsigned long size);
+
+	private:
+		// Start of the ring buffer from one rank to another. Its bytes follow.
+		// The counters are on cache lines of their own, as the sender writes
+		// one and the receiver the other.
+		struct Channel {
+			alignas(64) std::atomic<unsigned long long> written; // Total bytes written by the sender
+			alignas(64) std::atomic<unsigned long long> read; // Total bytes read by the receiver
+		};
+
+		// State of each rank, at the end of the mapping
+		struct Closed {
+			std::atomic<int> flag; // Set when the rank has gone: its transport was destroyed, or it died
+			std::atomic<pid_t> pid; // Process of the rank, or 0 until it has attached
+		};
+
+		char *base; // Start of the mapping, or 0 if it failed
+		unsigned long mapSize;
+		unsigned long channelSize; // Bytes of data in each ring buffer
+		unsigned long channelStride; // Bytes from one Channel to the next
+
+		Channel &channel(unsigned int from, unsigned int to) const {
+			return *(Channel *)(base + ((unsigned long)from * numRanks() + to) * channelStride);
+		}
+		char *channelData(unsigned int from, unsigned int to) const {
+			return (char *)&channel(from, to) + sizeof(Channel);
+		}
+		Closed &closed(unsigned int rank) const {
+			return ((Closed *)(base + (unsigned long)numRanks() * numRanks() * channelStride))[rank];
+		}
+
+		// Waits a little, after spins unsuccessful tries. Returns false if
+		// rank peer has gone, so waiting for it is pointless.
+		bool wait(unsigned int peer, unsigned long spins) const;
+
+		// Marks the other ranks whose processes have ended as gone
+		void checkPeers() const;
+};
+
+#endif
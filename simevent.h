@@ -0,0 +1,122 @@
+// simevent.h - version 1.3
+// Class describing a predicted collision event for the event-driven
+// simulation in BallsSim.
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - added crossing events, used by SectorSim
+//   1.2:
+//     - Later can break ties in time by the IDs of the balls and the wall
+//   1.3:
+//     - crossing events record their zone
+
+#ifndef SIMEVENT_H
+#define SIMEVENT_H
+
+#include "walls.h"
+#include <utility>
+
+// A SimEvent is a collision that has been predicted to happen at an absolute
+// time within the current frame. It is either between balls 1 and 2, or
+// between ball 1 and a wall, or, for SectorSim only, ball 1 crossing from one
+// region of the walls into the next without colliding. Balls are identified by their index in the
+// simulator. Each event also records how many collisions each of its balls
+// had undergone when the event was predicted; if either ball has collided
+// since then, the prediction is out of date and the event must be ignored.
+class SimEvent {
+	public:
+
+		// Constructors
+		SimEvent() {
+			itime = 0.;
+			ib1 = ib2 = 0;
+			icount1 = icount2 = 0;
+			iwall = Walls::NONE;
+			izone = 0;
+		}
+
+		// Collision between balls b1 and b2 at time t. c1 and c2 are the
+		// collision counts of b1 and b2 at the time of prediction.
+		SimEvent(double t, unsigned long b1, unsigned long b2, unsigned long c1, unsigned long c2) {
+			itime = t;
+			ib1 = b1;
+			ib2 = b2;
+			icount1 = c1;
+			icount2 = c2;
+			iwall = Walls::NONE;
+			izone = 0;
+		}
+
+		// Collision between ball b and wall w at time t. c is the collision
+		// count of b at the time of prediction.
+		SimEvent(double t, unsigned long b, unsigned long c, Walls::Wall w) {
+			itime = t;
+			ib1 = b;
+			ib2 = b;
+			icount1 = c;
+			icount2 = c;
+			iwall = w;
+			izone = 0;
+		}
+
+		// Ball b crossing into the next region of SectorSim at time t, into
+		// or out of zone z. c is the collision count of b at the time of
+		// prediction.
+		SimEvent(double t, unsigned long b, unsigned long c, unsigned int z) {
+			itime = t;
+			ib1 = b;
+			ib2 = b;
+			icount1 = c;
+			icount2 = c;
+			iwall = Walls::NONE;
+			izone = z;
+		}
+
+		// Get methods
+		double time() const { return itime; }
+		unsigned long ball1() const { return ib1; }
+		unsigned long ball2() const { return ib2; } // Only meaningful if !isWallEvent()
+		unsigned long count1() const { return icount1; }
+		unsigned long count2() const { return icount2; }
+		Walls::Wall wall() const { return iwall; }
+		unsigned int zone() const { return izone; } // Only meaningful if isCrossingEvent()
+		bool isWallEvent() const { return iwall != Walls::NONE; }
+		bool isCrossingEvent() const { return iwall == Walls::NONE && ib1 == ib2; }
+
+		// Comparison functor for std::priority_queue. The queue puts the
+		// "largest" element on top, so an event is "less" than another
+		// if it happens later. Given the IDs of the balls by index, events
+		// at the same time are ordered by the lower ID of their balls, then
+		// the higher, then the wall, so the order in which they come out of
+		// the queue does not depend on the order in which they went in.
+		// Without IDs such events are left unordered.
+		struct Later {
+			const int *ids; // ID of each ball, or 0
+
+			explicit Later(const int *ballIDs = 0) { ids = ballIDs; }
+
+			bool operator()(const SimEvent &left, const SimEvent &right) const {
+				if (ids == 0 || left.itime != right.itime) return left.itime > right.itime;
+				int l1 = ids[left.ib1], l2 = ids[left.ib2];
+				int r1 = ids[right.ib1], r2 = ids[right.ib2];
+				if (l1 > l2) std::swap(l1, l2);
+				if (r1 > r2) std::swap(r1, r2);
+				if (l1 != r1) return l1 > r1;
+				if (l2 != r2) return l2 > r2;
+				return left.iwall > right.iwall;
+			}
+		};
+
+	private:
+		// Note: i stands for internal
+		double itime; // Absolute time of the collision within the frame
+		unsigned long ib1; // Index of ball 1
+		unsigned long ib2; // Index of ball 2 (same as ball 1 for a wall or crossing event)
+		unsigned long icount1; // Collision count of ball 1 when predicted
+		unsigned long icount2; // Collision count of ball 2 when predicted
+		Walls::Wall iwall; // Wall for a wall event, Walls::NONE otherwise
+		unsigned int izone; // Zone of a crossing event, 0 otherwise
+};
+
+#endif
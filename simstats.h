@@ -0,0 +1,184 @@
+// simstats.h - version 1.4
+// Performance counters of BallsSim::advanceSim()
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - added reorders() and reorderNs()
+//   1.2:
+//     - BallsSim is now BallsSimT, a template on the scalar type
+//   1.3:
+//     - added sectorRounds(), boundaryEvents(), rolledBackEvents() and
+//       sectorFallbacks() for the frames run by SectorSim
+//   1.4:
+//     - added batches(), batchedCollisions(), largestBatch(), cutBatches()
+//       and putBackEvents() for the batches of BallsSim::setMaxBatchSize()
+
+#ifndef SIMSTATS_H
+#define SIMSTATS_H
+
+template <class T> class BallsSimT;
+template <class T> class SectorSimT;
+
+// Counts the work done by BallsSim::advanceSim() over one or more frames.
+// BallsSim keeps one SimStats for the last frame and one for all frames since
+// the counters were last reset. The counters are only collected if the
+// library is built with BALLSSIM_STATS defined (see BallsSim::statsEnabled());
+// otherwise they stay 0 and cost nothing.
+class SimStats {
+	public:
+
+		// Constructors
+		SimStats() { reset(); }
+
+		// Set all counters to 0
+		void reset() {
+			iframes = 0;
+			ipairTests = 0;
+			iwallTests = 0;
+			ieventsQueued = 0;
+			istaleEvents = 0;
+			iballCollisions = 0;
+			iwallCollisions = 0;
+			icapHits = 0;
+			ieventsLeftAtCap = 0;
+			ipredictNs = 0;
+			ibroadPhaseNs = 0;
+			ieventNs = 0;
+			iadvanceNs = 0;
+			ireorders = 0;
+			ireorderNs = 0;
+			isectorRounds = 0;
+			iboundaryEvents = 0;
+			irolledBackEvents = 0;
+			isectorFallbacks = 0;
+			ibatches = 0;
+			ibatchedCollisions = 0;
+			ilargestBatch = 0;
+			icutBatches = 0;
+			iputBackEvents = 0;
+		}
+
+		// Get methods
+		// Number of calls to advanceSim()
+		unsigned long long frames() const { return iframes; }
+		// Pairs of balls tested for a collision
+		unsigned long long pairTests() const { return ipairTests; }
+		// Balls tested for a collision with the walls
+		unsigned long long wallTests() const { return iwallTests; }
+		// Collisions predicted and put in the event queue
+		unsigned long long eventsQueued() const { return ieventsQueued; }
+		// Queued collisions discarded because one of their balls had collided since
+		unsigned long long staleEvents() const { return istaleEvents; }
+		// Collisions between two balls processed
+		unsigned long long ballCollisions() const { return iballCollisions; }
+		// Collisions with a wall processed
+		unsigned long long wallCollisions() const { return iwallCollisions; }
+		// Frames cut short by the maximum number of collisions per frame
+		unsigned long long capHits() const { return icapHits; }
+		// Events still queued when frames were cut short. These include stale
+		// events, so this is an upper bound of the collisions that were dropped.
+		unsigned long long eventsLeftAtCap() const { return ieventsLeftAtCap; }
+		// Nanoseconds spent predicting the collisions at the start of frames,
+		// including building the broad phase
+		unsigned long long predictNs() const { return ipredictNs; }
+		// Part of predictNs() spent building the broad phase
+		unsigned long long broadPhaseNs() const { return ibroadPhaseNs; }
+		// Nanoseconds spent processing collisions and re-predicting the balls involved
+		unsigned long long eventNs() const { return ieventNs; }
+		// Nanoseconds spent moving the balls to the end of frames
+		unsigned long long advanceNs() const { return iadvanceNs; }
+		// Times the balls were reordered in memory
+		unsigned long long reorders() const { return ireorders; }
+		// Nanoseconds spent reordering the balls
+		unsigned long long reorderNs() const { return ireorderNs; }
+		// Rounds of parallel then serial work in frames split into sectors
+		// (see BallsSim::setNumSectors())
+		unsigned long long sectorRounds() const { return isectorRounds; }
+		// Collisions processed serially because they involve balls near the
+		// boundaries between sectors
+		unsigned long long boundaryEvents() const { return iboundaryEvents; }
+		// Collisions processed by a sector ahead of the others and undone
+		unsigned long long rolledBackEvents() const { return irolledBackEvents; }
+		// Frames split into sectors that had to be run again serially
+		unsigned long long sectorFallbacks() const { return isectorFallbacks; }
+		// Batches of collisions processed (see BallsSim::setMaxBatchSize())
+		unsigned long long batches() const { return ibatches; }
+		// Collisions processed in batches; divided by batches(), the mean
+		// size of a batch
+		unsigned long long batchedCollisions() const { return ibatchedCollisions; }
+		// Collisions in the largest batch
+		unsigned long long largestBatch() const { return ilargestBatch; }
+		// Batches cut short because a collision found for one of their
+		// events preceded a later one
+		unsigned long long cutBatches() const { return icutBatches; }
+		// Collisions taken into batches that were cut short and put back in
+		// the queue
+		unsigned long long putBackEvents() const { return iputBackEvents; }
+		// Nanoseconds spent in advanceSim()
+		unsigned long long totalNs() const { return ireorderNs + ipredictNs + ieventNs + iadvanceNs; }
+		// Collisions of either kind processed
+		unsigned long long collisions() const { return iballCollisions + iwallCollisions; }
+
+		// Add the counters of other to these, except largestBatch(), which
+		// becomes the larger of the two
+		SimStats &operator+=(const SimStats &other) {
+			iframes += other.iframes;
+			ipairTests += other.ipairTests;
+			iwallTests += other.iwallTests;
+			ieventsQueued += other.ieventsQueued;
+			istaleEvents += other.istaleEvents;
+			iballCollisions += other.iballCollisions;
+			iwallCollisions += other.iwallCollisions;
+			icapHits += other.icapHits;
+			ieventsLeftAtCap += other.ieventsLeftAtCap;
+			ipredictNs += other.ipredictNs;
+			ibroadPhaseNs += other.ibroadPhaseNs;
+			ieventNs += other.ieventNs;
+			iadvanceNs += other.iadvanceNs;
+			ireorders += other.ireorders;
+			ireorderNs += other.ireorderNs;
+			isectorRounds += other.isectorRounds;
+			iboundaryEvents += other.iboundaryEvents;
+			irolledBackEvents += other.irolledBackEvents;
+			isectorFallbacks += other.isectorFallbacks;
+			ibatches += other.ibatches;
+			ibatchedCollisions += other.ibatchedCollisions;
+			if (other.ilargestBatch > ilargestBatch) ilargestBatch = other.ilargestBatch;
+			icutBatches += other.icutBatches;
+			iputBackEvents += other.iputBackEvents;
+			return *this;
+		}
+
+	private:
+		template <class T> friend class BallsSimT; // Updates the counters directly
+		template <class T> friend class SectorSimT;
+
+		// Note: i stands for internal
+		unsigned long long iframes;
+		unsigned long long ipairTests;
+		unsigned long long iwallTests;
+		unsigned long long ieventsQueued;
+		unsigned long long istaleEvents;
+		unsigned long long iballCollisions;
+		unsigned long long iwallCollisions;
+		unsigned long long icapHits;
+		unsigned long long ieventsLeftAtCap;
+		unsigned long long ipredictNs;
+		unsigned long long ibroadPhaseNs;
+		unsigned long long ieventNs;
+		unsigned long long iadvanceNs;
+		unsigned long long ireorders;
+		unsigned long long ireorderNs;
+		unsigned long long isectorRounds;
+		unsigned long long iboundaryEvents;
+		unsigned long long irolledBackEvents;
+		unsigned long long isectorFallbacks;
+		unsigned long long ibatches;
+		unsigned long long ibatchedCollisions;
+		unsigned long long ilargestBatch;
+		unsigned long long icutBatches;
+		unsigned long long iputBackEvents;
+};
+
+#endif
@@ -0,0 +1,166 @@
+// simthread.cpp - version 1.0
+// Functions declared in simthread.h.
+// See simthread.h for documentation of functions.
+
+#include "simthread.h"
+#include <algorithm>
+#include <chrono>
+
+template <class T>
+SimThreadT<T>::SimThreadT(BallsSimT<T> &s) : sim(s), running(false), numDone(0) {
+	frameDt = .01;
+	realTime = false;
+	frameLimit = UNLIMITED;
+	commandsPosted = 0;
+	commandsRun = 0;
+	paused = false;
+	quit = false;
+}
+
+template <class T>
+SimThreadT<T>::~SimThreadT() {
+	stop();
+}
+
+template <class T>
+void SimThreadT<T>::start(unsigned long long numFrames) {
+	if (running.load()) return;
+	if (thread.joinable()) thread.join(); // Finished its frames
+	quit = false;
+	frameLimit = numFrames;
+	numDone = 0;
+	running = true;
+	thread = std::thread(&SimThreadT::threadLoop, this);
+}
+
+template <class T>
+void SimThreadT<T>::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_one();
+	if (thread.joinable()) thread.join();
+}
+
+template <class T>
+void SimThreadT<T>::setPaused(bool p) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		paused = p;
+	}
+	wake.notify_one();
+}
+
+template <class T>
+void SimThreadT<T>::post(const std::function<void(BallsSimT<T> &)> &command) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!running.load()) {
+		lock.unlock();
+		command(sim);
+		publish();
+		return;
+	}
+	commands.push_back(command);
+	commandsPosted++;
+	lock.unlock();
+	wake.notify_one();
+}
+
+template <class T>
+void SimThreadT<T>::runSync(const std::function<void(BallsSimT<T> &)> &command) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!running.load()) {
+		lock.unlock();
+		command(sim);
+		publish();
+		return;
+	}
+	commands.push_back(command);
+	unsigned long long ticket = ++commandsPosted;
+	wake.notify_one();
+	ran.wait(lock, [this, ticket] { return commandsRun >= ticket; });
+}
+
+template <class T>
+bool SimThreadT<T>::runCommands(std::unique_lock<std::mutex> &lock) {
+	if (commands.empty()) return false;
+	std::vector<std::function<void(BallsSimT<T> &)> > batch;
+	batch.swap(commands);
+	lock.unlock();
+	for (std::size_t k = 0; k < batch.size(); k++) batch[k](sim);
+	publish();
+	lock.lock();
+	commandsRun += batch.size();
+	ran.notify_all();
+	return true;
+}
+
+template <class T>
+void SimThreadT<T>::publish() {
+	BallSnapshot &s = snapshots.back();
+	unsigned long n = sim.numBalls();
+	s.frames = numDone.load();
+	s.time = sim.getTime();
+	s.wallX2 = sim.hasWalls() ? double(sim.getWalls().x2()) : 0.;
+	s.wallY2 = sim.hasWalls() ? double(sim.getWalls().y2()) : 0.;
+	s.x.resize(n);
+	s.y.resize(n);
+	s.r.resize(n);
+	s.color.resize(n);
+	s.id.resize(n);
+	for (unsigned long i = 0; i < n; i++) {
+		ConstBallRefT<T> b = sim.getBall(i);
+		s.x[i] = b.x();
+		s.y[i] = b.y();
+		s.r[i] = b.r();
+		s.color[i] = b.color();
+		s.id[i] = b.id();
+	}
+	snapshots.publish();
+}
+
+template <class T>
+void SimThreadT<T>::threadLoop() {
+	typedef std::chrono::steady_clock Clock;
+	const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(frameDt));
+	Clock::time_point lastStart = Clock::now(); // Wall time the last frame started
+	bool restart = true; // No frame since starting or resuming, so no time has passed in the simulation
+
+	publish(); // The state the thread starts from
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!quit && numDone.load() < frameLimit) {
+		if (runCommands(lock)) continue;
+		if (paused) {
+			wake.wait(lock, [this] { return !commands.empty() || !paused || quit; });
+			restart = true;
+			continue;
+		}
+
+		double dt = frameDt;
+		if (realTime) {
+			// Wait for the frame to be due, but run commands that arrive meanwhile
+			Clock::time_point due = restart ? Clock::now() : lastStart + period;
+			if (wake.wait_until(lock, due, [this] { return !commands.empty() || paused || quit; })) continue;
+			Clock::time_point now = Clock::now();
+			if (!restart) dt = std::min(std::chrono::duration<double>(now - lastStart).count(), MAX_LAG_FRAMES * frameDt);
+			lastStart = now;
+			restart = false;
+		}
+
+		lock.unlock();
+		sim.advanceSim(T(dt));
+		numDone++;
+		if (frameCallback) frameCallback(sim);
+		publish();
+		lock.lock();
+	}
+
+	// Commands posted before running was cleared must still run
+	runCommands(lock);
+	running = false;
+}
+
+// Threads for simulators of both scalar types are always built
+template class SimThreadT<double>;
+template class SimThreadT<float>;
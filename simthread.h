@@ -0,0 +1,123 @@
+// simthread.h - version 1.0
+// Runs a BallsSim on a thread of its own and publishes the state of the
+// balls after every frame.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef SIMTHREAD_H
+#define SIMTHREAD_H
+
+#include "ballssim.h"
+#include "snapshotbuffer.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+// While the thread runs, only it may touch the simulator. Other threads
+// change or query the simulator through post() or runSync(), whose commands
+// run between frames, and read the balls from the snapshots, through
+// latest(). Rendering, recording or streaming thus never stall the
+// simulation, and the simulation never stalls them.
+template <class T>
+class SimThreadT {
+	public:
+
+		// Constants
+		// Frame limit of start() meaning run until stop()
+		static const unsigned long long UNLIMITED = ~0ULL;
+
+		// Constructors
+		// sim is not owned and must outlive this object
+		explicit SimThreadT(BallsSimT<T> &sim);
+		~SimThreadT(); // Stops the thread
+
+		// Settings, used by the next start()
+		// Duration of a frame, in simulated seconds (default .01)
+		void setFrameDt(double dt) { frameDt = dt; }
+
+		// In real time mode frames start at least frameDt apart in wall time,
+		// and each advances the simulation by the wall time since the last
+		// one started (up to MAX_LAG_FRAMES frames), so the simulation keeps
+		// pace with the clock even when a frame takes longer than frameDt.
+		// Otherwise (the default) frames of frameDt run back to back.
+		void setRealTime(bool rt) { realTime = rt; }
+
+		// Function called on the simulation thread after every frame, e.g.
+		// to collect statistics. It must not call other methods of this object.
+		void setFrameCallback(const std::function<void(const BallsSimT<T> &)> &callback) { frameCallback = callback; }
+
+		// Starts the thread, which runs numFrames frames, or until stop().
+		// Does nothing if it is already running.
+		void start(unsigned long long numFrames = UNLIMITED);
+
+		// Stops the thread after the current frame and waits for it
+		void stop();
+
+		// A paused thread runs commands but no frames
+		void setPaused(bool p);
+
+		// Queues command to run on the simulation thread before the next
+		// frame, then publishes a snapshot. If the thread is not running,
+		// command runs at once on the calling thread.
+		void post(const std::function<void(BallsSimT<T> &)> &command);
+
+		// Same as post(), but waits until command has run
+		void runSync(const std::function<void(BallsSimT<T> &)> &command);
+
+		// Latest snapshot of the balls (see SnapshotBuffer::latest()). There
+		// must be only one thread reading snapshots.
+		const BallSnapshot *latest() { return snapshots.latest(); }
+
+		// Has a snapshot been published since the last call to latest()?
+		bool hasNewSnapshot() const { return snapshots.hasNew(); }
+
+		// Get methods
+		// Is the thread running (started, and neither stopped nor finished)?
+		bool isRunning() const { return running.load(); }
+		// Frames run since the last start()
+		unsigned long long framesDone() const { return numDone.load(); }
+		double getFrameDt() const { return frameDt; }
+		bool isRealTime() const { return realTime; }
+
+	private:
+		// Longest frame in real time mode, in frames of frameDt
+		static const unsigned int MAX_LAG_FRAMES = 10;
+
+		BallsSimT<T> &sim;
+		double frameDt;
+		bool realTime;
+		std::function<void(const BallsSimT<T> &)> frameCallback;
+		SnapshotBuffer snapshots;
+		std::thread thread;
+		std::atomic<bool> running; // Thread running and not finished
+		std::atomic<unsigned long long> numDone; // Frames run
+		unsigned long long frameLimit; // Frames to run before finishing
+
+		std::mutex mutex; // Protects the members below
+		std::condition_variable wake; // Signals the thread that there are commands, or a change of state
+		std::condition_variable ran; // Signals runSync() that commands have run
+		std::vector<std::function<void(BallsSimT<T> &)> > commands; // Waiting to run
+		unsigned long long commandsPosted; // Number of commands ever posted
+		unsigned long long commandsRun; // Number of those that have run
+		bool paused;
+		bool quit; // Tells the thread to exit
+
+		// Not copyable: the thread belongs to one object
+		SimThreadT(const SimThreadT &);
+		SimThreadT &operator=(const SimThreadT &);
+
+		// Main function of the thread
+		void threadLoop();
+		// Runs the queued commands. Returns true if there were any.
+		bool runCommands(std::unique_lock<std::mutex> &lock);
+		// Copies the balls to a snapshot and publishes it
+		void publish();
+};
+
+typedef SimThreadT<SimScalar> SimThread;
+
+#endif
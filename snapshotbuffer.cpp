@@ -0,0 +1,25 @@
+// snapshotbuffer.cpp - version 1.0
+// Functions declared in snapshotbuffer.h.
+// See snapshotbuffer.h for documentation of functions.
+
+#include "snapshotbuffer.h"
+
+SnapshotBuffer::SnapshotBuffer() : middle(1) {
+	backIndex = 0;
+	frontIndex = 2;
+	haveFront = false;
+}
+
+void SnapshotBuffer::publish() {
+	// Release: the consumer that takes this buffer sees everything written to it
+	backIndex = middle.exchange(backIndex | NEW_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+}
+
+const BallSnapshot *SnapshotBuffer::latest() {
+	if (middle.load(std::memory_order_acquire) & NEW_BIT) {
+		// Acquire: see the contents of the buffer taken
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		haveFront = true;
+	}
+	return haveFront ? &slots[frontIndex] : 0;
+}
@@ -0,0 +1,73 @@
+// snapshotbuffer.h - version 1.0
+// Lock-free triple buffer through which a simulation thread hands the
+// latest state of the balls to a reader on another thread.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef SNAPSHOTBUFFER_H
+#define SNAPSHOTBUFFER_H
+
+#include <vector>
+#include <atomic>
+
+// The state of the balls at the end of a frame, for drawing or recording.
+// Arrays are indexed by ball, in the order of the simulator at the time.
+struct BallSnapshot {
+	unsigned long long frames; // Number of calls to advanceSim() before this state
+	double time; // Simulated time, BallsSim::getTime()
+	double wallX2, wallY2; // Walls from (0, 0) to (wallX2, wallY2), 0 if none
+	std::vector<double> x, y, r;
+	std::vector<unsigned long> color;
+	std::vector<int> id;
+
+	unsigned long size() const { return (unsigned long)x.size(); }
+};
+
+// Three snapshots: one being written by the producer, one being read by the
+// consumer and one holding the latest published state. publish() and
+// latest() each swap a buffer with the middle one by a single atomic
+// exchange, so neither side ever waits for the other and the consumer
+// always gets the newest complete snapshot. Frames published faster than
+// they are read are skipped. There must be one producer thread and one
+// consumer thread.
+class SnapshotBuffer {
+	public:
+
+		// Constructors
+		SnapshotBuffer();
+
+		// Producer
+		// Snapshot to fill in before calling publish(). It keeps the
+		// contents of an older snapshot, so its arrays need not be
+		// reallocated.
+		BallSnapshot &back() { return slots[backIndex]; }
+
+		// Makes back() the latest snapshot and hands the producer another
+		void publish();
+
+		// Consumer
+		// The latest published snapshot, or 0 if none has been published.
+		// It stays unchanged until the next call to latest().
+		const BallSnapshot *latest();
+
+		// Has a snapshot been published since the last call to latest()?
+		bool hasNew() const { return (middle.load(std::memory_order_acquire) & NEW_BIT) != 0; }
+
+	private:
+		// Set in middle when the middle buffer holds a snapshot not yet read
+		static const unsigned int NEW_BIT = 4;
+		static const unsigned int INDEX_MASK = 3;
+
+		BallSnapshot slots[3];
+		std::atomic<unsigned int> middle; // Index of the middle buffer, with NEW_BIT
+		unsigned int backIndex; // Buffer of the producer
+		unsigned int frontIndex; // Buffer of the consumer
+		bool haveFront; // Has the consumer got a published snapshot?
+
+		// Not copyable: the buffers are shared by two threads
+		SnapshotBuffer(const SnapshotBuffer &);
+		SnapshotBuffer &operator=(const SnapshotBuffer &);
+};
+
+#endif
@@ -0,0 +1,71 @@
+// sockettransport.cpp - version 1.0
+// Functions declared in sockettransport.h.
+// See sockettransport.h for documentation of functions.
+
+#include "sockettransport.h"
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+SocketTransport::SocketTransport(unsigned int numRanks) : Transport(numRanks) {
+	unsigned int n = this->numRanks();
+	fds.assign(n * n, -1);
+	open = true;
+	for (unsigned int i = 0; i < n && open; i++) {
+		for (unsigned int j = i + 1; j < n; j++) {
+			int pair[2];
+			if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+				open = false;
+				break;
+			}
+			fds[i * n + j] = pair[0];
+			fds[j * n + i] = pair[1];
+		}
+	}
+}
+
+SocketTransport::~SocketTransport() {
+	for (unsigned long k = 0; k < fds.size(); k++) {
+		if (fds[k] >= 0) close(fds[k]);
+	}
+}
+
+void SocketTransport::attach(unsigned int rank) {
+	// Close the ends of the other ranks, so a rank that exits closes all
+	// the sockets to it and its peers see end of file instead of waiting
+	unsigned int n = numRanks();
+	for (unsigned int i = 0; i < n; i++) {
+		if (i == rank) continue;
+		for (unsigned int j = 0; j < n; j++) {
+			int &fd = fds[i * n + j];
+			if (fd >= 0) close(fd);
+			fd = -1;
+		}
+	}
+}
+
+bool SocketTransport::write(unsigned int to, const char *data, unsigned long size) {
+	int fd = fds[rank() * numRanks() + to];
+	while (size > 0) {
+		ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL); // A closed peer is an error, not a signal
+		if (sent < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		data += sent;
+		size -= (unsigned long)sent;
+	}
+	return true;
+}
+
+bool SocketTransport::read(unsigned int from, char *data, unsigned long size) {
+	int fd = fds[rank() * numRanks() + from];
+	while (size > 0) {
+		ssize_t got = ::recv(fd, data, size, 0);
+		if (got < 0 && errno == EINTR) continue;
+		if (got <= 0) return false;
+		data += got;
+		size -= (unsigned long)got;
+	}
+	return true;
+}
@@ -0,0 +1,37 @@
+// sockettransport.h - version 1.0
+// Transport between the ranks of a DomainSim over Unix domain sockets.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef SOCKETTRANSPORT_H
+#define SOCKETTRANSPORT_H
+
+#include "transport.h"
+#include <vector>
+
+// Each pair of ranks is connected by a socket pair created before launch().
+// The kernel buffers a few hundred kilobytes in each direction, so larger
+// messages are passed on as the receiver reads them.
+class SocketTransport : public Transport {
+	public:
+
+		// Constructors
+		// Creates the sockets of numRanks ranks. Check isOpen() for failure.
+		explicit SocketTransport(unsigned int numRanks);
+		~SocketTransport();
+
+		// Were all sockets created?
+		bool isOpen() const { return open; }
+
+	protected:
+		void attach(unsigned int rank);
+		bool write(unsigned int to, const char *data, unsigned long size);
+		bool read(unsigned int from, char *data, unsigned long size);
+
+	private:
+		std::vector<int> fds; // fds[i * numRanks() + j] is the end rank i uses to talk to rank j, -1 if closed
+		bool open;
+};
+
+#endif
@@ -0,0 +1,87 @@
+// sweepandprune.cpp - version 1.0
+// Functions declared in sweepandprune.h.
+// See sweepandprune.h for documentation of functions.
+
+#include "sweepandprune.h"
+#include <algorithm>
+
+// Maximum number of places the insertion sort in rebuild() may move balls,
+// per ball, before giving up and sorting from scratch. Balls only move
+// far in the list when the order was disturbed, e.g. by
+// BallsSim::reorderBalls().
+static const unsigned long MAX_MOVES_PER_BALL = 16;
+
+void SweepAndPrune::rebuild(const std::vector<BoundingBox> &newBoxes) {
+	bool coherent = newBoxes.size() == boxes.size();
+	boxes = newBoxes;
+	maxWidth = 0.;
+	for (unsigned long i = 0; i < boxes.size(); i++) {
+		if (boxes[i].x2() - boxes[i].x1() > maxWidth) maxWidth = boxes[i].x2() - boxes[i].x1();
+	}
+	if (!coherent) {
+		sortFromScratch();
+		return;
+	}
+
+	// Insertion sort starting from the previous order
+	unsigned long maxMoves = MAX_MOVES_PER_BALL * boxes.size();
+	unsigned long moves = 0;
+	for (unsigned long p = 1; p < order.size(); p++) {
+		moves += moveTowardsFront(p);
+		if (moves > maxMoves) {
+			sortFromScratch();
+			return;
+		}
+	}
+}
+
+void SweepAndPrune::update(unsigned long i, const BoundingBox &box) {
+	boxes[i] = box;
+	if (box.x2() - box.x1() > maxWidth) maxWidth = box.x2() - box.x1();
+	if (moveTowardsFront(rank[i]) == 0) moveTowardsBack(rank[i]);
+}
+
+unsigned long SweepAndPrune::moveTowardsFront(unsigned long p) {
+	unsigned long i = order[p];
+	double x1 = boxes[i].x1();
+	unsigned long q = p;
+	while (q > 0 && boxes[order[q - 1]].x1() > x1) {
+		order[q] = order[q - 1];
+		rank[order[q]] = q;
+		q--;
+	}
+	order[q] = i;
+	rank[i] = q;
+	return p - q;
+}
+
+unsigned long SweepAndPrune::moveTowardsBack(unsigned long p) {
+	unsigned long i = order[p];
+	double x1 = boxes[i].x1();
+	unsigned long q = p;
+	while (q + 1 < order.size() && boxes[order[q + 1]].x1() < x1) {
+		order[q] = order[q + 1];
+		rank[order[q]] = q;
+		q++;
+	}
+	order[q] = i;
+	rank[i] = q;
+	return q - p;
+}
+
+// Orders balls by the lowest x coordinate of their boxes
+struct LowerX {
+	const std::vector<BoundingBox> *boxes;
+	bool operator()(unsigned long i, unsigned long j) const {
+		return (*boxes)[i].x1() < (*boxes)[j].x1();
+	}
+};
+
+void SweepAndPrune::sortFromScratch() {
+	order.resize(boxes.size());
+	for (unsigned long i = 0; i < order.size(); i++) order[i] = i;
+	LowerX lowerX = { &boxes };
+	std::sort(order.begin(), order.end(), lowerX);
+	rank.resize(order.size());
+	for (unsigned long p = 0; p < order.size(); p++) rank[order[p]] = p;
+}
@@ -0,0 +1,86 @@
+// sweepandprune.h - version 1.0
+// Sweep-and-prune broad phase used by BallsSim to limit the pairs of balls
+// passed to findTimeUntilTwoBallsCollide(). Unlike CellGrid it has no cell
+// size, so it copes with very large balls mixed with tiny ones.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef SWEEPANDPRUNE_H
+#define SWEEPANDPRUNE_H
+
+#include "boundingbox.h"
+#include <vector>
+
+// Each ball is represented by a bounding box (normally the box swept by the
+// ball over the rest of the frame). The balls are kept sorted by the lowest
+// x coordinate of their boxes; two balls are candidates for a collision only
+// if their boxes overlap, which a sweep along the sorted list finds without
+// looking at pairs that are apart in x. Balls move little from one frame to
+// the next, so the list is re-sorted with an insertion sort, which is nearly
+// linear on a nearly sorted list.
+class SweepAndPrune {
+	public:
+
+		// Constructors
+		SweepAndPrune() {
+			maxWidth = 0.;
+		}
+
+		// Registers boxes, replacing the previous ones. Box i belongs to ball
+		// i. If the number of boxes is unchanged the previous order is used as
+		// the starting point of the sort.
+		void rebuild(const std::vector<BoundingBox> &newBoxes);
+
+		// Replaces the box of ball i, moving it in the sorted list as needed
+		void update(unsigned long i, const BoundingBox &box);
+
+		// Calls f(i, j) with i < j for each pair of balls whose boxes overlap
+		template <class F> void forEachPair(F f) const {
+			unsigned long n = order.size();
+			for (unsigned long p = 0; p < n; p++) {
+				unsigned long i = order[p];
+				const BoundingBox &bi = boxes[i];
+				// Balls after i in the list start at or after bi.x1(), so they
+				// overlap bi in x until one starts after bi.x2()
+				for (unsigned long q = p + 1; q < n && boxes[order[q]].x1() <= bi.x2(); q++) {
+					unsigned long j = order[q];
+					if (bi.overlaps(boxes[j])) {
+						if (i < j) f(i, j);
+						else f(j, i);
+					}
+				}
+			}
+		}
+
+		// Calls f(j) for each ball j != i whose box overlaps the box of ball i
+		template <class F> void forEachCandidate(unsigned long i, F f) const {
+			const BoundingBox &bi = boxes[i];
+			unsigned long p = rank[i];
+			for (unsigned long q = p + 1; q < order.size() && boxes[order[q]].x1() <= bi.x2(); q++) {
+				if (bi.overlaps(boxes[order[q]])) f(order[q]);
+			}
+			// A ball before i overlaps it in x only if it starts less than the
+			// widest box before bi.x1()
+			for (unsigned long q = p; q > 0 && boxes[order[q - 1]].x1() >= bi.x1() - maxWidth; q--) {
+				if (bi.overlaps(boxes[order[q - 1]])) f(order[q - 1]);
+			}
+		}
+
+	private:
+		std::vector<BoundingBox> boxes; // Current box of each ball
+		std::vector<unsigned long> order; // Balls sorted by boxes[i].x1()
+		std::vector<unsigned long> rank; // Position of each ball in order
+		double maxWidth; // Width in x of the widest box registered since the last rebuild
+
+		// Moves the ball at position p of order towards the front or back
+		// until the list is sorted again around it. Returns the number of
+		// places it moved.
+		unsigned long moveTowardsFront(unsigned long p);
+		unsigned long moveTowardsBack(unsigned long p);
+
+		// Sets order to all the balls sorted from scratch
+		void sortFromScratch();
+};
+
+#endif
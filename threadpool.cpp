@@ -0,0 +1,102 @@
+// threadpool.cpp - version 1.0
+// Functions declared in threadpool.h.
+// See threadpool.h for documentation of functions.
+
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(unsigned int n) : job(0), jobTasks(0), nextTask(0), generation(0), busy(0), quit(false) {
+	start(n);
+}
+
+ThreadPool::ThreadPool(const ThreadPool &other) : job(0), jobTasks(0), nextTask(0), generation(0), busy(0), quit(false) {
+	start(other.numThreads());
+}
+
+ThreadPool &ThreadPool::operator=(const ThreadPool &other) {
+	if (this != &other) setNumThreads(other.numThreads());
+	return *this;
+}
+
+ThreadPool::~ThreadPool() {
+	stop();
+}
+
+void ThreadPool::setNumThreads(unsigned int n) {
+	if (n == 0) n = std::thread::hardware_concurrency();
+	if (n == 0) n = 1; // hardware_concurrency() may not know
+	if (n == numThreads()) return;
+	stop();
+	start(n);
+}
+
+void ThreadPool::start(unsigned int n) {
+	if (n == 0) n = std::thread::hardware_concurrency();
+	quit = false;
+	for (unsigned int k = 1; k < n; k++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, generation));
+	}
+}
+
+void ThreadPool::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (unsigned long k = 0; k < workers.size(); k++) {
+		workers[k].join();
+	}
+	workers.clear();
+}
+
+void ThreadPool::run(unsigned long numTasks, const std::function<void(unsigned long)> &task) {
+	if (numTasks == 0) return;
+	
+	// Not worth waking the workers
+	if (workers.empty() || numTasks == 1) {
+		for (unsigned long k = 0; k < numTasks; k++) {
+			task(k);
+		}
+		return;
+	}
+	
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &task;
+		jobTasks = numTasks;
+		nextTask = 0;
+		busy = (unsigned int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+	
+	runTasks(); // The calling thread works too
+	
+	std::unique_lock<std::mutex> lock(mutex);
+	while (busy != 0) done.wait(lock);
+	job = 0;
+}
+
+void ThreadPool::runTasks() {
+	for (;;) {
+		unsigned long k = nextTask++;
+		if (k >= jobTasks) break;
+		(*job)(k);
+	}
+}
+
+void ThreadPool::workerLoop(unsigned long lastGeneration) {
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!quit && generation == lastGeneration) wake.wait(lock);
+			if (quit) return;
+			lastGeneration = generation;
+		}
+		
+		runTasks();
+		
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busy == 0) done.notify_one();
+	}
+}
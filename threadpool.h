@@ -0,0 +1,67 @@
+// threadpool.h - version 1.0
+// A persistent pool of worker threads that runs numbered tasks in parallel.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// The threads are started once and sleep between calls to run(), so using
+// the pool for many short parallel loops (e.g. once per collision) is cheap.
+// The thread calling run() takes part in the work, so a pool of n threads
+// has n - 1 workers. Copying a pool creates a new pool with the same number
+// of threads; this keeps classes that own a pool copyable.
+class ThreadPool {
+	public:
+
+		// Constructors
+		// n = total number of threads, including the caller of run()
+		explicit ThreadPool(unsigned int n = 1);
+		ThreadPool(const ThreadPool &other);
+		ThreadPool &operator=(const ThreadPool &other);
+		~ThreadPool();
+
+		// Change the number of threads. 0 means one per hardware thread.
+		void setNumThreads(unsigned int n);
+
+		// Total number of threads, including the caller of run()
+		unsigned int numThreads() const { return (unsigned int)workers.size() + 1; }
+
+		// Calls task(k) once for each k in [0, numTasks), spread over the
+		// threads of the pool, and returns when all calls have finished.
+		// Tasks are handed out in increasing order of k as threads become free.
+		// Must not be called from inside a task.
+		void run(unsigned long numTasks, const std::function<void(unsigned long)> &task);
+
+	private:
+		std::vector<std::thread> workers; // Worker threads
+		std::mutex mutex; // Protects the members below
+		std::condition_variable wake; // Signals workers that there is a new job or they must quit
+		std::condition_variable done; // Signals run() that all workers have finished the job
+		const std::function<void(unsigned long)> *job; // Current job
+		unsigned long jobTasks; // Number of tasks in the current job
+		std::atomic<unsigned long> nextTask; // Next task of the current job to hand out
+		unsigned long generation; // Incremented for each job so workers can tell a new one has started
+		unsigned int busy; // Number of workers still working on the current job
+		bool quit; // Tells the workers to exit
+
+		// Starts n - 1 workers
+		void start(unsigned int n);
+		// Stops and joins all workers
+		void stop();
+		// Main function of a worker thread. lastGeneration is the generation
+		// when the worker was started; it waits for the next one.
+		void workerLoop(unsigned long lastGeneration);
+		// Runs tasks of the current job until there are none left
+		void runTasks();
+};
+
+#endif
@@ -0,0 +1,85 @@
+// trajectoryformat.h - version 1.1
+// Layout of the trajectory files written by TrajectoryWriter and read by
+// TrajectoryReader, and the integer coding they share.
+// Revisions:
+//   1.0:
+//     - initial version
+//   1.1:
+//     - added the longest varints of a payload
+
+#ifndef TRAJECTORYFORMAT_H
+#define TRAJECTORYFORMAT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// A trajectory file is a TrajectoryHeader followed by one record per frame:
+//   kind           1 byte, TRAJECTORY_KEYFRAME or TRAJECTORY_DELTA
+//   frame number   varint; numbers skipped are frames that were dropped
+//   time           8-byte double, simulated time at the end of the frame
+//   number of balls varint
+//   payload size   varint, in bytes
+//   payload
+// Positions and velocities are quantised to multiples of the precisions in
+// the header and the balls are sorted by ID. A keyframe payload holds the
+// IDs, each as the zigzag varint of its difference from the previous one,
+// then the quantised x of all balls, then y, vx and vy, each as a zigzag
+// varint. A delta payload holds only the four arrays, as the differences
+// from the quantised values of the previous frame, which always has the
+// same balls. Slowly moving balls thus take one or two bytes per number.
+struct TrajectoryHeader {
+	char magic[8]; // TRAJECTORY_MAGIC
+	uint32_t version; // TRAJECTORY_VERSION
+	uint32_t byteOrder; // TRAJECTORY_BYTE_ORDER as written
+	uint32_t keyframeInterval; // Maximum number of frames from one keyframe to the next
+	uint32_t reserved; // 0
+	double positionPrecision;
+	double velocityPrecision;
+};
+
+const char TRAJECTORY_MAGIC[8] = { 'B', 'S', 'I', 'M', 'T', 'R', 'A', 'J' };
+const uint32_t TRAJECTORY_VERSION = 1;
+const uint32_t TRAJECTORY_BYTE_ORDER = 0x01020304;
+const unsigned char TRAJECTORY_KEYFRAME = 'K';
+const unsigned char TRAJECTORY_DELTA = 'D';
+
+// Longest varints in a payload: the difference of two int IDs needs 33
+// bits, and a quantised value, kept within +-4e18 by the writer, or its
+// change, 64
+const unsigned int TRAJECTORY_MAX_ID_BYTES = 5;
+const unsigned int TRAJECTORY_MAX_VALUE_BYTES = 10;
+
+// Appends v to out as a varint: 7 bits per byte, low bits first, with the
+// top bit set on all bytes but the last
+inline void putVarint(std::vector<unsigned char> &out, uint64_t v) {
+	while (v >= 0x80) {
+		out.push_back((unsigned char)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((unsigned char)v);
+}
+
+// Reads a varint from p, which must be before end. Returns false if it is
+// cut off or too long.
+inline bool getVarint(const unsigned char *&p, const unsigned char *end, uint64_t &v) {
+	v = 0;
+	for (int shift = 0; shift < 64 && p < end; shift += 7) {
+		unsigned char b = *p++;
+		v |= uint64_t(b & 0x7F) << shift;
+		if ((b & 0x80) == 0) return true;
+	}
+	return false;
+}
+
+// Zigzag coding maps signed numbers of small magnitude to small unsigned
+// numbers: 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+inline uint64_t zigzag(int64_t v) {
+	return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+inline int64_t unzigzag(uint64_t v) {
+	return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+#endif
@@ -0,0 +1,87 @@
+// trajectoryreader.cpp - version 1.1
+// Functions declared in trajectoryreader.h.
+// See trajectoryreader.h for documentation of functions.
+
+#include "trajectoryreader.h"
+#include <cstring>
+
+bool TrajectoryReader::open(const char *fileName) {
+	close();
+	file = fopen(fileName, "rb");
+	if (file == 0) return false;
+	if (fread(&h, sizeof(h), 1, file) != 1 || memcmp(h.magic, TRAJECTORY_MAGIC, sizeof(h.magic)) != 0 ||
+		h.version != TRAJECTORY_VERSION || h.byteOrder != TRAJECTORY_BYTE_ORDER) {
+		close();
+		return false;
+	}
+	damaged = false;
+	haveKeyframe = false;
+	return true;
+}
+
+void TrajectoryReader::close() {
+	if (file != 0) fclose(file);
+	file = 0;
+}
+
+bool TrajectoryReader::readVarint(uint64_t &v) {
+	v = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int b = fgetc(file);
+		if (b == EOF) return false;
+		v |= uint64_t(b & 0x7F) << shift;
+		if ((b & 0x80) == 0) return true;
+	}
+	return false;
+}
+
+bool TrajectoryReader::nextFrame(TrajectoryFrame &f) {
+	if (file == 0 || damaged) return false;
+	int kind = fgetc(file);
+	if (kind == EOF) return false; // End of the file
+	damaged = true; // Until the whole record has been read
+
+	uint64_t number, n, size;
+	unsigned char time[8];
+	if (!readVarint(number) || fread(time, 8, 1, file) != 1 || !readVarint(n) || !readVarint(size)) return false;
+	if (kind != TRAJECTORY_KEYFRAME && (kind != TRAJECTORY_DELTA || !haveKeyframe || n != ids.size())) return false;
+	// No more than the longest varints of a frame of n balls, which have
+	// int IDs, so there are at most 2^32 of them
+	uint64_t ballBytes = 4 * TRAJECTORY_MAX_VALUE_BYTES + (kind == TRAJECTORY_KEYFRAME ? TRAJECTORY_MAX_ID_BYTES : 0);
+	if (n > 0xFFFFFFFFULL || size > ballBytes * n) return false;
+	payload.resize(size);
+	if (size > 0 && fread(payload.data(), 1, size, file) != size) return false;
+
+	const unsigned char *p = payload.data();
+	const unsigned char *end = p + size;
+	uint64_t v;
+	if (kind == TRAJECTORY_KEYFRAME) {
+		ids.resize(n);
+		int64_t prev = 0;
+		for (uint64_t k = 0; k < n; k++) {
+			if (!getVarint(p, end, v)) return false;
+			prev += unzigzag(v);
+			ids[k] = int(prev);
+		}
+		for (int c = 0; c < 4; c++) q[c].assign(n, 0);
+	}
+	std::vector<double> *values[4] = { &f.x, &f.y, &f.vx, &f.vy };
+	for (int c = 0; c < 4; c++) {
+		double precision = c < 2 ? h.positionPrecision : h.velocityPrecision;
+		values[c]->resize(n);
+		for (uint64_t k = 0; k < n; k++) {
+			if (!getVarint(p, end, v)) return false;
+			q[c][k] += unzigzag(v);
+			(*values[c])[k] = double(q[c][k]) * precision;
+		}
+	}
+	if (p != end) return false;
+
+	f.number = number;
+	memcpy(&f.time, time, 8);
+	f.keyframe = kind == TRAJECTORY_KEYFRAME;
+	f.ids = ids;
+	haveKeyframe = true;
+	damaged = false;
+	return true;
+}
@@ -0,0 +1,64 @@
+// trajectoryreader.h - version 1.0
+// Reads the trajectory files written by TrajectoryWriter.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef TRAJECTORYREADER_H
+#define TRAJECTORYREADER_H
+
+#include "trajectoryformat.h"
+#include <cstdio>
+#include <vector>
+#include <cstdint>
+
+// One frame of a trajectory. The balls are sorted by ID and the positions
+// and velocities are multiples of the precisions of the file.
+struct TrajectoryFrame {
+	unsigned long long number; // Frame number; gaps are dropped frames
+	double time; // Simulated time
+	bool keyframe;
+	std::vector<int> ids;
+	std::vector<double> x, y, vx, vy;
+};
+
+class TrajectoryReader {
+	public:
+
+		// Constructors
+		TrajectoryReader() { file = 0; }
+		~TrajectoryReader() { close(); }
+
+		// Opens a trajectory file and reads its header. Returns false if it
+		// cannot be opened or is not a trajectory file.
+		bool open(const char *fileName);
+
+		void close();
+
+		// Reads the next frame into f. Returns false at the end of the file
+		// or if the file is damaged (see isDamaged()).
+		bool nextFrame(TrajectoryFrame &f);
+
+		// Get methods
+		const TrajectoryHeader &header() const { return h; }
+		// Did nextFrame() stop at a damaged record rather than the end of the file?
+		bool isDamaged() const { return damaged; }
+
+	private:
+		FILE *file;
+		TrajectoryHeader h;
+		bool damaged;
+		bool haveKeyframe; // Has a keyframe been read, so deltas can be decoded?
+		std::vector<int> ids; // IDs of the balls since the last keyframe
+		std::vector<int64_t> q[4]; // Quantised x, y, vx, vy of the last frame
+		std::vector<unsigned char> payload;
+
+		// Not copyable: the file belongs to one object
+		TrajectoryReader(const TrajectoryReader &);
+		TrajectoryReader &operator=(const TrajectoryReader &);
+
+		// Reads a varint from the file
+		bool readVarint(uint64_t &v);
+};
+
+#endif
@@ -0,0 +1,196 @@
+// trajectorywriter.cpp - version 1.0
+// Functions declared in trajectorywriter.h.
+// See trajectorywriter.h for documentation of functions.
+
+#include "trajectorywriter.h"
+#include "trajectoryformat.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+TrajectoryWriter::TrajectoryWriter() {
+	positionPrecision = 1e-3;
+	velocityPrecision = 1e-3;
+	keyframeInterval = 100;
+	maxQueuedFrames = 4;
+	waitWhenFull = false;
+	file = 0;
+	numAdded = numDropped = numBytes = 0;
+	quit = false;
+	failed = false;
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+	close();
+}
+
+bool TrajectoryWriter::open(const char *fileName) {
+	close();
+	file = fopen(fileName, "wb");
+	if (file == 0) return false;
+
+	TrajectoryHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, TRAJECTORY_MAGIC, sizeof(h.magic));
+	h.version = TRAJECTORY_VERSION;
+	h.byteOrder = TRAJECTORY_BYTE_ORDER;
+	h.keyframeInterval = keyframeInterval;
+	h.positionPrecision = positionPrecision;
+	h.velocityPrecision = velocityPrecision;
+	failed = fwrite(&h, sizeof(h), 1, file) != 1;
+
+	numAdded = numDropped = 0;
+	numBytes = sizeof(h);
+	quit = false;
+	frames.assign(maxQueuedFrames, Frame());
+	freeFrames.clear();
+	for (unsigned int k = 0; k < maxQueuedFrames; k++) freeFrames.push_back(&frames[k]);
+	queue.clear();
+	lastIDs.clear();
+	orderIDs.clear();
+	lastNumber = 0;
+	framesSinceKey = keyframeInterval; // The first frame is a keyframe
+	writer = std::thread(&TrajectoryWriter::writerLoop, this);
+	return true;
+}
+
+bool TrajectoryWriter::close() {
+	if (file == 0) return true;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	queued.notify_one();
+	writer.join();
+	if (fclose(file) != 0) failed = true;
+	file = 0;
+	return !failed;
+}
+
+TrajectoryWriter::Frame *TrajectoryWriter::acquireFrame() {
+	if (file == 0) return 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	if (waitWhenFull) {
+		freed.wait(lock, [this] { return !freeFrames.empty(); });
+	}
+	if (freeFrames.empty()) {
+		numAdded++;
+		numDropped++;
+		return 0;
+	}
+	Frame *f = freeFrames.back();
+	freeFrames.pop_back();
+	f->number = numAdded++;
+	return f;
+}
+
+void TrajectoryWriter::queueFrame(Frame *f) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(f);
+	}
+	queued.notify_one();
+}
+
+void TrajectoryWriter::writerLoop() {
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		queued.wait(lock, [this] { return !queue.empty() || quit; });
+		if (queue.empty()) return; // quit and nothing left to write
+		Frame *f = queue.front();
+		queue.pop_front();
+		bool skip = failed;
+		lock.unlock();
+
+		bool ok = true;
+		if (!skip) {
+			encodeFrame(*f);
+			ok = fwrite(record.data(), 1, record.size(), file) == record.size();
+		}
+
+		lock.lock();
+		if (!ok) failed = true;
+		else if (!skip) numBytes += record.size();
+		freeFrames.push_back(f);
+		freed.notify_one();
+	}
+}
+
+// Multiple of precision nearest to v, kept within a range where the
+// differences between frames cannot overflow
+static int64_t quantise(double v, double precision) {
+	const double limit = 4e18;
+	double q = std::floor(v / precision + .5);
+	if (!(q > -limit)) q = -limit; // Also catches NaN
+	if (q > limit) q = limit;
+	return int64_t(q);
+}
+
+void TrajectoryWriter::encodeFrame(const Frame &f) {
+	unsigned long n = f.ids.size();
+
+	// Sort the balls by ID. The order only changes when the balls are
+	// reordered or added, so it is reused while the IDs by index are the same.
+	if (f.ids != orderIDs) {
+		order.resize(n);
+		for (unsigned long i = 0; i < n; i++) order[i] = i;
+		std::sort(order.begin(), order.end(), [&f](unsigned long a, unsigned long b) { return f.ids[a] < f.ids[b]; });
+		orderIDs = f.ids;
+	}
+
+	// A delta needs the previous frame, with the same balls
+	bool key = lastIDs.size() != n || f.number != lastNumber + 1 || framesSinceKey + 1 >= keyframeInterval;
+	for (unsigned long k = 0; k < n && !key; k++) {
+		if (f.ids[order[k]] != lastIDs[k]) key = true;
+	}
+
+	payload.clear();
+	if (key) {
+		lastIDs.resize(n);
+		int64_t prev = 0;
+		for (unsigned long k = 0; k < n; k++) {
+			lastIDs[k] = f.ids[order[k]];
+			putVarint(payload, zigzag(int64_t(lastIDs[k]) - prev));
+			prev = lastIDs[k];
+		}
+	}
+	const std::vector<double> *values[4] = { &f.x, &f.y, &f.vx, &f.vy };
+	for (int c = 0; c < 4; c++) {
+		double precision = c < 2 ? positionPrecision : velocityPrecision;
+		const std::vector<double> &v = *values[c];
+		std::vector<int64_t> &last = lastQ[c];
+		if (key) last.assign(n, 0);
+		for (unsigned long k = 0; k < n; k++) {
+			int64_t q = quantise(v[order[k]], precision);
+			putVarint(payload, zigzag(q - last[k]));
+			last[k] = q;
+		}
+	}
+	framesSinceKey = key ? 0 : framesSinceKey + 1;
+	lastNumber = f.number;
+
+	record.clear();
+	record.push_back(key ? TRAJECTORY_KEYFRAME : TRAJECTORY_DELTA);
+	putVarint(record, f.number);
+	unsigned char time[8];
+	memcpy(time, &f.time, 8);
+	record.insert(record.end(), time, time + 8);
+	putVarint(record, n);
+	putVarint(record, payload.size());
+	record.insert(record.end(), payload.begin(), payload.end());
+}
+
+unsigned long long TrajectoryWriter::framesAdded() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return numAdded;
+}
+
+unsigned long long TrajectoryWriter::framesDropped() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return numDropped;
+}
+
+unsigned long long TrajectoryWriter::bytesWritten() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return numBytes;
+}
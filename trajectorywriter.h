@@ -0,0 +1,133 @@
+// trajectorywriter.h - version 1.0
+// Writes the positions and velocities of the balls at every frame to a
+// compressed trajectory file (see trajectoryformat.h) on a background thread.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef TRAJECTORYWRITER_H
+#define TRAJECTORYWRITER_H
+
+#include <cstdio>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+// The simulation thread only copies each frame into one of a fixed number of
+// buffers; the background thread quantises, encodes and writes it. If all
+// buffers are waiting to be written the frame is dropped (and the next frame
+// written is a keyframe), unless setWaitWhenFull(true) makes addFrame() wait
+// for a buffer instead. BallsSim::setTrajectoryWriter() adds a frame at the
+// end of every call to advanceSim().
+class TrajectoryWriter {
+	public:
+
+		// Constructors
+		TrajectoryWriter();
+		~TrajectoryWriter(); // Closes the file
+
+		// Settings, used by the next open()
+		// Positions and velocities are written as multiples of these
+		void setPositionPrecision(double p) { positionPrecision = p; }
+		void setVelocityPrecision(double p) { velocityPrecision = p; }
+		// A keyframe is written at least every n frames (n >= 1)
+		void setKeyframeInterval(unsigned int n) { keyframeInterval = n > 0 ? n : 1; }
+		// Number of frames that can wait to be written
+		void setMaxQueuedFrames(unsigned int n) { maxQueuedFrames = n > 0 ? n : 1; }
+		// Should addFrame() wait for a free buffer rather than drop the frame?
+		void setWaitWhenFull(bool wait) { waitWhenFull = wait; }
+
+		// Creates the file and starts the background thread. Returns false
+		// if the file cannot be created.
+		bool open(const char *fileName);
+
+		// Writes the frames still queued, stops the thread and closes the
+		// file. Returns false if any write failed.
+		bool close();
+
+		// Is a file open?
+		bool isOpen() const { return file != 0; }
+
+		// Queues the balls of store (a BallStoreT) as the state at simulated
+		// time. Returns false if the frame was dropped or no file is open.
+		template <class S> bool addFrame(double time, const S &store) {
+			Frame *f = acquireFrame();
+			if (f == 0) return false;
+			unsigned long n = store.size();
+			f->time = time;
+			f->x.assign(store.x(), store.x() + n);
+			f->y.assign(store.y(), store.y() + n);
+			f->vx.assign(store.vx(), store.vx() + n);
+			f->vy.assign(store.vy(), store.vy() + n);
+			f->ids.resize(n);
+			for (unsigned long i = 0; i < n; i++) f->ids[i] = store.id(i);
+			queueFrame(f);
+			return true;
+		}
+
+		// Get methods
+		// Frames passed to addFrame() since open(), including dropped ones
+		unsigned long long framesAdded() const;
+		// Frames dropped because all buffers were full
+		unsigned long long framesDropped() const;
+		// Bytes written to the file so far
+		unsigned long long bytesWritten() const;
+
+	private:
+		// A frame waiting to be written
+		struct Frame {
+			unsigned long long number; // Frame number since open()
+			double time;
+			std::vector<int> ids;
+			std::vector<double> x, y, vx, vy;
+		};
+
+		double positionPrecision;
+		double velocityPrecision;
+		unsigned int keyframeInterval;
+		unsigned int maxQueuedFrames;
+		bool waitWhenFull;
+
+		FILE *file; // 0 if not open
+		std::thread writer; // Background thread
+		mutable std::mutex mutex; // Protects the members below
+		std::condition_variable queued; // Signals the writer that a frame was queued or it must quit
+		std::condition_variable freed; // Signals addFrame() that a buffer is free
+		std::vector<Frame> frames; // Buffers
+		std::vector<Frame *> freeFrames; // Buffers not in use
+		std::deque<Frame *> queue; // Frames waiting to be written, oldest first
+		unsigned long long numAdded;
+		unsigned long long numDropped;
+		unsigned long long numBytes;
+		bool quit; // Tells the writer to exit once the queue is empty
+		bool failed; // A write failed
+
+		// State of the writer thread only
+		std::vector<int> lastIDs; // Sorted IDs of the last frame written
+		std::vector<unsigned long> order; // Indices of the last frame's balls sorted by ID
+		std::vector<int> orderIDs; // IDs, by index, for which order was computed
+		std::vector<int64_t> lastQ[4]; // Quantised x, y, vx, vy of the last frame written
+		unsigned long long lastNumber; // Number of the last frame written
+		unsigned int framesSinceKey; // Frames written since the last keyframe
+		std::vector<unsigned char> payload; // Encoded balls of a frame
+		std::vector<unsigned char> record; // Encoded frame, with its payload
+
+		// Not copyable: the thread and file belong to one object
+		TrajectoryWriter(const TrajectoryWriter &);
+		TrajectoryWriter &operator=(const TrajectoryWriter &);
+
+		// Takes a free buffer, waiting for one if waitWhenFull. Returns 0 and
+		// counts the frame as dropped if there is none.
+		Frame *acquireFrame();
+		// Passes a filled buffer to the writer thread
+		void queueFrame(Frame *f);
+		// Main function of the writer thread
+		void writerLoop();
+		// Encodes f into record
+		void encodeFrame(const Frame &f);
+};
+
+#endif
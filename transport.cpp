@@ -0,0 +1,90 @@
+// transport.cpp - version 1.0
+// Functions declared in transport.h.
+// See transport.h for documentation of functions.
+
+#include "transport.h"
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/wait.h>
+
+Transport::Transport(unsigned int numRanks) {
+	irank = 0;
+	inumRanks = numRanks > 0 ? numRanks : 1;
+	ibytesSent = 0;
+	ibytesReceived = 0;
+}
+
+Transport::~Transport() {
+}
+
+unsigned int Transport::launch() {
+	for (unsigned int r = 1; r < inumRanks; r++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			children.clear();
+			irank = r;
+			attach(r);
+			return r;
+		}
+		if (pid < 0) {
+			// Without all ranks the others would wait for it forever
+			for (unsigned long k = 0; k < children.size(); k++) {
+				kill(children[k], SIGKILL);
+			}
+			join();
+			return inumRanks;
+		}
+		children.push_back(pid);
+	}
+	attach(0);
+	return 0;
+}
+
+bool Transport::join() {
+	bool ok = true;
+	for (unsigned long k = 0; k < children.size(); k++) {
+		int status;
+		while (waitpid(children[k], &status, 0) < 0) {
+			if (errno != EINTR) {
+				status = -1;
+				break;
+			}
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+	}
+	children.clear();
+	return ok;
+}
+
+bool Transport::send(unsigned int to, const void *data, unsigned long size) {
+	if (to >= inumRanks || to == irank) return false;
+	if (!write(to, (const char *)data, size)) return false;
+	ibytesSent += size;
+	return true;
+}
+
+bool Transport::receive(unsigned int from, void *data, unsigned long size) {
+	if (from >= inumRanks || from == irank) return false;
+	if (!read(from, (char *)data, size)) return false;
+	ibytesReceived += size;
+	return true;
+}
+
+bool Transport::sendMessage(unsigned int to, const std::vector<char> &message) {
+	unsigned long long size = message.size();
+	if (!send(to, &size, sizeof(size))) return false;
+	return size == 0 || send(to, &message[0], (unsigned long)size);
+}
+
+bool Transport::receiveMessage(unsigned int from, std::vector<char> &message) {
+	unsigned long long size;
+	if (!receive(from, &size, sizeof(size))) return false;
+	message.resize((unsigned long)size);
+	return size == 0 || receive(from, &message[0], (unsigned long)size);
+}
+
+bool Transport::exchange(unsigned int peer, const std::vector<char> &out, std::vector<char> &in) {
+	if (irank < peer) return sendMessage(peer, out) && receiveMessage(peer, in);
+	return receiveMessage(peer, in) && sendMessage(peer, out);
+}
@@ -0,0 +1,85 @@
+// transport.h - version 1.0
+// Base class of the channels through which the processes (ranks) of a
+// DomainSim exchange messages.
+// Revisions:
+//   1.0:
+//     - initial version
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <vector>
+#include <sys/types.h>
+
+// A transport connects numRanks() processes on one host, each of which can
+// send a stream of bytes to any other. It is created in one process before
+// the others exist; launch() then forks the other ranks, which inherit it.
+// Bytes sent from one rank to another arrive in order; send() may block
+// until the receiver has read earlier bytes, so two ranks must not send
+// large messages to each other at the same time. exchange() orders the two
+// directions so that they cannot block each other.
+//
+// Implementations (POSIX only): SocketTransport and SharedMemoryTransport.
+class Transport {
+	public:
+
+		// Constructors
+		explicit Transport(unsigned int numRanks);
+		virtual ~Transport();
+
+		// Starts ranks 1 to numRanks() - 1 as child processes of the caller,
+		// which becomes rank 0. Returns the rank of the process it returns
+		// in. A child must end with _exit() or exit() once its work is done,
+		// without returning to the code of rank 0. Returns numRanks() (in
+		// the caller only) if a process could not be started.
+		unsigned int launch();
+
+		// In rank 0, waits for the other ranks to exit. Returns true if all
+		// exited with status 0.
+		bool join();
+
+		// Get methods
+		unsigned int rank() const { return irank; }
+		unsigned int numRanks() const { return inumRanks; }
+		// Bytes sent and received by this rank so far
+		unsigned long long bytesSent() const { return ibytesSent; }
+		unsigned long long bytesReceived() const { return ibytesReceived; }
+
+		// Sends size bytes to rank to, or receives size bytes from rank from.
+		// Both block until done. Return false if the other rank has gone.
+		bool send(unsigned int to, const void *data, unsigned long size);
+		bool receive(unsigned int from, void *data, unsigned long size);
+
+		// Sends a message, or receives one into message, replacing its
+		// contents. A message is its size followed by its bytes.
+		bool sendMessage(unsigned int to, const std::vector<char> &message);
+		bool receiveMessage(unsigned int from, std::vector<char> &message);
+
+		// Sends out to rank peer and receives in from it, which must call
+		// exchange() with this rank at the same time. The lower rank sends
+		// first, so exchanges between disjoint pairs of ranks run in parallel.
+		bool exchange(unsigned int peer, const std::vector<char> &out, std::vector<char> &in);
+
+	protected:
+		// Called in each process by launch() once its rank is known, to drop
+		// the parts of the transport other ranks use
+		virtual void attach(unsigned int /* rank */) { }
+
+		// Called by send() and receive() to move the bytes
+		virtual bool write(unsigned int to, const char *data, unsigned long size) = 0;
+		virtual bool read(unsigned int from, char *data, unsigned long size) = 0;
+
+	private:
+		// Note: i stands for internal
+		unsigned int irank;
+		unsigned int inumRanks;
+		unsigned long long ibytesSent;
+		unsigned long long ibytesReceived;
+		std::vector<pid_t> children; // Processes of ranks 1 to numRanks() - 1, in rank 0
+
+		// Not copyable: the processes share one transport
+		Transport(const Transport &other);
+		Transport &operator=(const Transport &other);
+};
+
+#endif
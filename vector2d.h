@@ -1,72 +1,82 @@
 // Declarations for 2-D vectors
 // Copyright 2006 Chad Berchek
-// Version 1.1
+// Version 1.2
 // Revisions:
 //   1.1: (compatible with 1.0)
 //     - added operator-
+//   1.2: (compatible with 1.1)
+//     - made Vector2D a template on the scalar type, Vector2DT. Vector2D is Vector2DT<SimScalar>.
 
 #ifndef VECTOR2D_H
 #define VECTOR2D_H
 
+#include "scalar.h"
 #include <cmath>
 
-class Vector2D {
+template <class T>
+class Vector2DT {
 	public:
+		typedef T Scalar;
 
 		// Constructors
-		Vector2D() : internalX(0.), internalY(0.) { }
-		Vector2D(double ix, double iy) : internalX(ix), internalY(iy) { }
+		Vector2DT() : internalX(0), internalY(0) { }
+		Vector2DT(T ix, T iy) : internalX(ix), internalY(iy) { }
 
 		// Get / set methods
-		double x() const { return internalX; }
-		double y() const { return internalY; }
-		void setX(const double sx) { internalX = sx; }
-		void setY(const double sy) { internalY = sy; }
-		void setXY(const double sx, const double sy) { setX(sx); setY(sy); }
+		T x() const { return internalX; }
+		T y() const { return internalY; }
+		void setX(const T sx) { internalX = sx; }
+		void setY(const T sy) { internalY = sy; }
+		void setXY(const T sx, const T sy) { setX(sx); setY(sy); }
 		
 		// Member functions
 		// Get magnitude of vector
-		double magnitude() const {
+		T magnitude() const {
 			return std::sqrt(x() * x() + y() * y());
 		}
 
 		// Get a unit vector in the direction of this vector
 		// If this vector is the 0 vector, return a 0 vector
-		Vector2D unitVector() const {
-			double mag = magnitude();
-			if (mag != 0.) return Vector2D(x() / mag, y() / mag);
-			else return Vector2D();
+		Vector2DT unitVector() const {
+			T mag = magnitude();
+			if (mag != 0) return Vector2DT(x() / mag, y() / mag);
+			else return Vector2DT();
 		}
 
 		// Operators
 		// Addition
-		Vector2D operator+(const Vector2D &right) const {
-			return Vector2D(x() + right.x(), y() + right.y());
+		Vector2DT operator+(const Vector2DT &right) const {
+			return Vector2DT(x() + right.x(), y() + right.y());
 		}
 		
 		// Subtraction
-		Vector2D operator-(const Vector2D &right) const {
-			return Vector2D(x() - right.x(), y() - right.y());
+		Vector2DT operator-(const Vector2DT &right) const {
+			return Vector2DT(x() - right.x(), y() - right.y());
 		}
 		
 		// Dot product
-		double operator*(const Vector2D &right) const {
+		T operator*(const Vector2DT &right) const {
 			return (x() * right.x() + y() * right.y());
 		}
 		
 	private:
-		double internalX;
-		double internalY;
+		T internalX;
+		T internalY;
 };
 
-// Multiplication by a scalar (c * vector)
-inline Vector2D operator*(const double c, const Vector2D &right) {
-	return Vector2D(c * right.x(), c * right.y());
+typedef Vector2DT<SimScalar> Vector2D;
+
+// Multiplication by a scalar (c * vector). The scalar is converted to the
+// type of the vector.
+template <class T>
+inline Vector2DT<T> operator*(const typename Vector2DT<T>::Scalar c, const Vector2DT<T> &right) {
+	return Vector2DT<T>(c * right.x(), c * right.y());
 }
 
 // Multiplication by a scalar (vector * c)
-inline Vector2D operator*(const Vector2D &left, const double c) {
-	return c * left; // Call operator*(double, Vector2D&) above
+template <class T>
+inline Vector2DT<T> operator*(const Vector2DT<T> &left, const typename Vector2DT<T>::Scalar c) {
+	return c * left; // Call operator*(T, Vector2DT&) above
 }
 
 #endif
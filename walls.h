@@ -1,29 +1,43 @@
-// walls.h version 2.0 - Walls class for holding wall coordinates and enum for
+// walls.h version 2.1 - Walls class for holding wall coordinates and enum for
 // specifying a wall.
 // Copyright 2006 Chad Berchek
 // Not compatible with Walls version 1.0
 // Changes:
 //   2.0:
 //     - made struct into a class for future compatibility
+//   2.1: (compatible with 2.0)
+//     - made Walls a template on the scalar type, WallsT. Walls is WallsT<SimScalar>.
+//       The Wall enum is in the base class WallsBase so it is the same type for all WallsT.
 
 #ifndef WALLS_H
 #define WALLS_H
 
+#include "scalar.h"
+
+// Constants identifying a wall. They are in a base class of WallsT so that
+// Walls::Wall is the same type whatever the scalar type of the walls.
+class WallsBase {
+	public:
+		enum Wall { NONE, X1, Y1, X2, Y2 };
+};
+
 // x1 is the the wall with the lowest x coordinate, x2 is the
 // wall with the highest x coordinate. y1 is the
 // wall with the lowest y coordinate and y2 is the wall
 // with the highest y coordinate. The terms "top, bottom, left, and
 // right" are avoided because their meaning depends on the orientation
 // of the coordinate system.
-class Walls {
+template <class T>
+class WallsT : public WallsBase {
 	public:
+		typedef T Scalar;
 
 		// Constructors
-		Walls() {
-			ix1 = ix2 = iy1 = iy2 = 0.;
+		WallsT() {
+			ix1 = ix2 = iy1 = iy2 = 0;
 		}
 		
-		Walls(double sx1, double sy1, double sx2, double sy2) {
+		WallsT(T sx1, T sy1, T sx2, T sy2) {
 			ix1 = sx1;
 			iy1 = sy1;
 			ix2 = sx2;
@@ -31,25 +45,24 @@ class Walls {
 		}
 		
 		// Get methods
-		double x1() const { return ix1; }
-		double y1() const { return iy1; }
-		double x2() const { return ix2; }
-		double y2() const { return iy2; }
+		T x1() const { return ix1; }
+		T y1() const { return iy1; }
+		T x2() const { return ix2; }
+		T y2() const { return iy2; }
 
 		// Set methods
-		void setX1(const double sx1) { ix1 = sx1; }
-		void setY1(const double sy1) { iy1 = sy1; }
-		void setX2(const double sx2) { ix2 = sx2; }
-		void setY2(const double sy2) { iy2 = sy2; }
-
-		// Constants
-		enum Wall { NONE, X1, Y1, X2, Y2 };
+		void setX1(const T sx1) { ix1 = sx1; }
+		void setY1(const T sy1) { iy1 = sy1; }
+		void setX2(const T sx2) { ix2 = sx2; }
+		void setY2(const T sy2) { iy2 = sy2; }
 
 	private:
-      double ix1;
-		double iy1;
-		double ix2;
-		double iy2;
+      T ix1;
+		T iy1;
+		T ix2;
+		T iy2;
 };
 
+typedef WallsT<SimScalar> Walls;
+
 #endif